@@ -0,0 +1,337 @@
+#include "AsyncLCD.h"
+
+// PCF8574 wiring used by LiquidCrystal_I2C backpacks
+static const uint8_t LCD_EN = 0x04;         // Enable strobe
+static const uint8_t LCD_RS = 0x01;         // Register select (1 = data)
+static const uint8_t LCD_BACKLIGHT = 0x08;
+static const uint8_t LCD_SET_DDRAM = 0x80;  // Set address command
+static const uint8_t LCD_SET_CGRAM = 0x40;  // Set glyph address command
+static const uint8_t ROW_OFFSETS[4] = { 0x00, 0x40, 0x14, 0x54 };
+
+/**
+ * @brief Constructor
+ * @param display LiquidCrystal_I2C object for the same display (used by begin())
+ * @param i2cAddress PCF8574 address, e.g. 0x27
+ * @param columns Display width (capped at ASYNC_LCD_COLS)
+ * @param rowCount Display height (capped at ASYNC_LCD_ROWS)
+ */
+AsyncLCD::AsyncLCD(LiquidCrystal_I2C& display, uint8_t i2cAddress, uint8_t columns, uint8_t rowCount) {
+  driver = &display;
+  address = i2cAddress;
+  cols = min(columns, (uint8_t)ASYNC_LCD_COLS);
+  rows = min(rowCount, (uint8_t)ASYNC_LCD_ROWS);
+
+  memset(target, ' ', sizeof(target));
+  memset(shown, ' ', sizeof(shown));
+  dirty = false;
+  backlogged = false;
+  superseded = false;
+  droppedFrames = 0;
+
+  cursorCol = 0;
+  cursorRow = 0;
+  lcdCol = 255;
+  lcdRow = 255;
+  cgramAddress = 255;
+
+  memset(glyphTarget, 0, sizeof(glyphTarget));
+  memset(glyphShown, 0, sizeof(glyphShown));
+  glyphDirty = 0;
+  glyphLoaded = 0;
+
+  queueHead = 0;
+  queueCount = 0;
+
+  budgetUs = 1000; // About two characters per pass at 100kHz
+  backlightBit = LCD_BACKLIGHT;
+}
+
+/**
+ * @brief Power up the display and turn on the backlight
+ *
+ * Runs the blocking LiquidCrystal_I2C init sequence once, which leaves
+ * the display blank, so both frame buffers start as spaces. CGRAM is not
+ * cleared at power-up, so every glyph is uploaded in full on first use.
+ */
+void AsyncLCD::begin() {
+  driver->init();
+  driver->backlight();
+
+  memset(target, ' ', sizeof(target));
+  memset(shown, ' ', sizeof(shown));
+  dirty = false;
+  lcdCol = 255;
+  lcdRow = 255;
+  cgramAddress = 255;
+  glyphLoaded = 0;
+}
+
+/**
+ * @brief Set how long update() may spend sending per call
+ * @param budget Time budget in microseconds (at least one burst is always sent)
+ */
+void AsyncLCD::setBudget(unsigned int budget) {
+  budgetUs = budget;
+}
+
+/**
+ * @brief Blank the screen and home the cursor
+ */
+void AsyncLCD::clear() {
+  for (uint8_t r = 0; r < rows; r++) {
+    for (uint8_t c = 0; c < cols; c++) {
+      putCell(r, c, ' ');
+    }
+  }
+  home();
+}
+
+/**
+ * @brief Move the print cursor to the top left
+ */
+void AsyncLCD::home() {
+  setCursor(0, 0);
+}
+
+/**
+ * @brief Move the print cursor
+ * @param col Column (0-based)
+ * @param row Row (0-based)
+ */
+void AsyncLCD::setCursor(uint8_t col, uint8_t row) {
+  cursorCol = col;
+  cursorRow = row;
+}
+
+/**
+ * @brief Print one character at the cursor (Print interface)
+ *
+ * Characters past the right edge are dropped, as on the display itself.
+ */
+size_t AsyncLCD::write(uint8_t value) {
+  if (cursorRow < rows && cursorCol < cols) {
+    putCell(cursorRow, cursorCol, value);
+  }
+  cursorCol++;
+  return 1;
+}
+
+/**
+ * @brief Store one character in the target frame
+ *
+ * Overwriting a character that an earlier update() could not get to
+ * marks that frame as superseded; only the newest content ever goes out.
+ */
+void AsyncLCD::putCell(uint8_t row, uint8_t col, uint8_t value) {
+  char& cell = target[row][col];
+  if (cell == (char)value) return;
+
+  if (backlogged && cell != shown[row][col]) superseded = true;
+  cell = value;
+  dirty = true;
+}
+
+/**
+ * @brief Define a custom glyph
+ * @param location Glyph number (0-7)
+ * @param rows Eight rows of 5-pixel bitmaps, top first (in RAM)
+ */
+void AsyncLCD::createChar(uint8_t location, const uint8_t* rows) {
+  for (uint8_t r = 0; r < 8; r++) {
+    setGlyphRow(location, r, rows[r]);
+  }
+}
+
+/**
+ * @brief Change one row of a custom glyph
+ * @param location Glyph number (0-7)
+ * @param row Pixel row (0 = top)
+ * @param bits 5-pixel bitmap, leftmost pixel in bit 4
+ *
+ * Only rows that differ from the uploaded glyph go over I2C.
+ */
+void AsyncLCD::setGlyphRow(uint8_t location, uint8_t row, uint8_t bits) {
+  location &= 7;
+  bits &= 0x1F;
+  uint8_t mask = 1 << location;
+
+  // First use since power-up: CGRAM holds garbage, so send every row
+  if (!(glyphLoaded & mask)) {
+    memset(glyphShown[location], 0xFF, 8);
+    glyphLoaded |= mask;
+  }
+
+  glyphTarget[location][row & 7] = bits;
+  if (glyphShown[location][row & 7] != bits) {
+    glyphDirty |= mask;
+  }
+}
+
+/**
+ * @brief Send queued changes until the time budget runs out
+ * @return True if there is still more to send
+ *
+ * Call once per loop pass. Each burst is one short I2C transmission,
+ * so a pass takes at most the budget or one burst, whichever is longer.
+ */
+bool AsyncLCD::update() {
+  if (superseded) {
+    droppedFrames++;
+    superseded = false;
+  }
+
+  // Stop before a burst that would run past the budget (the first always goes)
+  unsigned long start = micros();
+  unsigned long burstUs;
+  do {
+    if (queueCount == 0 && !fillQueue()) {
+      backlogged = false;
+      return false;
+    }
+    unsigned long sent = micros();
+    sendBurst();
+    burstUs = micros() - sent;
+  } while (micros() - start + burstUs <= budgetUs);
+
+  backlogged = queueCount > 0 || dirty || glyphDirty;
+  return backlogged;
+}
+
+/**
+ * @brief Send every pending change now
+ *
+ * For places that are about to block anyway (startup, long delays).
+ */
+void AsyncLCD::flush() {
+  while (queueCount > 0 || fillQueue()) {
+    sendBurst();
+  }
+  backlogged = false;
+}
+
+/**
+ * @brief Check whether the display shows the current frame
+ */
+bool AsyncLCD::isIdle() {
+  return queueCount == 0 && !dirty && !glyphDirty;
+}
+
+/**
+ * @brief Number of update passes whose pending content was replaced before it was shown
+ */
+unsigned long AsyncLCD::getDroppedFrames() {
+  return droppedFrames;
+}
+
+/**
+ * @brief Queue the next changed characters
+ * @return True if anything was queued
+ *
+ * Scans for cells that differ from what the display shows, moving the
+ * HD44780 address only when the next change is not where the last
+ * write left it. Cells are marked shown as they are queued, so a later
+ * change to the same cell is picked up by the next scan.
+ */
+bool AsyncLCD::fillQueue() {
+  // Glyphs first, so cells that use them show the new shape straight away
+  if (glyphDirty && fillGlyphs()) return true;
+  if (!dirty) return false;
+
+  bool queued = false;
+  for (uint8_t r = 0; r < rows; r++) {
+    for (uint8_t c = 0; c < cols; c++) {
+      if (target[r][c] == shown[r][c]) continue;
+
+      bool moveNeeded = (r != lcdRow || c != lcdCol);
+      uint8_t needed = moveNeeded ? 8 : 4;
+      if (ASYNC_LCD_QUEUE_SIZE - queueCount < needed) return true;
+
+      if (moveNeeded) {
+        queueByte(LCD_SET_DDRAM | (ROW_OFFSETS[r] + c), 0);
+        lcdRow = r;
+        cgramAddress = 255;
+      }
+      queueByte(target[r][c], LCD_RS);
+      shown[r][c] = target[r][c];
+      lcdCol = c + 1;
+      queued = true;
+    }
+  }
+
+  // Whole frame queued
+  dirty = false;
+  return queued;
+}
+
+/**
+ * @brief Queue changed glyph rows
+ * @return True if anything was queued
+ *
+ * CGRAM writes move the HD44780 address counter out of DDRAM, so the
+ * next character write sets its position again.
+ */
+bool AsyncLCD::fillGlyphs() {
+  bool queued = false;
+  for (uint8_t g = 0; g < 8; g++) {
+    if (!(glyphDirty & (1 << g))) continue;
+
+    for (uint8_t r = 0; r < 8; r++) {
+      if (glyphTarget[g][r] == glyphShown[g][r]) continue;
+
+      uint8_t glyphAddress = (g << 3) | r;
+      bool moveNeeded = (glyphAddress != cgramAddress);
+      uint8_t needed = moveNeeded ? 8 : 4;
+      if (ASYNC_LCD_QUEUE_SIZE - queueCount < needed) return true;
+
+      if (moveNeeded) {
+        queueByte(LCD_SET_CGRAM | glyphAddress, 0);
+      }
+      queueByte(glyphTarget[g][r], LCD_RS);
+      glyphShown[g][r] = glyphTarget[g][r];
+      cgramAddress = glyphAddress + 1;
+      lcdRow = 255;
+      queued = true;
+    }
+    glyphDirty &= ~(1 << g);
+  }
+  return queued;
+}
+
+/**
+ * @brief Queue one HD44780 byte as two 4-bit transfers
+ * @param value Command or character
+ * @param mode 0 for a command, LCD_RS for data
+ */
+void AsyncLCD::queueByte(uint8_t value, uint8_t mode) {
+  queueNibble((value & 0xF0) | mode);
+  queueNibble(((value << 4) & 0xF0) | mode);
+}
+
+/**
+ * @brief Queue one nibble with its enable strobe
+ *
+ * The HD44780 latches on the falling edge of EN. At 100kHz each expander
+ * byte takes ~90us, well past the 37us the controller needs per write.
+ */
+void AsyncLCD::queueNibble(uint8_t nibble) {
+  uint8_t bits = nibble | backlightBit;
+  uint8_t tail = (queueHead + queueCount) % ASYNC_LCD_QUEUE_SIZE;
+  queue[tail] = bits | LCD_EN;
+  queue[(tail + 1) % ASYNC_LCD_QUEUE_SIZE] = bits;
+  queueCount += 2;
+}
+
+/**
+ * @brief Send up to ASYNC_LCD_BURST queued bytes in one transmission
+ */
+void AsyncLCD::sendBurst() {
+  uint8_t count = min(queueCount, ASYNC_LCD_BURST);
+
+  Wire.beginTransmission(address);
+  for (uint8_t i = 0; i < count; i++) {
+    Wire.write(queue[queueHead]);
+    queueHead = (queueHead + 1) % ASYNC_LCD_QUEUE_SIZE;
+  }
+  Wire.endTransmission();
+  queueCount -= count;
+}
@@ -0,0 +1,107 @@
+#ifndef ASYNC_LCD_H
+#define ASYNC_LCD_H
+#include <Arduino.h>
+#include <Wire.h>
+#include <LiquidCrystal_I2C.h>
+
+// Largest display the frame buffers are sized for (override before including)
+#ifndef ASYNC_LCD_COLS
+#define ASYNC_LCD_COLS 16
+#endif
+#ifndef ASYNC_LCD_ROWS
+#define ASYNC_LCD_ROWS 2
+#endif
+
+// PCF8574 bytes waiting to go out; AVR Wire sends at most 32 per transmission
+const uint8_t ASYNC_LCD_QUEUE_SIZE = 32;
+// Bytes per I2C transmission: two characters at four expander writes each
+const uint8_t ASYNC_LCD_BURST = 8;
+
+/**
+ * @class AsyncLCD
+ * @brief Non-blocking front end for an HD44780 display on a PCF8574 backpack
+ *
+ * Printing only updates a RAM copy of the screen. update() compares it with
+ * what the display is known to show and sends changed characters as queued
+ * nibble writes, stopping once its time budget for the pass is used up.
+ * A newer frame simply overwrites the buffer, so stale content is dropped
+ * instead of delaying the next frame, and redrawing the same text costs no
+ * I2C traffic at all. clear() blanks the buffer rather than sending the
+ * HD44780 clear command and its ~2ms wait.
+ *
+ * The eight custom CGRAM glyphs are cached the same way, a row at a time,
+ * so animating a glyph only sends the rows that changed.
+ *
+ * LiquidCrystal_I2C is still used for the power-up sequence in begin().
+ */
+class AsyncLCD : public Print {
+private:
+    LiquidCrystal_I2C* driver;
+    uint8_t address;
+    uint8_t cols;
+    uint8_t rows;
+
+    // Frame buffers: what the sketch wants, and what the display shows
+    char target[ASYNC_LCD_ROWS][ASYNC_LCD_COLS];
+    char shown[ASYNC_LCD_ROWS][ASYNC_LCD_COLS];
+    bool dirty;                 // target may differ from shown
+    bool backlogged;            // update() ran out of budget with changes left
+    bool superseded;            // Backlogged content was overwritten by a newer frame
+    unsigned long droppedFrames;
+
+    // Custom glyphs (5 pixels per row), wanted and uploaded
+    uint8_t glyphTarget[8][8];
+    uint8_t glyphShown[8][8];
+    uint8_t glyphDirty;         // Bit per glyph with rows to send
+    uint8_t glyphLoaded;        // Bit per glyph set up since begin()
+
+    // Print cursor (into target)
+    uint8_t cursorCol;
+    uint8_t cursorRow;
+
+    // HD44780 address counter, as last set over I2C (255 = unknown)
+    uint8_t lcdCol;
+    uint8_t lcdRow;
+    uint8_t cgramAddress;       // CGRAM address counter (255 = unknown or in DDRAM)
+
+    // Expander byte queue
+    uint8_t queue[ASYNC_LCD_QUEUE_SIZE];
+    uint8_t queueHead;
+    uint8_t queueCount;
+
+    unsigned int budgetUs;      // Time update() may spend per pass
+    uint8_t backlightBit;
+
+public:
+    AsyncLCD(LiquidCrystal_I2C& display, uint8_t i2cAddress, uint8_t columns, uint8_t rowCount);
+
+    void begin();                         // Power up the display (blocking)
+    void setBudget(unsigned int budget);  // Per-pass time limit for update()
+
+    // Drawing (RAM only)
+    void clear();
+    void home();
+    void setCursor(uint8_t col, uint8_t row);
+    virtual size_t write(uint8_t value);
+    using Print::write;
+
+    // Custom glyphs (RAM only; shown by writing character 0-7)
+    void createChar(uint8_t location, const uint8_t* rows);
+    void setGlyphRow(uint8_t location, uint8_t row, uint8_t bits);
+
+    // Output
+    bool update();              // Send changes within the budget; true while busy
+    void flush();               // Send everything now (blocking)
+    bool isIdle();
+    unsigned long getDroppedFrames();
+
+private:
+    void putCell(uint8_t row, uint8_t col, uint8_t value);
+    bool fillQueue();
+    bool fillGlyphs();
+    void queueByte(uint8_t value, uint8_t mode);
+    void queueNibble(uint8_t nibble);
+    void sendBurst();
+};
+
+#endif
@@ -0,0 +1,269 @@
+#include "ClockSync.h"
+
+// Longest stretch predict() works across before folding the drift into the offset
+static const long SYNC_REBASE_MS = 60000;
+
+/**
+ * @brief Constructor: off, nothing received
+ */
+ClockSync::ClockSync() {
+  out = NULL;
+  byteUs = 1042;
+  startSong = -1;
+  startTime = 0;
+  startTempo = 100;
+  setRole(SYNC_OFF);
+}
+
+/**
+ * @brief Set where beacons and passed-on lines go
+ * @param output Serial port the sync lines arrive on
+ * @param baud Its speed, for the time a line spends on the wire
+ */
+void ClockSync::begin(Print& output, unsigned long baud) {
+  out = &output;
+  byteUs = 10000000UL / baud;   // 8N1: ten bits a byte
+}
+
+/**
+ * @brief Master, follower or off
+ *
+ * A follower starts on its own millis() and steps to the master's clock
+ * at the first beacon.
+ */
+void ClockSync::setRole(uint8_t newRole) {
+  role = newRole;
+  offset = 0;
+  driftPpm = 0;
+  driftRemainder = 0;
+  baseLocal = millis();
+  lastNow = baseLocal;
+  stepped = true;
+
+  acquired = false;
+  locked = false;
+  windows = 0;
+  windowCount = 0;
+  windowBest = 0;
+  lastWindowEnd = baseLocal;
+  lastError = 0;
+
+  beacons = 0;
+  lastBeacon = baseLocal;
+  lastSent = baseLocal - SYNC_BEACON_INTERVAL;
+}
+
+/**
+ * @brief Get the time on the shared clock
+ * @return Milliseconds; millis() on a master or a unit with sync off
+ */
+unsigned long ClockSync::now() {
+  unsigned long local = millis();
+  if (role != SYNC_FOLLOWER || !acquired) return local;
+
+  unsigned long shared = local + predict(local);
+  if (stepped) {
+    stepped = false;
+  } else if ((long)(shared - lastNow) < 0) {
+    shared = lastNow;   // Hold still rather than go back
+  }
+  lastNow = shared;
+  return shared;
+}
+
+/**
+ * @brief Send beacons when due, and drop the lock if they stop arriving
+ */
+void ClockSync::update() {
+  unsigned long local = millis();
+
+  if (role == SYNC_FOLLOWER && locked && local - lastBeacon >= SYNC_LOST_MS) {
+    // Carry on from the model; the lock comes back after a few windows
+    locked = false;
+    windows = 1;
+  }
+
+  if ((role == SYNC_MASTER || (role == SYNC_FOLLOWER && locked)) &&
+      local - lastSent >= SYNC_BEACON_INTERVAL) {
+    sendBeacon();
+    lastSent = local;
+  }
+}
+
+/**
+ * @brief Act on a line that may be a sync line
+ * @return SYNC_NOT_MINE unless the line starts with '@'
+ *
+ * A unit with sync off takes no notice of sync lines.
+ */
+SyncAction ClockSync::handleLine(const String& line) {
+  const char* text = line.c_str();
+  if (text[0] != '@') return SYNC_NOT_MINE;
+  if (role == SYNC_OFF) return SYNC_OK;
+
+  char kind = text[1];
+  const char* args = kind != '\0' ? text + 2 : text + 1;
+
+  switch (kind) {
+    case 't':
+      if (role == SYNC_FOLLOWER) receiveBeacon(args, line.length());
+      return SYNC_OK;
+
+    case 'p': {
+      char* end;
+      long song = strtol(args, &end, 10);
+      unsigned long at = strtoul(end, &end, 10);
+      long tempo = strtol(end, &end, 10);
+      if (role == SYNC_FOLLOWER) forward(text);
+      startSong = song;
+      startTime = at;
+      startTempo = tempo > 0 ? tempo : 100;
+      return SYNC_START;
+    }
+
+    case 'x':
+      if (role == SYNC_FOLLOWER) forward(text);
+      return SYNC_STOP;
+  }
+  return SYNC_OK;
+}
+
+/**
+ * @brief Tell the units downstream to play a song
+ * @param song Song number
+ * @param at Start time on the shared clock; allow for every hop
+ * @param tempo Percent, so every unit keeps the same pace
+ */
+void ClockSync::sendStart(int song, unsigned long at, int tempo) {
+  if (out == NULL) return;
+  out->print("@p ");
+  out->print(song);
+  out->print(' ');
+  out->print(at);
+  out->print(' ');
+  out->println(tempo);
+}
+
+/**
+ * @brief Tell the units downstream to stop
+ */
+void ClockSync::sendStop() {
+  if (out == NULL) return;
+  out->println("@x");
+}
+
+/**
+ * @brief Take one beacon as a sample of the offset
+ * @param args Text after "@t"
+ * @param length Length of the whole line as received
+ *
+ * The master stamped the line as it started sending it; the last byte
+ * (the '\n' not in length) landed length + 1 byte times later.
+ */
+void ClockSync::receiveBeacon(const char* args, size_t length) {
+  unsigned long received = millis();
+  unsigned long stamp = strtoul(args, NULL, 10);
+  unsigned long wireMs = ((length + 1) * byteUs + 500) / 1000;
+  long sample = (long)(stamp + wireMs - received);
+
+  beacons++;
+  lastBeacon = received;
+
+  if (!acquired) {
+    // First beacon: take the offset as it stands; drift comes later
+    offset = sample;
+    baseLocal = received;
+    acquired = true;
+    stepped = true;
+    windowCount = 0;
+    lastWindowEnd = received;
+    return;
+  }
+
+  long residual = sample - predict(received);
+  if (windowCount == 0 || residual > windowBest) {
+    windowBest = residual;
+  }
+  if (++windowCount >= SYNC_WINDOW) {
+    endWindow(received);
+  }
+}
+
+/**
+ * @brief Correct the model from a window's best sample
+ *
+ * The offset takes the whole error. The drift takes the rate the error
+ * built up at over the window: all of it until locked, then a quarter,
+ * so one late window moves it little.
+ */
+void ClockSync::endWindow(unsigned long local) {
+  long error = windowBest;
+  unsigned long span = local - lastWindowEnd;
+
+  rebase(local);
+  windowCount = 0;
+  lastWindowEnd = local;
+  lastError = error;
+
+  if (error > SYNC_STEP_MS || error < -SYNC_STEP_MS) {
+    // Another master, or this one restarted: step to it and start again
+    offset += error;
+    stepped = true;
+    locked = false;
+    windows = 1;
+    return;
+  }
+
+  offset += error;
+  if (windows > 0 && span > 0) {
+    long ppm = error * 1000000L / (long)span;
+    driftPpm += locked ? ppm / 4 : ppm;
+    driftPpm = constrain(driftPpm, -SYNC_MAX_DRIFT_PPM, SYNC_MAX_DRIFT_PPM);
+  }
+  if (windows < 255) windows++;
+  locked = windows >= SYNC_LOCK_WINDOWS && abs(error) <= SYNC_LOCK_ERROR_MS;
+}
+
+/**
+ * @brief Offset the model gives at a local time
+ */
+long ClockSync::predict(unsigned long local) {
+  if ((long)(local - baseLocal) > SYNC_REBASE_MS) {
+    rebase(local);
+  }
+  long elapsed = (long)(local - baseLocal);
+  return offset + (elapsed * driftPpm + driftRemainder) / 1000000L;
+}
+
+/**
+ * @brief Fold the drift since baseLocal into the offset
+ *
+ * What is left over below a millisecond is kept, so rebasing often
+ * loses nothing.
+ */
+void ClockSync::rebase(unsigned long local) {
+  long drifted = (long)(local - baseLocal) * driftPpm + driftRemainder;
+  offset += drifted / 1000000L;
+  driftRemainder = drifted % 1000000L;
+  baseLocal = local;
+}
+
+/**
+ * @brief Send "@t <ms>" from the shared clock
+ */
+void ClockSync::sendBeacon() {
+  if (out == NULL) return;
+  out->print("@t ");
+  out->println(now());
+}
+
+/**
+ * @brief Pass a start or stop line to the next unit, without its '\r'
+ */
+void ClockSync::forward(const char* text) {
+  if (out == NULL) return;
+  while (*text != '\0' && *text != '\r') {
+    out->print(*text++);
+  }
+  out->println();
+}
@@ -0,0 +1,130 @@
+#ifndef CLOCK_SYNC_H
+#define CLOCK_SYNC_H
+#include <Arduino.h>
+
+const unsigned long SYNC_BEACON_INTERVAL = 250;   // Between time beacons (ms)
+const uint8_t SYNC_WINDOW = 8;                    // Beacons per estimate
+const uint8_t SYNC_LOCK_WINDOWS = 3;              // Estimates before the clock counts as locked
+const long SYNC_LOCK_ERROR_MS = 4;                // Largest correction that keeps it locked
+const long SYNC_STEP_MS = 100;                    // Correction treated as a new master
+const long SYNC_MAX_DRIFT_PPM = 20000;            // Ceramic resonators are within 0.5%
+const unsigned long SYNC_LOST_MS = 5000;          // No beacon for this long: unlocked
+const unsigned long SYNC_DEFAULT_LEAD = 1000;     // "sync play" start delay (ms)
+
+/**
+ * @enum SyncRole
+ * @brief Where a unit's shared clock comes from (saved with the settings)
+ */
+enum SyncRole {
+    SYNC_OFF,           // Plays on its own millis()
+    SYNC_MASTER,        // Its millis() is the shared clock; sends beacons
+    SYNC_FOLLOWER       // Tracks the beacons it receives, and passes them on once locked
+};
+
+/**
+ * @enum SyncAction
+ * @brief What the sketch should do after a sync line
+ */
+enum SyncAction {
+    SYNC_NOT_MINE,      // Not a sync line
+    SYNC_OK,
+    SYNC_START,         // Play getStartSong() at getStartTime()
+    SYNC_STOP
+};
+
+/**
+ * @class ClockSync
+ * @brief One clock shared by several units over a serial line
+ *
+ * The master's millis() is the shared clock. It sends a beacon carrying
+ * that time every SYNC_BEACON_INTERVAL. A follower takes the master's
+ * time plus the line's time on the wire, less its own millis() when the
+ * line came in, as one sample of the offset between the two clocks. A
+ * sample can only come out low (the line waited to be sent or to be
+ * read), so each window of SYNC_WINDOW samples keeps its highest.
+ *
+ * The clock is modelled as an offset plus a drift in parts per million.
+ * At the end of each window the highest sample, less what the model
+ * predicted, corrects the offset at once and the drift by the rate it
+ * implies, so a resonator running 0.5% fast is tracked within a few
+ * windows and a window's error stays around a millisecond. Corrections
+ * never take now() backwards: it holds still until the clock catches
+ * up, so a note in progress is never cut short by a step back.
+ *
+ * A locked follower sends beacons of its own from now(), so units can be
+ * daisy-chained, each following the one before it. Start and stop lines
+ * are passed on as they arrive; a start carries its time on the shared
+ * clock, so every unit starts together however many hops it took.
+ *
+ * Lines start with '@':
+ *   @t <ms>                      beacon: shared time as the line is sent
+ *   @p <song> <startMs> <tempo>  play a song from startMs on the shared clock
+ *   @x                           stop
+ */
+class ClockSync {
+private:
+    Print* out;
+    unsigned long byteUs;           // One byte on the wire
+    uint8_t role;
+
+    // Clock model: shared time = millis() + offset + drift since baseLocal
+    long offset;
+    long driftPpm;
+    long driftRemainder;            // Part of a millisecond (ms x ppm) not yet in offset
+    unsigned long baseLocal;
+    unsigned long lastNow;          // now() never goes back past this
+    bool stepped;                   // Next now() may jump, as after a new master
+
+    // Estimate
+    bool acquired;                  // A beacon has set the offset
+    bool locked;
+    uint8_t windows;                // Completed since acquiring
+    uint8_t windowCount;
+    long windowBest;                // Highest sample this window, less the model
+    unsigned long lastWindowEnd;
+    long lastError;                 // Correction made by the last window
+
+    // Counters
+    unsigned long beacons;          // Received
+    unsigned long lastBeacon;
+    unsigned long lastSent;
+
+    // Last start line
+    int startSong;
+    unsigned long startTime;
+    int startTempo;
+
+public:
+    ClockSync();
+
+    void begin(Print& output, unsigned long baud);
+    void setRole(uint8_t newRole);  // SyncRole; forgets any estimate
+    uint8_t getRole() { return role; }
+    bool isFollowing() { return role == SYNC_FOLLOWER; }
+
+    unsigned long now();            // Shared clock (ms)
+    void update();                  // Beacons and lock timeout; call often
+    SyncAction handleLine(const String& line);
+
+    void sendStart(int song, unsigned long at, int tempo);
+    void sendStop();
+    int getStartSong() { return startSong; }
+    unsigned long getStartTime() { return startTime; }
+    int getStartTempo() { return startTempo; }
+
+    bool isLocked() { return role == SYNC_MASTER || locked; }
+    long getOffset() { return offset; }
+    long getDrift() { return driftPpm; }
+    long getLastError() { return lastError; }
+    unsigned long getBeacons() { return beacons; }
+
+private:
+    void receiveBeacon(const char* args, size_t length);
+    void endWindow(unsigned long local);
+    long predict(unsigned long local);
+    void rebase(unsigned long local);
+    void sendBeacon();
+    void forward(const char* text);
+};
+
+#endif
@@ -1,5 +1,15 @@
 #include "DualBuzzer.h"
 
+// Visualizer glyphs: 0-3 are bar tips 1-4 pixels wide, 4-5 fill with note progress
+static const uint8_t GLYPH_BAR_TIP = 0;
+static const uint8_t GLYPH_MELODY_PROGRESS = 4;
+static const uint8_t GLYPH_HARMONY_PROGRESS = 5;
+static const uint8_t LCD_FULL_BLOCK = 0xFF;          // HD44780 ROM character
+static const unsigned long VISUALIZER_INTERVAL = 50;  // ms between frames
+
+// Style for a song that came without one: its own harmony, C major
+static const HarmonyStyle WRITTEN_HARMONY = { HARMONY_WRITTEN, 0, false, 0 };
+
 /**
  * @brief Constructor for DualBuzzer class
  * @param melodyBuzzerPin Pin number for the melody buzzer
@@ -9,58 +19,60 @@
  * Sets up LED configuration with invalid pins (disabled by default).
  */
 DualBuzzer::DualBuzzer(int melodyBuzzerPin, int harmonyBuzzerPin) {
-  melodyPin = melodyBuzzerPin;
-  harmonyPin = harmonyBuzzerPin;
-  
-  // Initialize pins as outputs
-  pinMode(melodyPin, OUTPUT);
-  pinMode(harmonyPin, OUTPUT);
-  
-  // Initialize note arrays and playback variables
-  melodyNotes = NULL;
-  harmonyNotes = NULL;
-  melodyLength = 0;
-  harmonyLength = 0;
-  
-  melodyIndex = 0;
-  harmonyIndex = 0;
-  
-  melodyPlaying = false;
-  harmonyPlaying = false;
-  
-  melodyStartTime = 0;
-  harmonyStartTime = 0;
+  voices.setPin(MELODY_VOICE, melodyBuzzerPin);
+  voices.setPin(HARMONY_VOICE, harmonyBuzzerPin);
   
+  cue.pending = false;
+  startPending = false;
+  startTime = 0;
+
+  songInfo.durationMs = 0;
+  songInfo.lowestPitch = 0;
+  songInfo.highestPitch = 0;
+  rangeLow = 0;
+  rangeHigh = 0;
+
+  songStyle = WRITTEN_HARMONY;
+  harmonyRule = HARMONY_WRITTEN;
+  writtenHarmony = false;
+
   // Initialize lyrics system
   lyrics = NULL;
+  lyricSource = NULL;
   lyricsCount = 0;
-  currentLyricIndex = 0;
-  
+  currentLyricIndex = -1;
+  currentLyricTime = 0;
+  nextLyricTime = 0;
+  lyricLeadTime = 300; // Cue the next word 300ms early
+  lyricProgressCells = -1;
+  lyricCueShown = false;
+  lyricWordColumn = 0;
+  lyricWordLength = 0;
+  lyricNextColumn = -1;
+  lyricLine = 0;
+  lineScore = -1;
+  lyricLatency = LCD_LATENCY_DEFAULT_US;
+  lyricDrawTime = 0;
+  lyricDrawPending = false;
+
   // Initialize LCD display system
   lcd = NULL;
   lcdRows = 0;
   lcdCols = 0;
+  lcdBusy = false;
+  recorder = NULL;
   
   // Initialize LED system with default settings
   ledEnabled = false;
-  currentPattern = PATTERN_RANDOM_NOTES;
   lastLEDUpdate = 0;
-  ledUpdateInterval = 50; // 20 FPS for smooth effects
+  lastPatternFrame = 0;
+  ledUpdateInterval = LED_PATTERN_INTERVAL; // 20 pattern frames a second; the envelope runs at 100
+  lastLEDFrameUs = 0;
+  ledFrameGap = LED_FRAME_INTERVAL * 1000UL;
+  setLEDPattern(LED_PATTERN_DEFAULT); // Also sets up the note tracking
 
-  lastRandomLED = -1;
-  firstRandomNote = true;
-
-  patternStep = 0;
-  currentIntensity = 0;
-  strobeState = false;
-  lastStrobeTime = 0;
-  lastMelodyFreq = 0;
-  lastHarmonyFreq = 0;
-  noteChangeTime = 0;
-  noteJustChanged = false;
-
-  lastHarmonyIndex = -1;
-  lastMelodyIndex = -1;
+  visualizerEnabled = false;
+  lastVisualizerUpdate = 0;
 
   // Initialize idle mode variables
   lastIdleUpdate = 0;
@@ -108,13 +120,34 @@ void DualBuzzer::setupLEDs(int redPin, int bluePin, int greenPin, int yellowPin,
 
 /**
  * @brief Set the LED animation pattern
- * @param pattern The LED pattern to use (see LEDPattern enum)
+ * @param pattern Index in LED_PATTERNS (out of range is ignored)
  * 
- * Changes the LED animation pattern and resets animation counters.
+ * Changes the LED animation pattern, sets up its state and resets
+ * animation counters. The next frame counts as a new note.
  */
-void DualBuzzer::setLEDPattern(LEDPattern pattern) {
+void DualBuzzer::setLEDPattern(uint8_t pattern) {
+  if (pattern >= LED_PATTERN_COUNT) return;
+  
   currentPattern = pattern;
   patternStep = 0;
+  lastMelodyIndex = -1;
+  lastHarmonyIndex = -1;
+  
+  void (*init)(LEDPatternState&) = (void (*)(LEDPatternState&))pgm_read_ptr(&LED_PATTERNS[pattern].init);
+  if (init != NULL) {
+    init(patternState);
+  }
+}
+
+/**
+ * @brief Shape the fade of every LED (see LEDEnvelope)
+ * @param attackMs Rise at each note onset
+ * @param decayMs Fall to the sustain level after the rise
+ * @param sustainPercent Share of the pattern's level held while lit
+ * @param releaseMs Fade out when the pattern turns an LED off
+ */
+void DualBuzzer::setLEDEnvelope(uint16_t attackMs, uint16_t decayMs, uint8_t sustainPercent, uint16_t releaseMs) {
+  ledEnvelope.setTimes(attackMs, decayMs, sustainPercent, releaseMs);
 }
 
 /**
@@ -134,9 +167,7 @@ void DualBuzzer::enableLEDs(bool enable) {
  * @param length Number of notes in the melody
  */
 void DualBuzzer::setMelody(Note* notes, int length) {
-  melodyNotes = notes;
-  melodyLength = length;
-  melodyIndex = 0;
+  setVoice(MELODY_VOICE, notes, length);
 }
 
 /**
@@ -145,31 +176,77 @@ void DualBuzzer::setMelody(Note* notes, int length) {
  * @param length Number of notes in the harmony
  */
 void DualBuzzer::setHarmony(Note* notes, int length) {
-  harmonyNotes = notes;
-  harmonyLength = length;
-  harmonyIndex = 0;
+  setVoice(HARMONY_VOICE, notes, length);
+}
+
+/**
+ * @brief Set the note sequence for any voice
+ * @param voice Voice number (MELODY_VOICE, HARMONY_VOICE, or an extra part)
+ * @param notes Pointer to array of Note structures (should be in PROGMEM)
+ * @param length Number of notes in the part
+ * 
+ * The song length comes from the SongInfo given to setSong(), so an extra
+ * part longer than the melody and harmony should be measured into it.
+ */
+void DualBuzzer::setVoice(uint8_t voice, Note* notes, int length) {
+  if (voice >= BUZZER_VOICES) return;
+  voices.setVoice(voice, notes, length);
+}
+
+/**
+ * @brief Give a voice's notes accents
+ * @param voice Voice number
+ * @param accents PROGMEM volume steps, one per note, or NULL for none
+ * 
+ * Setting the voice's notes clears them, so call this after.
+ */
+void DualBuzzer::setAccents(uint8_t voice, const int8_t* accents) {
+  if (voice >= BUZZER_VOICES) return;
+  voices.setAccents(voice, accents);
+}
+
+/**
+ * @brief Assign a buzzer pin to a voice
+ * @param voice Voice number
+ * @param pin Pin number for the buzzer (use -1 to leave the part silent)
+ */
+void DualBuzzer::setVoicePin(uint8_t voice, int pin) {
+  if (voice >= BUZZER_VOICES) return;
+  voices.setPin(voice, pin);
 }
 
 /**
  * @brief Set both melody and harmony for a complete song
  * @param melody Pointer to melody note array
  * @param melodyLen Length of melody array
- * @param harmony Pointer to harmony note array
+ * @param harmony Pointer to harmony note array, or NULL to generate one
  * @param harmonyLen Length of harmony array
+ * @param info Length and pitch range, measured at compile time (see describeSong())
  * 
  * Stops current playback and configures a new song with both melody and harmony.
- * Resets lyrics position and LED effects.
+ * Resets lyrics position and LED effects. A song without a harmony table
+ * needs setHarmonyStyle() to say how to generate one.
  */
-void DualBuzzer::setSong(Note* melody, int melodyLen, Note* harmony, int harmonyLen) {
+void DualBuzzer::setSong(Note* melody, int melodyLen, Note* harmony, int harmonyLen,
+                         const SongInfo& info) {
   // Stop current playback if any
   stop();
   
-  // Set new melody and harmony
+  // Set new melody and harmony; extra parts are cleared until set again
+  voices.setSource(NULL);
+  for (uint8_t v = 0; v < BUZZER_VOICES; v++) {
+    voices.setVoice(v, NULL, 0);
+  }
   setMelody(melody, melodyLen);
   setHarmony(harmony, harmonyLen);
+  songInfo = info;
+  voices.setSongDuration(info.durationMs);
+  writtenHarmony = harmony != NULL && harmonyLen > 0;
+  songStyle = WRITTEN_HARMONY;
+  applyHarmony();
   
   // Reset lyrics position
-  currentLyricIndex = 0;
+  seekLyricCursor(0);
   
   // Reset LED effects
   patternStep = 0;
@@ -180,24 +257,132 @@ void DualBuzzer::setSong(Note* melody, int melodyLen, Note* harmony, int harmony
  * @param timings Array of LyricTiming structures
  * @param count Number of lyric entries
  * 
- * Configures lyrics that will be displayed in sync with the melody.
+ * Configures lyrics that will be displayed against the song clock.
+ * Entries must be sorted by time.
  */
 void DualBuzzer::setLyrics(LyricTiming* timings, int count) {
   lyrics = timings;
+  lyricSource = NULL;
   lyricsCount = count;
-  currentLyricIndex = 0;
+  seekLyricCursor(0);
+}
+
+/**
+ * @brief Set up a song whose notes and lyrics arrive while it plays
+ * @param notes Source for every voice
+ * @param words Source for the lyrics, or NULL for none
+ * @param info Length and pitch range, as announced by the sender
+ * 
+ * Stops current playback. The song can't be seeked or cued behind.
+ */
+void DualBuzzer::setStreamedSong(NoteSource* notes, LyricSource* words, const SongInfo& info) {
+  stop();
+  
+  voices.setSource(notes);
+  songInfo = info;
+  voices.setSongDuration(info.durationMs);
+  writtenHarmony = true;
+  songStyle = WRITTEN_HARMONY;
+  applyHarmony();
+  
+  lyrics = NULL;
+  lyricSource = words;
+  lyricsCount = (words != NULL) ? words->getLyricCount() : 0;
+  seekLyricCursor(0);
+  
+  patternStep = 0;
+}
+
+/**
+ * @brief Set the key and harmony rule of the current song
+ * @param style Rule used if the song has no harmony table, and the key
+ *              any generated harmony follows
+ * 
+ * Call after setSong(), which clears it.
+ */
+void DualBuzzer::setHarmonyStyle(const HarmonyStyle& style) {
+  songStyle = style;
+  applyHarmony();
+}
+
+/**
+ * @brief Choose how the harmony is played, for this song and the ones after
+ * @param rule HARMONY_WRITTEN for each song's own harmony (table, or its
+ *             rule if it has none); any other rule replaces it
+ * 
+ * Generated parts follow each song's key. A song playing now jumps to
+ * its current position with the new harmony. Streamed songs always play
+ * the harmony they are sent.
+ */
+void DualBuzzer::setHarmonyRule(HarmonyRule rule) {
+  harmonyRule = rule;
+  applyHarmony();
+  
+  if (isPlaying() && voices.getSource() == NULL) {
+    voices.seek(voices.getSongPosition());
+  }
+}
+
+/**
+ * @brief Get the harmony rule chosen with setHarmonyRule()
+ */
+HarmonyRule DualBuzzer::getHarmonyRule() {
+  return harmonyRule;
+}
+
+/**
+ * @brief Check whether the harmony now playing is generated from the melody
+ */
+bool DualBuzzer::isHarmonyGenerated() {
+  return voices.isGenerated(HARMONY_VOICE);
+}
+
+/**
+ * @brief Pick the harmony for the current song and its pitch range
+ * 
+ * A chosen rule wins, then the song's table, then the song's own rule.
+ */
+void DualBuzzer::applyHarmony() {
+  HarmonyStyle style = songStyle;
+  if (harmonyRule != HARMONY_WRITTEN) {
+    style.rule = harmonyRule;
+  } else if (writtenHarmony) {
+    style.rule = HARMONY_WRITTEN;
+  }
+  
+  bool generate = style.rule != HARMONY_WRITTEN && voices.getSource() == NULL;
+  harmonizer.setStyle(style);
+  voices.setGenerator(generate ? HARMONY_VOICE : -1, &harmonizer);
+  
+  rangeLow = songInfo.lowestPitch;
+  rangeHigh = songInfo.highestPitch;
+  if (generate) {
+    int low, high;
+    harmonizer.getRange(songInfo.lowestPitch, songInfo.highestPitch, low, high);
+    rangeLow = lowerPitch(rangeLow, low);
+    rangeHigh = higherPitch(rangeHigh, high);
+  }
+}
+
+/**
+ * @brief Set how early the next word is cued on the display
+ * @param leadMs Milliseconds before a word starts that its cue appears
+ */
+void DualBuzzer::setLyricLeadTime(unsigned long leadMs) {
+  lyricLeadTime = leadMs;
 }
 
 /**
  * @brief Configure LCD display for lyrics
- * @param display Pointer to LiquidCrystal_I2C display object
+ * @param display Pointer to the AsyncLCD display front end
  * @param rows Number of rows on the display
  * @param columns Number of columns on the display
  */
-void DualBuzzer::setLCD(LiquidCrystal_I2C* display, int rows, int columns) {
+void DualBuzzer::setLCD(AsyncLCD* display, int rows, int columns) {
   lcd = display;
   lcdRows = rows;
   lcdCols = columns;
+  if (visualizerEnabled) loadVisualizerGlyphs();
 }
 
 /**
@@ -207,13 +392,54 @@ void DualBuzzer::setLCD(LiquidCrystal_I2C* display, int rows, int columns) {
  * and shows the first lyric if available.
  */
 void DualBuzzer::play() {
-  playMelody();
-  playHarmony();
+  for (uint8_t v = 0; v < BUZZER_VOICES; v++) {
+    voices.playVoice(v);
+  }
   
   // Reset lyrics and display first lyric if available
-  currentLyricIndex = 0;
+  seekLyricCursor(0);
   clearLyrics();
-  updateLyrics();
+  updateSlidingLyrics();
+}
+
+/**
+ * @brief Start the song at a set time on the song clock
+ * @param at Clock value (see setClock()) when the first notes sound
+ * 
+ * Nothing plays until then; updateAudio() starts it on time. A time
+ * already past starts it part-way through, where it would be by now.
+ */
+void DualBuzzer::playAt(unsigned long at) {
+  startPending = true;
+  startTime = at;
+  isIdleMode = false;
+}
+
+/**
+ * @brief Check whether playAt() is waiting for its start time
+ */
+bool DualBuzzer::isStartPending() {
+  return startPending;
+}
+
+/**
+ * @brief Log note changes and finished LCD frames
+ * @param to Flight recorder, or NULL to stop
+ */
+void DualBuzzer::setRecorder(FlightRecorder* to) {
+  recorder = to;
+}
+
+/**
+ * @brief Take song time from another clock
+ * @param clock Function returning milliseconds, like millis()
+ * 
+ * Units that share a clock (see ClockSync.h) stay in step when each
+ * plays on it. Set before playing: song times already taken are not
+ * moved.
+ */
+void DualBuzzer::setClock(unsigned long (*clock)()) {
+  voices.setClock(clock);
 }
 
 /**
@@ -222,18 +448,7 @@ void DualBuzzer::play() {
  * Begins melody playback from the first note and starts the first tone.
  */
 void DualBuzzer::playMelody() {
-  if (melodyNotes != NULL && melodyLength > 0) {
-    melodyPlaying = true;
-    melodyIndex = 0;
-    melodyStartTime = millis();
-    
-    // Start playing the first note
-    if (melodyNotes[0].frequency > 0) {
-      tone(melodyPin, melodyNotes[0].frequency);
-    } else {
-      noTone(melodyPin); // Rest note
-    }
-  }
+  voices.playVoice(MELODY_VOICE);
 }
 
 /**
@@ -242,29 +457,19 @@ void DualBuzzer::playMelody() {
  * Begins harmony playback from the first note and starts the first tone.
  */
 void DualBuzzer::playHarmony() {
-  if (harmonyNotes != NULL && harmonyLength > 0) {
-    harmonyPlaying = true;
-    harmonyIndex = 0;
-    harmonyStartTime = millis();
-    
-    // Start playing the first note
-    if (harmonyNotes[0].frequency > 0) {
-      tone(harmonyPin, harmonyNotes[0].frequency);
-    } else {
-      noTone(harmonyPin); // Rest note
-    }
-  }
+  voices.playVoice(HARMONY_VOICE);
 }
 
 /**
  * @brief Stop all playback and effects
  * 
- * Stops both melody and harmony, clears lyrics display, starts idle mode,
+ * Stops every voice, clears lyrics display, starts idle mode,
  * and turns off all LEDs.
  */
 void DualBuzzer::stop() {
-  stopMelody();
-  stopHarmony();
+  voices.stop();
+  startPending = false;
+  cancelCue();
   clearLyrics();
   startIdleMode();
   
@@ -274,224 +479,702 @@ void DualBuzzer::stop() {
   }
 }
 
+/**
+ * @brief Prepare the song to play when the current one finishes
+ * @param melody Pointer to melody note array
+ * @param melodyLen Length of melody array
+ * @param harmony Pointer to harmony note array
+ * @param harmonyLen Length of harmony array
+ * @param info Length and pitch range, measured at compile time (see describeSong())
+ * @param timings Lyrics for the cued song
+ * @param count Number of lyric entries
+ * @param gapMs Silence between the end of this song and the next (0 = gapless)
+ * 
+ * Everything is stored now, while the current song plays, so the switch
+ * in update() only has to swap pointers and start the first notes.
+ */
+void DualBuzzer::cueSong(Note* melody, int melodyLen, Note* harmony, int harmonyLen,
+                         const SongInfo& info, LyricTiming* timings, int count,
+                         unsigned long gapMs) {
+  for (uint8_t v = 0; v < BUZZER_VOICES; v++) {
+    cue.notes[v] = NULL;
+    cue.lengths[v] = 0;
+    cue.accents[v] = NULL;
+  }
+  cue.notes[MELODY_VOICE] = melody;
+  cue.lengths[MELODY_VOICE] = melodyLen;
+  cue.notes[HARMONY_VOICE] = harmony;
+  cue.lengths[HARMONY_VOICE] = harmonyLen;
+  cue.lyrics = timings;
+  cue.lyricsCount = count;
+  cue.info = info;
+  cue.style = WRITTEN_HARMONY;
+  cue.gapMs = gapMs;
+  cue.pending = true;
+}
+
+/**
+ * @brief Add an extra part to the cued song
+ * @param voice Voice number above HARMONY_VOICE
+ * @param notes Pointer to PROGMEM note array
+ * @param length Number of notes
+ * 
+ * Call after cueSong(), which clears the extra parts.
+ */
+void DualBuzzer::cueVoice(uint8_t voice, Note* notes, int length) {
+  if (voice >= BUZZER_VOICES) return;
+  cue.notes[voice] = notes;
+  cue.lengths[voice] = length;
+  cue.accents[voice] = NULL;
+}
+
+/**
+ * @brief Give one of the cued song's voices accents
+ * 
+ * Call after cueSong() or cueVoice() for that voice, which clear them.
+ */
+void DualBuzzer::cueAccents(uint8_t voice, const int8_t* accents) {
+  if (voice >= BUZZER_VOICES) return;
+  cue.accents[voice] = accents;
+}
+
+/**
+ * @brief Set the key and harmony rule of the cued song
+ * 
+ * Call after cueSong(), which clears it.
+ */
+void DualBuzzer::cueHarmonyStyle(const HarmonyStyle& style) {
+  cue.style = style;
+}
+
+/**
+ * @brief Drop the cued song, if any
+ */
+void DualBuzzer::cancelCue() {
+  cue.pending = false;
+}
+
+/**
+ * @brief Check whether a song is waiting to follow the current one
+ * @return True until the cued song starts or is cancelled
+ */
+bool DualBuzzer::isSongCued() {
+  return cue.pending;
+}
+
+/**
+ * @brief Switch to the cued song and start it on the song clock
+ * 
+ * startAt is the moment the song should have started; starting the voices
+ * there makes up for however late this pass ran, so the first notes stay
+ * in time with the previous song.
+ */
+void DualBuzzer::startCuedSong(unsigned long startAt) {
+  cue.pending = false;
+  
+  voices.setSource(NULL);
+  for (uint8_t v = 0; v < BUZZER_VOICES; v++) {
+    voices.setVoice(v, cue.notes[v], cue.lengths[v]);
+    voices.setAccents(v, cue.accents[v]);
+  }
+  songInfo = cue.info;
+  voices.setSongDuration(songInfo.durationMs);
+  writtenHarmony = cue.notes[HARMONY_VOICE] != NULL && cue.lengths[HARMONY_VOICE] > 0;
+  songStyle = cue.style;
+  applyHarmony();
+  lyrics = cue.lyrics;
+  lyricSource = NULL;
+  lyricsCount = cue.lyricsCount;
+  patternStep = 0;
+  
+  isIdleMode = false;
+  voices.startSongAt(startAt);
+  seekLyricCursor(getSongPosition());
+  updateSlidingLyrics();
+}
+
 /**
  * @brief Stop melody playback only
  */
 void DualBuzzer::stopMelody() {
-  melodyPlaying = false;
-  noTone(melodyPin);
+  voices.stopVoice(MELODY_VOICE);
 }
 
 /**
  * @brief Stop harmony playback only
  */
 void DualBuzzer::stopHarmony() {
-  harmonyPlaying = false;
-  noTone(harmonyPin);
+  voices.stopVoice(HARMONY_VOICE);
+}
+
+/**
+ * @brief Jump every voice and the lyrics to a song position
+ * @param positionMs Milliseconds from the start of the song
+ * 
+ * Restarts the song clock so that positionMs is "now", finds the note each
+ * voice should be sounding and re-syncs the lyric cursor. Starts playback
+ * from that position if the song was stopped.
+ */
+void DualBuzzer::seek(unsigned long positionMs) {
+  voices.seek(positionMs);
+
+  seekLyricCursor(positionMs);
+  updateSlidingLyrics();
 }
 
 /**
  * @brief Main update function - call this in your main loop
  * 
- * Handles note timing, advances playback, updates lyrics display,
- * manages idle mode, and updates LED effects. This must be called
- * frequently for proper operation.
+ * Runs everything below in turn, the LED and idle frames at their own
+ * intervals. A sketch with a scheduler can call the parts itself instead.
  */
 void DualBuzzer::update() {
   unsigned long currentTime = millis();
   
-  // Update melody playback
-  if (melodyPlaying && melodyNotes != NULL) {
-    // Read current note from PROGMEM
-    Note currentNote;
-    memcpy_P(&currentNote, &melodyNotes[melodyIndex], sizeof(Note));
-    
-    // Check if current note duration has elapsed
-    if (currentTime - melodyStartTime >= currentNote.duration) {
-      melodyIndex++;
-      
-      // Check if we've reached the end of the melody
-      if (melodyIndex >= melodyLength) {
-        stopMelody();
-      } else {
-        // Start playing the next note
-        melodyStartTime = currentTime;
-        
-        // Read next note from PROGMEM
-        Note nextNote;
-        memcpy_P(&nextNote, &melodyNotes[melodyIndex], sizeof(Note));
-        
-        if (nextNote.frequency > 0) {
-          tone(melodyPin, nextNote.frequency);
-        } else {
-          noTone(melodyPin); // Rest note
-        }
-        
-        // Update lyrics display for the new note
-        updateLyrics();
+  updateAudio();
+  
+  if (currentTime - lastIdleUpdate >= IDLE_FRAME_INTERVAL) {
+    updateIdleScreen();
+  }
+  
+  updateDisplay();
+  
+  if (currentTime - lastLEDUpdate >= LED_FRAME_INTERVAL) {
+    updateLEDs();
+  }
+}
+
+/**
+ * @brief Advance the notes - call every loop pass
+ * 
+ * Moves on every voice whose note has run out and starts a cued song
+ * when its time comes.
+ */
+void DualBuzzer::updateAudio() {
+  unsigned long currentTime = voices.now();
+  
+  // A song started with playAt(), from the time it was due rather than
+  // when this pass saw it
+  if (startPending && (long)(currentTime - startTime) >= 0) {
+    startPending = false;
+    voices.startSongAt(startTime);
+    seekLyricCursor(getSongPosition());
+    clearLyrics();
+    updateSlidingLyrics();
+  }
+  
+  // Advance every voice whose note has run out
+  uint8_t moved = voices.update(currentTime);
+  if (moved != 0 && recorder != NULL) {
+    for (uint8_t voice = 0; voice < BUZZER_VOICES; voice++) {
+      if ((moved >> voice) & 1) {
+        recorder->record(FLIGHT_NOTE, voice, voices.getNoteIndex(voice));
       }
     }
   }
   
-  // Update harmony playback (similar to melody)
-  if (harmonyPlaying && harmonyNotes != NULL) {
-    Note currentNote;
-    memcpy_P(&currentNote, &harmonyNotes[harmonyIndex], sizeof(Note));
-    
-    if (currentTime - harmonyStartTime >= currentNote.duration) {
-      harmonyIndex++;
-      
-      if (harmonyIndex >= harmonyLength) {
-        stopHarmony();
-      } else {
-        harmonyStartTime = currentTime;
-        
-        Note nextNote;
-        memcpy_P(&nextNote, &harmonyNotes[harmonyIndex], sizeof(Note));
-        
-        if (nextNote.frequency > 0) {
-          tone(harmonyPin, nextNote.frequency);
-        } else {
-          noTone(harmonyPin); // Rest note
-        }
-      }
+  // Start the cued song once this one's scheduled end plus the gap is reached.
+  // Timing off the song clock rather than when the voices were seen to stop
+  // keeps back-to-back songs from drifting apart by a loop pass each time.
+  if (cue.pending && !isPlaying()) {
+    unsigned long startAt = voices.getSongEndTime() + cue.gapMs;
+    if ((long)(currentTime - startAt) >= 0) {
+      startCuedSong(startAt);
     }
   }
+}
+
+/**
+ * @brief Update lyrics and the visualizer, and drain the LCD
+ * 
+ * Call often: the lyric highlight follows the song clock, and the LCD
+ * only takes a few changed characters per call.
+ */
+void DualBuzzer::updateDisplay() {
+  // Lyrics follow the song clock, which every voice's notes keep to
+  updateLyrics();
   
-  // Handle idle mode display when not playing
-  if (isIdleMode && !isPlaying()) {
-      showIdleLCD();
+  // Visualizer frames at a fixed rate while playing
+  unsigned long currentTime = millis();
+  if (visualizerEnabled && isPlaying() && currentTime - lastVisualizerUpdate >= VISUALIZER_INTERVAL) {
+    drawVisualizer();
+    lastVisualizerUpdate = currentTime;
   }
   
-  // Update LED effects at specified intervals
-  if (ledEnabled && currentTime - lastLEDUpdate >= ledUpdateInterval) {
-    updateLEDs();
-    lastLEDUpdate = currentTime;
+  // Push a few changed characters to the display; never waits on a full redraw
+  if (lcd != NULL) {
+    bool busy = lcd->update();
+    if (lcdBusy && !busy && recorder != NULL) {
+      recorder->record(FLIGHT_LCD, 0, lcd->getDroppedFrames());
+    }
+    lcdBusy = busy;
+    
+    // A new word is on the glass: fold the time it took into the lead
+    if (lyricDrawPending && !busy) {
+      lyricDrawPending = false;
+      unsigned long took = micros() - lyricDrawTime;
+      if (took <= LCD_LATENCY_MAX_US) {
+        lyricLatency += ((long)took - (long)lyricLatency) / 8;
+      }
+    }
+  }
+}
+
+/**
+ * @brief Draw the next idle animation frame, if idle
+ * 
+ * Call every IDLE_FRAME_INTERVAL.
+ */
+void DualBuzzer::updateIdleScreen() {
+  if (isIdleMode && !isPlaying()) {
+    showIdleLCD();
   }
 }
 
+/**
+ * @brief Get the time between LED frames
+ * @return Milliseconds between updateLEDs() calls (the envelope step)
+ */
+unsigned long DualBuzzer::getLEDInterval() {
+  return LED_FRAME_INTERVAL;
+}
+
 /**
  * @brief Check if any audio is currently playing
- * @return True if melody or harmony is playing, false otherwise
+ * @return True if any voice is playing, false otherwise
  */
 bool DualBuzzer::isPlaying() {
-  return melodyPlaying || harmonyPlaying;
+  return voices.isPlaying();
+}
+
+/**
+ * @brief Get where the current song's notes come from
+ * @return The source given to setStreamedSong(), or NULL for PROGMEM tables
+ */
+NoteSource* DualBuzzer::getNoteSource() {
+  return voices.getSource();
 }
 
 /**
- * @brief Update lyrics display based on current melody position
+ * @brief Check whether a streamed song is silent waiting for notes
+ */
+bool DualBuzzer::isHolding() {
+  return voices.isHolding();
+}
+
+/**
+ * @brief Get how long the current hold has lasted
+ * @return Milliseconds, or 0 when not holding
+ */
+unsigned long DualBuzzer::getHoldTime() {
+  return voices.getHoldTime();
+}
+
+/**
+ * @brief Get the current song position
+ * @return Milliseconds since the song started (valid while playing)
+ */
+unsigned long DualBuzzer::getSongPosition() {
+  return voices.getSongPosition();
+}
+
+/**
+ * @brief Set the playback tempo
+ * @param percent Speed relative to the written tempo (100 = as written)
  * 
- * Finds the appropriate lyric for the current note and updates
- * the sliding lyrics display.
+ * Takes effect from the next note. The song clock is rebased so the
+ * lyrics keep their place.
+ */
+void DualBuzzer::setTempo(int percent) {
+  voices.setTempo(percent);
+}
+
+/**
+ * @brief Get the playback tempo in percent
+ */
+int DualBuzzer::getTempo() {
+  return voices.getTempo();
+}
+
+/**
+ * @brief Transpose playback by a number of semitones
+ * @param semitones Offset from the written key (-12 to +12)
+ * 
+ * Takes effect from the next note.
+ */
+void DualBuzzer::setTranspose(int semitones) {
+  voices.setTranspose(semitones);
+}
+
+/**
+ * @brief Get the transpose offset in semitones
+ */
+int DualBuzzer::getTranspose() {
+  return voices.getTranspose();
+}
+
+/**
+ * @brief Set how loud a voice plays, so the harmony can sit under the melody
+ * @param voice MELODY_VOICE, HARMONY_VOICE or an extra voice
+ * @param volume 0 (muted) to PITCH_VOLUME_MAX (full)
+ * 
+ * Notes' accents move each note up or down from this. Only the Timer1
+ * buzzer pins on an Uno can play below full volume.
+ */
+void DualBuzzer::setVolume(uint8_t voice, uint8_t volume) {
+  if (voice >= BUZZER_VOICES) return;
+  voices.setVolume(voice, volume);
+}
+
+/**
+ * @brief Get a voice's volume (0-PITCH_VOLUME_MAX)
+ */
+uint8_t DualBuzzer::getVolume(uint8_t voice) {
+  return voice < BUZZER_VOICES ? voices.getVolume(voice) : 0;
+}
+
+/**
+ * @brief Get the note a voice is sounding, transposition included
+ * @return Nearest MIDI note, or 0 for a rest or a voice not playing
+ */
+uint8_t DualBuzzer::getPitch(uint8_t voice) {
+  return voice < BUZZER_VOICES ? midiNote(voices.getFrequency(voice)) : 0;
+}
+
+/**
+ * @brief Update lyrics display based on the song clock
+ * 
+ * Advances the lyric cursor to the current song position, plus the time
+ * the LCD takes to show a frame, so a word is on the display as its note
+ * sounds rather than a frame after. That time is measured from each new
+ * word to the LCD going idle. A new word redraws the sliding lyrics;
+ * otherwise only the progress highlight and next-word cue are refreshed,
+ * and only when they change.
  */
 void DualBuzzer::updateLyrics() {
-    if (lcd == NULL || lyrics == NULL || !melodyPlaying) return;
+    if (lcd == NULL || !hasLyrics() || !isPlaying()) return;
     
-    // Find the current lyric based on melody index
-    int targetLyricIndex = 0;
-    for (int i = 0; i < lyricsCount; i++) {
-        if (melodyIndex >= lyrics[i].noteIndex) {
-            targetLyricIndex = i;
-        } else {
-            break;
+    // Streamed words keep arriving; the last known word may now have a successor
+    if (lyricSource != NULL && lyricSource->getLyricCount() != lyricsCount) {
+        lyricsCount = lyricSource->getLyricCount();
+        loadLyricBounds();
+    }
+    
+    // The lead coming down just after a word was drawn early doesn't take
+    // it back; only a real jump behind the word re-syncs the cursor
+    unsigned long position = getLyricPosition();
+    unsigned long mostLead = LCD_LATENCY_MAX_US * getTempo() / 100000UL;
+    if (position < currentLyricTime && getSongPosition() + mostLead >= currentLyricTime) {
+        position = currentLyricTime;
+    }
+    
+    if (advanceLyricCursor(position)) {
+        updateSlidingLyrics();
+        if (!lyricDrawPending) {
+            lyricDrawPending = true;
+            lyricDrawTime = micros();
         }
+    } else {
+        drawLyricCue();
+    }
+}
+
+/**
+ * @brief Read one lyric entry from PROGMEM (or the lyric source)
+ */
+void DualBuzzer::readLyric(int index, LyricTiming& out) {
+    if (lyricSource != NULL) {
+        lyricSource->readLyric(index, out);
+        return;
     }
+    memcpy_P(&out, &lyrics[index], sizeof(LyricTiming));
+}
+
+/**
+ * @brief Check whether a word begins a line of lyrics
+ */
+static bool startsLyricLine(const char* word) {
+    return word[0] == LYRIC_LINE_MARK;
+}
+
+/**
+ * @brief A word as shown, without its line mark
+ */
+static const char* lyricText(const char* word) {
+    return startsLyricLine(word) ? word + 1 : word;
+}
+
+/**
+ * @brief Cache the start times of the word under the cursor and the next one
+ * @return True if the word under the cursor starts a line
+ * 
+ * The last word runs until the end of the song.
+ */
+bool DualBuzzer::loadLyricBounds() {
+    LyricTiming entry;
+    bool lineStart = false;
     
-    currentLyricIndex = targetLyricIndex;
-    updateSlidingLyrics();
+    currentLyricTime = 0;
+    if (currentLyricIndex >= 0) {
+        readLyric(currentLyricIndex, entry);
+        currentLyricTime = entry.timeMs;
+        lineStart = startsLyricLine(entry.word);
+    }
+    
+    if (currentLyricIndex + 1 < lyricsCount) {
+        readLyric(currentLyricIndex + 1, entry);
+        nextLyricTime = entry.timeMs;
+    } else {
+        nextLyricTime = max(voices.getSongDuration(), currentLyricTime);
+    }
+    return lineStart;
 }
 
 /**
- * @brief Update the sliding lyrics display with animation
+ * @brief Move the lyric cursor forward to a song position
+ * @param position Song time in milliseconds
+ * @return True if the cursor moved to a different word
  * 
- * Creates a scrolling text effect that centers the current word
- * and adds animated dots below it to indicate the active lyric.
+ * Steps one entry at a time, so normal playback costs a single
+ * comparison per call. A position behind the cursor re-syncs it.
  */
-void DualBuzzer::updateSlidingLyrics() {
-    if (lcd == NULL || lyrics == NULL) return;
+bool DualBuzzer::advanceLyricCursor(unsigned long position) {
+    if (position < currentLyricTime) {
+        seekLyricCursor(position);
+        return true;
+    }
     
-    // Build the full lyrics text
-    String fullText = "";
-    for (int i = 0; i < lyricsCount; i++) {
-        if (i > 0) fullText += " ";
-        fullText += String(lyrics[i].word);
+    bool moved = false;
+    while (currentLyricIndex + 1 < lyricsCount && position >= nextLyricTime) {
+        currentLyricIndex++;
+        if (loadLyricBounds()) lyricLine++;
+        moved = true;
     }
     
-    // Find current word position in full text
-    int currentWordStart = 0;
-    int currentWordEnd = 0;
-    int wordIndex = 0;
+    // The display still shows a few words behind the cursor
+    if (moved && lyricSource != NULL) {
+        lyricSource->releaseLyrics(currentLyricIndex - 2);
+    }
+    return moved;
+}
+
+/**
+ * @brief Place the lyric cursor at an arbitrary song position
+ * @param position Song time in milliseconds
+ * 
+ * Binary search for the last word starting at or before position.
+ */
+void DualBuzzer::seekLyricCursor(unsigned long position) {
+    int low = 0;
+    int high = hasLyrics() ? lyricsCount : 0;
     
-    for (int i = 0; i < lyricsCount && wordIndex <= currentLyricIndex; i++) {
-        if (wordIndex == currentLyricIndex) {
-            currentWordEnd = currentWordStart + String(lyrics[i].word).length() - 1;
-            break;
+    while (low < high) {
+        int mid = (low + high) / 2;
+        LyricTiming entry;
+        readLyric(mid, entry);
+        if (entry.timeMs <= position) {
+            low = mid + 1;
+        } else {
+            high = mid;
         }
-        currentWordStart += String(lyrics[i].word).length();
-        if (i < lyricsCount - 1) currentWordStart++; // Add space
-        wordIndex++;
     }
     
-    // Calculate display window to center current word
-    int displayStart = 0;
-    int currentWordLength = currentWordEnd - currentWordStart + 1;
+    currentLyricIndex = low - 1;
+    loadLyricBounds();
+    lyricProgressCells = -1;
+    lyricLine++;
+    lineScore = -1;
+}
+
+/**
+ * @brief Get the word under the lyric cursor
+ * @return Lyric index, or -1 before the first word
+ */
+int DualBuzzer::getCurrentLyricIndex() {
+    return currentLyricIndex;
+}
+
+/**
+ * @brief Look ahead for the next word
+ * @param withinMs How far ahead to look
+ * @return Index of the next word if it starts within withinMs, otherwise -1
+ */
+int DualBuzzer::getUpcomingLyricIndex(unsigned long withinMs) {
+    if (!hasLyrics() || currentLyricIndex + 1 >= lyricsCount) return -1;
+    
+    unsigned long position = getLyricPosition();
+    if (position + withinMs >= nextLyricTime) {
+        return currentLyricIndex + 1;
+    }
+    return -1;
+}
+
+/**
+ * @brief Get progress through the current word
+ * @return 0 at the start of the word, 255 when the next word is due
+ */
+uint8_t DualBuzzer::getLyricProgress() {
+    if (currentLyricIndex < 0 || nextLyricTime <= currentLyricTime) return 0;
+    
+    unsigned long position = getLyricPosition();
+    if (position >= nextLyricTime) return 255;
+    
+    return (uint8_t)(((position - currentLyricTime) * 255UL) / (nextLyricTime - currentLyricTime));
+}
+
+/**
+ * @brief Get a number that changes whenever a new line of lyrics begins
+ * 
+ * Counts up by one at each word that starts a line, and at every jump
+ * of the lyric cursor (a new song or a seek), so whatever was being
+ * sung before a jump is treated as a line of its own.
+ */
+int DualBuzzer::getLyricLine() {
+    return lyricLine;
+}
+
+/**
+ * @brief Show how well the last line was sung
+ * @param percent 0-100, or -1 to clear
+ * 
+ * Goes at the right of the progress cue row until the next jump of the
+ * lyric cursor or the next score; it is not shown while the visualizer
+ * has the row, or where it would cover the word being sung.
+ */
+void DualBuzzer::showLineScore(int percent) {
+    lineScore = constrain(percent, -1, 100);
+    lyricProgressCells = -1;
+    if (isPlaying()) drawLyricCue();
+}
+
+/**
+ * @brief Get how far ahead of the song clock the lyrics are drawn
+ * @return Microseconds: the average time from drawing a new word to the
+ *         LCD showing it
+ */
+unsigned long DualBuzzer::getLyricLatency() {
+    return lyricLatency;
+}
+
+/**
+ * @brief Song position the lyric cursor and highlight are drawn for
+ * 
+ * Ahead of the notes by the LCD latency, converted to written time.
+ * Notes start on the song clock however late a pass runs (see
+ * PolyBuzzer::update()), so words stay with them.
+ */
+unsigned long DualBuzzer::getLyricPosition() {
+    return getSongPosition() + lyricLatency * (unsigned long)getTempo() / 100000UL;
+}
+
+
+/**
+ * @brief Update the sliding lyrics display
+ * 
+ * Centers the word under the cursor on the top row and fills the rest of
+ * the row by walking outwards to its neighbours, so the work is bounded by
+ * the display width rather than the length of the song. The bottom row
+ * holds the progress highlight and next-word cue (see drawLyricCue()).
+ */
+void DualBuzzer::updateSlidingLyrics() {
+    if (lcd == NULL || !hasLyrics() || lyricsCount == 0) return;
+    
+    char line[41];
+    int cols = min(lcdCols, 40);
+    memset(line, ' ', cols);
+    line[cols] = '\0';
     
-    // Center the current word if possible
-    if (currentWordStart >= lcdCols / 2) {
-        displayStart = currentWordStart - (lcdCols / 2) + (currentWordLength / 2);
+    // Before the first word, center the upcoming word instead
+    int focus = max(currentLyricIndex, 0);
+    LyricTiming entry;
+    readLyric(focus, entry);
+    
+    const char* text = lyricText(entry.word);
+    int length = strlen(text);
+    int column = max(0, (cols - length) / 2);
+    for (int i = 0; i < length && column + i < cols; i++) {
+        line[column + i] = text[i];
     }
     
-    // Ensure we don't go past the end
-    if (displayStart + lcdCols > fullText.length()) {
-        displayStart = max(0, (int)fullText.length() - lcdCols);
+    // Words after the focus, left to right
+    int nextColumn = -1;
+    int right = column + length + 1;
+    for (int w = focus + 1; w < lyricsCount && right < cols; w++) {
+        readLyric(w, entry);
+        if (w == focus + 1) nextColumn = right;
+        text = lyricText(entry.word);
+        int wordLength = strlen(text);
+        for (int i = 0; i < wordLength && right + i < cols; i++) {
+            line[right + i] = text[i];
+        }
+        right += wordLength + 1;
     }
     
-    // Extract display text and pad with spaces
-    String displayText = fullText.substring(displayStart, min(displayStart + lcdCols, (int)fullText.length()));
-    while (displayText.length() < lcdCols) {
-        displayText += " ";
+    // Words before the focus, right to left
+    int left = column - 1;
+    for (int w = focus - 1; w >= 0 && left > 0; w--) {
+        readLyric(w, entry);
+        text = lyricText(entry.word);
+        int wordLength = strlen(text);
+        int wordStart = left - wordLength;
+        for (int i = 0; i < wordLength; i++) {
+            if (wordStart + i >= 0) line[wordStart + i] = text[i];
+        }
+        left = wordStart - 1;
     }
     
     // Display lyrics on top row
-    lcd->clear();
     lcd->setCursor(0, 0);
-    lcd->print(displayText);
+    lcd->print(line);
     
-    // Create animated dots on bottom row to highlight current word
-    String dotLine = "";
-    for (int i = 0; i < lcdCols; i++) {
-        dotLine += " ";
+    lyricWordColumn = column;
+    if (currentLyricIndex >= 0) {
+        lyricWordLength = min(length, cols - column);
+        lyricNextColumn = nextColumn;
+    } else {
+        lyricWordLength = 0;
+        lyricNextColumn = column;
     }
     
-    // Calculate dot positions for current word
-    int wordStartInDisplay = currentWordStart - displayStart;
-    int wordEndInDisplay = currentWordEnd - displayStart;
+    // Force the bottom row to redraw for the new word
+    lyricProgressCells = -1;
+    drawLyricCue();
+}
+
+/**
+ * @brief Draw the progress highlight and next-word cue on the bottom row
+ * 
+ * The current word is underlined with '=' as it is sung, and a '^' marks
+ * the next word once it is within the lead time. The row is only rewritten
+ * when one of those changes.
+ */
+void DualBuzzer::drawLyricCue() {
+    if (lcd == NULL || !hasLyrics() || lcdRows < 2 || visualizerEnabled) return;
+    
+    int cells = (lyricWordLength * (getLyricProgress() + 1)) >> 8;
+    bool cue = lyricNextColumn >= 0 && getUpcomingLyricIndex(lyricLeadTime) >= 0;
     
-    // Only show dots if current word is visible
-    if (wordStartInDisplay >= 0 && wordStartInDisplay < lcdCols) {
-        int dotCount = min(3, currentWordLength);
-        int dotSpacing = max(1, currentWordLength / dotCount);
-        
-        for (int i = 0; i < dotCount; i++) {
-            int dotPos = wordStartInDisplay + (i * dotSpacing);
-            if (dotPos >= 0 && dotPos < lcdCols) {
-                // Animate dots with different characters for visual effect
-                char dotChar = '.';
-                int animPhase = (millis() / 200 + i) % 4;
-                switch (animPhase) {
-                    case 0: dotChar = '.'; break;
-                    case 1: dotChar = 'o'; break;
-                    case 2: dotChar = 'O'; break;
-                    case 3: dotChar = 'o'; break;
-                }
-                dotLine[dotPos] = dotChar;
-            }
-        }
+    if (cells == lyricProgressCells && cue == lyricCueShown) return;
+    lyricProgressCells = cells;
+    lyricCueShown = cue;
+    
+    char line[41];
+    int cols = min(lcdCols, 40);
+    memset(line, ' ', cols);
+    line[cols] = '\0';
+    
+    for (int i = 0; i < lyricWordLength; i++) {
+        line[lyricWordColumn + i] = (i < cells) ? '=' : '.';
+    }
+    if (cue) {
+        line[lyricNextColumn] = '^';
+    }
+    if (lineScore >= 0 && lyricWordColumn + lyricWordLength <= cols - 4) {
+        snprintf(line + cols - 4, 5, "%3d%%", lineScore);
     }
     
-    // Display animated dots on bottom row
     lcd->setCursor(0, 1);
-    lcd->print(dotLine);
+    lcd->print(line);
 }
 
 /**
@@ -504,151 +1187,291 @@ void DualBuzzer::clearLyrics() {
 }
 
 /**
- * @brief Update LED effects based on current pattern
- * 
- * Calls the appropriate LED pattern function and manages animation timing.
+ * @brief Show pitch and note-progress bars on the bottom row
+ * @param enable True for the visualizer, false for the lyric progress cue
  */
-void DualBuzzer::updateLEDs() {
-  if (!ledEnabled) return;
+void DualBuzzer::enableVisualizer(bool enable) {
+  visualizerEnabled = enable;
+  if (lcd == NULL) return;
   
-  switch (currentPattern) {
-    case PATTERN_RAINBOW_CHASE:
-      applyRainbowChase();
-      break;
-    case PATTERN_SEQUENTIAL_NOTES:
-      applySequentialNotes();
-      break;
-    case PATTERN_NOTE_MAPPING:
-      applyNoteMapping();
-      break;
-    case PATTERN_RANDOM_NOTES:
-      applyRandomNotes();
-      break;
+  if (enable) {
+    loadVisualizerGlyphs();
+    lastVisualizerUpdate = 0;
+  } else {
+    // Give the bottom row back to the lyric cue
+    lyricProgressCells = -1;
+    if (isPlaying()) drawLyricCue();
   }
-  
-  patternStep++;
-  if (patternStep > 255) patternStep = 0;
 }
 
 /**
- * @brief Set LED colors with PWM brightness control
- * @param red Red LED brightness (0-255)
- * @param green Green LED brightness (0-255)
- * @param blue Blue LED brightness (0-255)
- * @param yellow Yellow LED brightness (0-255)
- * @param white White LED brightness (0-255)
+ * @brief Check whether the visualizer owns the bottom row
+ */
+bool DualBuzzer::isVisualizerEnabled() {
+  return visualizerEnabled;
+}
+
+/**
+ * @brief Define the bar-tip glyphs (1-4 pixel columns filled from the left)
  * 
- * Only sets LEDs that have valid pin assignments (>= 0).
+ * The display caches glyphs, so calling this again costs nothing.
  */
-void DualBuzzer::setLEDColor(int red, int green, int blue, int yellow, int white) {
-  if (ledConfig.redPin >= 0) analogWrite(ledConfig.redPin, red);
-  if (ledConfig.greenPin >= 0) analogWrite(ledConfig.greenPin, green);
-  if (ledConfig.bluePin >= 0) analogWrite(ledConfig.bluePin, blue);
-  if (ledConfig.yellowPin >= 0) analogWrite(ledConfig.yellowPin, yellow);
-  if (ledConfig.whitePin >= 0) analogWrite(ledConfig.whitePin, white);
+void DualBuzzer::loadVisualizerGlyphs() {
+  for (uint8_t width = 1; width <= 4; width++) {
+    uint8_t bits = (0x1F << (5 - width)) & 0x1F;
+    for (uint8_t row = 0; row < 8; row++) {
+      lcd->setGlyphRow(GLYPH_BAR_TIP + width - 1, row, bits);
+    }
+  }
 }
 
 /**
- * @brief Apply rainbow chase LED effect
+ * @brief Draw one visualizer frame on the bottom row
  * 
- * Cycles through colors in sequence with smooth brightness variation.
+ * Each half of the row is one voice: a pitch bar with one-pixel steps
+ * across the song's range, then a cell that fills upwards as the note
+ * is held. A frame is skipped while the display is still sending the
+ * previous one, so the visualizer never adds to an I2C backlog; the
+ * display's own per-pass budget bounds the rest.
  */
-void DualBuzzer::applyRainbowChase() {
-  // Cycle through colors in sequence
-  int step = (patternStep / 20) % 5;
-  int brightness = 200 + (sin(patternStep * 0.2) * 55);
+void DualBuzzer::drawVisualizer() {
+  if (lcd == NULL || lcdRows < 2) return;
+  if (!lcd->isIdle()) return;
   
-  int red = (step == 0) ? brightness : 0;
-  int yellow = (step == 1) ? brightness : 0;
-  int green = (step == 2) ? brightness : 0;
-  int blue = (step == 3) ? brightness : 0;
-  int white = (step == 4) ? brightness : 0;
+  int half = lcdCols / 2;
+  drawPitchBar(0, half - 1, voices.getFrequency(MELODY_VOICE));
+  drawNoteProgress(GLYPH_MELODY_PROGRESS, half - 1, MELODY_VOICE);
+  drawPitchBar(half, half - 1, voices.getFrequency(HARMONY_VOICE));
+  drawNoteProgress(GLYPH_HARMONY_PROGRESS, lcdCols - 1, HARMONY_VOICE);
+}
+
+/**
+ * @brief Draw a horizontal pitch bar with sub-cell resolution
+ * @param column First cell of the bar
+ * @param width Bar width in cells (5 pixels each)
+ * @param frequency Sounding frequency, or 0 for an empty bar
+ * 
+ * Length is in semitones above the song's lowest pitch, in the key it is
+ * playing in, so octaves and steps look the same anywhere on the bar.
+ */
+void DualBuzzer::drawPitchBar(int column, int width, int frequency) {
+  int pixels = 0;
+  
+  if (frequency > 0) {
+    int lowest = voices.transposeFrequency(rangeLow);
+    int highest = voices.transposeFrequency(rangeHigh);
+    int range = max(semitonesAbove(lowest, highest), 1);
+    int steps = min(semitonesAbove(lowest, frequency), range);
+    pixels = 1 + ((long)steps * (width * 5 - 1)) / range;
+  }
   
-  setLEDColor(red, green, blue, yellow, white);
+  lcd->setCursor(column, 1);
+  for (int cell = 0; cell < width; cell++) {
+    int filled = pixels - cell * 5;
+    if (filled >= 5) {
+      lcd->write(LCD_FULL_BLOCK);
+    } else if (filled > 0) {
+      lcd->write(GLYPH_BAR_TIP + filled - 1);
+    } else {
+      lcd->write(' ');
+    }
+  }
 }
 
+/**
+ * @brief Fill a glyph from the bottom as a voice's note is held
+ * @param glyph CGRAM glyph for this voice
+ * @param column Cell that shows the glyph
+ * @param voice Voice to follow
+ * 
+ * One more row lights per eighth of the note, so each step changes a
+ * single glyph row over I2C.
+ */
+void DualBuzzer::drawNoteProgress(uint8_t glyph, int column, uint8_t voice) {
+  uint8_t level = ((unsigned int)voices.getNoteProgress(voice) * 9) >> 8; // 0-8 rows
+  
+  for (uint8_t row = 0; row < 8; row++) {
+    lcd->setGlyphRow(glyph, row, (row >= 8 - level) ? 0x1F : 0x00);
+  }
+  lcd->setCursor(column, 1);
+  lcd->write(glyph);
+}
 
 /**
- * @brief Applies sequential note lighting effects for dual buzzer melody and harmony playback
+ * @brief Count semitones from one frequency up to another
+ * @param base Lower frequency in Hz
+ * @param frequency Higher frequency in Hz
+ * @return Nearest whole number of semitones (0 if frequency is not above base)
  * 
- * This method handles LED visualization during dual buzzer operation by:
- * - Reading current melody and harmony note frequencies from PROGMEM
- * - Detecting note changes and triggering sparkle effects
- * - Randomly selecting LEDs for each note to create visual variety
- * - Preventing back-to-back LED repetition for better visual experience
- */
-void DualBuzzer::applySequentialNotes() {
-  int melodyFreq = 0, harmonyFreq = 0;
+ * Integer only: whole octaves by halving, then the Q14 pitch-ratio table
+ * for the rest.
+ */
+int DualBuzzer::semitonesAbove(int base, int frequency) {
+  if (base <= 0 || frequency <= base) return 0;
   
-  // Get current frequencies from PROGMEM stored note sequences
-  if (melodyPlaying && melodyNotes != NULL && melodyIndex < melodyLength) {
-    Note currentNote;
-    memcpy_P(&currentNote, &melodyNotes[melodyIndex], sizeof(Note));
-    melodyFreq = currentNote.frequency;
+  int steps = 0;
+  unsigned long f = frequency;
+  while (f >= 2UL * base) {
+    f /= 2;
+    steps += 12;
   }
   
-  if (harmonyPlaying && harmonyNotes != NULL && harmonyIndex < harmonyLength) {
-    Note currentNote;
-    memcpy_P(&currentNote, &harmonyNotes[harmonyIndex], sizeof(Note));
-    harmonyFreq = currentNote.frequency;
+  // Round to the nearest step by comparing against the midpoint ratios
+  for (int s = 1; s <= 12; s++) {
+    unsigned long below = pgm_read_word(&PITCH_RATIOS[TRANSPOSE_MAX_SEMITONES + s - 1]);
+    unsigned long above = pgm_read_word(&PITCH_RATIOS[TRANSPOSE_MAX_SEMITONES + s]);
+    if (f * 16384UL < (unsigned long)base * ((below + above) / 2)) break;
+    steps++;
   }
+  return steps;
+}
+
+/**
+ * @brief Step the LED envelopes, running the pattern when it is due
+ * 
+ * The pattern runs every ledUpdateInterval, and at once when either
+ * voice moves to another note so the attack starts with the note. A
+ * note due within half a step is shown from this one, so the attack
+ * lands within half a step of the note rather than up to a whole step
+ * after it (see getLEDLead()). Only outputs the envelope changed are
+ * written.
+ */
+void DualBuzzer::updateLEDs() {
+  unsigned long currentTime = millis();
+  lastLEDUpdate = currentTime;
   
-  /**
-   * Note change detection system - tracks when frequencies change
-   * to trigger special visual effects and prevent LED flicker
-   */
-  if (melodyFreq != lastMelodyFreq || harmonyFreq != lastHarmonyFreq) {
-    lastMelodyFreq = melodyFreq;
-    lastHarmonyFreq = harmonyFreq;
-    noteChangeTime = millis();
-    noteJustChanged = true;
+  // Steps come when the scheduler gets to them, so time them
+  unsigned long nowUs = micros();
+  unsigned long gap = nowUs - lastLEDFrameUs;
+  lastLEDFrameUs = nowUs;
+  if (gap <= 4 * LED_FRAME_INTERVAL * 1000UL) {
+    ledFrameGap += ((long)gap - (long)ledFrameGap) / 8;
   }
+  if (!ledEnabled) return;
   
-  // Use melody frequency as primary, harmony as secondary fallback
-  int primaryFreq = (melodyFreq > 0) ? melodyFreq : harmonyFreq;
+  // A new note in either voice, regardless of frequency
+  int melodyFreq;
+  int harmonyFreq;
+  int melodyIndex = ledNote(MELODY_VOICE, melodyFreq);
+  int harmonyIndex = ledNote(HARMONY_VOICE, harmonyFreq);
+  bool onset = (melodyIndex != lastMelodyIndex || harmonyIndex != lastHarmonyIndex);
+  lastMelodyIndex = melodyIndex;
+  lastHarmonyIndex = harmonyIndex;
   
-  // Clear all LED states before applying new lighting
-  setLEDColor(0, 0, 0, 0, 0);
+  if (onset) {
+    runPattern(true, melodyFreq, harmonyFreq);
+  } else if (currentTime - lastPatternFrame >= ledUpdateInterval) {
+    runPattern(false, melodyFreq, harmonyFreq);
+    lastPatternFrame = currentTime;
+    patternStep++;
+  }
   
-  if (primaryFreq > 0) {
-    /**
-     * Random LED selection with anti-repetition logic
-     * Ensures visual variety while preventing monotonous back-to-back same LED
-     */
-    static int lastLED = -1;
-    int currentLED;
-    
-    do {
-      currentLED = random(0, 5); // 0=Red, 1=Green, 2=Blue, 3=Yellow, 4=White
-    } while (currentLED == lastLED && noteJustChanged);
-    
-    lastLED = currentLED;
-    
-    // Map LED index to color channels (RGB + Yellow + White)
-    int red = (currentLED == 0) ? 255 : 0;
-    int green = (currentLED == 1) ? 255 : 0;
-    int blue = (currentLED == 2) ? 255 : 0;
-    int yellow = (currentLED == 3) ? 255 : 0;
-    int white = (currentLED == 4) ? 255 : 0;
-    
-    setLEDColor(red, green, blue, yellow, white);
-    
-    /**
-     * Sparkle effect on note transitions
-     * Creates a brief 100ms flash of all LEDs when notes change
-     */
-    if (noteJustChanged && millis() - noteChangeTime < 100) {
-      // Brief flash of all LEDs when note changes
-      setLEDColor(100, 100, 100, 100, 100);
+  uint8_t changed = ledEnvelope.step();
+  for (uint8_t channel = 0; channel < LED_CHANNELS; channel++) {
+    if (changed & (1 << channel)) {
+      writeLED(channel, ledEnvelope.getOutput(channel));
     }
   }
+}
+
+/**
+ * @brief Find the note a voice's LEDs show this step
+ * @param frequency Set to the note's frequency as decoded (0 = rest)
+ * @return The note's index
+ * 
+ * The note sounding, or the next one if it is due within getLEDLead().
+ * Songs from a NoteSource can't be read ahead, so they light on the note.
+ */
+int DualBuzzer::ledNote(uint8_t voice, int& frequency) {
+  Note next;
+  if (voices.getTimeLeft(voice) <= (getLEDLead() + 500) / 1000 && voices.peekNote(voice, next)) {
+    frequency = next.frequency;
+    return voices.getNoteIndex(voice) + 1;
+  }
+  frequency = voices.getFrequency(voice);
+  return voices.getNoteIndex(voice);
+}
+
+/**
+ * @brief Get how early a note's LEDs may light
+ * @return Microseconds: half the measured time between envelope steps
+ */
+unsigned long DualBuzzer::getLEDLead() {
+  return ledFrameGap / 2;
+}
+
+/**
+ * @brief Run the pattern's hooks from LED_PATTERNS and hand its levels
+ *        to the envelope
+ * @param onset A note has just started (onNote runs first)
+ * @param melodyFreq Melody note shown, as decoded (tempo and key applied)
+ * @param harmonyFreq Harmony note shown
+ */
+void DualBuzzer::runPattern(bool onset, int melodyFreq, int harmonyFreq) {
+  LEDFrame frame;
+  frame.melodyFreq = melodyFreq;
+  frame.harmonyFreq = harmonyFreq;
+  frame.lowest = voices.transposeFrequency(rangeLow);
+  frame.highest = voices.transposeFrequency(rangeHigh);
+  frame.step = patternStep;
+  frame.now = lastLEDUpdate;
+  memset(frame.levels, 0, sizeof(frame.levels));
+  
+  const LEDPatternDef* pattern = &LED_PATTERNS[currentPattern];
+  
+  if (onset) {
+    void (*onNote)(LEDPatternState&, LEDFrame&) = (void (*)(LEDPatternState&, LEDFrame&))pgm_read_ptr(&pattern->onNote);
+    if (onNote != NULL) {
+      onNote(patternState, frame);
+    }
+  }
+  
+  void (*onFrame)(LEDPatternState&, LEDFrame&) = (void (*)(LEDPatternState&, LEDFrame&))pgm_read_ptr(&pattern->onFrame);
+  if (onFrame != NULL) {
+    onFrame(patternState, frame);
+  }
   
-  // Reset note change flag after sparkle duration expires
-  if (millis() - noteChangeTime > 100) {
-    noteJustChanged = false;
+  for (uint8_t channel = 0; channel < LED_CHANNELS; channel++) {
+    ledEnvelope.setTarget(channel, frame.levels[channel], onset);
   }
 }
 
+/**
+ * @brief Set LED colors with PWM brightness control
+ * @param red Red LED brightness (0-255)
+ * @param green Green LED brightness (0-255)
+ * @param blue Blue LED brightness (0-255)
+ * @param yellow Yellow LED brightness (0-255)
+ * @param white White LED brightness (0-255)
+ * 
+ * Only sets LEDs that have valid pin assignments (>= 0). Bypasses the
+ * envelope; patterns carry on from these levels.
+ */
+void DualBuzzer::setLEDColor(int red, int green, int blue, int yellow, int white) {
+  const int levels[LED_CHANNELS] = { red, green, blue, yellow, white };
+  for (uint8_t channel = 0; channel < LED_CHANNELS; channel++) {
+    ledEnvelope.jump(channel, constrain(levels[channel], 0, 255));
+    writeLED(channel, levels[channel]);
+  }
+}
+
+/**
+ * @brief Write one LED's PWM level
+ * @param channel LEDChannel
+ * @param level Brightness (0-255)
+ */
+void DualBuzzer::writeLED(uint8_t channel, int level) {
+  int pin = -1;
+  switch (channel) {
+    case LED_RED:    pin = ledConfig.redPin; break;
+    case LED_GREEN:  pin = ledConfig.greenPin; break;
+    case LED_BLUE:   pin = ledConfig.bluePin; break;
+    case LED_YELLOW: pin = ledConfig.yellowPin; break;
+    case LED_WHITE:  pin = ledConfig.whitePin; break;
+  }
+  if (pin >= 0) analogWrite(pin, level);
+}
+
 /**
  * @brief Plays a musical sequence with synchronized LED visualization
  * 
@@ -793,18 +1616,13 @@ void DualBuzzer::lightLEDForNote(int frequency) {
  * - Scrolling text message on top LCD line
  * - Wave animation pattern on bottom LCD line
  * - Musical note symbols integrated into wave pattern
- * - Controlled update timing (300ms intervals) for smooth animation
+ * - One step per call (called every IDLE_FRAME_INTERVAL) for smooth animation
  * - Overflow protection for animation counters
  */
 void DualBuzzer::showIdleLCD() {
-  unsigned long currentTime = millis();
+  if (lcd == NULL) return;
   
-  // Throttle animation updates to 300ms intervals for smooth motion
-  if (currentTime - lastIdleUpdate < 300) { 
-    return;
-  }
-  
-  lastIdleUpdate = currentTime;
+  lastIdleUpdate = millis();
   isIdleMode = true;
   
   /**
@@ -894,169 +1712,6 @@ void DualBuzzer::startIdleMode() {
   setLEDColor(0,0,0,0,0);  // Clear all LED outputs
   isIdleMode = true;
   idleAnimationStep = 0;   // Reset animation counter
-  lastIdleUpdate = 0;      // Force immediate update
   showIdleLCD();           // Display initial animation frame
 }
 
-
-/**
- * @brief Apply note-to-LED mapping pattern similar to Angela's approach
- * 
- * Maps specific musical notes/frequencies to corresponding LEDs:
- * - Each LED represents a different note or frequency range
- * - Only the LED corresponding to the currently playing note lights up
- * - Uses both melody and harmony frequencies for comprehensive mapping
- */
-void DualBuzzer::applyNoteMapping() {
-  int melodyFreq = 0, harmonyFreq = 0;
-  
-  // Get current frequencies from PROGMEM
-  if (melodyPlaying && melodyNotes != NULL && melodyIndex < melodyLength) {
-    Note currentNote;
-    memcpy_P(&currentNote, &melodyNotes[melodyIndex], sizeof(Note));
-    melodyFreq = currentNote.frequency;
-  }
-  
-  if (harmonyPlaying && harmonyNotes != NULL && harmonyIndex < harmonyLength) {
-    Note currentNote;
-    memcpy_P(&currentNote, &harmonyNotes[harmonyIndex], sizeof(Note));
-    harmonyFreq = currentNote.frequency;
-  }
-  
-  // Clear all LEDs first
-  setLEDColor(0, 0, 0, 0, 0);
-  
-  // Map melody frequency to LED
-  if (melodyFreq > 0) {
-    mapFrequencyToLED(melodyFreq, true);
-  }
-  
-  // Map harmony frequency to LED (dimmer if both playing)
-  if (harmonyFreq > 0) {
-    mapFrequencyToLED(harmonyFreq, melodyFreq == 0);
-  }
-}
-
-/**
- * @brief Helper method to map a specific frequency to an LED
- * @param frequency The frequency to map
- * @param fullBrightness Whether to use full brightness or dimmed
- */
-void DualBuzzer::mapFrequencyToLED(int frequency, bool fullBrightness) {
-  int brightness = fullBrightness ? 255 : 127;
-  
-  // Frequency ranges mapped to specific LEDs (similar to Angela's approach)
-  if (frequency >= 130 && frequency <= 200) {
-    // Low bass notes -> Red LED
-    setLEDColor(brightness, 0, 0, 0, 0);
-  }
-  else if (frequency >= 201 && frequency <= 300) {
-    // Mid-low notes -> Yellow LED  
-    setLEDColor(0, 0, 0, brightness, 0);
-  }
-  else if (frequency >= 301 && frequency <= 500) {
-    // Mid notes -> Green LED
-    setLEDColor(0, brightness, 0, 0, 0);
-  }
-  else if (frequency >= 501 && frequency <= 800) {
-    // Mid-high notes -> Blue LED
-    setLEDColor(0, 0, brightness, 0, 0);
-  }
-  else if (frequency > 800) {
-    // High notes -> White LED
-    setLEDColor(0, 0, 0, 0, brightness);
-  }
-}
-
-/**
- * @brief Apply random LED selection pattern with anti-repetition
- * 
- * This pattern randomly selects one LED for each note while ensuring:
- * - No consecutive notes use the same LED
- * - Equal probability for all available LEDs
- * - Smooth transitions between notes
- * - Support for both melody and harmony playback
- */
-void DualBuzzer::applyRandomNotes() {
-    int melodyFreq = 0, harmonyFreq = 0;
-    
-    // Get current frequencies from PROGMEM
-    if (melodyPlaying && melodyNotes != NULL && melodyIndex < melodyLength) {
-        Note currentNote;
-        memcpy_P(&currentNote, &melodyNotes[melodyIndex], sizeof(Note));
-        melodyFreq = currentNote.frequency;
-    }
-    
-    if (harmonyPlaying && harmonyNotes != NULL && harmonyIndex < harmonyLength) {
-        Note currentNote;
-        memcpy_P(&currentNote, &harmonyNotes[harmonyIndex], sizeof(Note));
-        harmonyFreq = currentNote.frequency;
-    }
-    
-    // Check if we have a note index change (new note, regardless of frequency)
-    bool noteChanged = (melodyIndex != lastMelodyIndex || harmonyIndex != lastHarmonyIndex);
-    
-    if (noteChanged) {
-        lastMelodyIndex = melodyIndex;
-        lastHarmonyIndex = harmonyIndex;
-        lastMelodyFreq = melodyFreq;
-        lastHarmonyFreq = harmonyFreq;
-        firstRandomNote = false;
-    }
-    
-    // Use primary frequency (melody takes priority, harmony as fallback)
-    int primaryFreq = (melodyFreq > 0) ? melodyFreq : harmonyFreq;
-    
-    // Clear all LEDs first
-    setLEDColor(0, 0, 0, 0, 0);
-    
-    // Only light LED if we have a frequency (not a rest)
-    if (primaryFreq > 0) {
-        int selectedLED;
-        
-        // Select random LED with anti-repetition logic
-        if (firstRandomNote) {
-            // First note can be any LED
-            selectedLED = random(0, 5);
-            firstRandomNote = false;
-        } else if (noteChanged) {
-            // Note changed (new note in sequence) - select different LED than last time
-            do {
-                selectedLED = random(0, 5);
-            } while (selectedLED == lastRandomLED);
-        } else {
-            // Same note continuing (shouldn't happen with index tracking, but fallback)
-            selectedLED = lastRandomLED;
-        }
-        
-        // Update tracking variable
-        if (noteChanged) {
-            lastRandomLED = selectedLED;
-        }
-        
-        // Calculate brightness based on frequency (higher freq = brighter)
-        int brightness = map(constrain(primaryFreq, 130, 2093), 130, 2093, 180, 255);
-        
-        // Light the selected LED
-        switch (selectedLED) {
-            case 0: // Red
-                setLEDColor(brightness, 0, 0, 0, 0);
-                break;
-            case 1: // Green
-                setLEDColor(0, brightness, 0, 0, 0);
-                break;
-            case 2: // Blue
-                setLEDColor(0, 0, brightness, 0, 0);
-                break;
-            case 3: // Yellow
-                setLEDColor(0, 0, 0, brightness, 0);
-                break;
-            case 4: // White
-                setLEDColor(0, 0, 0, 0, brightness);
-                break;
-        }
-    } else {
-        // No frequency - turn off all LEDs
-        setLEDColor(0, 0, 0, 0, 0);
-    }
-}
@@ -1,24 +1,127 @@
 #ifndef DUAL_BUZZER_H
 #define DUAL_BUZZER_H
 #include <Arduino.h>
-#include <LiquidCrystal_I2C.h>
+#include "AsyncLCD.h"
+#include "PolyBuzzer.h"
+#include "LEDPatterns.h"
+#include "FlightRecorder.h"
+
+// Number of buzzer voices; voice 0 is the melody and voice 1 the harmony.
+// Build with -DBUZZER_VOICES=3 (or 4) to add bass or percussion parts.
+#ifndef BUZZER_VOICES
+#define BUZZER_VOICES 2
+#endif
+
+const uint8_t MELODY_VOICE = 0;
+const uint8_t HARMONY_VOICE = 1;
+
+// Time between idle animation frames (see updateIdleScreen())
+const unsigned long IDLE_FRAME_INTERVAL = 300;
+
+// Lookahead for the lyrics: a word is drawn this early, then by what the
+// LCD is measured to take (see updateLyrics())
+const unsigned long LCD_LATENCY_DEFAULT_US = 15000;
+const unsigned long LCD_LATENCY_MAX_US = 200000;    // Slower frames (a clear, a seek) aren't counted
 
 /**
- * @struct Note
- * @brief Structure to hold a musical note and its duration
+ * @struct LyricTiming
+ * @brief Structure to synchronize lyrics with the song clock
+ *
+ * Entries must be sorted by timeMs. Times are absolute from the start of
+ * the song, so a word can land on a rest or a harmony-only passage.
+ * A word that starts a line is written with a leading LYRIC_LINE_MARK,
+ * which is not shown.
  */
-struct Note {
-    int frequency;  // Hz
-    int duration;   // milliseconds
+const char LYRIC_LINE_MARK = '/';
+
+struct LyricTiming {
+    const char* word;       // Word or phrase to display
+    unsigned long timeMs;   // Song time (ms) at which the word starts
 };
 
 /**
- * @struct LyricTiming
- * @brief Structure to synchronize lyrics with musical notes
+ * @class LyricSource
+ * @brief Lyrics kept somewhere other than a PROGMEM table
+ *
+ * The count may grow while the song plays. Words a source has already
+ * dropped read back as empty strings. Words returned stay valid until
+ * releaseLyrics() lets the source reuse them.
  */
-struct LyricTiming {
-    String word;      // Word or phrase to display
-    int noteIndex;    // Note index for timing
+class LyricSource {
+public:
+    virtual int getLyricCount() = 0;
+    virtual void readLyric(int index, LyricTiming& out) = 0;
+    virtual void releaseLyrics(int before) = 0;     // Words before this index are done with
+};
+
+/**
+ * @struct SongInfo
+ * @brief Song measurements worked out at compile time (see describeSong())
+ */
+struct SongInfo {
+    unsigned long durationMs;   // Written length of the longest part
+    int lowestPitch;            // Hz, rests skipped
+    int highestPitch;           // Hz
+};
+
+/**
+ * @brief Measure a melody and harmony pair at compile time
+ *
+ * Use with constexpr note tables:
+ *   constexpr SongInfo info = describeSong(melody, harmony);
+ */
+template <size_t M, size_t H>
+constexpr SongInfo describeSong(const Note (&melody)[M], const Note (&harmony)[H]) {
+    return SongInfo{
+        higherDuration(notesDuration(melody), notesDuration(harmony)),
+        lowerPitch(lowestPitch(melody), lowestPitch(harmony)),
+        higherPitch(highestPitch(melody), highestPitch(harmony))
+    };
+}
+
+/**
+ * @brief Measure a melody-only song, whose harmony is generated
+ *
+ * The pitch range covers the melody; DualBuzzer widens it for the
+ * generated part (see Harmonizer::getRange()).
+ */
+template <size_t M>
+constexpr SongInfo describeMelody(const Note (&melody)[M]) {
+    return SongInfo{ notesDuration(melody), lowestPitch(melody), highestPitch(melody) };
+}
+
+// Check that melody and harmony end together
+template <size_t M, size_t H>
+constexpr bool partsMatch(const Note (&melody)[M], const Note (&harmony)[H]) {
+    return notesDuration(melody) == notesDuration(harmony);
+}
+
+// Check that lyric times never go backwards
+template <size_t N>
+constexpr bool lyricsSorted(const LyricTiming (&lyrics)[N], size_t i = 1) {
+    return (i >= N) || (lyrics[i - 1].timeMs <= lyrics[i].timeMs && lyricsSorted(lyrics, i + 1));
+}
+
+// Check that every word starts before the song ends (lyrics must be sorted)
+template <size_t N>
+constexpr bool lyricsWithin(const LyricTiming (&lyrics)[N], unsigned long durationMs) {
+    return lyrics[N - 1].timeMs < durationMs;
+}
+
+/**
+ * @struct SongCue
+ * @brief A song prepared ahead of time to follow the current one
+ */
+struct SongCue {
+    Note* notes[BUZZER_VOICES];
+    int lengths[BUZZER_VOICES];
+    const int8_t* accents[BUZZER_VOICES];
+    LyricTiming* lyrics;
+    int lyricsCount;
+    SongInfo info;
+    HarmonyStyle style;
+    unsigned long gapMs;      // Silence between the two songs
+    bool pending;
 };
 
 /**
@@ -33,74 +136,81 @@ struct LEDConfig {
     int whitePin;
 };
 
-/**
- * @enum LEDPattern
- * @brief Enumeration of available LED light show patterns
- */
-enum LEDPattern {
-    PATTERN_RAINBOW_CHASE,       // Continuous color cycling
-    PATTERN_SEQUENTIAL_NOTES,    // Sequential LED activation
-    PATTERN_NOTE_MAPPING,        // Map each note to an LED based on freq
-    PATTERN_RANDOM_NOTES         // Random led
-};
-
 /**
  * @class DualBuzzer
  * @brief Controls dual buzzers for melody and harmony playback
+ *
+ * Note timing is handled by PolyBuzzer; BUZZER_VOICES above two adds
+ * extra parts on their own buzzers (see setVoice()/setVoicePin()).
  */
 class DualBuzzer {
 private:
-    // Hardware pins
-    int melodyPin;
-    int harmonyPin;
-
-    // Music data
-    Note* melodyNotes;
-    Note* harmonyNotes;
-    int melodyLength;
-    int harmonyLength;
-
-    // Timing control
-    unsigned long melodyStartTime;
-    unsigned long harmonyStartTime;
-    int melodyIndex;
-    int harmonyIndex;
-
-    // Playback status
-    bool melodyPlaying;
-    bool harmonyPlaying;
+    // Voices, song clock, tempo and key
+    PolyBuzzer<BUZZER_VOICES> voices;
+
+    // Compile-time measurements of the current song
+    SongInfo songInfo;
+    int rangeLow;                   // Pitch range sounding, generated harmony included
+    int rangeHigh;
+
+    // Generated harmony
+    Harmonizer harmonizer;
+    HarmonyStyle songStyle;         // Key and rule that came with the song
+    HarmonyRule harmonyRule;        // Chosen by the user; HARMONY_WRITTEN = the song's own
+    bool writtenHarmony;            // Current song has a harmony table
+
+    // Next song, started by update() when this one ends
+    SongCue cue;
+
+    // Song waiting for playAt()'s start time
+    bool startPending;
+    unsigned long startTime;        // On the song clock
 
     // Lyrics system
     LyricTiming* lyrics;
+    LyricSource* lyricSource;       // Replaces the table when set
     int lyricsCount;
-    int currentLyricIndex;
+    int currentLyricIndex;          // Cursor: last word whose time has passed (-1 before first)
+    unsigned long currentLyricTime; // Start time of the word under the cursor
+    unsigned long nextLyricTime;    // Start time of the following word (or song end)
+    unsigned long lyricLeadTime;    // How early the next word is cued (ms)
+    int lyricProgressCells;         // Highlight cells drawn for the current word
+    bool lyricCueShown;             // Whether the next-word cue is drawn
+    int lyricWordColumn;            // Where the current word sits on the top row
+    int lyricWordLength;
+    int lyricNextColumn;            // Where the next word sits (-1 if off screen)
+    int lyricLine;                  // Counts lines begun; a jump of the cursor counts as one
+    int8_t lineScore;               // Percent shown at the end of the cue row (-1 = none)
+    unsigned long lyricLatency;     // Average us from drawing a new word to the LCD showing it
+    unsigned long lyricDrawTime;    // micros() the word being sent was drawn
+    bool lyricDrawPending;          // Waiting for the LCD to show it
 
     // LCD display
-    LiquidCrystal_I2C* lcd;
+    AsyncLCD* lcd;
     int lcdRows;
     int lcdCols;
+    bool lcdBusy;                   // Last update() left changes to send
+
+    FlightRecorder* recorder;       // Notes and LCD frames go here (NULL = not recorded)
 
     // LED system
     LEDConfig ledConfig;
     bool ledEnabled;
-    LEDPattern currentPattern;
-    unsigned long lastLEDUpdate;
-    int ledUpdateInterval;
-    int patternStep;
-    int lastMelodyFreq;
-    int lastHarmonyFreq;
-    unsigned long noteChangeTime;
-    bool noteJustChanged;
-    int lastMelodyIndex;
+    uint8_t currentPattern;         // Index in LED_PATTERNS
+    LEDPatternState patternState;
+    LEDEnvelope ledEnvelope;
+    unsigned long lastLEDUpdate;        // Last envelope step
+    unsigned long lastPatternFrame;
+    unsigned long ledUpdateInterval;    // Between pattern frames
+    uint8_t patternStep;
+    int lastMelodyIndex;            // Notes shown at the last frame, to spot new ones
     int lastHarmonyIndex;
+    unsigned long lastLEDFrameUs;       // micros() at the last envelope step
+    unsigned long ledFrameGap;          // Average us between envelope steps
 
-    // LED effects
-    int currentIntensity;
-    bool strobeState;
-    unsigned long lastStrobeTime;
-
-    int lastRandomLED;
-    bool firstRandomNote;
+    // Pitch and note-progress bars on the bottom row (replaces the lyric cue)
+    bool visualizerEnabled;
+    unsigned long lastVisualizerUpdate;
 
     // Idle mode
     int idleAnimationStep;
@@ -114,37 +224,93 @@ public:
     // Music setup
     void setMelody(Note* notes, int length);
     void setHarmony(Note* notes, int length);
-    void setSong(Note* melodyNotes, int melodyLength, Note* harmonyNotes, int harmonyLength);
+    void setSong(Note* melodyNotes, int melodyLength, Note* harmonyNotes, int harmonyLength,
+                 const SongInfo& info);
+    void setVoice(uint8_t voice, Note* notes, int length);   // Any voice, including extras
+    void setAccents(uint8_t voice, const int8_t* accents);   // After the voice's notes
+    void setVoicePin(uint8_t voice, int pin);                // Buzzer pin for an extra voice
     void setLyrics(LyricTiming* timings, int count);
+    void setStreamedSong(NoteSource* notes, LyricSource* words, const SongInfo& info);
+    void setHarmonyStyle(const HarmonyStyle& style);         // Key and rule for this song
 
     // Display setup
-    void setLCD(LiquidCrystal_I2C* display, int rows, int columns);
+    void setLCD(AsyncLCD* display, int rows, int columns);
+    void setRecorder(FlightRecorder* to);
 
     // LED setup and control
     void setupLEDs(int redPin, int bluePin, int greenPin, int yellowPin, int whitePin);
-    void setLEDPattern(LEDPattern pattern);
+    void setLEDPattern(uint8_t pattern);    // Index in LED_PATTERNS
     void enableLEDs(bool enable);
+    void setLEDEnvelope(uint16_t attackMs, uint16_t decayMs, uint8_t sustainPercent, uint16_t releaseMs);
 
     // Playback control
     void play();              // Start both parts
+    void playAt(unsigned long at);  // Start both parts at a song clock time
+    bool isStartPending();
     void playMelody();        // Start melody only
     void playHarmony();       // Start harmony only
     void stop();              // Stop all
     void stopMelody();        // Stop melody only
     void stopHarmony();       // Stop harmony only
+    void seek(unsigned long positionMs); // Jump to a song position
+    void setClock(unsigned long (*clock)()); // Song clock; millis() by default
+
+    // Gapless follow-on song
+    void cueSong(Note* melodyNotes, int melodyLength, Note* harmonyNotes, int harmonyLength,
+                 const SongInfo& info, LyricTiming* timings, int count, unsigned long gapMs);
+    void cueVoice(uint8_t voice, Note* notes, int length); // Extra voices for the cued song
+    void cueAccents(uint8_t voice, const int8_t* accents);
+    void cueHarmonyStyle(const HarmonyStyle& style);
+    void cancelCue();
+    bool isSongCued();
+
+    // Tempo and key
+    void setTempo(int percent);          // 100 = as written
+    int getTempo();
+    void setTranspose(int semitones);    // 0 = as written
+    int getTranspose();
+    void setVolume(uint8_t voice, uint8_t volume);  // 0-PITCH_VOLUME_MAX, full by default
+    uint8_t getVolume(uint8_t voice);
+    uint8_t getPitch(uint8_t voice);     // MIDI note sounding now (0 = rest)
+
+    // Generated harmony
+    void setHarmonyRule(HarmonyRule rule);  // HARMONY_WRITTEN = as the song says
+    HarmonyRule getHarmonyRule();
+    bool isHarmonyGenerated();              // Harmony voice comes from the Harmonizer
 
     // Main update loop
-    void update();            // Call in main loop
+    void update();            // Call in main loop (or the four below from a scheduler)
+    void updateAudio();       // Notes and cued songs: every pass
+    void updateDisplay();     // Lyrics, visualizer and LCD drain: every pass
+    void updateIdleScreen();  // One idle frame: every IDLE_FRAME_INTERVAL
+    void updateLEDs();        // One LED envelope step: every getLEDInterval()
+    unsigned long getLEDInterval();
     bool isPlaying();         // Check playback status
+    NoteSource* getNoteSource(); // Set by setStreamedSong(), NULL for tables
+    bool isHolding();         // Streamed song waiting for notes
+    unsigned long getHoldTime();
+    unsigned long getSongPosition(); // Milliseconds since the song started
 
     // Display functions
     void updateLyrics();
     void updateSlidingLyrics();
     void clearLyrics();
+    void setLyricLeadTime(unsigned long leadMs);
+    void enableVisualizer(bool enable);
+    bool isVisualizerEnabled();
+
+    // Lyric timeline
+    int getCurrentLyricIndex();
+    int getUpcomingLyricIndex(unsigned long withinMs);
+    uint8_t getLyricProgress();   // 0-255 through the current word
+    int getLyricLine();           // Changes as each line of lyrics begins
+    void showLineScore(int percent);  // At the end of the cue row; -1 to clear
+    unsigned long getLyricLatency();  // us a word is drawn ahead of its time
 
     // LED control
     void setLEDColor(int red, int green, int blue, int yellow, int white);
     void lightLEDForNote(int freq);
+    unsigned long getLEDLead();       // us a note's LEDs may light ahead of it
     void playSequenceWithLEDs(const Note* sequence, int length, int buzzerPin);
     
 
@@ -155,16 +321,32 @@ public:
 private:
     // Helper functions
     void splitLyrics();
+    void readLyric(int index, LyricTiming& out);
+    bool hasLyrics() { return lyrics != NULL || lyricSource != NULL; }
+
+    bool advanceLyricCursor(unsigned long position);
+    void seekLyricCursor(unsigned long position);
+    bool loadLyricBounds();       // True if the word under the cursor starts a line
+    unsigned long getLyricPosition();   // Song position the LCD is drawn for
+
+    void drawLyricCue();
+    void startCuedSong(unsigned long startAt);
+    void applyHarmony();
 
-    // LED pattern implementations
-    void updateLEDs();
-    void applyRainbowChase();
-    void applySequentialNotes();
-    void applyRandomNotes();
-    void applyNoteMapping();
-    void mapFrequencyToLED(int frequency, bool fullBrightness);
+    // Visualizer
+    void loadVisualizerGlyphs();
+    void drawVisualizer();
+    void drawPitchBar(int column, int width, int frequency);
+    void drawNoteProgress(uint8_t glyph, int column, uint8_t voice);
+    int semitonesAbove(int base, int frequency);
 
-    // LED utilities
+
+    // LED output
+    int ledNote(uint8_t voice, int& frequency);
+    void runPattern(bool onset, int melodyFreq, int harmonyFreq);
+    void writeLED(uint8_t channel, int level);
+
+    // Idle mode
     void showIdleLCD();
 };
 
@@ -0,0 +1,192 @@
+#include "FlightRecorder.h"
+#if defined(__AVR__)
+#include <avr/wdt.h>
+#define FLIGHT_NOINIT __attribute__((section(".noinit")))
+#else
+#define FLIGHT_NOINIT
+#endif
+
+// Tells a ring left by the last run from whatever RAM held at power-up
+static const uint16_t FLIGHT_MAGIC = 0xF17E;
+
+/**
+ * The ring and its state, outside the class so the C runtime leaves it
+ * alone at a reset and the watchdog interrupt can reach it.
+ */
+struct FlightLog {
+    uint16_t magic;
+    uint8_t head;                   // Next entry written
+    uint8_t count;
+    volatile uint8_t stalled;       // Set by the watchdog interrupt
+    unsigned long stallTime;        // millis() when it fired
+    FlightEvent events[FLIGHT_EVENTS];
+};
+
+static FlightLog flightLog FLIGHT_NOINIT;
+
+#if defined(__AVR__)
+// After a watchdog reset the watchdog stays on at its shortest timeout.
+// Turn it off before the C runtime starts, or setup() never finishes.
+void flightRecorderEarlyInit() __attribute__((naked, used, section(".init3")));
+void flightRecorderEarlyInit() {
+  MCUSR = 0;
+  wdt_disable();
+}
+
+ISR(WDT_vect) {
+  // The hardware has cleared WDIE, so the next timeout resets the board
+  // unless endPass() sees this first
+  flightLog.stalled = 1;
+  flightLog.stallTime = millis();
+}
+
+/**
+ * @brief Watchdog on at 4 seconds, interrupt first and reset the time after
+ *
+ * Longer than the 2 second pause "play" takes before a song starts.
+ */
+static void armWatchdog() {
+  uint8_t sreg = SREG;
+  cli();
+  wdt_reset();
+  WDTCSR = _BV(WDCE) | _BV(WDE);
+  WDTCSR = _BV(WDIE) | _BV(WDE) | _BV(WDP3);
+  SREG = sreg;
+}
+#endif
+
+/**
+ * @brief A pass time in the 100us steps of an event's value
+ */
+static uint16_t passSteps(unsigned long passUs) {
+  unsigned long steps = passUs / 100;
+  return steps > 0xFFFF ? 0xFFFF : steps;
+}
+
+/**
+ * @brief Add an entry, overwriting the oldest once the ring is full
+ */
+static void append(unsigned long time, uint8_t type, uint8_t arg, uint16_t value) {
+  FlightEvent& event = flightLog.events[flightLog.head];
+  event.time = time;
+  event.type = type;
+  event.arg = arg;
+  event.value = value;
+
+  flightLog.head = (flightLog.head + 1) % FLIGHT_EVENTS;
+  if (flightLog.count < FLIGHT_EVENTS) flightLog.count++;
+}
+
+/**
+ * @brief Constructor: nothing is recorded until begin()
+ *
+ * The ring may hold the last run's events, so it is not cleared here.
+ */
+FlightRecorder::FlightRecorder() {
+  watchdogReset = false;
+  held = true;
+}
+
+/**
+ * @brief Take over the ring left by the last run, or start an empty one
+ *
+ * Call at the end of setup(), as the watchdog starts here and setup()
+ * may block for longer than it allows.
+ */
+void FlightRecorder::begin() {
+  bool warm = flightLog.magic == FLIGHT_MAGIC && flightLog.head < FLIGHT_EVENTS &&
+              flightLog.count <= FLIGHT_EVENTS;
+
+  if (!warm) {
+    clear();
+  } else if (flightLog.stalled) {
+    // The stall never ended: the watchdog reset the board
+    append(flightLog.stallTime, FLIGHT_STALL, 0xFF, 0);
+    watchdogReset = true;
+  }
+  flightLog.stalled = 0;
+  append(millis(), FLIGHT_BOOT, watchdogReset ? 1 : 0, 0);
+  held = watchdogReset;
+
+#if defined(__AVR__)
+  armWatchdog();
+#endif
+}
+
+/**
+ * @brief Add an event, timed now
+ * @param type FlightEventType
+ * @param arg, value As the type says
+ */
+void FlightRecorder::record(uint8_t type, uint8_t arg, uint16_t value) {
+  if (held) return;
+  append(millis(), type, arg, value);
+}
+
+/**
+ * @brief Add a FLIGHT_COMMAND event holding up to three characters of text
+ */
+void FlightRecorder::recordCommand(const char* text) {
+  uint8_t chars[3] = { 0, 0, 0 };
+  for (uint8_t i = 0; i < 3 && text[i] != '\0'; i++) {
+    chars[i] = text[i];
+  }
+  record(FLIGHT_COMMAND, chars[0], chars[1] | (chars[2] << 8));
+}
+
+/**
+ * @brief Feed the watchdog and log the pass if it was slow or stalled
+ * @param passUs How long the loop pass took
+ * @param slowestTask Task that took longest in it
+ *
+ * Call once at the end of every loop() pass.
+ */
+void FlightRecorder::endPass(unsigned long passUs, uint8_t slowestTask) {
+#if defined(__AVR__)
+  wdt_reset();
+  if (flightLog.stalled) {
+    // Fired, but the loop came back in time: arm the interrupt again
+    flightLog.stalled = 0;
+    armWatchdog();
+    record(FLIGHT_STALL, slowestTask, passSteps(passUs));
+    return;
+  }
+#endif
+  if (passUs >= FLIGHT_SLOW_PASS_US) {
+    record(FLIGHT_SLOW_PASS, slowestTask, passSteps(passUs));
+  }
+}
+
+/**
+ * @brief Get how many events the ring holds
+ */
+uint8_t FlightRecorder::getCount() {
+  return flightLog.count;
+}
+
+/**
+ * @brief Get an event, oldest first
+ * @param index 0 to getCount() - 1
+ */
+const FlightEvent& FlightRecorder::getEvent(uint8_t index) {
+  uint8_t first = (flightLog.head + FLIGHT_EVENTS - flightLog.count) % FLIGHT_EVENTS;
+  return flightLog.events[(first + index) % FLIGHT_EVENTS];
+}
+
+/**
+ * @brief Start recording again once the events before a reset have been read
+ */
+void FlightRecorder::release() {
+  held = false;
+}
+
+/**
+ * @brief Empty the ring
+ */
+void FlightRecorder::clear() {
+  flightLog.magic = FLIGHT_MAGIC;
+  flightLog.head = 0;
+  flightLog.count = 0;
+  flightLog.stalled = 0;
+  flightLog.stallTime = 0;
+}
@@ -0,0 +1,74 @@
+#ifndef FLIGHT_RECORDER_H
+#define FLIGHT_RECORDER_H
+#include <Arduino.h>
+
+const uint8_t FLIGHT_EVENTS = 32;                   // Ring size, 8 bytes each
+const unsigned long FLIGHT_SLOW_PASS_US = 5000;     // Loop passes at least this long are logged
+
+/**
+ * @enum FlightEventType
+ * @brief What a FlightEvent records, and what its arg and value hold
+ */
+enum FlightEventType {
+    FLIGHT_BOOT,        // arg: 1 after a watchdog reset
+    FLIGHT_NOTE,        // arg: voice, value: note index it moved to
+    FLIGHT_COMMAND,     // arg, value: the command's first three characters
+    FLIGHT_LCD,         // A frame finished going out; value: frames dropped so far
+    FLIGHT_SLOW_PASS,   // arg: slowest task, value: pass time (100us)
+    FLIGHT_STALL        // The watchdog fired and the loop came back; value as above
+};
+
+/**
+ * @struct FlightEvent
+ * @brief One entry of the ring
+ */
+struct FlightEvent {
+    unsigned long time;     // millis()
+    uint8_t type;           // FlightEventType
+    uint8_t arg;
+    uint16_t value;
+};
+
+/**
+ * @class FlightRecorder
+ * @brief The last FLIGHT_EVENTS things the sketch did, kept across a reset
+ *
+ * record() writes one 8-byte entry over the oldest, so leaving it on
+ * costs a few microseconds per event and no allocation. The ring lives
+ * in the AVR .noinit section, which the C runtime does not clear, so it
+ * is still there after a watchdog or reset-button reset; a magic number
+ * tells a warm start from a power-up, when the ring starts empty.
+ *
+ * begin() starts the watchdog, and endPass() feeds it once per loop
+ * pass. A pass still running after about four seconds fires the
+ * watchdog interrupt, which marks the ring as stalled; if the pass then
+ * ends, the stall goes in the ring as an event. If it doesn't, the next
+ * timeout resets the board, and after the restart the ring is held, with
+ * nothing more recorded, until it has been read with the "trace"
+ * command, so the events leading up to the reset are not pushed out.
+ *
+ * On other boards there is no watchdog and the ring is cleared at every
+ * start, but recording and reading work the same.
+ */
+class FlightRecorder {
+public:
+    FlightRecorder();
+
+    void begin();                                   // Check the ring and start the watchdog
+    void record(uint8_t type, uint8_t arg, uint16_t value);
+    void recordCommand(const char* text);
+    void endPass(unsigned long passUs, uint8_t slowestTask);    // Feed the watchdog
+
+    uint8_t getCount();
+    const FlightEvent& getEvent(uint8_t index);     // 0 = oldest
+    bool wasWatchdogReset() { return watchdogReset; }
+    bool isHeld() { return held; }
+    void release();                                 // Record again after a watchdog reset
+    void clear();
+
+private:
+    bool watchdogReset;         // The last run ended in a watchdog reset
+    bool held;                  // Not recording until the ring has been read
+};
+
+#endif
@@ -0,0 +1,163 @@
+#include "Harmonizer.h"
+#include "PolyBuzzer.h"
+
+// Semitones above the key note of each scale degree
+static const uint8_t MAJOR_SCALE[7] PROGMEM = { 0, 2, 4, 5, 7, 9, 11 };
+static const uint8_t MINOR_SCALE[7] PROGMEM = { 0, 2, 3, 5, 7, 8, 10 };
+
+// Chord for each melody degree: I where it fits, else V, else IV
+static const uint8_t CHORD_ROOTS[7] PROGMEM = { 0, 4, 0, 3, 0, 3, 4 };
+
+// Drone and bass notes sit in the octave from C3 (MIDI 48)
+static const uint8_t LOW_OCTAVE = 48;
+
+/**
+ * @brief Constructor: generated parts off, C major
+ */
+Harmonizer::Harmonizer() {
+  style.rule = HARMONY_WRITTEN;
+  style.keyNote = 0;
+  style.minor = false;
+  style.beatMs = 0;
+  rewind();
+}
+
+/**
+ * @brief Set the rule and key; the part starts again from the first note
+ */
+void Harmonizer::setStyle(const HarmonyStyle& harmonyStyle) {
+  style = harmonyStyle;
+  style.keyNote %= 12;
+  rewind();
+}
+
+/**
+ * @brief Forget the walk, so the next note asked for must be the first
+ */
+void Harmonizer::rewind() {
+  nextIndex = 0;
+  position = 0;
+  bassNote = 0;
+  lastIndex = -1;
+  lastFrequency = 0;
+}
+
+/**
+ * @brief Work out the harmony note for a melody note
+ * @param index Melody note number; the next one in order, the last one
+ *              again, or 0 to start over (see follows())
+ * @param melody Written melody note
+ * @param out Written harmony note, as long as the melody note
+ */
+void Harmonizer::harmonize(int index, const Note& melody, Note& out) {
+  out.duration = melody.duration;
+  if (index == lastIndex) {
+    out.frequency = lastFrequency;
+    return;
+  }
+  if (index == 0) rewind();
+
+  bool onBeat = style.beatMs == 0 || position % style.beatMs == 0;
+  out.frequency = midiFrequency(generate(midiNote(melody.frequency), onBeat));
+
+  position += melody.duration;
+  nextIndex = index + 1;
+  lastIndex = index;
+  lastFrequency = out.frequency;
+}
+
+/**
+ * @brief Pitch range of the generated part
+ *
+ * Thirds and sixths follow the melody down the scale, so its lowest and
+ * highest notes give theirs. The drone and bass only use a few notes.
+ */
+void Harmonizer::getRange(int melodyLowest, int melodyHighest, int& lowest, int& highest) {
+  lowest = 0;
+  highest = 0;
+
+  switch (style.rule) {
+    case HARMONY_THIRD:
+    case HARMONY_SIXTH:
+      lowest = midiFrequency(generate(midiNote(melodyLowest), true));
+      highest = midiFrequency(generate(midiNote(melodyHighest), true));
+      break;
+
+    case HARMONY_DRONE:
+      lowest = highest = midiFrequency(LOW_OCTAVE + style.keyNote);
+      break;
+
+    case HARMONY_BASS:
+      // Roots of I, IV and V
+      for (uint8_t degree = 0; degree < 7; degree++) {
+        if (degree != 0 && degree != 3 && degree != 4) continue;
+        const uint8_t* scale = style.minor ? MINOR_SCALE : MAJOR_SCALE;
+        int frequency = midiFrequency(LOW_OCTAVE + (style.keyNote + pgm_read_byte(&scale[degree])) % 12);
+        if (lowest == 0 || frequency < lowest) lowest = frequency;
+        if (frequency > highest) highest = frequency;
+      }
+      break;
+  }
+}
+
+/**
+ * @brief Harmony MIDI note for a melody MIDI note (0 = rest)
+ * @param onBeat Whether the melody note starts on a beat (HARMONY_BASS)
+ */
+uint8_t Harmonizer::generate(uint8_t melodyNote, bool onBeat) {
+  switch (style.rule) {
+    case HARMONY_THIRD:
+      return melodyNote != 0 ? stepDown(melodyNote, 2) : 0;
+    case HARMONY_SIXTH:
+      return melodyNote != 0 ? stepDown(melodyNote, 5) : 0;
+    case HARMONY_DRONE:
+      return LOW_OCTAVE + style.keyNote;
+    case HARMONY_BASS:
+      // Off the beat the bass holds whatever the last beat gave it
+      if (onBeat) bassNote = melodyNote != 0 ? chordRoot(melodyNote) : 0;
+      return bassNote;
+    default:
+      return 0;
+  }
+}
+
+/**
+ * @brief Move a note down the scale
+ * @param steps Scale steps: 2 for a third, 5 for a sixth
+ */
+uint8_t Harmonizer::stepDown(uint8_t melodyNote, uint8_t steps) {
+  const uint8_t* scale = style.minor ? MINOR_SCALE : MAJOR_SCALE;
+  uint8_t degree = scaleDegree(melodyNote);
+
+  // Key note at or below the melody note
+  int base = melodyNote - (melodyNote + 12 - style.keyNote) % 12;
+  int target = degree - steps;
+  if (target < 0) {
+    target += 7;
+    base -= 12;
+  }
+
+  int note = base + pgm_read_byte(&scale[target]);
+  return note > 0 ? note : 0;
+}
+
+/**
+ * @brief Scale degree (0-6) of a note, or of the scale note below it
+ */
+uint8_t Harmonizer::scaleDegree(uint8_t note) {
+  const uint8_t* scale = style.minor ? MINOR_SCALE : MAJOR_SCALE;
+  uint8_t semitones = (note + 12 - style.keyNote) % 12;
+
+  uint8_t degree = 6;
+  while (degree > 0 && pgm_read_byte(&scale[degree]) > semitones) degree--;
+  return degree;
+}
+
+/**
+ * @brief Bass MIDI note: root of the chord that harmonizes a melody note
+ */
+uint8_t Harmonizer::chordRoot(uint8_t melodyNote) {
+  const uint8_t* scale = style.minor ? MINOR_SCALE : MAJOR_SCALE;
+  uint8_t root = pgm_read_byte(&CHORD_ROOTS[scaleDegree(melodyNote)]);
+  return LOW_OCTAVE + (style.keyNote + pgm_read_byte(&scale[root])) % 12;
+}
@@ -0,0 +1,81 @@
+#ifndef HARMONIZER_H
+#define HARMONIZER_H
+#include <Arduino.h>
+
+struct Note;
+
+/**
+ * @enum HarmonyRule
+ * @brief How a second part is made from the melody (see Harmonizer)
+ */
+enum HarmonyRule {
+    HARMONY_WRITTEN,    // The song's own harmony table (silent if it has none)
+    HARMONY_THIRD,      // A diatonic third below each melody note
+    HARMONY_SIXTH,      // A diatonic sixth below each melody note
+    HARMONY_DRONE,      // The key note, held under the whole song
+    HARMONY_BASS        // Root of the I, IV or V chord, changing on the beat
+};
+
+const uint8_t HARMONY_RULE_COUNT = 5;
+
+/**
+ * @struct HarmonyStyle
+ * @brief Per-song settings for a generated harmony
+ *
+ * Plain data so songs.h can keep one in PROGMEM next to each song.
+ */
+struct HarmonyStyle {
+    uint8_t rule;           // HarmonyRule used when the song has no harmony table
+    uint8_t keyNote;        // Key note as a pitch class: 0 = C, 1 = C#, ... 11 = B
+    bool minor;             // Natural minor rather than major
+    uint16_t beatMs;        // Beat length for HARMONY_BASS (0 = every note is a beat)
+};
+
+/**
+ * @class Harmonizer
+ * @brief Works out a harmony note for each melody note as it is played
+ *
+ * Each harmony note lasts exactly as long as its melody note, so the
+ * generated part has the same note count and ends with the melody.
+ * Pitches are worked on as MIDI note numbers in the song's key:
+ * thirds and sixths move down the scale from the melody note (a note
+ * outside the scale counts as the scale note below it), while the drone
+ * and bass sit in the octave from C3. Rests stay rests, except under
+ * the drone, which holds through them.
+ *
+ * HARMONY_BASS needs to know where each note falls in the bar, so notes
+ * must be asked for in order from the first. Asking for an earlier note
+ * (a seek) means starting again with rewind().
+ */
+class Harmonizer {
+private:
+    HarmonyStyle style;
+
+    // Walk through the melody
+    int nextIndex;              // Melody note expected next
+    unsigned long position;     // Written start of that note (ms)
+    uint8_t bassNote;           // Bass MIDI note from the last beat (0 = rest)
+    int lastIndex;              // Last note generated, repeated without a walk
+    int lastFrequency;
+
+public:
+    Harmonizer();
+
+    void setStyle(const HarmonyStyle& harmonyStyle);
+    const HarmonyStyle& getStyle() { return style; }
+    void rewind();                                  // Back to the first note
+
+    bool follows(int index) { return index == 0 || index == nextIndex || index == lastIndex; }
+    void harmonize(int index, const Note& melody, Note& out);
+
+    // Pitch range (Hz) of the part for a melody spanning melodyLowest-melodyHighest
+    void getRange(int melodyLowest, int melodyHighest, int& lowest, int& highest);
+
+private:
+    uint8_t generate(uint8_t melodyNote, bool onBeat);
+    uint8_t stepDown(uint8_t melodyNote, uint8_t steps);
+    uint8_t scaleDegree(uint8_t note);
+    uint8_t chordRoot(uint8_t melodyNote);
+};
+
+#endif
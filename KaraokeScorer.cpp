@@ -0,0 +1,309 @@
+#include "KaraokeScorer.h"
+#include "PitchTimer.h"
+#include "PolyBuzzer.h"
+
+#if defined(__AVR_ATmega328P__) && F_CPU == 16000000L
+#define MIC_ADC
+#endif
+
+// Samples a second: each is two ADC readings added together
+constexpr double SCORE_SAMPLE_HZ = MIC_READING_HZ / 2.0;
+
+// cos(x) for 0 <= x <= pi from its Taylor series, as C++11 constexpr
+// can't call <cmath>; seventeen terms are exact to well past Q12
+constexpr double cosSeries(double x2, double term, int k) {
+  return k > 16 ? term : term + cosSeries(x2, -term * x2 / ((2.0 * k - 1) * (2.0 * k)), k + 1);
+}
+
+constexpr double cosine(double x) {
+  return cosSeries(x * x, 1.0, 1);
+}
+
+constexpr double goertzelCos(int note) {
+  return cosine(2 * 3.14159265358979 * noteHz(note) / SCORE_SAMPLE_HZ);
+}
+
+// Q12 Goertzel coefficient 2cos(2 pi f / fs) for a note (0 = never scored)
+constexpr int16_t goertzelCoeff(int note) {
+  return note < SCORE_LOWEST_PITCH - 1 || note > SCORE_HIGHEST_PITCH + 1 ? 0
+       : (int16_t)(8192 * goertzelCos(note) + (goertzelCos(note) < 0 ? -0.5 : 0.5));
+}
+
+#define GOERTZEL_ROW(n) goertzelCoeff(n), goertzelCoeff(n + 1), goertzelCoeff(n + 2), goertzelCoeff(n + 3), \
+                        goertzelCoeff(n + 4), goertzelCoeff(n + 5), goertzelCoeff(n + 6), goertzelCoeff(n + 7)
+
+/**
+ * Coefficients for MIDI notes 0-127, each filter on a scored note and
+ * a semitone either side, worked out by the compiler from the exact
+ * pitch.
+ */
+constexpr int16_t GOERTZEL_COEFFS[MIDI_NOTE_COUNT] PROGMEM = {
+  GOERTZEL_ROW(0),   GOERTZEL_ROW(8),   GOERTZEL_ROW(16),  GOERTZEL_ROW(24),
+  GOERTZEL_ROW(32),  GOERTZEL_ROW(40),  GOERTZEL_ROW(48),  GOERTZEL_ROW(56),
+  GOERTZEL_ROW(64),  GOERTZEL_ROW(72),  GOERTZEL_ROW(80),  GOERTZEL_ROW(88),
+  GOERTZEL_ROW(96),  GOERTZEL_ROW(104), GOERTZEL_ROW(112), GOERTZEL_ROW(120)
+};
+static_assert(noteHz(SCORE_HIGHEST_PITCH + 1) < SCORE_SAMPLE_HZ / 2, "Highest scored note is over half the sample rate");
+
+// Filled two readings at a time by the ADC interrupt (or feed()),
+// emptied by update()
+static volatile uint16_t ring[MIC_RING_SIZE];
+static volatile uint8_t ringHead;
+static volatile uint8_t ringTail;
+static volatile bool ringOverflow;      // A sample was dropped
+static uint16_t firstReading;           // Waiting for the other half of its pair
+static bool haveFirst;
+
+static void takeReading(uint16_t reading) {
+  if (!haveFirst) {
+    firstReading = reading;
+    haveFirst = true;
+    return;
+  }
+  haveFirst = false;
+
+  uint8_t next = (ringHead + 1) & (MIC_RING_SIZE - 1);
+  if (next == ringTail) {
+    ringOverflow = true;
+    return;
+  }
+  ring[ringHead] = firstReading + reading;
+  ringHead = next;
+}
+
+#ifdef MIC_ADC
+ISR(ADC_vect) {
+  takeReading(ADC);
+}
+#endif
+
+/**
+ * @brief Power at a filter's pitch, from its last two states
+ * @return |X|^2 / 256
+ *
+ * The states are brought down to 14 bits first so every product fits
+ * in 32.
+ */
+static unsigned long goertzelPower(long s1, long s2, int16_t coeff) {
+  s1 >>= 4;
+  s2 >>= 4;
+  long power = s1 * s1 + s2 * s2 - ((s1 * coeff) >> 12) * s2;
+  return power > 0 ? power : 0;
+}
+
+static int percentOf(unsigned int hits, unsigned int blocks) {
+  return blocks == 0 ? -1 : (int)(((unsigned long)hits * 100 + blocks / 2) / blocks);
+}
+
+/**
+ * @brief Constructor: no microphone until begin()
+ */
+KaraokeScorer::KaraokeScorer() {
+  fitted = false;
+  listening = false;
+  channel = 0;
+  blockPitch = 0;
+  blockValid = true;
+  blockCount = 0;
+  energy = 0;
+  dcSum = 0;
+  dcOffset = 1024;      // Mid-scale, until the first block measures it
+  lastEnergy = 0;
+  overruns = 0;
+  startSong();
+}
+
+/**
+ * @brief Use a microphone module on an analog pin
+ * @param pin A0-A7, or the channel number
+ * @return False if the pin has no ADC input
+ *
+ * The module's output should sit at half the supply with nothing heard;
+ * whatever bias it has is measured and taken off.
+ */
+bool KaraokeScorer::begin(uint8_t pin) {
+#ifdef MIC_ADC
+  channel = pin >= A0 ? pin - A0 : pin;
+  if (channel > 7) return false;
+  if (channel < 6) DIDR0 |= _BV(channel);   // Digital input off: less noise on the reading
+#else
+  channel = pin;
+#endif
+  fitted = true;
+  return true;
+}
+
+/**
+ * @brief Start or stop sampling
+ *
+ * Samples waiting and the block in progress are dropped either way, so
+ * the first block after starting again is all new sound.
+ */
+void KaraokeScorer::listen(bool on) {
+  if (!fitted || on == listening) return;
+  listening = on;
+
+#ifdef MIC_ADC
+  if (!on) {
+    ADCSRA &= ~(_BV(ADATE) | _BV(ADIE));   // Ends after the reading in progress
+  }
+#endif
+
+  ringTail = ringHead;
+  ringOverflow = false;
+  haveFirst = false;
+  blockCount = 0;
+  blockValid = true;
+
+#ifdef MIC_ADC
+  if (on) {
+    ADMUX = _BV(REFS0) | channel;           // AVcc reference
+    ADCSRB = 0;                             // Free running
+    ADCSRA = _BV(ADEN) | _BV(ADSC) | _BV(ADATE) | _BV(ADIE) | _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0);
+  }
+#endif
+}
+
+/**
+ * @brief Take one ADC reading (0-1023) as if the interrupt had
+ */
+void KaraokeScorer::feed(uint16_t reading) {
+  takeReading(reading);
+}
+
+/**
+ * @brief Filter the samples waiting, and score any block they complete
+ * @param pitch MIDI note the melody is sounding (0 for a rest)
+ *
+ * Call every loop pass while listening. A block is judged against the
+ * note sounding as it starts, and not scored if another is sounding
+ * when it ends.
+ */
+void KaraokeScorer::update(uint8_t pitch) {
+  if (!listening) return;
+
+  if (ringOverflow) {
+    ringOverflow = false;
+    overruns++;
+    blockValid = false;
+  }
+
+  for (uint8_t n = 0; n < SCORE_DRAIN_MAX && ringTail != ringHead; n++) {
+    uint16_t sample = ring[ringTail];
+    ringTail = (ringTail + 1) & (MIC_RING_SIZE - 1);
+    if (blockCount == 0) startBlock(pitch);
+
+    dcSum += sample;
+    int16_t x = ((int)sample - dcOffset) >> 3;
+    energy += (long)x * x;
+
+    // s[n] = x + 2cos(w) s[n-1] - s[n-2]
+    if (blockPitch != 0) {
+      for (uint8_t f = 0; f < 3; f++) {
+        long s0 = x + ((coeffs[f] * states[f][0]) >> 12) - states[f][1];
+        states[f][1] = states[f][0];
+        states[f][0] = s0;
+      }
+    }
+
+    if (++blockCount == SCORE_BLOCK) endBlock(pitch);
+  }
+}
+
+/**
+ * @brief Set the filters up for the note sounding
+ */
+void KaraokeScorer::startBlock(uint8_t pitch) {
+  blockPitch = (pitch >= SCORE_LOWEST_PITCH && pitch <= SCORE_HIGHEST_PITCH) ? pitch : 0;
+  for (uint8_t f = 0; f < 3; f++) {
+    coeffs[f] = blockPitch != 0 ? (int16_t)pgm_read_word(&GOERTZEL_COEFFS[blockPitch - 1 + f]) : 0;
+    states[f][0] = 0;
+    states[f][1] = 0;
+  }
+  energy = 0;
+  dcSum = 0;
+}
+
+/**
+ * @brief Score a finished block, unless it lost samples or the note changed
+ */
+void KaraokeScorer::endBlock(uint8_t pitch) {
+  blockCount = 0;
+  dcOffset = dcSum / SCORE_BLOCK;
+  lastEnergy = energy;
+
+  bool scored = blockValid && blockPitch != 0 && pitch == blockPitch;
+  blockValid = true;
+  if (!scored) return;
+
+  lineBlocks++;
+  songBlocks++;
+  if (inTune()) {
+    lineHits++;
+    songHits++;
+  }
+}
+
+/**
+ * @brief Check the block just filtered against its note
+ *
+ * Samples are a quarter of an ADC reading, so the quiet level is
+ * compared at that scale. A pure tone puts energy * SCORE_BLOCK / 2 into
+ * its filter; a voice, with its overtones, is asked for an eighth of
+ * that at the note.
+ */
+bool KaraokeScorer::inTune() {
+  if (energy * 16 < (unsigned long)SCORE_QUIET_LEVEL * SCORE_QUIET_LEVEL * SCORE_BLOCK) return false;
+
+  unsigned long below = goertzelPower(states[0][0], states[0][1], coeffs[0]);
+  unsigned long on = goertzelPower(states[1][0], states[1][1], coeffs[1]);
+  unsigned long above = goertzelPower(states[2][0], states[2][1], coeffs[2]);
+  return on >= below && on >= above && on >= (energy * SCORE_BLOCK) >> 12;
+}
+
+/**
+ * @brief Clear the score for a new song
+ */
+void KaraokeScorer::startSong() {
+  lineBlocks = 0;
+  lineHits = 0;
+  songBlocks = 0;
+  songHits = 0;
+  lines = 0;
+  lastLinePercent = -1;
+}
+
+/**
+ * @brief Close the line being sung
+ * @return Percent of its blocks in tune, or -1 if none were scored (a
+ *         line of rests, or the microphone was off)
+ */
+int KaraokeScorer::endLine() {
+  int percent = percentOf(lineHits, lineBlocks);
+  if (percent >= 0) {
+    lines++;
+    lastLinePercent = percent;
+  }
+  lineBlocks = 0;
+  lineHits = 0;
+  return percent;
+}
+
+/**
+ * @brief Get the percent of the song's scored blocks that were in tune
+ */
+int KaraokeScorer::getSongPercent() {
+  return percentOf(songHits, songBlocks);
+}
+
+/**
+ * @brief How loud the microphone was over the last block
+ * @return RMS in ADC counts; a few counts is the module's own noise
+ *
+ * For setting the module's gain: singing should be well above
+ * SCORE_QUIET_LEVEL without reaching 200 or so, where peaks clip.
+ */
+uint8_t KaraokeScorer::getLevel() {
+  float rms = 4 * sqrt(lastEnergy / (float)SCORE_BLOCK);
+  return rms > 255 ? 255 : (uint8_t)rms;
+}
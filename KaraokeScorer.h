@@ -0,0 +1,97 @@
+#ifndef KARAOKE_SCORER_H
+#define KARAOKE_SCORER_H
+#include <Arduino.h>
+
+const unsigned int MIC_READING_HZ = 9615;       // Free-running ADC at 16MHz: clk/128, 13 clocks a reading
+const uint8_t MIC_RING_SIZE = 64;               // Samples waiting for update(), about 13ms (power of two)
+const uint8_t SCORE_DRAIN_MAX = 24;             // Most samples one update() works through
+const unsigned int SCORE_BLOCK = 320;           // Samples a pitch is judged over, about 67ms
+const uint8_t SCORE_LOWEST_PITCH = 48;          // C3; lower notes are not scored
+const uint8_t SCORE_HIGHEST_PITCH = 96;         // C7, well under half the sample rate
+const uint8_t SCORE_QUIET_LEVEL = 8;            // RMS ADC counts below which nobody is singing
+
+/**
+ * @class KaraokeScorer
+ * @brief Scores a singer on a microphone against the melody as it plays
+ *
+ * The ADC runs free on the microphone's pin and its interrupt adds each
+ * pair of readings to a small ring, about 4.8k samples a second, so
+ * nothing is lost while the loop is busy. update() works through the
+ * ring in blocks of SCORE_BLOCK samples, each one checked against the
+ * melody note sounding when it started: three Goertzel filters, on the
+ * note and a semitone either side, measure how much of the block is at
+ * each pitch. A block is in tune when the note beats both neighbours and
+ * holds a fair share of the sound. Rests, notes out of range and blocks
+ * that run across a change of note are not scored; silence while a note
+ * plays counts against the singer.
+ *
+ * Everything is integer: samples go in at 8 bits, the filters keep
+ * 32-bit state with Q12 coefficients the compiler works out for every
+ * MIDI note, and each sample costs three multiplies. With the interrupt
+ * that comes to roughly a tenth of an Uno's time while a song plays, and
+ * update() never takes on more than SCORE_DRAIN_MAX samples at a time.
+ *
+ * Scores are kept for the song and for the line being sung; endLine()
+ * closes a line and gives its percentage. listen() only runs the ADC
+ * while it is wanted, as its interrupt would otherwise keep the board
+ * from sleeping.
+ *
+ * On an ATmega328P at 16MHz begin() takes over the ADC, so analogRead()
+ * can't be used alongside. On other boards nothing samples the pin:
+ * readings come from feed(), which is how the host tools play a WAV file
+ * in as the microphone.
+ */
+class KaraokeScorer {
+private:
+    bool fitted;                    // begin() found a microphone pin
+    bool listening;
+    uint8_t channel;                // ADC input
+
+    // Block being filtered
+    uint8_t blockPitch;             // MIDI note it is judged against (0 = not scored)
+    bool blockValid;                // No samples lost
+    unsigned int blockCount;
+    int16_t coeffs[3];              // Q12 2cos(w): a semitone below, on, above
+    long states[3][2];              // Goertzel s[n-1], s[n-2]
+    unsigned long energy;           // Sum of squared samples
+    unsigned long dcSum;            // Raw samples, for the next block's offset
+    int dcOffset;                   // Mic bias, as a raw sample (two readings)
+    unsigned long lastEnergy;       // Last block, for getLevel()
+
+    // Score
+    unsigned int lineBlocks;
+    unsigned int lineHits;
+    unsigned int songBlocks;
+    unsigned int songHits;
+    unsigned int lines;             // Lines ended this song
+    int lastLinePercent;
+    unsigned long overruns;         // Blocks lost to a full ring
+
+public:
+    KaraokeScorer();
+
+    bool begin(uint8_t pin);        // Analog pin; false if the board can't sample it
+    bool isFitted() { return fitted; }
+    void listen(bool on);           // Run the ADC, or stop it and drop what is waiting
+    bool isListening() { return listening; }
+    void feed(uint16_t reading);    // One 10-bit reading, as the interrupt takes it
+    void update(uint8_t pitch);     // Melody note sounding now (MIDI, 0 = rest)
+
+    // Score
+    void startSong();
+    int endLine();                  // Percent for the line, -1 if nothing was scored
+    unsigned int getLines() { return lines; }
+    int getLastLinePercent() { return lastLinePercent; }
+    int getSongPercent();           // -1 if nothing was scored
+    unsigned int getSongBlocks() { return songBlocks; }
+    unsigned int getSongHits() { return songHits; }
+    uint8_t getLevel();             // RMS ADC counts in the last block
+    unsigned long getOverruns() { return overruns; }
+
+private:
+    void startBlock(uint8_t pitch);
+    void endBlock(uint8_t pitch);
+    bool inTune();
+};
+
+#endif
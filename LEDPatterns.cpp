@@ -0,0 +1,312 @@
+#include "LEDPatterns.h"
+
+// How long the Sequential Notes flash lasts after a change of pitch
+static const unsigned long SPARKLE_MS = 100;
+
+// How long Note Strobe holds each flash before it fades
+static const unsigned long STROBE_MS = 40;
+
+/**
+ * @brief Light one LED and turn the rest off
+ */
+static void lightOnly(LEDFrame& frame, uint8_t channel, uint8_t level) {
+  memset(frame.levels, 0, sizeof(frame.levels));
+  frame.levels[channel] = level;
+}
+
+/**
+ * @brief Melody if it is sounding, otherwise harmony (0 = both resting)
+ */
+static int primaryFrequency(const LEDFrame& frame) {
+  return (frame.melodyFreq > 0) ? frame.melodyFreq : frame.harmonyFreq;
+}
+
+/**
+ * @brief Rainbow Chase: cycles through the colours with a gentle pulse
+ */
+static void rainbowFrame(LEDPatternState& /*state*/, LEDFrame& frame) {
+  static const uint8_t ORDER[5] = { LED_RED, LED_YELLOW, LED_GREEN, LED_BLUE, LED_WHITE };
+
+  int step = (frame.step / 20) % 5;
+  int brightness = 200 + (sin(frame.step * 0.2) * 55);
+  frame.levels[ORDER[step]] = brightness;
+}
+
+static void sequentialInit(LEDPatternState& state) {
+  state.sequential.lastMelodyFreq = 0;
+  state.sequential.lastHarmonyFreq = 0;
+  state.sequential.changeTime = 0;
+  state.sequential.sparkling = false;
+  state.sequential.lastLED = -1;
+}
+
+/**
+ * @brief Sequential Notes: a random LED while notes sound, with a brief
+ *        flash of every LED when the pitch changes
+ *
+ * The LED changes on each change of pitch, never to the same one twice.
+ */
+static void sequentialFrame(LEDPatternState& state, LEDFrame& frame) {
+  if (frame.melodyFreq != state.sequential.lastMelodyFreq || frame.harmonyFreq != state.sequential.lastHarmonyFreq) {
+    state.sequential.lastMelodyFreq = frame.melodyFreq;
+    state.sequential.lastHarmonyFreq = frame.harmonyFreq;
+    state.sequential.changeTime = frame.now;
+    state.sequential.sparkling = true;
+  }
+
+  if (primaryFrequency(frame) > 0) {
+    int led;
+    do {
+      led = random(0, LED_CHANNELS);
+    } while (led == state.sequential.lastLED && state.sequential.sparkling);
+    state.sequential.lastLED = led;
+    frame.levels[led] = 255;
+
+    if (state.sequential.sparkling && frame.now - state.sequential.changeTime < SPARKLE_MS) {
+      memset(frame.levels, 100, sizeof(frame.levels));
+    }
+  }
+
+  if (frame.now - state.sequential.changeTime > SPARKLE_MS) {
+    state.sequential.sparkling = false;
+  }
+}
+
+/**
+ * @brief The LED for a frequency band (-1 below the lowest band)
+ */
+static int8_t frequencyBand(int frequency) {
+  if (frequency >= 130 && frequency <= 200) return LED_RED;        // Low bass notes
+  if (frequency >= 201 && frequency <= 300) return LED_YELLOW;     // Mid-low notes
+  if (frequency >= 301 && frequency <= 500) return LED_GREEN;      // Mid notes
+  if (frequency >= 501 && frequency <= 800) return LED_BLUE;       // Mid-high notes
+  if (frequency > 800) return LED_WHITE;                           // High notes
+  return -1;
+}
+
+/**
+ * @brief Note Mapping: each frequency band has its own LED
+ *
+ * The harmony's LED wins when both voices sound, at half brightness.
+ */
+static void mappingFrame(LEDPatternState& /*state*/, LEDFrame& frame) {
+  int8_t band = frequencyBand(frame.melodyFreq);
+  if (frame.melodyFreq > 0 && band >= 0) {
+    lightOnly(frame, band, 255);
+  }
+
+  band = frequencyBand(frame.harmonyFreq);
+  if (frame.harmonyFreq > 0 && band >= 0) {
+    lightOnly(frame, band, frame.melodyFreq == 0 ? 255 : 127);
+  }
+}
+
+static void randomInit(LEDPatternState& state) {
+  state.random.lastLED = -1;
+}
+
+/**
+ * @brief Random Notes: pick an LED for each new note, never the last one
+ */
+static void randomNote(LEDPatternState& state, LEDFrame& frame) {
+  if (primaryFrequency(frame) <= 0) return;
+
+  int led;
+  do {
+    led = random(0, LED_CHANNELS);
+  } while (led == state.random.lastLED);
+  state.random.lastLED = led;
+}
+
+/**
+ * @brief Random Notes: the chosen LED, brighter for higher notes
+ *
+ * Brightness is spread over the song's range in the key it is playing in.
+ */
+static void randomFrame(LEDPatternState& state, LEDFrame& frame) {
+  int frequency = primaryFrequency(frame);
+  if (frequency <= 0 || state.random.lastLED < 0) return;
+
+  int brightness = 255;
+  if (frame.highest > frame.lowest) {
+    brightness = map(constrain(frequency, frame.lowest, frame.highest), frame.lowest, frame.highest, 180, 255);
+  }
+  frame.levels[state.random.lastLED] = brightness;
+}
+
+static void strobeInit(LEDPatternState& state) {
+  state.strobe.lit = false;
+}
+
+/**
+ * @brief Note Strobe: every LED flashes on each note
+ *
+ * The flash is held for STROBE_MS; the envelope's release fades it out.
+ */
+static void strobeNote(LEDPatternState& state, LEDFrame& frame) {
+  if (primaryFrequency(frame) > 0) {
+    state.strobe.noteTime = frame.now;
+    state.strobe.lit = true;
+  }
+}
+
+static void strobeFrame(LEDPatternState& state, LEDFrame& frame) {
+  if (state.strobe.lit && frame.now - state.strobe.noteTime < STROBE_MS) {
+    memset(frame.levels, 255, sizeof(frame.levels));
+  } else {
+    state.strobe.lit = false;
+  }
+}
+
+// The registry: a new pattern only needs its hooks and a line here
+const LEDPatternDef LED_PATTERNS[] PROGMEM = {
+  // name                init             onNote       onFrame
+  { "Rainbow Chase",     NULL,            NULL,        rainbowFrame },
+  { "Sequential Notes",  sequentialInit,  NULL,        sequentialFrame },
+  { "Note Mapping",      NULL,            NULL,        mappingFrame },
+  { "Random Notes",      randomInit,      randomNote,  randomFrame },
+  { "Note Strobe",       strobeInit,      strobeNote,  strobeFrame }
+};
+
+const uint8_t LED_PATTERN_COUNT = sizeof(LED_PATTERNS) / sizeof(LED_PATTERNS[0]);
+
+/**
+ * @brief Constructor: every LED dark, default envelope times
+ */
+LEDEnvelope::LEDEnvelope() {
+  memset(channels, 0, sizeof(channels));
+  setTimes(20, 200, 70, 150);
+}
+
+/**
+ * @brief Set the envelope shape, shared by every LED
+ * @param attack Time to rise to the pattern's level (ms)
+ * @param decay Time to fall from there to the sustain level (ms)
+ * @param sustainPercent Share of the level held while the LED stays lit
+ * @param release Time to fade out once the pattern turns the LED off (ms)
+ *
+ * Takes effect from the next segment each LED starts.
+ */
+void LEDEnvelope::setTimes(uint16_t attack, uint16_t decay, uint8_t sustainPercent, uint16_t release) {
+  attackMs = attack;
+  decayMs = decay;
+  sustain = (uint16_t)min(sustainPercent, (uint8_t)100) * 256 / 100;
+  releaseMs = release;
+}
+
+/**
+ * @brief Give an LED the level the pattern wants this frame
+ * @param channel LEDChannel
+ * @param level Brightness asked for (0 = off)
+ * @param onset A note started this frame, so lit LEDs attack again
+ *
+ * Only starts a new segment when something changed, so calling it every
+ * pattern frame with the same level costs next to nothing.
+ */
+void LEDEnvelope::setTarget(uint8_t channel, uint8_t level, bool onset) {
+  Channel& c = channels[channel];
+
+  if (level == 0) {
+    if (c.level > 0 && c.stage != STAGE_RELEASE) {
+      startSegment(c, STAGE_RELEASE, 0, releaseMs);
+    }
+    c.peak = 0;
+    return;
+  }
+
+  if (onset || c.stage == STAGE_IDLE || c.stage == STAGE_RELEASE) {
+    c.peak = level;
+    startSegment(c, STAGE_ATTACK, (uint16_t)level << 8, attackMs);
+  } else if (level != c.peak) {
+    c.peak = level;
+    if (c.stage == STAGE_ATTACK) {
+      startSegment(c, STAGE_ATTACK, (uint16_t)level << 8, attackMs);
+    } else {
+      startSegment(c, STAGE_DECAY, sustainLevel(level), decayMs);
+    }
+  }
+}
+
+/**
+ * @brief Put an LED straight at a level, as when it is written directly
+ *
+ * The next pattern level takes it on from there.
+ */
+void LEDEnvelope::jump(uint8_t channel, uint8_t level) {
+  Channel& c = channels[channel];
+  c.level = (uint16_t)level << 8;
+  c.goal = c.level;
+  c.peak = level;
+  c.stage = STAGE_IDLE;
+  c.output = level;
+}
+
+/**
+ * @brief Advance every LED by one frame
+ * @return Bit (1 << LEDChannel) set for each output that changed
+ */
+uint8_t LEDEnvelope::step() {
+  uint8_t changed = 0;
+
+  for (uint8_t i = 0; i < LED_CHANNELS; i++) {
+    Channel& c = channels[i];
+
+    if (c.stage != STAGE_IDLE && c.stage != STAGE_SUSTAIN) {
+      if (c.level < c.goal) {
+        c.level = (c.goal - c.level > c.step) ? c.level + c.step : c.goal;
+      } else {
+        c.level = (c.level - c.goal > c.step) ? c.level - c.step : c.goal;
+      }
+
+      if (c.level == c.goal) {
+        if (c.stage == STAGE_ATTACK) {
+          startSegment(c, STAGE_DECAY, sustainLevel(c.peak), decayMs);
+        } else if (c.stage == STAGE_DECAY) {
+          c.stage = STAGE_SUSTAIN;
+        } else {
+          c.stage = STAGE_IDLE;
+        }
+      }
+    }
+
+    uint8_t output = (c.level + 128) >> 8;
+    if (output != c.output) {
+      c.output = output;
+      changed |= 1 << i;
+    }
+  }
+  return changed;
+}
+
+/**
+ * @brief Head for a new level over a given time
+ *
+ * The one division per segment happens here, never in step().
+ */
+void LEDEnvelope::startSegment(Channel& channel, uint8_t stage, uint16_t goal, uint16_t ms) {
+  uint16_t distance = (channel.level > goal) ? channel.level - goal : goal - channel.level;
+
+  channel.stage = stage;
+  channel.goal = goal;
+  if (ms <= LED_FRAME_INTERVAL) {
+    channel.step = distance;
+  } else {
+    channel.step = (uint32_t)distance * LED_FRAME_INTERVAL / ms;
+  }
+  if (channel.step == 0) channel.step = 1;
+}
+
+/**
+ * @brief Copy a pattern's name out of flash
+ * @param pattern Index in LED_PATTERNS
+ * @param name Buffer for the name
+ * @param size Size of the buffer, terminator included
+ */
+void getLEDPatternName(uint8_t pattern, char* name, size_t size) {
+  if (size == 0) return;
+  name[0] = '\0';
+  if (pattern >= LED_PATTERN_COUNT) return;
+
+  strncpy_P(name, LED_PATTERNS[pattern].name, size - 1);
+  name[size - 1] = '\0';
+}
@@ -0,0 +1,131 @@
+#ifndef LED_PATTERNS_H
+#define LED_PATTERNS_H
+#include <Arduino.h>
+
+/**
+ * @enum LEDChannel
+ * @brief The five LEDs, in the order of LEDFrame::levels
+ */
+enum LEDChannel {
+    LED_RED,
+    LED_GREEN,
+    LED_BLUE,
+    LED_YELLOW,
+    LED_WHITE,
+    LED_CHANNELS
+};
+
+const uint8_t LED_PATTERN_NAME_SIZE = 18;      // Longest name plus terminator
+
+// LED output frames (envelope steps) and pattern frames, in ms
+const unsigned long LED_FRAME_INTERVAL = 10;
+const unsigned long LED_PATTERN_INTERVAL = 50;
+
+/**
+ * @struct LEDFrame
+ * @brief What a pattern sees each frame, and where it puts its output
+ */
+struct LEDFrame {
+    int melodyFreq;                 // Hz as sounding (0 = rest)
+    int harmonyFreq;
+    int lowest;                     // The song's pitch range as sounding (Hz)
+    int highest;
+    uint8_t step;                   // Frame count, wraps at 256
+    unsigned long now;              // millis()
+    uint8_t levels[LED_CHANNELS];   // Brightness out, all 0 on entry
+};
+
+/**
+ * @union LEDPatternState
+ * @brief Working state of whichever pattern is running
+ *
+ * Only one pattern runs at a time, so they share this space; a new
+ * pattern's state is set up by its init hook. Add a member for a new
+ * pattern that needs one.
+ */
+union LEDPatternState {
+    struct {
+        int lastMelodyFreq;
+        int lastHarmonyFreq;
+        unsigned long changeTime;   // When the notes last changed pitch
+        bool sparkling;             // Within the flash after a change
+        int8_t lastLED;
+    } sequential;
+    struct {
+        int8_t lastLED;             // LED lit for the current note (-1 = none yet)
+    } random;
+    struct {
+        unsigned long noteTime;     // When the last note started
+        bool lit;
+    } strobe;
+};
+
+/**
+ * @struct LEDPatternDef
+ * @brief One entry of the pattern registry (kept in flash)
+ *
+ * Any hook may be NULL. onNote runs when a voice moves to another note
+ * (rests included), just before that frame's onFrame.
+ */
+struct LEDPatternDef {
+    char name[LED_PATTERN_NAME_SIZE];
+    void (*init)(LEDPatternState& state);
+    void (*onNote)(LEDPatternState& state, LEDFrame& frame);
+    void (*onFrame)(LEDPatternState& state, LEDFrame& frame);
+};
+
+/**
+ * @class LEDEnvelope
+ * @brief Attack, decay and release for each LED, stepped once per LED frame
+ *
+ * Patterns say how bright each LED should be; the envelope gets it
+ * there. A note onset (or an LED lighting from dark) starts an attack up
+ * to the pattern's level, then a decay down to the sustain fraction of
+ * it. A level the pattern changes while the LED stays lit glides to its
+ * new sustain at the decay rate, and an LED the pattern turns off
+ * releases to dark.
+ *
+ * Levels are 8.8 fixed point. Each segment's step per frame is worked
+ * out once when it starts, so step() is a handful of adds and compares
+ * per LED whatever the pattern does.
+ */
+class LEDEnvelope {
+private:
+    enum Stage { STAGE_IDLE, STAGE_ATTACK, STAGE_DECAY, STAGE_SUSTAIN, STAGE_RELEASE };
+
+    struct Channel {
+        uint16_t level;             // 8.8
+        uint16_t goal;              // Where the current segment ends (8.8)
+        uint16_t step;              // Change per frame (8.8)
+        uint8_t peak;               // Level last asked for by the pattern
+        uint8_t stage;
+        uint8_t output;             // Last level handed out by step()
+    };
+
+    Channel channels[LED_CHANNELS];
+    uint16_t attackMs;
+    uint16_t decayMs;
+    uint16_t sustain;               // Fraction of the peak held, out of 256
+    uint16_t releaseMs;
+
+public:
+    LEDEnvelope();
+
+    void setTimes(uint16_t attack, uint16_t decay, uint8_t sustainPercent, uint16_t release);
+    void setTarget(uint8_t channel, uint8_t level, bool onset);
+    void jump(uint8_t channel, uint8_t level);     // Set at once, no envelope
+    uint8_t step();                                // One frame; bit per changed output
+    uint8_t getOutput(uint8_t channel) { return channels[channel].output; }
+
+private:
+    void startSegment(Channel& channel, uint8_t stage, uint16_t goal, uint16_t ms);
+    uint16_t sustainLevel(uint8_t peak) { return (uint16_t)peak * sustain; }
+};
+
+extern const LEDPatternDef LED_PATTERNS[] PROGMEM;
+extern const uint8_t LED_PATTERN_COUNT;
+const uint8_t LED_PATTERN_DEFAULT = 3;          // Random Notes
+
+void getLEDPatternName(uint8_t pattern, char* name, size_t size);
+
+#endif
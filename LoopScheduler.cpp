@@ -0,0 +1,173 @@
+#include "LoopScheduler.h"
+
+/**
+ * @brief Constructor: no tasks until begin()
+ */
+LoopScheduler::LoopScheduler() {
+  tasks = NULL;
+  taskCount = 0;
+  passes = 0;
+  worstPassUs = 0;
+  lastPassUs = 0;
+  lastSlowest = 0;
+}
+
+/**
+ * @brief Take over a task table
+ * @param table Tasks; must outlive the scheduler
+ * @param count Entries in table (at most LOOP_MAX_TASKS)
+ *
+ * Tasks of equal priority run in table order.
+ */
+void LoopScheduler::begin(LoopTask* table, uint8_t count) {
+  tasks = table;
+  taskCount = min(count, LOOP_MAX_TASKS);
+
+  // Insertion sort, so equal priorities keep their table order
+  for (uint8_t i = 0; i < taskCount; i++) {
+    uint8_t j = i;
+    while (j > 0 && tasks[order[j - 1]].priority < tasks[i].priority) {
+      order[j] = order[j - 1];
+      j--;
+    }
+    order[j] = i;
+  }
+
+  unsigned long now = millis();
+  for (uint8_t i = 0; i < taskCount; i++) {
+    nextDue[i] = now;
+  }
+  resetStats();
+}
+
+/**
+ * @brief Run every task that is due, highest priority first
+ *
+ * Call once per loop(). Each task's deadline is checked just before its
+ * turn, so one that falls due while a higher priority task runs still
+ * gets its turn in this pass.
+ */
+void LoopScheduler::run() {
+  unsigned long passStart = micros();
+  lastSlowest = 0;
+  slowestUs = 0;
+
+  for (uint8_t i = 0; i < taskCount; i++) {
+    uint8_t task = order[i];
+    unsigned long now = millis();
+    if ((long)(now - nextDue[task]) >= 0) {
+      runTask(task, now);
+    }
+  }
+
+  passes++;
+  lastPassUs = micros() - passStart;
+  if (lastPassUs > worstPassUs) {
+    worstPassUs = lastPassUs;
+  }
+}
+
+/**
+ * @brief Change how often a task runs
+ * @param task Index in the table
+ * @param periodMs New period (0 = every pass)
+ *
+ * A shorter period takes effect at once rather than after the current
+ * one runs out. Safe to call from inside the task itself.
+ */
+void LoopScheduler::setPeriod(uint8_t task, unsigned long periodMs) {
+  if (task >= taskCount) return;
+
+  unsigned long due = millis() + periodMs;
+  if ((long)(nextDue[task] - due) > 0) {
+    nextDue[task] = due;
+  }
+  tasks[task].periodMs = periodMs;
+}
+
+/**
+ * @brief Make a task due at once
+ * @param task Index in the table
+ *
+ * It runs in the next pass, and its period carries on from then.
+ */
+void LoopScheduler::wake(uint8_t task) {
+  if (task >= taskCount) return;
+  nextDue[task] = millis();
+}
+
+/**
+ * @brief Get how long until the next periodic task is due
+ * @return Milliseconds (0 if one is due already)
+ *
+ * Tasks run every pass are left out: the sketch decides whether they
+ * have anything to do before it sleeps for this long.
+ */
+unsigned long LoopScheduler::getSlack() {
+  unsigned long now = millis();
+  unsigned long slack = 0xFFFFFFFFUL;
+  for (uint8_t i = 0; i < taskCount; i++) {
+    if (tasks[i].periodMs == 0) continue;
+    long untilDue = (long)(nextDue[i] - now);
+    if (untilDue <= 0) return 0;
+    if ((unsigned long)untilDue < slack) slack = untilDue;
+  }
+  return slack;
+}
+
+/**
+ * @brief Clear the run counts and timings of every task
+ */
+void LoopScheduler::resetStats() {
+  for (uint8_t i = 0; i < taskCount; i++) {
+    stats[i].runs = 0;
+    stats[i].overruns = 0;
+    stats[i].missed = 0;
+    stats[i].worstUs = 0;
+    stats[i].totalUs = 0;
+  }
+  passes = 0;
+  worstPassUs = 0;
+}
+
+/**
+ * @brief Schedule a task's next run, then run and time it
+ * @param task Index of a task that is due
+ * @param now millis() when its turn came
+ *
+ * The next deadline is set first so that a task can change its own
+ * period while it runs.
+ */
+void LoopScheduler::runTask(uint8_t task, unsigned long now) {
+  LoopTask& entry = tasks[task];
+  LoopTaskStats& stat = stats[task];
+  if (entry.periodMs == 0) {
+    nextDue[task] = now;
+  } else {
+    unsigned long late = now - nextDue[task];
+    if (late >= entry.periodMs) {
+      stat.missed += late / entry.periodMs;
+      nextDue[task] = now + entry.periodMs;
+    } else {
+      nextDue[task] += entry.periodMs;
+    }
+  }
+
+  unsigned long start = micros();
+  entry.run();
+  unsigned long took = micros() - start;
+
+  if (took >= slowestUs) {
+    slowestUs = took;
+    lastSlowest = task;
+  }
+
+  stat.runs++;
+  stat.totalUs += took;
+  if (took > stat.worstUs) {
+    stat.worstUs = took;
+  }
+  if (took > entry.budgetUs) {
+    stat.overruns++;
+  }
+}
@@ -0,0 +1,88 @@
+#ifndef LOOP_SCHEDULER_H
+#define LOOP_SCHEDULER_H
+#include <Arduino.h>
+
+// Most tasks one scheduler can hold
+const uint8_t LOOP_MAX_TASKS = 8;
+
+/**
+ * @struct LoopTask
+ * @brief One entry of the sketch's task table
+ *
+ * The table is written out in full in the sketch; what LoopScheduler
+ * keeps about each task while it runs is in LoopTaskStats.
+ */
+struct LoopTask {
+    const char* name;
+    void (*run)();
+    unsigned long periodMs;     // 0 = every pass
+    uint8_t priority;           // Higher runs first within a pass
+    unsigned long budgetUs;     // Longest one run should take
+};
+
+/**
+ * @struct LoopTaskStats
+ * @brief How one task's runs have gone since the last resetStats()
+ */
+struct LoopTaskStats {
+    unsigned long runs;
+    unsigned long overruns;     // Runs that went over budgetUs
+    unsigned long missed;       // Whole periods skipped because a run started late
+    unsigned long worstUs;      // Longest run
+    unsigned long totalUs;      // All runs together, for the average
+};
+
+/**
+ * @class LoopScheduler
+ * @brief Cooperative scheduler for a fixed table of periodic tasks
+ *
+ * Each pass of loop() calls run(), which runs every task that is due,
+ * highest priority first. Tasks are never pre-empted, so a slow task
+ * delays the ones after it, but everything due still runs in the same
+ * pass: no task can starve another. How long each run took is checked
+ * against the task's budget, and runs over it are counted, so the
+ * subsystem at fault shows up in getStats() rather than as late notes.
+ *
+ * Deadlines are compared as differences of millis() values, so they
+ * work across the 49-day wraparound. A task keeps its phase when it
+ * runs late by less than a period (it catches up); later than that it
+ * counts the periods missed and starts again from now.
+ */
+class LoopScheduler {
+private:
+    LoopTask* tasks;
+    uint8_t taskCount;
+    uint8_t order[LOOP_MAX_TASKS];  // Task indexes, highest priority first
+    unsigned long nextDue[LOOP_MAX_TASKS];  // millis() each task's next run is due
+    LoopTaskStats stats[LOOP_MAX_TASKS];
+
+    unsigned long passes;
+    unsigned long worstPassUs;      // Longest pass that ran at least one task
+    unsigned long lastPassUs;
+    uint8_t lastSlowest;            // Task that took longest in the last pass
+    unsigned long slowestUs;
+
+public:
+    LoopScheduler();
+
+    void begin(LoopTask* table, uint8_t count);     // Every task due at once
+    void run();                                     // One pass
+
+    void setPeriod(uint8_t task, unsigned long periodMs);
+    void wake(uint8_t task);                        // Due now, whatever its period
+    unsigned long getSlack();                       // ms until a periodic task is due
+    void resetStats();
+
+    uint8_t getTaskCount() { return taskCount; }
+    const LoopTask& getTask(uint8_t task) { return tasks[task]; }
+    const LoopTaskStats& getStats(uint8_t task) { return stats[task]; }
+    unsigned long getPasses() { return passes; }
+    unsigned long getWorstPass() { return worstPassUs; }
+    unsigned long getLastPass() { return lastPassUs; }
+    uint8_t getLastSlowest() { return lastSlowest; }
+
+private:
+    void runTask(uint8_t task, unsigned long now);
+};
+
+#endif
@@ -0,0 +1,335 @@
+#include "NoteStream.h"
+#include <stdlib.h>
+
+/**
+ * @brief Constructor: no session, nothing received
+ */
+NoteStream::NoteStream() {
+  out = NULL;
+  active = false;
+  started = false;
+  info.durationMs = 0;
+  info.lowestPitch = 0;
+  info.highestPitch = 0;
+  underruns = 0;
+  close();
+}
+
+/**
+ * @brief Set where credit and telemetry lines go (normally Serial)
+ */
+void NoteStream::begin(Print& output) {
+  out = &output;
+}
+
+/**
+ * @brief Act on one line from the host
+ * @param line Line without its newline
+ * @return STREAM_NOT_MINE for anything that isn't a stream line
+ */
+StreamAction NoteStream::handleLine(const String& line) {
+  const char* text = line.c_str();
+  if (text[0] != '~') return STREAM_NOT_MINE;
+
+  char kind = text[1];
+  const char* args = text[1] != '\0' ? text + 2 : text + 1;
+
+  if (kind == 's') {
+    open(args);
+    return STREAM_OK;
+  }
+  if (!active) return STREAM_OK;  // Data for a session that has ended
+
+  switch (kind) {
+    case 'n':
+      receiveNotes(args);
+      break;
+    case 'w':
+      receiveWord(args);
+      break;
+    case 'e':
+      receiveEnd(args);
+      break;
+    case 'p':
+      if (!started) {
+        started = true;
+        return STREAM_START;
+      }
+      break;
+    case 'x':
+      return STREAM_STOP;
+  }
+  return STREAM_OK;
+}
+
+/**
+ * @brief Call once per loop while a session is open
+ * @return STREAM_STOP once a hold has lasted STREAM_UNDERRUN_TIMEOUT
+ */
+StreamAction NoteStream::update() {
+  if (!active) return STREAM_OK;
+  unsigned long now = millis();
+
+  // Playback moving into the next half frees the one behind it
+  for (uint8_t v = 0; v < STREAM_VOICES; v++) {
+    int limit = noteLimit(v);
+    if (limit != limits[v]) {
+      limits[v] = limit;
+      sendCredit('0' + v, received[v], limit);
+    }
+  }
+  int wordLimit = wordsReleased + STREAM_LYRIC_SLOTS;
+  if (wordLimit != wordsLimit) {
+    wordsLimit = wordLimit;
+    sendCredit('l', wordsReceived, wordLimit);
+  }
+
+  if (now - lastTelemetry >= STREAM_TELEMETRY_INTERVAL) {
+    sendTelemetry();
+    lastTelemetry = now;
+  }
+
+  if (started && starved && now - starvedSince >= STREAM_UNDERRUN_TIMEOUT) {
+    return STREAM_STOP;
+  }
+  return STREAM_OK;
+}
+
+/**
+ * @brief End the session; the host is told with "~x"
+ *
+ * The underrun count is kept for status until the next session.
+ */
+void NoteStream::close() {
+  if (active && out != NULL) out->println("~x");
+  active = false;
+  started = false;
+  starved = false;
+
+  for (uint8_t v = 0; v < STREAM_VOICES; v++) {
+    received[v] = 0;
+    playing[v] = -1;
+    totals[v] = 0;
+    limits[v] = 0;
+  }
+  wordsReceived = 0;
+  wordsReleased = 0;
+  wordsLimit = 0;
+}
+
+/**
+ * @brief Start a session: "~s <durationMs> <lowHz> <highHz>"
+ *
+ * Replaces any session already open and hands out the first credit.
+ */
+void NoteStream::open(const char* args) {
+  char* end;
+  info.durationMs = strtoul(args, &end, 10);
+  info.lowestPitch = strtol(end, &end, 10);
+  info.highestPitch = strtol(end, &end, 10);
+
+  close();
+  active = true;
+  underruns = 0;
+  lastTelemetry = millis();
+  for (uint8_t v = 0; v < STREAM_VOICES; v++) {
+    totals[v] = NOTE_SOURCE_OPEN;
+    limits[v] = noteLimit(v);
+    sendCredit('0' + v, 0, limits[v]);
+  }
+  wordsLimit = STREAM_LYRIC_SLOTS;
+  sendCredit('l', 0, wordsLimit);
+}
+
+/**
+ * @brief Store notes: "~n <voice> <index> <f>:<d>[:<accent>] ..."
+ *
+ * Notes must follow on from the last one received and fit the credit;
+ * anything else is dropped and the answer tells the host where to
+ * carry on from.
+ */
+void NoteStream::receiveNotes(const char* args) {
+  char* end;
+  long voice = strtol(args, &end, 10);
+  long index = strtol(end, &end, 10);
+  if (voice < 0 || voice >= STREAM_VOICES) return;
+
+  if (index == received[voice]) {
+    while (*end != '\0' && received[voice] < limits[voice]) {
+      Note note;
+      note.frequency = strtol(end, &end, 10);
+      if (*end != ':') break;
+      note.duration = strtol(end + 1, &end, 10);
+      int8_t accent = (*end == ':') ? strtol(end + 1, &end, 10) : 0;
+
+      notes[voice][received[voice] % STREAM_NOTE_SLOTS] = note;
+      accents[voice][received[voice] % STREAM_NOTE_SLOTS] = accent;
+      received[voice]++;
+    }
+  }
+  sendCredit('0' + voice, received[voice], limits[voice]);
+}
+
+/**
+ * @brief Store a lyric: "~w <index> <timeMs> <word>"
+ *
+ * The word is the rest of the line, cut to STREAM_WORD_SIZE - 1 characters.
+ */
+void NoteStream::receiveWord(const char* args) {
+  char* end;
+  long index = strtol(args, &end, 10);
+  unsigned long timeMs = strtoul(end, &end, 10);
+
+  if (index == wordsReceived && wordsReceived < wordsLimit) {
+    StreamedLyric& slot = words[wordsReceived % STREAM_LYRIC_SLOTS];
+    if (*end == ' ') end++;
+
+    uint8_t length = 0;
+    while (end[length] != '\0' && end[length] != '\r' && length < STREAM_WORD_SIZE - 1) {
+      slot.word[length] = end[length];
+      length++;
+    }
+    slot.word[length] = '\0';
+    slot.timeMs = timeMs;
+    wordsReceived++;
+  }
+  sendCredit('l', wordsReceived, wordsLimit);
+}
+
+/**
+ * @brief Mark the end of a voice or the lyrics: "~e <voice|l> <count>"
+ */
+void NoteStream::receiveEnd(const char* args) {
+  while (*args == ' ') args++;
+  if (*args == 'l') return;     // Lyrics end when the song does
+
+  char* end;
+  long voice = strtol(args, &end, 10);
+  long count = strtol(end, &end, 10);
+  if (voice < 0 || voice >= STREAM_VOICES) return;
+  totals[voice] = constrain(count, 0L, (long)NOTE_SOURCE_OPEN);
+}
+
+/**
+ * @brief Notes received but not yet played on a voice
+ */
+int NoteStream::getFill(uint8_t voice) {
+  return received[voice] - (playing[voice] + 1);
+}
+
+/**
+ * @brief Lyrics received but not yet released by the display
+ */
+int NoteStream::getLyricFill() {
+  return wordsReceived - wordsReleased;
+}
+
+/**
+ * @brief Hand a note to the player
+ * @return False if it hasn't arrived (counted as an underrun) or was overwritten
+ */
+bool NoteStream::readNote(uint8_t voice, int index, Note& note) {
+  if (voice >= STREAM_VOICES || index < 0) return false;
+
+  if (index < received[voice] && index + STREAM_NOTE_SLOTS >= received[voice]) {
+    note = notes[voice][index % STREAM_NOTE_SLOTS];
+    if (index > playing[voice]) playing[voice] = index;
+    starved = false;
+    return true;
+  }
+
+  // The player keeps asking while it holds; count the underrun once
+  if (!starved) {
+    starved = true;
+    starvedSince = millis();
+    underruns++;
+    if (out != NULL) {
+      out->print("~u ");
+      out->print((int)voice);
+      out->print(' ');
+      out->println(index);
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief Accent of a note readNote() has just handed out
+ */
+int8_t NoteStream::readAccent(uint8_t voice, int index) {
+  if (voice >= STREAM_VOICES || index < 0) return 0;
+  return accents[voice][index % STREAM_NOTE_SLOTS];
+}
+
+/**
+ * @brief Notes in a voice, or NOTE_SOURCE_OPEN until the host has said
+ */
+int NoteStream::getLength(uint8_t voice) {
+  return voice < STREAM_VOICES ? totals[voice] : 0;
+}
+
+int NoteStream::getLyricCount() {
+  return wordsReceived;
+}
+
+/**
+ * @brief Look up a lyric; words already overwritten read back empty
+ */
+void NoteStream::readLyric(int index, LyricTiming& lyric) {
+  if (index >= 0 && index < wordsReceived && index + STREAM_LYRIC_SLOTS >= wordsReceived) {
+    StreamedLyric& slot = words[index % STREAM_LYRIC_SLOTS];
+    lyric.word = slot.word;
+    lyric.timeMs = slot.timeMs;
+  } else {
+    lyric.word = "";
+    lyric.timeMs = 0;
+  }
+}
+
+/**
+ * @brief Let the host overwrite words before an index
+ */
+void NoteStream::releaseLyrics(int before) {
+  if (before > wordsReleased) {
+    wordsReleased = min(before, wordsReceived);
+  }
+}
+
+/**
+ * @brief Highest note index plus one the host may send for a voice
+ *
+ * The ring always keeps the half holding the note now playing, so the
+ * limit moves a half at a time.
+ */
+int NoteStream::noteLimit(uint8_t voice) {
+  int base = max(playing[voice], 0);
+  return base - base % STREAM_HALF_NOTES + STREAM_NOTE_SLOTS;
+}
+
+/**
+ * @brief Send "~a <stream> <received> <limit>"
+ */
+void NoteStream::sendCredit(char stream, int receivedCount, int limit) {
+  if (out == NULL) return;
+  out->print("~a ");
+  out->print(stream);
+  out->print(' ');
+  out->print(receivedCount);
+  out->print(' ');
+  out->println(limit);
+}
+
+/**
+ * @brief Send "~f <fill0> <fill1> <fillL> <underruns>" so the host can pace itself
+ */
+void NoteStream::sendTelemetry() {
+  if (out == NULL) return;
+  out->print("~f ");
+  for (uint8_t v = 0; v < STREAM_VOICES; v++) {
+    out->print(getFill(v));
+    out->print(' ');
+  }
+  out->print(getLyricFill());
+  out->print(' ');
+  out->println(underruns);
+}
@@ -0,0 +1,130 @@
+#ifndef NOTE_STREAM_H
+#define NOTE_STREAM_H
+#include <Arduino.h>
+#include "DualBuzzer.h"
+
+// Ring sizes: each voice holds two halves, one playing while the other fills
+const uint8_t STREAM_VOICES = 2;
+const uint8_t STREAM_HALF_NOTES = 8;
+const uint8_t STREAM_NOTE_SLOTS = 2 * STREAM_HALF_NOTES;
+const uint8_t STREAM_LYRIC_SLOTS = 8;
+const uint8_t STREAM_WORD_SIZE = 12;        // Including the terminator
+
+// Longest line accepted while streaming; keeps a line inside the 64 byte serial buffer
+const uint8_t STREAM_LINE_MAX = 60;
+
+const unsigned long STREAM_TELEMETRY_INTERVAL = 500;
+const unsigned long STREAM_UNDERRUN_TIMEOUT = 3000;   // Give up after holding this long
+
+/**
+ * @enum StreamAction
+ * @brief What the sketch should do after a stream line or update()
+ */
+enum StreamAction {
+    STREAM_NOT_MINE,    // Not a stream line; handle it as a command
+    STREAM_OK,
+    STREAM_START,       // Sender asked for playback to begin
+    STREAM_STOP         // Sender aborted, or the stream stalled for good
+};
+
+/**
+ * @class NoteStream
+ * @brief Song data received over serial into small RAM rings
+ *
+ * Lets a song longer than flash can hold play while the host sends it.
+ * Notes are addressed by their index in the voice and land in slot
+ * index % STREAM_NOTE_SLOTS, so PolyBuzzer reads them as if from a table.
+ *
+ * Flow control is by credit. The host may send any note below the
+ * voice's limit; the limit moves up by a whole half when playback
+ * crosses into the next half, so the host refills in bursts of
+ * STREAM_HALF_NOTES. Each data line is answered with the voice's
+ * received count and limit, and the host waits for the answer before
+ * sending again, so no more than one line is ever in flight.
+ *
+ * Lines start with '~' and carry no echo:
+ *   host:   ~s <durationMs> <lowHz> <highHz>     open a session
+ *           ~n <voice> <index> <f>:<d>[:<a>] ...  up to 4 notes in order, a = accent
+ *           ~w <index> <timeMs> <word>           one lyric
+ *           ~e <voice|l> <count>                 total for a voice or the lyrics
+ *           ~p                                   start playback
+ *           ~x                                   abort
+ *   device: ~a <voice|l> <received> <limit>      answer and credit
+ *           ~f <fill0> <fill1> <fillL> <underruns>  every STREAM_TELEMETRY_INTERVAL
+ *           ~u <voice> <index>                   a voice ran dry
+ *           ~x                                   session over
+ *
+ * A voice that runs dry holds the whole song (see PolyBuzzer::update())
+ * and it carries on once the note arrives, so a slow link costs a pause
+ * rather than parts drifting apart. update() reports STREAM_STOP if the
+ * hold outlasts STREAM_UNDERRUN_TIMEOUT.
+ */
+class NoteStream : public NoteSource, public LyricSource {
+private:
+    struct StreamedLyric {
+        char word[STREAM_WORD_SIZE];
+        unsigned long timeMs;
+    };
+
+    Print* out;
+    bool active;                    // Session open
+    bool started;                   // Playback begun
+    SongInfo info;
+
+    // Note rings
+    Note notes[STREAM_VOICES][STREAM_NOTE_SLOTS];
+    int8_t accents[STREAM_VOICES][STREAM_NOTE_SLOTS];
+    int received[STREAM_VOICES];    // Notes stored so far
+    int playing[STREAM_VOICES];     // Highest note handed to the player (-1 = none)
+    int totals[STREAM_VOICES];      // NOTE_SOURCE_OPEN until the host says
+    int limits[STREAM_VOICES];      // Credit last announced
+
+    // Lyric ring
+    StreamedLyric words[STREAM_LYRIC_SLOTS];
+    int wordsReceived;
+    int wordsReleased;              // Words before this may be overwritten
+    int wordsLimit;
+
+    // Underruns
+    unsigned long underruns;
+    bool starved;
+    unsigned long starvedSince;
+    unsigned long lastTelemetry;
+
+public:
+    NoteStream();
+
+    void begin(Print& output);
+    StreamAction handleLine(const String& line);
+    StreamAction update();          // Credit, telemetry and the stall timeout
+    void close();                   // End the session and tell the host
+
+    bool isActive() { return active; }
+    bool isStarted() { return started; }
+    const SongInfo& getSongInfo() { return info; }
+    int getFill(uint8_t voice);     // Notes waiting to be played
+    int getLyricFill();
+    unsigned long getUnderruns() { return underruns; }
+
+    // NoteSource
+    bool readNote(uint8_t voice, int index, Note& out);
+    int getLength(uint8_t voice);
+    int8_t readAccent(uint8_t voice, int index);
+
+    // LyricSource
+    int getLyricCount();
+    void readLyric(int index, LyricTiming& out);
+    void releaseLyrics(int before);
+
+private:
+    void open(const char* args);
+    void receiveNotes(const char* args);
+    void receiveWord(const char* args);
+    void receiveEnd(const char* args);
+
+    int noteLimit(uint8_t voice);
+    void sendCredit(char stream, int receivedCount, int limit);
+    void sendTelemetry();
+};
+
+#endif
@@ -0,0 +1,212 @@
+#include "PitchTimer.h"
+#include "PolyBuzzer.h"
+
+#if defined(__AVR_ATmega328P__)
+
+// Timer1 ticks between output toggles (0 = too low for the timer)
+constexpr uint16_t halfPeriod(int note) {
+  return note < PITCH_TIMER_LOWEST ? 0
+       : (uint16_t)(F_CPU / PITCH_TIMER_PRESCALE / (2.0 * noteHz(note)) + 0.5);
+}
+
+#define HALF_PERIOD_ROW(n) halfPeriod(n), halfPeriod(n + 1), halfPeriod(n + 2), halfPeriod(n + 3), \
+                           halfPeriod(n + 4), halfPeriod(n + 5), halfPeriod(n + 6), halfPeriod(n + 7)
+
+/**
+ * Half periods for MIDI notes 0-127, worked out by the compiler from the
+ * exact pitch rather than the rounded Hz in pitches.h.
+ */
+constexpr uint16_t HALF_PERIODS[MIDI_NOTE_COUNT] PROGMEM = {
+  HALF_PERIOD_ROW(0),   HALF_PERIOD_ROW(8),   HALF_PERIOD_ROW(16),  HALF_PERIOD_ROW(24),
+  HALF_PERIOD_ROW(32),  HALF_PERIOD_ROW(40),  HALF_PERIOD_ROW(48),  HALF_PERIOD_ROW(56),
+  HALF_PERIOD_ROW(64),  HALF_PERIOD_ROW(72),  HALF_PERIOD_ROW(80),  HALF_PERIOD_ROW(88),
+  HALF_PERIOD_ROW(96),  HALF_PERIOD_ROW(104), HALF_PERIOD_ROW(112), HALF_PERIOD_ROW(120)
+};
+static_assert(halfPeriod(PITCH_TIMER_LOWEST) > 0 && noteHz(PITCH_TIMER_LOWEST) * 2 * 65535 >
+              F_CPU / PITCH_TIMER_PRESCALE, "Lowest timer note overflows 16 bits");
+
+// Share of each period spent high at each volume, out of 256. A pulse
+// wave's fundamental goes as sin(pi * duty), so these are
+// asin(volume / 10) / pi: even steps in the fundamental.
+static const uint8_t VOLUME_DUTY[PITCH_VOLUME_MAX + 1] PROGMEM = {
+  0, 8, 16, 25, 34, 43, 52, 63, 76, 91, 128
+};
+
+// Shortest high or low time (64us): the interrupt has to set the next
+// edge before the timer gets there, after waiting out whichever others
+// got in first (Timer0, TWI for the LCD, USART receive, the microphone's
+// ADC), each several microseconds
+static const uint16_t MIN_EDGE_TICKS = 128;
+
+// How far ahead an edge that is already late goes (8us), leaving the
+// interrupt time to return
+static const uint16_t LATE_EDGE_TICKS = 16;
+
+// Ticks each channel's output stays low [0] and high [1]; 0 = channel off
+// (A = pin 9, B = pin 10)
+static volatile uint16_t edgeTicks[2][2];
+static bool timerReady = false;
+
+/**
+ * @brief Compare value for a channel's next toggle
+ * @param edge The toggle that just happened
+ * @param ticks Time to the next one
+ *
+ * If the interrupt was held off so long that the timer is already past
+ * that point, it would not match again until TCNT1 wrapped, 33ms of
+ * silence. The toggle comes as soon as it can instead: one short
+ * half-cycle rather than a dropout.
+ */
+static inline uint16_t nextEdge(uint16_t edge, uint16_t ticks) {
+  uint16_t next = edge + ticks;
+  uint16_t soonest = TCNT1 + LATE_EDGE_TICKS;
+  return (int16_t)(next - soonest) < 0 ? soonest : next;
+}
+
+// The pin has just toggled, so its level says which time comes next
+ISR(TIMER1_COMPA_vect) {
+  OCR1A = nextEdge(OCR1A, edgeTicks[0][(PINB >> PINB1) & 1]);
+}
+
+ISR(TIMER1_COMPB_vect) {
+  OCR1B = nextEdge(OCR1B, edgeTicks[1][(PINB >> PINB2) & 1]);
+}
+
+/**
+ * @brief Timer1 channel behind a pin
+ * @return 0 for pin 9, 1 for pin 10, -1 for any other pin
+ */
+static int8_t timerChannel(uint8_t pin) {
+  return pin == 9 ? 0 : pin == 10 ? 1 : -1;
+}
+
+/**
+ * @brief Stop a channel toggling its pin and leave the pin low
+ */
+static void stopChannel(uint8_t channel, uint8_t pin) {
+  uint8_t sreg = SREG;
+  cli();
+  if (channel == 0) {
+    TIMSK1 &= ~_BV(OCIE1A);
+    TCCR1A &= ~_BV(COM1A0);
+  } else {
+    TIMSK1 &= ~_BV(OCIE1B);
+    TCCR1A &= ~_BV(COM1B0);
+  }
+  edgeTicks[channel][0] = 0;
+  edgeTicks[channel][1] = 0;
+  SREG = sreg;
+  digitalWrite(pin, LOW);
+}
+
+/**
+ * @brief Sound a MIDI note on a pin
+ * @param volume 1 to PITCH_VOLUME_MAX (0 = silent)
+ *
+ * A channel that is already sounding changes pitch and volume at its
+ * next toggle, so there is no gap between notes.
+ */
+void pitchTone(uint8_t pin, uint8_t pitch, uint8_t volume) {
+  if (pitch == 0 || volume == 0) {
+    pitchNoTone(pin);
+    return;
+  }
+  int8_t channel = timerChannel(pin);
+  uint16_t ticks = (channel >= 0 && pitch < MIDI_NOTE_COUNT) ? pgm_read_word(&HALF_PERIODS[pitch]) : 0;
+  if (ticks == 0) {
+    pitchToneHz(pin, midiFrequency(pitch));
+    return;
+  }
+
+  // Split the period at the volume's duty; full volume is the square wave as is
+  uint16_t high = ticks;
+  uint16_t low = ticks;
+  if (volume < PITCH_VOLUME_MAX) {
+    unsigned long period = 2UL * ticks;
+    unsigned long up = (period * pgm_read_byte(&VOLUME_DUTY[volume])) >> 8;
+    if (up < MIN_EDGE_TICKS) up = min((unsigned long)MIN_EDGE_TICKS, (unsigned long)ticks);
+    if (period - up > 0xFFFF) up = period - 0xFFFF;    // Very low notes: the low time must fit 16 bits
+    high = up;
+    low = period - up;
+  }
+
+  uint8_t sreg = SREG;
+  cli();
+  if (!timerReady) {
+    // Free running at clk/8 (the core set it up for 8-bit PWM)
+    TCCR1A = 0;
+    TCCR1B = _BV(CS11);
+    timerReady = true;
+  }
+
+  edgeTicks[channel][0] = low;
+  edgeTicks[channel][1] = high;
+  uint8_t enable = (channel == 0) ? _BV(OCIE1A) : _BV(OCIE1B);
+  if (!(TIMSK1 & enable)) {
+    // Channel was idle: drop any tone() on the pin; it is low, so the low time comes first
+    SREG = sreg;
+    noTone(pin);
+    cli();
+    if (channel == 0) {
+      OCR1A = TCNT1 + low;
+      TCCR1A |= _BV(COM1A0);
+    } else {
+      OCR1B = TCNT1 + low;
+      TCCR1A |= _BV(COM1B0);
+    }
+    TIFR1 = enable;     // OCF1x sits at the same bit as OCIE1x
+    TIMSK1 |= enable;
+  }
+  SREG = sreg;
+}
+
+/**
+ * @brief Sound a frequency that isn't on the table, through tone()
+ */
+void pitchToneHz(uint8_t pin, unsigned int frequency) {
+  int8_t channel = timerChannel(pin);
+  if (channel >= 0 && edgeTicks[channel][0] != 0) stopChannel(channel, pin);
+  tone(pin, frequency);
+}
+
+/**
+ * @brief Silence a pin, whichever way it was sounding
+ */
+void pitchNoTone(uint8_t pin) {
+  int8_t channel = timerChannel(pin);
+  if (channel >= 0 && edgeTicks[channel][0] != 0) {
+    stopChannel(channel, pin);
+  } else {
+    noTone(pin);
+  }
+}
+
+bool isPitchTimerPin(uint8_t pin) {
+  return timerChannel(pin) >= 0;
+}
+
+#else
+
+// No timer driver for this board: everything goes through tone(), at full volume
+
+void pitchTone(uint8_t pin, uint8_t pitch, uint8_t volume) {
+  if (pitch == 0 || volume == 0) {
+    noTone(pin);
+  } else {
+    tone(pin, midiFrequency(pitch));
+  }
+}
+
+void pitchToneHz(uint8_t pin, unsigned int frequency) {
+  tone(pin, frequency);
+}
+
+void pitchNoTone(uint8_t pin) {
+  noTone(pin);
+}
+
+bool isPitchTimerPin(uint8_t /*pin*/) {
+  return false;
+}
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef PITCH_TIMER_H
+#define PITCH_TIMER_H
+#include <Arduino.h>
+
+/**
+ * Buzzer output by MIDI note number instead of by frequency.
+ *
+ * tone() works out a prescaler and compare value from the frequency on
+ * every call, with 32-bit divisions. Here the compare value for every
+ * note is in a table built by the compiler, so starting a note is one
+ * PROGMEM read and a couple of register writes.
+ *
+ * On an ATmega328P (Uno R3, Nano) the buzzer pins 9 and 10 are Timer1's
+ * two compare outputs, and each gets its own note: the timer runs free
+ * at clk/8 and each channel's compare interrupt moves its next toggle
+ * half a period on. One prescaler covers every note in pitches.h, so
+ * the table only holds the half periods. This also lets both buzzers
+ * sound together, which the AVR tone() (one pin at a time) can't.
+ *
+ * Volume is set by the duty cycle. A piezo is loudest on a square wave,
+ * and its fundamental falls away as the wave gets narrower, so a quieter
+ * note stays high for less of each period. The compare interrupt already
+ * runs at every edge; it just adds the high or the low time instead of
+ * half the period each time, so a note below full volume costs one
+ * multiply as it starts and no extra interrupts.
+ *
+ * Other pins, notes below PITCH_TIMER_LOWEST and other boards go through
+ * tone(), which always plays a square wave at full volume. Timer1 is
+ * taken over by the first note, so analogWrite() on pins 9 and 10 (and
+ * the Servo library) can't be used alongside.
+ */
+const uint8_t PITCH_TIMER_PRESCALE = 8;
+const uint8_t PITCH_TIMER_LOWEST = 11;      // Lower notes overflow a 16-bit half period at clk/8
+const uint8_t PITCH_VOLUME_MAX = 10;        // Square wave; 1 is the quietest
+
+// Equal-tempered frequency of a MIDI note, counted out from A4 = 440Hz,
+// for tables the compiler builds
+constexpr double SEMITONE = 1.0594630943592953;
+constexpr double noteHz(int note) {
+    return note < 69 ? noteHz(note + 1) / SEMITONE : note > 69 ? noteHz(note - 1) * SEMITONE : 440.0;
+}
+
+void pitchTone(uint8_t pin, uint8_t pitch, uint8_t volume = PITCH_VOLUME_MAX);  // MIDI note 1-127
+void pitchToneHz(uint8_t pin, unsigned int frequency);  // A frequency off the table
+void pitchNoTone(uint8_t pin);
+bool isPitchTimerPin(uint8_t pin);                      // Driven by Timer1 on this board
+
+#endif
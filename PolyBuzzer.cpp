@@ -0,0 +1,60 @@
+#include "PolyBuzzer.h"
+
+/**
+ * Equal-tempered pitch ratios for -12..+12 semitones in Q14
+ * (16384 = unison), so transposing a note is one multiply and shift.
+ */
+const uint16_t PITCH_RATIOS[2 * TRANSPOSE_MAX_SEMITONES + 1] PROGMEM = {
+   8192,  8679,  9195,  9742, 10321, 10935, 11585, 12274, 13004, 13777, 14596, 15464,
+  16384,
+  17358, 18390, 19484, 20643, 21870, 23170, 24548, 26008, 27554, 29193, 30929, 32768
+};
+
+/**
+ * Equal-tempered frequencies for MIDI notes 0-127, rounded as in
+ * pitches.h, so packing a pitches.h note and reading it back gives the
+ * same value. Entry 0 is a rest.
+ */
+const uint16_t MIDI_FREQUENCIES[MIDI_NOTE_COUNT] PROGMEM = {
+      0,     9,     9,    10,    10,    11,    12,    12,    13,    14,    15,    15,
+     16,    17,    18,    19,    21,    22,    23,    24,    26,    28,    29,    31,
+     33,    35,    37,    39,    41,    44,    46,    49,    52,    55,    58,    62,
+     65,    69,    73,    78,    82,    87,    92,    98,   104,   110,   117,   123,
+    131,   139,   147,   156,   165,   175,   185,   196,   208,   220,   233,   247,
+    262,   277,   294,   311,   330,   349,   370,   392,   415,   440,   466,   494,
+    523,   554,   587,   622,   659,   698,   740,   784,   831,   880,   932,   988,
+   1047,  1109,  1175,  1245,  1319,  1397,  1480,  1568,  1661,  1760,  1865,  1976,
+   2093,  2217,  2349,  2489,  2637,  2794,  2960,  3136,  3322,  3520,  3729,  3951,
+   4186,  4435,  4699,  4978,  5274,  5588,  5920,  6272,  6645,  7040,  7459,  7902,
+   8372,  8870,  9397,  9956, 10548, 11175, 11840, 12544
+};
+
+/**
+ * @brief Frequency for a MIDI note number
+ * @return Hz, or 0 for a rest
+ */
+int midiFrequency(uint8_t note) {
+  return pgm_read_word(&MIDI_FREQUENCIES[note & 127]);
+}
+
+/**
+ * @brief MIDI note number nearest a frequency
+ * @return 1-127, or 0 for a rest
+ */
+uint8_t midiNote(int frequency) {
+  if (frequency <= 0) return 0;
+
+  // First note at or above the frequency, then whichever neighbour is closer
+  uint8_t low = 1;
+  uint8_t high = MIDI_NOTE_COUNT - 1;
+  while (low < high) {
+    uint8_t mid = (low + high) / 2;
+    if ((int)pgm_read_word(&MIDI_FREQUENCIES[mid]) < frequency) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  if (low > 1 && frequency - midiFrequency(low - 1) <= midiFrequency(low) - frequency) low--;
+  return low;
+}
@@ -0,0 +1,790 @@
+#ifndef POLY_BUZZER_H
+#define POLY_BUZZER_H
+#include <Arduino.h>
+#include "Harmonizer.h"
+#include "PitchTimer.h"
+
+/**
+ * @struct Note
+ * @brief Structure to hold a musical note and its duration
+ */
+struct Note {
+    int frequency;  // Hz
+    int duration;   // milliseconds
+};
+
+// Tempo and key limits
+const int TEMPO_MIN_PERCENT = 25;
+const int TEMPO_MAX_PERCENT = 400;
+const int TRANSPOSE_MAX_SEMITONES = 12;
+
+// Equal-tempered pitch ratios for -12..+12 semitones in Q14 (see PolyBuzzer.cpp)
+extern const uint16_t PITCH_RATIOS[2 * TRANSPOSE_MAX_SEMITONES + 1] PROGMEM;
+
+// Frequencies of MIDI notes 0-127, matching pitches.h; note 0 is a rest
+const uint8_t MIDI_NOTE_COUNT = 128;
+extern const uint16_t MIDI_FREQUENCIES[MIDI_NOTE_COUNT] PROGMEM;
+int midiFrequency(uint8_t note);        // Hz (0 = rest)
+uint8_t midiNote(int frequency);        // Nearest note (0 = rest)
+
+/**
+ * Compile-time measurements of note tables, so song lengths and pitch
+ * ranges are worked out by the compiler instead of by walking PROGMEM
+ * at runtime. The tables must be declared constexpr. Each helper is a
+ * single recursive expression (C++11 constexpr).
+ */
+
+// Lower of two pitches, where 0 (a rest) means "no pitch yet"
+constexpr int lowerPitch(int a, int b) {
+    return (a == 0) ? b : (b == 0 || a < b) ? a : b;
+}
+
+constexpr int higherPitch(int a, int b) {
+    return (a > b) ? a : b;
+}
+
+constexpr unsigned long higherDuration(unsigned long a, unsigned long b) {
+    return (a > b) ? a : b;
+}
+
+// Written length of a note table in milliseconds
+template <size_t N>
+constexpr unsigned long notesDuration(const Note (&notes)[N], size_t i = 0) {
+    return (i < N) ? (unsigned long)notes[i].duration + notesDuration(notes, i + 1) : 0;
+}
+
+// Lowest sounding pitch in Hz (rests skipped, 0 if there are none)
+template <size_t N>
+constexpr int lowestPitch(const Note (&notes)[N], size_t i = 0) {
+    return (i < N) ? lowerPitch(notes[i].frequency, lowestPitch(notes, i + 1)) : 0;
+}
+
+// Highest pitch in Hz
+template <size_t N>
+constexpr int highestPitch(const Note (&notes)[N], size_t i = 0) {
+    return (i < N) ? higherPitch(notes[i].frequency, highestPitch(notes, i + 1)) : 0;
+}
+
+// Check that an accent table has one entry per note
+template <size_t N, size_t A>
+constexpr bool accentsMatch(const Note (&)[N], const int8_t (&)[A]) {
+    return N == A;
+}
+
+// Length reported by a NoteSource whose end has not arrived yet
+const int NOTE_SOURCE_OPEN = 32767;
+
+/**
+ * @class NoteSource
+ * @brief Notes kept somewhere other than a PROGMEM table
+ *
+ * PolyBuzzer asks for each note as it is about to start it, in order
+ * within a voice. A source that has not received a note yet returns
+ * false and playback holds until it arrives (see PolyBuzzer::update()).
+ *
+ * After each pass PolyBuzzer calls prefetch() with the time until the
+ * next note is due, so a slow source can read ahead when there is time.
+ */
+class NoteSource {
+public:
+    virtual bool readNote(uint8_t voice, int index, Note& out) = 0;  // Written note, false if missing
+    virtual int getLength(uint8_t voice) = 0;                        // NOTE_SOURCE_OPEN until known
+    virtual void prefetch(unsigned long /*slackMs*/) {}
+    virtual int8_t readAccent(uint8_t /*voice*/, int /*index*/) { return 0; }  // Once readNote() has it
+};
+
+/**
+ * @class PolyBuzzer
+ * @brief Plays VOICES note sequences in step, one buzzer per voice
+ *
+ * Per-voice state is kept in small parallel arrays and a single loop
+ * advances every voice, so a third or fourth buzzer (bass, percussion)
+ * costs a few bytes of RAM instead of another copy of the playback code.
+ * VOICES is a compile-time constant, so the two-voice loop compiles down
+ * to the same work as hand-written melody and harmony paths.
+ *
+ * Notes are decoded as they are read: tempo scales the duration in fixed
+ * point, and the pitch is looked up as a MIDI note number and moved by
+ * the transpose offset. Buzzers are driven by note number through
+ * pitchTone() (see PitchTimer.h), so a note change is a table lookup
+ * instead of tone()'s divider arithmetic.
+ *
+ * Notes come from PROGMEM tables, or from a NoteSource for songs that
+ * arrive while they play. If a source runs dry the whole song holds:
+ * every buzzer goes quiet and the clocks stop until the note arrives,
+ * so the parts stay together.
+ *
+ * One voice can instead be generated from voice 0 by a Harmonizer (see
+ * setGenerator()): it reads the melody note with the same index and
+ * plays the harmony note worked out from it.
+ *
+ * Each voice has a volume, moved up or down for a note by its accent and
+ * played through the duty cycle (see PitchTimer.h). A voice at volume 0
+ * is muted whatever its accents. Accents are kept out of Note, in an
+ * optional PROGMEM table of one int8_t per note (see setAccents()), so
+ * a song without accents pays nothing for them.
+ *
+ * Song time comes from millis() unless setClock() names another clock,
+ * such as the one several units share (see ClockSync.h). Times passed in
+ * and handed out are on that clock.
+ */
+template <uint8_t VOICES>
+class PolyBuzzer {
+private:
+    // Hardware pins (-1 = voice not wired)
+    int8_t pins[VOICES];
+
+    // Music data
+    const Note* notes[VOICES];
+    int lengths[VOICES];
+    const int8_t* accentTables[VOICES];   // PROGMEM, one per note; NULL = none
+    NoteSource* source;               // Replaces the tables when set
+    Harmonizer* generator;            // Makes generatedVoice from voice 0
+    int8_t generatedVoice;            // -1 = none
+
+    // Underrun hold
+    bool holding;
+    uint8_t heldVoice;                // Voice waiting for its next note
+    unsigned long holdStart;
+
+    // Timing control
+    int indices[VOICES];
+    unsigned long startTimes[VOICES];
+    unsigned long durations[VOICES];  // Current note, as decoded
+    int frequencies[VOICES];          // Current note, as decoded
+    uint8_t pitches[VOICES];          // Current note as a MIDI number (0 = rest or off the table)
+    int8_t accents[VOICES];           // Current note, as written
+    uint8_t volumes[VOICES];          // 0 (muted) to PITCH_VOLUME_MAX
+    uint8_t playingMask;              // Bit per voice
+
+    // Song clock
+    unsigned long (*clock)();         // millis() unless shared with other units
+    unsigned long songStartTime;
+    unsigned long songDuration;       // Written length of the longest voice
+
+    // Tempo and key, applied as each note is read
+    int tempoPercent;
+    unsigned long tempoScale;   // Q12 duration multiplier (100% = 4096)
+    unsigned long tempoRate;    // Q12 song clock multiplier (inverse of tempoScale)
+    int transposeSemitones;
+    uint16_t pitchRatio;        // Q14 frequency multiplier (unison = 16384)
+
+public:
+    PolyBuzzer();
+
+    // Setup
+    void setPin(uint8_t voice, int pin);
+    void setVoice(uint8_t voice, const Note* sequence, int length);
+    void setAccents(uint8_t voice, const int8_t* table);
+    void setSongDuration(unsigned long durationMs);
+    void setSource(NoteSource* notesFrom);     // NULL to go back to the tables
+    void setGenerator(int8_t voice, Harmonizer* from);  // -1 to stop generating
+    void setClock(unsigned long (*from)()) { clock = from; }
+
+    // Playback control
+    void startSongAt(unsigned long startTime); // Start every voice on a shared clock
+    void playVoice(uint8_t voice);             // Start one voice from its first note
+    void stopVoice(uint8_t voice);
+    void stop();
+    void seek(unsigned long positionMs);
+
+    // Advance every voice; returns a bit per voice that moved to a new note or ended
+    uint8_t update(unsigned long currentTime);
+
+    // Status
+    bool isPlaying() { return playingMask != 0; }
+    bool isVoicePlaying(uint8_t voice) { return (playingMask >> voice) & 1; }
+    int getFrequency(uint8_t voice) { return isVoicePlaying(voice) ? frequencies[voice] : 0; }
+    int getNoteIndex(uint8_t voice) { return indices[voice]; }
+    uint8_t getNoteProgress(uint8_t voice);   // 0-255 through the current note
+    unsigned long getTimeLeft(uint8_t voice); // Clock ms until the next note is due
+    bool peekNote(uint8_t voice, Note& out);  // That note, decoded; false if not known
+    const Note* getNotes(uint8_t voice) { return notes[voice]; }
+    int getLength(uint8_t voice);
+    bool isGenerated(uint8_t voice) { return voice == generatedVoice; }
+    NoteSource* getSource() { return source; }
+    bool isHolding() { return holding; }
+    unsigned long getHoldTime() { return holding ? clock() - holdStart : 0; }
+    unsigned long getSongPosition();
+    unsigned long getSongDuration() { return songDuration; }
+    unsigned long getSongEndTime() { return songStartTime + scaleDuration(songDuration); }
+    unsigned long now() { return clock(); }
+
+    // Tempo and key
+    void setTempo(int percent);
+    int getTempo() { return tempoPercent; }
+    void setTranspose(int semitones);
+    int getTranspose() { return transposeSemitones; }
+
+    // Volume
+    void setVolume(uint8_t voice, uint8_t volume);
+    uint8_t getVolume(uint8_t voice) { return volumes[voice]; }
+    uint8_t getNoteVolume(uint8_t voice);      // Volume with the current note's accent
+    unsigned long scaleDuration(unsigned long scoreMs);
+    int transposeFrequency(int frequency);
+
+private:
+    bool hasNotes(uint8_t voice);
+    bool readWritten(uint8_t voice, int index, Note& out);
+    bool readNote(uint8_t voice, int index, Note& out, uint8_t& pitch);
+    int8_t readAccent(uint8_t voice, int index);
+    bool startNote(uint8_t voice, int index, unsigned long startTime);
+    void sound(uint8_t voice);
+    void hold(uint8_t voice, unsigned long currentTime);
+    bool release(unsigned long currentTime);
+};
+
+/**
+ * @brief Constructor: no pins, no notes, written tempo and key
+ */
+template <uint8_t VOICES>
+PolyBuzzer<VOICES>::PolyBuzzer() {
+    for (uint8_t v = 0; v < VOICES; v++) {
+        pins[v] = -1;
+        notes[v] = NULL;
+        lengths[v] = 0;
+        accentTables[v] = NULL;
+        indices[v] = 0;
+        startTimes[v] = 0;
+        durations[v] = 0;
+        frequencies[v] = 0;
+        pitches[v] = 0;
+        accents[v] = 0;
+        volumes[v] = PITCH_VOLUME_MAX;
+    }
+    playingMask = 0;
+    source = NULL;
+    generator = NULL;
+    generatedVoice = -1;
+    holding = false;
+    heldVoice = 0;
+    holdStart = 0;
+
+    clock = millis;
+    songStartTime = 0;
+    songDuration = 0;
+
+    tempoPercent = 100;
+    tempoScale = 4096;
+    tempoRate = 4096;
+    transposeSemitones = 0;
+    pitchRatio = 16384;
+}
+
+/**
+ * @brief Assign a buzzer pin to a voice and make it an output
+ */
+template <uint8_t VOICES>
+void PolyBuzzer<VOICES>::setPin(uint8_t voice, int pin) {
+    pins[voice] = pin;
+    if (pin >= 0) pinMode(pin, OUTPUT);
+}
+
+/**
+ * @brief Set the note sequence for one voice
+ * @param voice Voice number (0 = melody, 1 = harmony, ...)
+ * @param sequence Pointer to PROGMEM note array, or NULL for a silent voice
+ * @param length Number of notes
+ *
+ * Clears the voice's accents; set them again after.
+ */
+template <uint8_t VOICES>
+void PolyBuzzer<VOICES>::setVoice(uint8_t voice, const Note* sequence, int length) {
+    notes[voice] = sequence;
+    lengths[voice] = length;
+    accentTables[voice] = NULL;
+    indices[voice] = 0;
+}
+
+/**
+ * @brief Set the accents for one voice's notes
+ * @param table PROGMEM volume steps, one per note, or NULL for none
+ *
+ * A generated voice takes the melody's accents.
+ */
+template <uint8_t VOICES>
+void PolyBuzzer<VOICES>::setAccents(uint8_t voice, const int8_t* table) {
+    accentTables[voice] = table;
+}
+
+/**
+ * @brief Set the written length of the song (longest voice)
+ */
+template <uint8_t VOICES>
+void PolyBuzzer<VOICES>::setSongDuration(unsigned long durationMs) {
+    songDuration = durationMs;
+}
+
+/**
+ * @brief Take notes from a source instead of the PROGMEM tables
+ * @param notesFrom Source for every voice, or NULL for the tables
+ *
+ * seek() and startSongAt() only work with a source that can still
+ * read from the start of the song.
+ */
+template <uint8_t VOICES>
+void PolyBuzzer<VOICES>::setSource(NoteSource* notesFrom) {
+    source = notesFrom;
+    holding = false;
+    for (uint8_t v = 0; v < VOICES; v++) {
+        indices[v] = 0;
+    }
+}
+
+/**
+ * @brief Generate a voice from the melody instead of reading its notes
+ * @param voice Voice to generate (not voice 0), or -1 for none
+ * @param from Rule and key to generate with
+ *
+ * The voice's own table or source part is ignored while it is generated.
+ */
+template <uint8_t VOICES>
+void PolyBuzzer<VOICES>::setGenerator(int8_t voice, Harmonizer* from) {
+    if (voice <= 0 || voice >= VOICES || from == NULL) voice = -1;
+    generatedVoice = voice;
+    generator = from;
+    if (generator != NULL) generator->rewind();
+}
+
+/**
+ * @brief Number of notes in a voice
+ *
+ * A generated voice has one note for each melody note.
+ */
+template <uint8_t VOICES>
+int PolyBuzzer<VOICES>::getLength(uint8_t voice) {
+    if (voice == generatedVoice) voice = 0;
+    return source != NULL ? source->getLength(voice) : lengths[voice];
+}
+
+/**
+ * @brief Start every voice with notes as if the song began at startTime
+ * @param startTime Clock value (see setClock()) for the start of the song; may be in the
+ *                  past, in which case the voices catch up via seek()
+ */
+template <uint8_t VOICES>
+void PolyBuzzer<VOICES>::startSongAt(unsigned long startTime) {
+    songStartTime = startTime;
+    seek(getSongPosition());
+}
+
+/**
+ * @brief Start one voice from its first note
+ *
+ * The first voice to start also starts the song clock.
+ */
+template <uint8_t VOICES>
+void PolyBuzzer<VOICES>::playVoice(uint8_t voice) {
+    if (getLength(voice) <= 0 || !hasNotes(voice)) return;
+
+    unsigned long now = clock();
+    if (!isPlaying()) {
+        songStartTime = now;
+        holding = false;
+    }
+    startNote(voice, 0, now);
+}
+
+/**
+ * @brief Stop one voice and silence its buzzer
+ */
+template <uint8_t VOICES>
+void PolyBuzzer<VOICES>::stopVoice(uint8_t voice) {
+    playingMask &= ~(1 << voice);
+    if (pins[voice] >= 0) pitchNoTone(pins[voice]);
+}
+
+/**
+ * @brief Stop all voices
+ */
+template <uint8_t VOICES>
+void PolyBuzzer<VOICES>::stop() {
+    holding = false;
+    for (uint8_t v = 0; v < VOICES; v++) {
+        stopVoice(v);
+    }
+}
+
+/**
+ * @brief Jump every voice to a song position
+ * @param positionMs Written (score) milliseconds from the start of the song
+ *
+ * Restarts the song clock so positionMs is "now". For each voice, walks
+ * the written durations to the note covering positionMs and back-dates
+ * its start so it ends on time at the current tempo. Voices shorter than
+ * the position are stopped. Starts playback if the song was stopped.
+ */
+template <uint8_t VOICES>
+void PolyBuzzer<VOICES>::seek(unsigned long positionMs) {
+    unsigned long now = clock();
+    songStartTime = now - scaleDuration(positionMs);
+    holding = false;
+
+    for (uint8_t v = 0; v < VOICES; v++) {
+        int length = getLength(v);
+        if (length <= 0 || !hasNotes(v)) continue;
+
+        unsigned long noteStart = 0;
+        int i = 0;
+        for (; i < length; i++) {
+            Note note;
+            if (!readWritten(v, i, note)) {
+                i = length; // Can't walk this voice; leave it silent
+                break;
+            }
+            if (positionMs < noteStart + note.duration) break;
+            noteStart += note.duration;
+        }
+
+        if (i < length) {
+            startNote(v, i, now - scaleDuration(positionMs - noteStart));
+        } else {
+            // Position is past the end of this voice
+            indices[v] = length;
+            stopVoice(v);
+        }
+    }
+}
+
+/**
+ * @brief Advance every playing voice whose note has run out
+ * @param currentTime Clock value (see setClock()) for this pass
+ * @return Bit per voice that started a new note or finished
+ *
+ * Each note starts when the one before it was due to end, not when this
+ * pass noticed, so a late pass shortens the next note instead of pushing
+ * the rest of the song late, and every voice stays on the song clock.
+ * A voice more than a whole note behind skips the notes it has missed.
+ */
+template <uint8_t VOICES>
+uint8_t PolyBuzzer<VOICES>::update(unsigned long currentTime) {
+    uint8_t changed = 0;
+    if (holding && !release(currentTime)) return 0;
+
+    for (uint8_t v = 0; v < VOICES; v++) {
+        if (!isVoicePlaying(v)) continue;
+
+        // Check if current note duration has elapsed
+        if (currentTime - startTimes[v] < durations[v]) continue;
+        changed |= 1 << v;
+
+        int length = getLength(v);
+        int index = indices[v] + 1;
+        unsigned long due = startTimes[v] + durations[v];
+        while (index < length) {
+            if (!startNote(v, index, due)) {
+                hold(v, currentTime);
+                return changed;
+            }
+            if (currentTime - due < durations[v]) break;
+            due += durations[v];
+            index++;
+        }
+
+        // Check if we've reached the end of this voice
+        if (index >= length) {
+            indices[v] = length;
+            stopVoice(v);
+        }
+    }
+
+
+    // Let the source read ahead until the next note is due
+    if (source != NULL && isPlaying()) {
+        unsigned long slack = 0xFFFFFFFFUL;
+        for (uint8_t v = 0; v < VOICES; v++) {
+            if (!isVoicePlaying(v)) continue;
+            unsigned long left = durations[v] - (currentTime - startTimes[v]);
+            if (left < slack) slack = left;
+        }
+        source->prefetch(slack);
+    }
+    return changed;
+}
+
+/**
+ * @brief Silence the song while a voice waits for its next note
+ *
+ * The voices keep their notes; release() picks them up again.
+ */
+template <uint8_t VOICES>
+void PolyBuzzer<VOICES>::hold(uint8_t voice, unsigned long currentTime) {
+    holding = true;
+    heldVoice = voice;
+    holdStart = currentTime;
+    for (uint8_t v = 0; v < VOICES; v++) {
+        if (pins[v] >= 0) pitchNoTone(pins[v]);
+    }
+}
+
+/**
+ * @brief End a hold once the missing note has arrived
+ * @return True if playback carries on this pass
+ *
+ * Every clock moves forward by the time spent waiting, so each voice
+ * resumes the remainder of the note it was sounding. The held voice's
+ * note has already run out, so update() starts its next one straight
+ * away.
+ */
+template <uint8_t VOICES>
+bool PolyBuzzer<VOICES>::release(unsigned long currentTime) {
+    int index = indices[heldVoice] + 1;
+    Note next;
+    uint8_t pitch;
+    if (index < getLength(heldVoice) && !readNote(heldVoice, index, next, pitch)) return false;
+
+    unsigned long stall = currentTime - holdStart;
+    holding = false;
+    songStartTime += stall;
+    for (uint8_t v = 0; v < VOICES; v++) {
+        if (!isVoicePlaying(v)) continue;
+        startTimes[v] += stall;
+        if (v != heldVoice) sound(v);
+    }
+    return true;
+}
+
+/**
+ * @brief Get progress through a voice's current note
+ * @return 0 at the start of the note, 255 at its end (0 when stopped)
+ */
+template <uint8_t VOICES>
+uint8_t PolyBuzzer<VOICES>::getNoteProgress(uint8_t voice) {
+    if (!isVoicePlaying(voice) || durations[voice] == 0) return 0;
+
+    unsigned long now = holding ? holdStart : clock();
+    unsigned long elapsed = now - startTimes[voice];
+    if (elapsed >= durations[voice]) return 255;
+    return (uint8_t)((elapsed * 255UL) / durations[voice]);
+}
+
+/**
+ * @brief Get how long until a voice moves to its next note
+ * @return Clock milliseconds (0 once it is due), or 0xFFFFFFFF for a
+ *         voice that is stopped or held
+ */
+template <uint8_t VOICES>
+unsigned long PolyBuzzer<VOICES>::getTimeLeft(uint8_t voice) {
+    if (!isVoicePlaying(voice) || holding) return 0xFFFFFFFFUL;
+
+    unsigned long elapsed = clock() - startTimes[voice];
+    return elapsed >= durations[voice] ? 0 : durations[voice] - elapsed;
+}
+
+/**
+ * @brief Read the note a voice moves to next, with tempo and key applied
+ * @return False after its last note, and for songs from a NoteSource
+ *
+ * For anything drawn before the note starts (see getTimeLeft()). Sources
+ * are not asked: a streamed note not yet sent would count as an underrun,
+ * and a card note not yet cached would be read out of turn.
+ */
+template <uint8_t VOICES>
+bool PolyBuzzer<VOICES>::peekNote(uint8_t voice, Note& out) {
+    int index = indices[voice] + 1;
+    uint8_t pitch;
+    if (source != NULL || !isVoicePlaying(voice) || index >= getLength(voice)) return false;
+    return readNote(voice, index, out, pitch);
+}
+
+/**
+ * @brief Get the current song position
+ * @return Written (score) milliseconds since the song started
+ */
+template <uint8_t VOICES>
+unsigned long PolyBuzzer<VOICES>::getSongPosition() {
+    // The clock stands still during a hold
+    unsigned long now = holding ? holdStart : clock();
+    unsigned long elapsed = now - songStartTime;
+    if (tempoPercent == 100) return elapsed;
+
+    // Wall-clock time back to written (score) time
+    return (unsigned long)(((unsigned long long)elapsed * tempoRate) >> 12);
+}
+
+/**
+ * @brief Set the playback tempo
+ * @param percent Speed relative to the written tempo (100 = as written)
+ *
+ * Takes effect from the next note. The song clock is rebased so the
+ * song position carries on from where it was.
+ */
+template <uint8_t VOICES>
+void PolyBuzzer<VOICES>::setTempo(int percent) {
+    percent = constrain(percent, TEMPO_MIN_PERCENT, TEMPO_MAX_PERCENT);
+    unsigned long position = getSongPosition();
+
+    tempoPercent = percent;
+    tempoScale = (409600UL + percent / 2) / percent;
+    tempoRate = ((unsigned long)percent * 4096UL + 50) / 100;
+
+    songStartTime = clock() - scaleDuration(position);
+}
+
+/**
+ * @brief Transpose playback by a number of semitones
+ * @param semitones Offset from the written key (-12 to +12)
+ *
+ * Takes effect from the next note.
+ */
+template <uint8_t VOICES>
+void PolyBuzzer<VOICES>::setTranspose(int semitones) {
+    transposeSemitones = constrain(semitones, -TRANSPOSE_MAX_SEMITONES, TRANSPOSE_MAX_SEMITONES);
+    pitchRatio = pgm_read_word(&PITCH_RATIOS[transposeSemitones + TRANSPOSE_MAX_SEMITONES]);
+}
+
+/**
+ * @brief Set how loud a voice plays
+ * @param volume 0 (muted) to PITCH_VOLUME_MAX (full, the default)
+ *
+ * A note that is sounding changes at once, with no gap.
+ */
+template <uint8_t VOICES>
+void PolyBuzzer<VOICES>::setVolume(uint8_t voice, uint8_t volume) {
+    volumes[voice] = min(volume, PITCH_VOLUME_MAX);
+    if (isVoicePlaying(voice) && !holding) sound(voice);
+}
+
+/**
+ * @brief Get the volume a voice's current note plays at
+ * @return The voice's volume moved by the note's accent, kept within
+ *         1 to PITCH_VOLUME_MAX; 0 if the voice is muted
+ */
+template <uint8_t VOICES>
+uint8_t PolyBuzzer<VOICES>::getNoteVolume(uint8_t voice) {
+    if (volumes[voice] == 0) return 0;
+    return constrain(volumes[voice] + accents[voice], 1, PITCH_VOLUME_MAX);
+}
+
+/**
+ * @brief Convert written (score) milliseconds to wall-clock milliseconds
+ */
+template <uint8_t VOICES>
+unsigned long PolyBuzzer<VOICES>::scaleDuration(unsigned long scoreMs) {
+    if (tempoPercent == 100) return scoreMs;
+    return (unsigned long)(((unsigned long long)scoreMs * tempoScale + 2048) >> 12);
+}
+
+/**
+ * @brief Check whether a voice has anywhere to get notes from
+ */
+template <uint8_t VOICES>
+bool PolyBuzzer<VOICES>::hasNotes(uint8_t voice) {
+    if (voice == generatedVoice) voice = 0;
+    return source != NULL || notes[voice] != NULL;
+}
+
+/**
+ * @brief Read a note as written, from PROGMEM, the source or the generator
+ * @return False if the source doesn't have the note yet
+ */
+template <uint8_t VOICES>
+bool PolyBuzzer<VOICES>::readWritten(uint8_t voice, int index, Note& out) {
+    if (voice == generatedVoice) {
+        Note melody;
+
+        // Out of order (a song started part-way): walk the melody up to it
+        if (!generator->follows(index)) {
+            for (int i = 0; i < index; i++) {
+                if (!readWritten(0, i, melody)) return false;
+                generator->harmonize(i, melody, out);
+            }
+        }
+        if (!readWritten(0, index, melody)) return false;
+        generator->harmonize(index, melody, out);
+        return true;
+    }
+
+    if (source != NULL) return source->readNote(voice, index, out);
+    memcpy_P(&out, &notes[voice][index], sizeof(Note));
+    return true;
+}
+
+/**
+ * @brief Read a note and apply tempo and key
+ * @param pitch Set to the MIDI note played, or 0 for a rest or a
+ *              frequency that isn't an equal-tempered note
+ * @return False if the source doesn't have the note yet
+ *
+ * Integer only. A note from pitches.h is found on the MIDI table and
+ * transposed by moving along it; any other frequency is scaled by the
+ * Q14 pitch ratio and played through tone().
+ */
+template <uint8_t VOICES>
+bool PolyBuzzer<VOICES>::readNote(uint8_t voice, int index, Note& out, uint8_t& pitch) {
+    if (!readWritten(voice, index, out)) return false;
+
+    pitch = midiNote(out.frequency);
+    if (pitch != 0 && midiFrequency(pitch) == out.frequency) {
+        pitch = constrain(pitch + transposeSemitones, 1, MIDI_NOTE_COUNT - 1);
+        out.frequency = midiFrequency(pitch);
+    } else {
+        pitch = 0;
+        out.frequency = transposeFrequency(out.frequency);
+    }
+    out.duration = scaleDuration(out.duration);
+    return true;
+}
+
+/**
+ * @brief Read a note's accent from the voice's table or the source
+ * @return Volume steps (0 when there are none)
+ */
+template <uint8_t VOICES>
+int8_t PolyBuzzer<VOICES>::readAccent(uint8_t voice, int index) {
+    if (voice == generatedVoice) voice = 0;
+    if (source != NULL) return source->readAccent(voice, index);
+    return accentTables[voice] != NULL ? (int8_t)pgm_read_byte(&accentTables[voice][index]) : 0;
+}
+
+/**
+ * @brief Convert a written frequency to the key being played (0 stays a rest)
+ */
+template <uint8_t VOICES>
+int PolyBuzzer<VOICES>::transposeFrequency(int frequency) {
+    if (transposeSemitones == 0 || frequency <= 0) return frequency;
+    return ((unsigned long)frequency * pitchRatio + 8192) >> 14;
+}
+
+/**
+ * @brief Make a note current on a voice and sound it
+ * @return False (and nothing changes) if the note isn't available
+ */
+template <uint8_t VOICES>
+bool PolyBuzzer<VOICES>::startNote(uint8_t voice, int index, unsigned long startTime) {
+    Note note;
+    uint8_t pitch;
+    if (!readNote(voice, index, note, pitch)) return false;
+
+    indices[voice] = index;
+    startTimes[voice] = startTime;
+    durations[voice] = note.duration;
+    frequencies[voice] = note.frequency;
+    pitches[voice] = pitch;
+    accents[voice] = readAccent(voice, index);
+    playingMask |= 1 << voice;
+    sound(voice);
+    return true;
+}
+
+/**
+ * @brief Drive a voice's buzzer with its current note: by pitch from the
+ *        timer table when it has one, else by frequency (0 = rest)
+ *
+ * Volume only reaches notes on the table; tone() plays the rest at full.
+ */
+template <uint8_t VOICES>
+void PolyBuzzer<VOICES>::sound(uint8_t voice) {
+    if (pins[voice] < 0) return;
+
+    uint8_t volume = getNoteVolume(voice);
+    if (pitches[voice] != 0 || volume == 0) {
+        pitchTone(pins[voice], pitches[voice], volume);
+    } else if (frequencies[voice] > 0) {
+        pitchToneHz(pins[voice], frequencies[voice]);
+    } else {
+        pitchNoTone(pins[voice]); // Rest note
+    }
+}
+
+#endif
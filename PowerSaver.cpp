@@ -0,0 +1,93 @@
+#include "PowerSaver.h"
+#if defined(__AVR__)
+#include <avr/sleep.h>
+#endif
+
+static const float MS_PER_HOUR = 3600000.0;
+
+/**
+ * @brief Constructor: nothing counted until begin()
+ */
+PowerSaver::PowerSaver() {
+  serial = NULL;
+  startedAt = 0;
+  resetStats();
+}
+
+/**
+ * @brief Start counting
+ * @param port Serial port whose input ends a sleep
+ */
+void PowerSaver::begin(Stream& port) {
+  serial = &port;
+  resetStats();
+}
+
+/**
+ * @brief Sleep until maxMs has passed or serial input arrives
+ * @param maxMs Longest time to sleep (0 = don't)
+ * @return True if a received byte ended the sleep
+ *
+ * Only call when nothing but a timer or a command can give the sketch
+ * work to do.
+ */
+bool PowerSaver::sleep(unsigned long maxMs) {
+#if defined(__AVR__)
+  if (serial == NULL || maxMs == 0 || serial->available() > 0) return false;
+
+  unsigned long start = millis();
+  unsigned long startUs = micros();
+  set_sleep_mode(SLEEP_MODE_IDLE);
+
+  bool woken = false;
+  while (millis() - start < maxMs) {
+    if (serial->available() > 0) {
+      woken = true;
+      break;
+    }
+    // A byte landing just after the check is seen at the next tick
+    sleep_mode();
+  }
+
+  unsigned long tookUs = micros() - startUs;
+  asleepMs += tookUs / 1000;
+  asleepUs += tookUs % 1000;
+  if (asleepUs >= 1000) {
+    asleepMs++;
+    asleepUs -= 1000;
+  }
+  sleeps++;
+  if (woken) serialWakes++;
+  return woken;
+#else
+  (void)maxMs;
+  return false;
+#endif
+}
+
+/**
+ * @brief Clear the counters and start the awake time from now
+ */
+void PowerSaver::resetStats() {
+  startedAt = millis();
+  asleepMs = 0;
+  asleepUs = 0;
+  sleeps = 0;
+  serialWakes = 0;
+}
+
+/**
+ * @brief Estimate the MCU's charge use since begin() or resetStats()
+ * @return Milliamp-hours
+ */
+float PowerSaver::getChargeMah() {
+  return (getAwakeMs() * MCU_ACTIVE_MA + asleepMs * MCU_IDLE_MA) / MS_PER_HOUR;
+}
+
+/**
+ * @brief Estimate how much charge sleeping has saved
+ * @return Milliamp-hours
+ */
+float PowerSaver::getSavedMah() {
+  return asleepMs * (MCU_ACTIVE_MA - MCU_IDLE_MA) / MS_PER_HOUR;
+}
@@ -0,0 +1,49 @@
+#ifndef POWER_SAVER_H
+#define POWER_SAVER_H
+#include <Arduino.h>
+
+// ATmega328P supply current at 16MHz and 5V (datasheet typicals), for the
+// charge estimate. The rest of the board (USB chip, regulator, LEDs) is
+// not counted: it draws the same asleep or awake.
+const float MCU_ACTIVE_MA = 10.0;
+const float MCU_IDLE_MA = 3.0;
+
+/**
+ * @class PowerSaver
+ * @brief Sleeps the MCU while nothing is due, and keeps count
+ *
+ * sleep() uses AVR idle sleep: the CPU stops but the clocks keep running,
+ * so millis() stays right and the UART still receives. The Timer0 tick
+ * wakes it every millisecond to check whether the time is up; a received
+ * byte wakes it at once. Deeper sleep modes would stop the UART clock and
+ * lose the first byte of a command, so they are not used.
+ *
+ * On other boards sleep() returns at once and nothing is counted.
+ */
+class PowerSaver {
+private:
+    Stream* serial;
+    unsigned long startedAt;        // millis() at begin()
+
+    // Time asleep, kept as ms plus leftover us so it never wraps in practice
+    unsigned long asleepMs;
+    unsigned long asleepUs;
+    unsigned long sleeps;
+    unsigned long serialWakes;      // Sleeps cut short by a received byte
+
+public:
+    PowerSaver();
+
+    void begin(Stream& port);
+    bool sleep(unsigned long maxMs);    // True if woken by serial input
+    void resetStats();
+
+    unsigned long getAsleepMs() { return asleepMs; }
+    unsigned long getAwakeMs() { return millis() - startedAt - asleepMs; }
+    unsigned long getSleeps() { return sleeps; }
+    unsigned long getSerialWakes() { return serialWakes; }
+    float getChargeMah();           // MCU charge used since begin() (estimate)
+    float getSavedMah();            // Less than staying awake all the time
+};
+
+#endif
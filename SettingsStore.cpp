@@ -0,0 +1,145 @@
+#include "SettingsStore.h"
+#include <stddef.h>
+
+static const uint16_t SEQUENCE_ERASED = 0xFFFF;
+
+/**
+ * @brief Constructor: nothing loaded, nothing pending
+ */
+SettingsStore::SettingsStore() {
+  pendingIndex = 0;
+  writing = false;
+  slot = SLOTS - 1; // First save goes to slot 0
+  sequence = 0;
+}
+
+/**
+ * @brief Read the newest valid record
+ * @param state Filled in if a record is found
+ * @return False if no slot holds a record for this SavedState version
+ *
+ * Sequence numbers are compared with wrap-around, so the store keeps
+ * working past 65535 saves.
+ */
+bool SettingsStore::load(SavedState& state) {
+  bool found = false;
+
+  for (uint8_t i = 0; i < SLOTS; i++) {
+    Record record;
+    EEPROM.get(slotAddress(i), record);
+
+    if (record.sequence == SEQUENCE_ERASED) continue;
+    if (record.crc != checksum(record)) continue;
+    if (found && (int16_t)(record.sequence - sequence) <= 0) continue;
+
+    found = true;
+    slot = i;
+    sequence = record.sequence;
+    state = record.state;
+  }
+  return found;
+}
+
+/**
+ * @brief Queue a record for writing
+ * @param state Settings and resume point to store
+ *
+ * A save made while the previous one is still being written restarts it
+ * in the same slot: that slot's record is already invalid, and the older
+ * records are left alone.
+ */
+void SettingsStore::save(const SavedState& state) {
+  if (!writing) {
+    slot = (slot + 1) % SLOTS;
+    sequence++;
+    if (sequence == SEQUENCE_ERASED) sequence = 0;
+  }
+
+  memset(&pending, 0, sizeof(pending)); // Padding too, so the CRC is repeatable
+  pending.sequence = sequence;
+  pending.state = state;
+  pending.crc = checksum(pending);
+  pendingIndex = 0;
+  writing = true;
+}
+
+/**
+ * @brief Mark every slot erased, so load() finds nothing
+ *
+ * Blocks for a few EEPROM writes per slot; meant for the "reset" command.
+ */
+void SettingsStore::erase() {
+  writing = false;
+  for (uint8_t i = 0; i < SLOTS; i++) {
+    EEPROM.put(slotAddress(i), SEQUENCE_ERASED);
+  }
+  slot = SLOTS - 1;
+  sequence = 0;
+}
+
+/**
+ * @brief Write the next byte of the pending record if the EEPROM is free
+ * @return True while a record is still being written
+ *
+ * Call once per loop pass. EEPROM.update() skips bytes that already
+ * match, which saves wear when little has changed since this slot was
+ * last used.
+ */
+bool SettingsStore::update() {
+  if (!writing) return false;
+
+#ifdef __AVR__
+  // The previous byte is still being programmed
+  if (!eeprom_is_ready()) return true;
+#endif
+
+  const uint8_t* bytes = (const uint8_t*)&pending;
+  EEPROM.update(slotAddress(slot) + pendingIndex, bytes[pendingIndex]);
+  pendingIndex++;
+
+  if (pendingIndex >= sizeof(Record)) {
+    writing = false;
+  }
+  return writing;
+}
+
+/**
+ * @brief Finish writing the pending record now
+ */
+void SettingsStore::flush() {
+  while (update()) {
+  }
+}
+
+/**
+ * @brief Check whether a record is still being written
+ */
+bool SettingsStore::isBusy() {
+  return writing;
+}
+
+/**
+ * @brief EEPROM address of a slot
+ */
+int SettingsStore::slotAddress(uint8_t index) {
+  return SETTINGS_EEPROM_BASE + index * sizeof(Record);
+}
+
+/**
+ * @brief CRC-16/CCITT over the sequence number and state
+ *
+ * Seeded with SAVED_STATE_VERSION so records from an older layout are
+ * rejected rather than misread.
+ */
+uint16_t SettingsStore::checksum(const Record& record) {
+  const uint8_t* bytes = (const uint8_t*)&record;
+  uint16_t crc = 0xFFFF ^ SAVED_STATE_VERSION;
+
+  for (uint8_t i = 0; i < offsetof(Record, crc); i++) {
+    crc ^= (uint16_t)bytes[i] << 8;
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+    }
+  }
+  return crc;
+}
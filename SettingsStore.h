@@ -0,0 +1,92 @@
+#ifndef SETTINGS_STORE_H
+#define SETTINGS_STORE_H
+#include <Arduino.h>
+#include <EEPROM.h>
+
+// Bump when SavedState changes layout; older records then fail their check
+const uint8_t SAVED_STATE_VERSION = 4;
+
+// Where the records live in EEPROM: from the base to the end, all of it
+// taken up by slots the writes rotate over (see SettingsStore)
+const int SETTINGS_EEPROM_BASE = 0;
+#ifdef E2END
+const int SETTINGS_EEPROM_END = E2END + 1;
+#else
+const int SETTINGS_EEPROM_END = 1024;
+#endif
+
+/**
+ * @struct SavedState
+ * @brief Settings and resume point kept across power cycles
+ */
+struct SavedState {
+    // Settings (written by the "save" command)
+    uint8_t autoPlay;
+    uint8_t ledsEnabled;
+    uint8_t ledPattern;
+    uint8_t visualizer;
+    uint8_t fastBoot;
+    int8_t transpose;
+    uint8_t harmony;        // HarmonyRule
+    uint16_t tempo;
+    uint16_t songGap;
+    uint8_t syncRole;       // SyncRole
+    uint8_t melodyVolume;
+    uint8_t harmonyVolume;
+
+    // Resume point (kept up to date during playback)
+    int8_t song;            // Last song played (-1 = none)
+    uint8_t resume;         // Song was playing when saved
+    uint32_t positionMs;    // Song position when saved
+};
+
+/**
+ * @class SettingsStore
+ * @brief Wear-levelled, checksummed SavedState records in EEPROM
+ *
+ * Each save goes to the next slot with a higher sequence number and a
+ * CRC-16, so a save cut short by power loss leaves the previous record
+ * in place. load() picks the newest record that passes its check. The
+ * slots fill the EEPROM (about 40 in an Uno's 1KB), so each cell takes
+ * one write in every 40 or so saves: at a save a minute, its 100,000
+ * write cycles last over 7 years of continuous playback.
+ *
+ * Writes are queued and update() starts at most one byte per call, and
+ * only when the EEPROM is ready, so saving during playback never stalls
+ * the loop for the ~3.3ms each AVR EEPROM byte takes.
+ */
+class SettingsStore {
+private:
+    struct Record {
+        uint16_t sequence;      // 0xFFFF = erased
+        SavedState state;
+        uint16_t crc;
+    };
+
+    // As many slots as fit between the base and the end (at most 255)
+    static const uint16_t SLOTS_FIT = (SETTINGS_EEPROM_END - SETTINGS_EEPROM_BASE) / sizeof(Record);
+    static const uint8_t SLOTS = SLOTS_FIT > 255 ? 255 : SLOTS_FIT;
+
+    Record pending;             // Record being written
+    uint8_t pendingIndex;       // Next byte of pending to write
+    bool writing;
+    uint8_t slot;               // Slot pending goes to / the newest record
+    uint16_t sequence;          // Sequence number of the newest record
+
+public:
+    SettingsStore();
+
+    bool load(SavedState& state);       // Newest valid record; false if none
+    void save(const SavedState& state); // Queue a write to the next slot
+    void erase();                       // Forget every record (blocking)
+
+    bool update();                      // Write at most one byte; true while busy
+    void flush();                       // Finish the pending write (blocking)
+    bool isBusy();
+
+private:
+    int slotAddress(uint8_t index);
+    static uint16_t checksum(const Record& record);
+};
+
+#endif
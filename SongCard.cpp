@@ -0,0 +1,245 @@
+#include "SongCard.h"
+
+static const char INDEX_FILE[] = "SONGS.IDX";
+
+/**
+ * @brief Constructor: no card, no song
+ */
+SongCard::SongCard() {
+  present = false;
+  songCount = 0;
+  loadedSong = -1;
+  memset(&header, 0, sizeof(header));
+  blockReads = 0;
+  lateReads = 0;
+  invalidate();
+}
+
+/**
+ * @brief Mount the card and check its index
+ * @param chipSelect SPI chip-select pin of the card reader
+ * @return False if there is no card or no SONGS.IDX on it
+ */
+bool SongCard::begin(uint8_t chipSelect) {
+  present = false;
+  songCount = 0;
+  if (!SD.begin(chipSelect)) return false;
+
+  File index = SD.open(INDEX_FILE);
+  if (!index) return false;
+
+  CardIndexHeader indexHeader;
+  bool valid = index.read((uint8_t*)&indexHeader, sizeof(indexHeader)) == sizeof(indexHeader) &&
+               memcmp(indexHeader.magic, "SIDX", 4) == 0;
+  index.close();
+  if (!valid) return false;
+
+  songCount = indexHeader.count;
+  present = true;
+  return true;
+}
+
+/**
+ * @brief Read one song's entry from the index
+ * @return False if there is no such song
+ */
+bool SongCard::readEntry(int song, CardIndexEntry& entry) {
+  if (!present || song < 0 || song >= songCount) return false;
+
+  File index = SD.open(INDEX_FILE);
+  if (!index) return false;
+  bool found = index.seek(sizeof(CardIndexHeader) + (uint32_t)song * sizeof(CardIndexEntry)) &&
+               index.read((uint8_t*)&entry, sizeof(entry)) == sizeof(entry);
+  index.close();
+
+  entry.title[sizeof(entry.title) - 1] = '\0';
+  return found;
+}
+
+/**
+ * @brief Make a song current
+ * @return False if its file is missing or damaged
+ *
+ * Reads the header and the first block of each part, so the song starts
+ * without waiting on the card.
+ */
+bool SongCard::open(int song) {
+  if (file) file.close();
+  loadedSong = -1;
+  invalidate();
+  if (!present || song < 0 || song >= songCount) return false;
+
+  char name[13];
+  snprintf(name, sizeof(name), "S%03d.SNG", song);
+  file = SD.open(name);
+  if (!file) return false;
+
+  if (file.read((uint8_t*)&header, sizeof(header)) != sizeof(header) ||
+      memcmp(header.magic, "SNG1", 4) != 0) {
+    file.close();
+    return false;
+  }
+
+  // Lyric records start on a 16-byte boundary, so none straddles a block
+  sections[0] = sizeof(CardSongHeader);
+  sections[1] = sections[0] + header.noteCounts[0] * sizeof(PackedNote);
+  sections[2] = (sections[1] + header.noteCounts[1] * sizeof(PackedNote) + 15) & ~15UL;
+  loadedSong = song;
+
+  for (uint8_t s = 0; s < 3; s++) {
+    fetch(sections[s], false);
+  }
+  return true;
+}
+
+/**
+ * @brief Length and pitch range of the current song
+ */
+SongInfo SongCard::getSongInfo() {
+  SongInfo info;
+  info.durationMs = header.durationMs;
+  info.lowestPitch = header.lowestPitch;
+  info.highestPitch = header.highestPitch;
+  return info;
+}
+
+/**
+ * @brief Unpack one note of the current song
+ * @return False if the card could not be read
+ */
+bool SongCard::readNote(uint8_t voice, int index, Note& out) {
+  if (loadedSong < 0 || voice > 1 || index < 0 || index >= header.noteCounts[voice]) return false;
+
+  uint32_t offset = sections[voice] + (uint32_t)index * sizeof(PackedNote);
+  const uint8_t* block = fetch(offset, true);
+  if (block == NULL) {
+    loadedSong = -1;    // Card gone: every voice ends (see getLength())
+    return false;
+  }
+
+  const uint8_t* bytes = block + offset % CARD_BLOCK_SIZE;
+  PackedNote packed = bytes[0] | (bytes[1] << 8);
+  out.frequency = midiFrequency(packed >> 9);
+  out.duration = (packed & PACKED_MAX_TICKS) * PACKED_TICK_MS;
+
+  nextNotes[voice] = index + 1;
+  return true;
+}
+
+/**
+ * @brief Notes in one part of the current song
+ */
+int SongCard::getLength(uint8_t voice) {
+  if (loadedSong < 0 || voice > 1) return 0;
+  return header.noteCounts[voice];
+}
+
+/**
+ * @brief Read ahead while no note is due
+ * @param slackMs Time until the next note starts on any voice
+ *
+ * Loads at most one block: first the block each voice's next note is
+ * in, then the block after it, then the next lyrics.
+ */
+void SongCard::prefetch(unsigned long slackMs) {
+  if (loadedSong < 0 || slackMs < CARD_READ_MARGIN_MS) return;
+
+  for (uint8_t ahead = 0; ahead < 2; ahead++) {
+    for (uint8_t v = 0; v < 2; v++) {
+      uint32_t offset = sections[v] + (uint32_t)nextNotes[v] * sizeof(PackedNote) + ahead * CARD_BLOCK_SIZE;
+      if (offset >= sections[v] + header.noteCounts[v] * sizeof(PackedNote)) continue;
+      if (!isCached(offset)) {
+        fetch(offset, false);
+        return;
+      }
+    }
+  }
+
+  if (nextLyric < header.lyricCount) {
+    uint32_t offset = sections[2] + (uint32_t)nextLyric * sizeof(CardLyric);
+    if (!isCached(offset)) fetch(offset, false);
+  }
+}
+
+int SongCard::getLyricCount() {
+  return loadedSong >= 0 ? header.lyricCount : 0;
+}
+
+/**
+ * @brief Look up a lyric of the current song
+ *
+ * The word points into the cache, so it is only good until the next read.
+ */
+void SongCard::readLyric(int index, LyricTiming& out) {
+  out.word = "";
+  out.timeMs = 0;
+  if (loadedSong < 0 || index < 0 || index >= header.lyricCount) return;
+
+  uint32_t offset = sections[2] + (uint32_t)index * sizeof(CardLyric);
+  const uint8_t* block = fetch(offset, false);
+  if (block == NULL) return;
+
+  const CardLyric* lyric = (const CardLyric*)(block + offset % CARD_BLOCK_SIZE);
+  out.word = lyric->word;
+  out.timeMs = lyric->timeMs;
+  if (index + 1 > nextLyric) nextLyric = index + 1;
+}
+
+/**
+ * @brief Get the cached block holding a file offset, reading it if needed
+ * @param late True when a note is waiting on this read
+ * @return The block's first byte, or NULL if the card could not be read
+ */
+const uint8_t* SongCard::fetch(uint32_t offset, bool late) {
+  uint32_t start = offset - offset % CARD_BLOCK_SIZE;
+  useClock++;
+
+  // Hit, or else the least recently used block
+  uint8_t victim = 0;
+  uint8_t oldest = 0;
+  for (uint8_t i = 0; i < CARD_CACHE_BLOCKS; i++) {
+    Block& block = cache[i];
+    if (block.valid && block.offset == start) {
+      block.lastUse = useClock;
+      return block.data;
+    }
+    uint8_t age = block.valid ? (uint8_t)(useClock - block.lastUse) : 255;
+    if (age >= oldest) {
+      oldest = age;
+      victim = i;
+    }
+  }
+
+  Block& block = cache[victim];
+  block.valid = false;
+  if (!file.seek(start) || file.read(block.data, CARD_BLOCK_SIZE) <= 0) return NULL;
+
+  block.offset = start;
+  block.lastUse = useClock;
+  block.valid = true;
+  blockReads++;
+  if (late) lateReads++;
+  return block.data;
+}
+
+bool SongCard::isCached(uint32_t offset) {
+  uint32_t start = offset - offset % CARD_BLOCK_SIZE;
+  for (uint8_t i = 0; i < CARD_CACHE_BLOCKS; i++) {
+    if (cache[i].valid && cache[i].offset == start) return true;
+  }
+  return false;
+}
+
+/**
+ * @brief Forget every cached block (new song)
+ */
+void SongCard::invalidate() {
+  for (uint8_t i = 0; i < CARD_CACHE_BLOCKS; i++) {
+    cache[i].valid = false;
+    cache[i].lastUse = 0;
+  }
+  useClock = 0;
+  nextNotes[0] = 0;
+  nextNotes[1] = 0;
+  nextLyric = 0;
+}
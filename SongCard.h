@@ -0,0 +1,130 @@
+#ifndef SONG_CARD_H
+#define SONG_CARD_H
+#include <Arduino.h>
+#include <SD.h>
+#include "DualBuzzer.h"
+
+/**
+ * Card layout. Every number is little-endian and every field sits on
+ * its natural alignment, so the structs read the same on AVR, ARM and
+ * the PC that packs the card (see host/packsongs.cpp).
+ *
+ *   SONGS.IDX     CardIndexHeader, then one CardIndexEntry per song
+ *   S000.SNG ...  one file per song, numbered as in the index:
+ *                 CardSongHeader, melody, harmony, then CardLyric records
+ *
+ * Notes are packed into 16 bits: the MIDI note number in the top seven
+ * (0 = rest) and the length in 10ms ticks in the bottom nine. Longer
+ * notes are split into tied notes when the card is packed.
+ */
+typedef uint16_t PackedNote;
+const unsigned int PACKED_TICK_MS = 10;
+const unsigned int PACKED_MAX_TICKS = 511;
+
+struct CardIndexHeader {
+    char magic[4];              // "SIDX"
+    uint16_t count;
+    uint16_t reserved;
+};
+
+struct CardIndexEntry {
+    char title[28];             // Terminated
+    uint32_t durationMs;
+};
+
+struct CardSongHeader {
+    char magic[4];              // "SNG1"
+    uint16_t noteCounts[2];     // Melody, harmony
+    uint16_t lyricCount;
+    uint16_t reserved;
+    uint32_t durationMs;
+    int16_t lowestPitch;        // Hz
+    int16_t highestPitch;
+    uint8_t unused[12];
+};
+
+struct CardLyric {
+    uint32_t timeMs;
+    char word[12];              // Terminated
+};
+
+// Cache geometry: two blocks per voice and four for the words on screen
+const uint8_t CARD_BLOCK_SIZE = 32;
+const uint8_t CARD_CACHE_BLOCKS = 8;
+
+// Only read ahead when no note is due for at least this long
+const unsigned long CARD_READ_MARGIN_MS = 20;
+
+/**
+ * @class SongCard
+ * @brief Song library on an SD card, played through a small block cache
+ *
+ * A song is never loaded whole: PolyBuzzer asks for each note as it
+ * starts it (NoteSource) and DualBuzzer for the words it shows
+ * (LyricSource). Both read out of CARD_CACHE_BLOCKS blocks of
+ * CARD_BLOCK_SIZE bytes.
+ *
+ * A card read takes a few milliseconds, too long to do between one
+ * note ending and the next starting. So after each pass PolyBuzzer
+ * reports how long it is until the next note is due, and when that is
+ * at least CARD_READ_MARGIN_MS, prefetch() loads the next block a voice
+ * will need, one block per pass. Reads that still have to happen as a
+ * note starts are counted as late (see getLateReads()).
+ */
+class SongCard : public NoteSource, public LyricSource {
+private:
+    struct Block {
+        uint8_t data[CARD_BLOCK_SIZE];  // First, so CardLyric fields are aligned
+        uint32_t offset;        // File offset of the first byte
+        uint8_t lastUse;        // For least recently used replacement
+        bool valid;
+    };
+
+    bool present;
+    uint16_t songCount;
+
+    File file;                  // Current song
+    CardSongHeader header;
+    int loadedSong;             // -1 = none
+    uint32_t sections[3];       // File offsets of melody, harmony and lyrics
+
+    Block cache[CARD_CACHE_BLOCKS];
+    uint8_t useClock;
+    int nextNotes[2];           // Next note each voice will ask for
+    int nextLyric;
+
+    // Counters
+    unsigned long blockReads;
+    unsigned long lateReads;
+
+public:
+    SongCard();
+
+    bool begin(uint8_t chipSelect);     // Mount the card and read the index header
+    bool isPresent() { return present; }
+    int getSongCount() { return songCount; }
+    bool readEntry(int song, CardIndexEntry& entry);
+
+    bool open(int song);                // Make a song current (header only)
+    SongInfo getSongInfo();
+
+    // NoteSource
+    bool readNote(uint8_t voice, int index, Note& out);
+    int getLength(uint8_t voice);
+    void prefetch(unsigned long slackMs);
+
+    // LyricSource
+    int getLyricCount();
+    void readLyric(int index, LyricTiming& out);
+    void releaseLyrics(int /*before*/) {}
+
+    unsigned long getBlockReads() { return blockReads; }
+    unsigned long getLateReads() { return lateReads; }
+
+private:
+    const uint8_t* fetch(uint32_t offset, bool late);
+    bool isCached(uint32_t offset);
+    void invalidate();
+};
+
+#endif
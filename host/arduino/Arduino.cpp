@@ -0,0 +1,62 @@
+#include "Arduino.h"
+#include "Wire.h"
+#include "EEPROM.h"
+
+unsigned long millis() { return HostBoard::current().nowUs / 1000; }
+unsigned long micros() { return HostBoard::current().nowUs; }
+void delay(unsigned long ms) { HostBoard::current().advance(ms * 1000); }
+void delayMicroseconds(unsigned int us) { HostBoard::current().advance(us); }
+
+void tone(uint8_t pin, unsigned int freq, unsigned long) { HostBoard::current().onTone(pin, freq); }
+void noTone(uint8_t pin) { HostBoard::current().onNoTone(pin); }
+
+void pinMode(uint8_t, uint8_t) {}
+void digitalWrite(uint8_t pin, uint8_t val) { HostBoard::current().onPinWrite(pin, val); }
+void analogWrite(uint8_t pin, int val) { HostBoard::current().onPinWrite(pin, val); }
+int analogRead(uint8_t) { return 0; }
+
+// xorshift32, per board
+static uint32_t nextRandom() {
+  uint32_t& x = HostBoard::current().randomState;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return x;
+}
+long random(long hi) { return hi > 0 ? nextRandom() % hi : 0; }
+long random(long lo, long hi) { return hi > lo ? lo + (long)(nextRandom() % (hi - lo)) : lo; }
+void randomSeed(unsigned long s) { HostBoard::current().randomState = s ? s : 1; }
+
+// Each block carries its size in front, so the live total can be kept
+void* hostRealloc(void* block, size_t size) {
+  HostBoard& board = HostBoard::current();
+  size_t* header = block ? (size_t*)block - 1 : NULL;
+  size_t oldSize = header ? *header : 0;
+
+  header = (size_t*)realloc(header, size + sizeof(size_t));
+  if (header == NULL) return NULL;
+  *header = size;
+
+  board.heapAllocations++;
+  board.heapBytes += (long)size - (long)oldSize;
+  board.heapPeakBytes = std::max(board.heapPeakBytes, board.heapBytes);
+  return header + 1;
+}
+
+void hostFree(void* block) {
+  if (block == NULL) return;
+  HostBoard& board = HostBoard::current();
+  size_t* header = (size_t*)block - 1;
+  board.heapFrees++;
+  board.heapBytes -= *header;
+  free(header);
+}
+
+HardwareSerial Serial;
+size_t HardwareSerial::write(uint8_t c) { HostBoard::current().onSerialWrite(c); return 1; }
+int HardwareSerial::available() { return HostBoard::current().onSerialAvailable(); }
+int HardwareSerial::read() { return HostBoard::current().onSerialRead(); }
+int HardwareSerial::peek() { return HostBoard::current().onSerialPeek(); }
+
+TwoWire Wire;
+EEPROMClass EEPROM;
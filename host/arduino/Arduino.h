@@ -0,0 +1,130 @@
+/**
+ * @file Arduino.h
+ * @brief Host stand-in for the parts of the Arduino core the sketch uses
+ *
+ * PROGMEM is ordinary memory here, so the _P functions and pgm_read_*
+ * are plain reads. Time, tones, pins and Serial go to the calling
+ * thread's HostBoard.
+ */
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+#include <algorithm>
+#include <cstdio>
+#include "HostBoard.h"
+
+typedef uint8_t byte;
+typedef bool boolean;
+#define PROGMEM
+#define OUTPUT 1
+#define INPUT 0
+#define HIGH 1
+#define LOW 0
+#define F_CPU 16000000UL
+#define memcpy_P memcpy
+#define strcpy_P strcpy
+#define strlen_P strlen
+#define strncpy_P strncpy
+#define pgm_read_ptr(p) (*(void* const*)(p))
+#define pgm_read_word(p) (*(const uint16_t*)(p))
+#define pgm_read_dword(p) (*(const uint32_t*)(p))
+#define pgm_read_byte(p) (*(const uint8_t*)(p))
+#define PSTR(s) (s)
+#define F(s) (s)
+#define DEC 10
+#define HEX 16
+
+// Analog input pins, numbered as on an Uno
+const uint8_t A0 = 14, A1 = 15, A2 = 16, A3 = 17, A4 = 18, A5 = 19;
+
+using std::min;
+using std::max;
+template <class T, class A, class B> T constrain(T x, A a, B b) { return x < a ? a : (x > b ? b : x); }
+inline long map(long x, long a, long b, long c, long d) { return (x - a) * (d - c) / (b - a) + c; }
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void tone(uint8_t pin, unsigned int freq, unsigned long duration = 0);
+void noTone(uint8_t pin);
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+void analogWrite(uint8_t pin, int val);
+int analogRead(uint8_t pin);
+long random(long hi);
+long random(long lo, long hi);
+void randomSeed(unsigned long s);
+
+// Heap used by the sketch (String), counted on the current HostBoard
+void* hostRealloc(void* block, size_t size);
+void hostFree(void* block);
+
+#include "WString.h"
+
+class Print {
+public:
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* b, size_t n) { for (size_t i = 0; i < n; i++) write(b[i]); return n; }
+  size_t write(const char* s) { return write((const uint8_t*)s, strlen(s)); }
+  size_t print(const String& v) { return write((const uint8_t*)v.c_str(), v.length()); }
+  size_t print(const char* v) { return write(v); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int v, int base = DEC) { return print((long)v, base); }
+  size_t print(unsigned int v, int base = DEC) { return print((unsigned long)v, base); }
+  size_t print(long v, int base = DEC) { char b[34]; snprintf(b, sizeof b, base == HEX ? "%lx" : "%ld", v); return write(b); }
+  size_t print(unsigned long v, int base = DEC) { char b[34]; snprintf(b, sizeof b, base == HEX ? "%lx" : "%lu", v); return write(b); }
+  size_t print(double v, int d = 2) { char b[40]; snprintf(b, sizeof b, "%.*f", d, v); return write(b); }
+  size_t println() { return write("\r\n"); }
+  template <class T> size_t println(const T& v) { size_t n = print(v); return n + println(); }
+  template <class T> size_t println(const T& v, int f) { size_t n = print(v, f); return n + println(); }
+  virtual ~Print() {}
+};
+
+class Stream : public Print {
+public:
+  Stream() : timeoutMs(1000) {}
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+  void setTimeout(unsigned long ms) { timeoutMs = ms; }
+
+  // As on the board, a missing terminator stalls the caller for the timeout
+  String readStringUntil(char t) {
+    String r;
+    int c;
+    while ((c = timedRead()) >= 0 && c != t) r += (char)c;
+    return r;
+  }
+
+protected:
+  unsigned long timeoutMs;
+
+  int timedRead() {
+    unsigned long start = millis();
+    do {
+      int c = read();
+      if (c >= 0) return c;
+      HostBoard::current().onSerialWait();
+    } while (millis() - start < timeoutMs);
+    return -1;
+  }
+};
+
+class HardwareSerial : public Stream {
+public:
+  void begin(unsigned long) {}
+  size_t write(uint8_t c) override;
+  int available() override;
+  int read() override;
+  int peek() override;
+  void flush() {}
+  operator bool() { return true; }
+};
+extern HardwareSerial Serial;
+
+#endif
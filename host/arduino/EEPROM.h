@@ -0,0 +1,33 @@
+#ifndef HOST_EEPROM_H
+#define HOST_EEPROM_H
+#include "Arduino.h"
+
+/**
+ * @class EEPROMClass
+ * @brief 1KB of host EEPROM, erased to 0xFF, with a write count per cell
+ */
+class EEPROMClass {
+public:
+  uint8_t cells[1024];
+  uint32_t writes[1024];    // Wear per cell
+
+  EEPROMClass() { memset(cells, 0xFF, sizeof(cells)); memset(writes, 0, sizeof(writes)); }
+
+  uint8_t read(int address) { return cells[address]; }
+  void write(int address, uint8_t value) { cells[address] = value; writes[address]++; }
+  void update(int address, uint8_t value) { if (cells[address] != value) write(address, value); }
+  uint16_t length() { return sizeof(cells); }
+
+  template <class T> T& get(int address, T& value) {
+    memcpy(&value, cells + address, sizeof(T));
+    return value;
+  }
+  template <class T> const T& put(int address, const T& value) {
+    const uint8_t* bytes = (const uint8_t*)&value;
+    for (size_t i = 0; i < sizeof(T); i++) update(address + i, bytes[i]);
+    return value;
+  }
+};
+extern EEPROMClass EEPROM;
+
+#endif
@@ -0,0 +1,214 @@
+#include "HostBoard.h"
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <termios.h>
+
+// Board used by threads that never select one
+static thread_local HostBoard* currentBoard = NULL;
+
+/**
+ * @brief Constructor: clock at zero, blank display
+ */
+HostBoard::HostBoard() {
+  nowUs = 0;
+  i2cByteUs = 0;
+  sdRoot = NULL;
+  sdSectorUs = 0;
+  setBaud(9600);
+  serialRxDropped = 0;
+  serialWireFreeUs = 0;
+  serialTxFreeUs = 0;
+  memset(lcd, ' ', sizeof(lcd));
+  for (int r = 0; r < 4; r++) lcd[r][40] = '\0';
+  memset(cgram, 0, sizeof(cgram));
+  randomState = 1;
+
+  i2cBytes = 0;
+  sdSectorReads = 0;
+  heapAllocations = 0;
+  heapFrees = 0;
+  heapBytes = 0;
+  heapPeakBytes = 0;
+
+  lcdNibble = 0;
+  lcdHaveNibble = false;
+  lcdEnable = false;
+  lcdAddress = 0;
+  lcdInCgram = false;
+}
+
+HostBoard::~HostBoard() {
+  if (currentBoard == this) currentBoard = NULL;
+}
+
+void HostBoard::makeCurrent() {
+  currentBoard = this;
+}
+
+HostBoard& HostBoard::current() {
+  static thread_local HostBoard fallback;
+  return currentBoard != NULL ? *currentBoard : fallback;
+}
+
+void HostBoard::advance(unsigned long us) {
+  nowUs += us;
+}
+
+void HostBoard::setBaud(unsigned long baud) {
+  serialByteUs = 10000000UL / baud;   // Start, eight data and stop bits
+}
+
+/**
+ * @brief Put text on the wire into the board, a byte time per byte
+ * @param atUs When the host starts sending, if the wire is free by then
+ */
+void HostBoard::sendSerial(const std::string& text, unsigned long atUs) {
+  unsigned long byteAt = std::max(atUs, serialWireFreeUs);
+  for (size_t i = 0; i < text.size(); i++) {
+    byteAt += serialByteUs;
+    serialWire.push_back(std::make_pair(byteAt, (uint8_t)text[i]));
+  }
+  serialWireFreeUs = byteAt;
+}
+
+/**
+ * @brief Put one byte on the wire whose arrival the sender has worked out
+ */
+void HostBoard::receiveSerial(uint8_t c, unsigned long atUs) {
+  serialWire.push_back(std::make_pair(atUs, c));
+  serialWireFreeUs = std::max(serialWireFreeUs, atUs);
+}
+
+void HostBoard::deliverSerial() {
+  while (!serialWire.empty() && serialWire.front().first <= nowUs) {
+    if (serialRx.size() < SERIAL_BUFFER_SIZE) serialRx.push_back(serialWire.front().second);
+    else serialRxDropped++;
+    serialWire.pop_front();
+  }
+}
+
+/**
+ * @brief Queue a byte the sketch writes, holding it while the buffer is full
+ * @return When the byte will have left the board
+ */
+unsigned long HostBoard::transmitSerial() {
+  unsigned long bufferedUs = SERIAL_BUFFER_SIZE * serialByteUs;
+  if (serialTxFreeUs > nowUs + bufferedUs) nowUs = serialTxFreeUs - bufferedUs;
+  serialTxFreeUs = std::max(serialTxFreeUs, nowUs) + serialByteUs;
+  return serialTxFreeUs;
+}
+
+void HostBoard::onTone(uint8_t, unsigned int) {}
+void HostBoard::onNoTone(uint8_t) {}
+void HostBoard::onPinWrite(uint8_t, int) {}
+
+void HostBoard::onSerialWrite(uint8_t c) {
+  putchar(c);
+}
+
+void HostBoard::onLCDWrite(bool, uint8_t, uint8_t) {}
+
+int HostBoard::onSerialRead() {
+  deliverSerial();
+  if (serialRx.empty()) return -1;
+  int c = serialRx.front();
+  serialRx.pop_front();
+  return c;
+}
+
+int HostBoard::onSerialPeek() {
+  deliverSerial();
+  return serialRx.empty() ? -1 : serialRx.front();
+}
+
+int HostBoard::onSerialAvailable() {
+  deliverSerial();
+  return serialRx.size();
+}
+
+void HostBoard::onSerialWait() {
+  nowUs += serialByteUs;
+  deliverSerial();
+}
+
+/**
+ * @brief Decode one PCF8574 byte from a LiquidCrystal_I2C style backpack
+ *
+ * Bit 2 is EN and bit 0 is RS; the HD44780 latches the high nibble on
+ * the falling edge of EN, two nibbles per byte.
+ */
+void HostBoard::onI2CWrite(uint8_t value) {
+  nowUs += i2cByteUs;
+  i2cBytes++;
+
+  bool enable = value & 0x04;
+  if (lcdEnable && !enable) {
+    if (!lcdHaveNibble) {
+      lcdNibble = value & 0xF0;
+      lcdHaveNibble = true;
+    } else {
+      uint8_t data = lcdNibble | (value >> 4);
+      lcdHaveNibble = false;
+
+      if (value & 0x01) {
+        onLCDWrite(lcdInCgram, lcdAddress, data);
+        if (lcdInCgram) {
+          cgram[lcdAddress & 63] = data;
+        } else {
+          // DDRAM rows start at 0x00, 0x40, 0x14, 0x54
+          int row = lcdAddress >= 0x54 ? 3 : lcdAddress >= 0x40 ? 1 : lcdAddress >= 0x14 ? 2 : 0;
+          static const uint8_t rowStart[4] = { 0x00, 0x40, 0x14, 0x54 };
+          int col = lcdAddress - rowStart[row];
+          if (col < 40) lcd[row][col] = data;
+        }
+        lcdAddress++;
+      } else if (data & 0x80) {
+        lcdAddress = data & 0x7F;
+        lcdInCgram = false;
+      } else if (data & 0x40) {
+        lcdAddress = data & 0x3F;
+        lcdInCgram = true;
+      } else if (data == 0x01) {
+        memset(lcd, ' ', sizeof(lcd));
+        for (int r = 0; r < 4; r++) lcd[r][40] = '\0';
+        lcdAddress = 0;
+        lcdInCgram = false;
+      }
+    }
+  }
+  lcdEnable = enable;
+}
+
+static speed_t baudConstant(unsigned long baud) {
+  switch (baud) {
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    default: return 0;
+  }
+}
+
+int openBoardPort(const char* device, unsigned long baud) {
+  speed_t speed = baudConstant(baud);
+  int port = speed != 0 ? open(device, O_RDWR | O_NOCTTY | O_NONBLOCK) : -1;
+  if (port < 0) {
+    fprintf(stderr, "cannot open %s at %lu baud\n", device, baud);
+    return -1;
+  }
+
+  struct termios settings;
+  tcgetattr(port, &settings);
+  cfmakeraw(&settings);
+  cfsetispeed(&settings, speed);
+  cfsetospeed(&settings, speed);
+  tcsetattr(port, TCSANOW, &settings);
+
+  sleep(6);
+  tcflush(port, TCIOFLUSH);
+  return port;
+}
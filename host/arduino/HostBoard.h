@@ -0,0 +1,113 @@
+#ifndef HOST_BOARD_H
+#define HOST_BOARD_H
+#include <stdint.h>
+#include <stddef.h>
+#include <deque>
+#include <string>
+#include <utility>
+
+/**
+ * @class HostBoard
+ * @brief Virtual board behind the host Arduino shim
+ *
+ * Holds the clock that millis()/micros() read and receives everything
+ * the sketch sends to the outside world: tones, pin writes, serial bytes
+ * and the PCF8574 writes of the LCD backpack, which it decodes into a
+ * copy of the HD44780 display memory. It also says which directory, if
+ * any, plays the part of the SD card.
+ *
+ * Serial is modelled as on an Uno: bytes put on the wire with
+ * sendSerial() land at the baud rate in a 64-byte receive buffer, which
+ * loses whatever finds it full, and transmitSerial() holds the sketch
+ * while its 64-byte transmit buffer is full.
+ *
+ * Each thread has its own current board, so several songs can run side
+ * by side with no shared state. Tools subclass it to record what they
+ * need and select it with makeCurrent().
+ */
+class HostBoard {
+public:
+    unsigned long nowUs;        // Virtual clock
+    unsigned long i2cByteUs;    // Clock cost of one expander byte (0 = free)
+
+    // SD card: a directory standing in for the card (NULL = no card fitted)
+    const char* sdRoot;
+    unsigned long sdSectorUs;   // Clock cost of reading one 512-byte sector
+
+    // Serial line
+    unsigned long serialByteUs;         // Time one byte takes on the wire (see setBaud())
+    unsigned long serialRxDropped;      // Bytes that found the receive buffer full
+
+    // HD44780 display and glyph memory, as decoded from I2C writes
+    char lcd[4][41];
+    uint8_t cgram[64];
+
+    HostBoard();
+    virtual ~HostBoard();
+
+    void makeCurrent();                 // Route this thread's Arduino calls here
+    static HostBoard& current();
+
+    void advance(unsigned long us);     // Move the clock forward
+
+    // Serial wire into the board
+    void setBaud(unsigned long baud);
+    void sendSerial(const std::string& text, unsigned long atUs);  // After whatever is already on the wire
+    void receiveSerial(uint8_t c, unsigned long atUs);              // One byte, arriving at atUs
+    void deliverSerial();               // Move bytes that have arrived into the receive buffer
+    bool serialWireBusy() { return serialWireFreeUs > nowUs; }
+    bool serialIdle() { return serialWire.empty() && serialRx.empty(); }
+
+    // Serial out of the board: when the byte the sketch writes now will have left
+    unsigned long transmitSerial();
+
+    // Hooks, called from the shim
+    virtual void onTone(uint8_t pin, unsigned int frequency);
+    virtual void onNoTone(uint8_t pin);
+    virtual void onPinWrite(uint8_t pin, int value);
+    virtual void onSerialWrite(uint8_t c);
+    virtual int onSerialRead();         // From the receive buffer; -1 when nothing is waiting
+    virtual int onSerialPeek();
+    virtual int onSerialAvailable();
+    virtual void onSerialWait();        // Serial read found nothing; one byte time passes
+    virtual void onLCDWrite(bool glyph, uint8_t address, uint8_t value); // Decoded data write
+    void onI2CWrite(uint8_t value);
+
+    // Per-board random() state, so runs are repeatable in any thread
+    uint32_t randomState;
+
+    // Counters
+    unsigned long i2cBytes;
+    unsigned long sdSectorReads;
+    unsigned long heapAllocations;      // malloc/realloc calls
+    unsigned long heapFrees;
+    long heapBytes;                     // Live
+    long heapPeakBytes;
+
+private:
+    static const size_t SERIAL_BUFFER_SIZE = 64;    // AVR HardwareSerial RX and TX rings
+
+    // Serial state
+    std::deque<std::pair<unsigned long, uint8_t> > serialWire;  // Bytes in flight and when they land
+    std::deque<uint8_t> serialRx;
+    unsigned long serialWireFreeUs;
+    unsigned long serialTxFreeUs;       // When the last byte written will have left
+
+    // LCD decoder state
+    uint8_t lcdNibble;
+    bool lcdHaveNibble;
+    bool lcdEnable;
+    uint8_t lcdAddress;
+    bool lcdInCgram;
+};
+
+/**
+ * @brief Open a real board's serial port raw at a baud rate
+ * @return File descriptor, or -1 (with a message) if it can't be opened
+ *
+ * Opening the port resets the board, so this waits out the bootloader
+ * and startup and throws away whatever the board printed meanwhile.
+ */
+int openBoardPort(const char* device, unsigned long baud);
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef HOST_LIQUID_CRYSTAL_I2C_H
+#define HOST_LIQUID_CRYSTAL_I2C_H
+#include "Arduino.h"
+
+/**
+ * @class LiquidCrystal_I2C
+ * @brief Host stand-in: power-up is instant and direct prints are dropped
+ *
+ * The sketch draws through AsyncLCD, whose I2C writes HostBoard decodes.
+ */
+class LiquidCrystal_I2C : public Print {
+public:
+  LiquidCrystal_I2C(uint8_t, uint8_t, uint8_t) {}
+  void init() {}
+  void begin(uint8_t, uint8_t) {}
+  void backlight() {}
+  void noBacklight() {}
+  void clear() {}
+  void home() {}
+  void setCursor(uint8_t, uint8_t) {}
+  void createChar(uint8_t, uint8_t*) {}
+  size_t write(uint8_t) override { return 1; }
+  using Print::write;
+};
+
+#endif
@@ -0,0 +1,84 @@
+#include "SD.h"
+#include "HostBoard.h"
+#include <string>
+
+SDClass SD;
+
+static const long SECTOR_SIZE = 512;
+
+/**
+ * @brief Count the sectors a read touched and move the clock for them
+ */
+void File::charge(long first, long last) {
+  HostBoard& board = HostBoard::current();
+  for (long s = first; s <= last; s++) {
+    if (s == sector) continue;
+    board.nowUs += board.sdSectorUs;
+    board.sdSectorReads++;
+  }
+  sector = last;
+}
+
+int File::read() {
+  uint8_t c;
+  return read(&c, 1) == 1 ? c : -1;
+}
+
+int File::read(void* buffer, size_t length) {
+  if (!handle) return -1;
+  long start = ftell(handle.get());
+  size_t count = fread(buffer, 1, length, handle.get());
+  if (count > 0) charge(start / SECTOR_SIZE, (start + (long)count - 1) / SECTOR_SIZE);
+  return count;
+}
+
+bool File::seek(uint32_t position) {
+  return handle && fseek(handle.get(), position, SEEK_SET) == 0;
+}
+
+uint32_t File::position() {
+  return handle ? ftell(handle.get()) : 0;
+}
+
+uint32_t File::size() {
+  if (!handle) return 0;
+  long here = ftell(handle.get());
+  fseek(handle.get(), 0, SEEK_END);
+  long end = ftell(handle.get());
+  fseek(handle.get(), here, SEEK_SET);
+  return end;
+}
+
+int File::available() {
+  return handle ? size() - position() : 0;
+}
+
+size_t File::write(const uint8_t* buffer, size_t length) {
+  return handle ? fwrite(buffer, 1, length, handle.get()) : 0;
+}
+
+/**
+ * @brief Succeeds if the current board has a card directory
+ */
+bool SDClass::begin(uint8_t) {
+  return HostBoard::current().sdRoot != NULL;
+}
+
+/**
+ * @brief Open a file; finding it in the directory costs two sector reads
+ */
+File SDClass::open(const char* path, uint8_t mode) {
+  HostBoard& board = HostBoard::current();
+  if (board.sdRoot == NULL) return File();
+
+  board.nowUs += 2 * board.sdSectorUs;
+  board.sdSectorReads += 2;
+  std::string full = std::string(board.sdRoot) + "/" + path;
+  FILE* handle = fopen(full.c_str(), mode == FILE_WRITE ? "ab+" : "rb");
+  return handle != NULL ? File(handle) : File();
+}
+
+bool SDClass::exists(const char* path) {
+  File file = open(path);
+  return file;
+}
@@ -0,0 +1,53 @@
+#ifndef HOST_SD_H
+#define HOST_SD_H
+#include "Arduino.h"
+#include <memory>
+#include <stdio.h>
+
+#define FILE_READ 0
+#define FILE_WRITE 1
+
+/**
+ * @class File
+ * @brief A file in the directory standing in for the card
+ *
+ * Copies share the open file, as with the Arduino SD library. Reads
+ * cost HostBoard::sdSectorUs for each 512-byte sector that isn't the
+ * one the last read ended in, much like the library's one-sector cache.
+ */
+class File {
+public:
+  File() : sector(-1) {}
+  File(FILE* handle) : handle(handle, fclose), sector(-1) {}
+
+  operator bool() const { return (bool)handle; }
+
+  int read();
+  int read(void* buffer, size_t length);
+  bool seek(uint32_t position);
+  uint32_t position();
+  uint32_t size();
+  int available();
+  size_t write(const uint8_t* buffer, size_t length);
+  void close() { handle.reset(); }
+
+private:
+  std::shared_ptr<FILE> handle;
+  long sector;                  // Sector the last read ended in
+
+  void charge(long first, long last);
+};
+
+/**
+ * @class SDClass
+ * @brief Opens files under HostBoard::sdRoot
+ */
+class SDClass {
+public:
+  bool begin(uint8_t chipSelect = 10);
+  File open(const char* path, uint8_t mode = FILE_READ);
+  bool exists(const char* path);
+};
+extern SDClass SD;
+
+#endif
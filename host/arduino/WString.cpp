@@ -0,0 +1,280 @@
+#include "Arduino.h"
+#include <stdio.h>
+#include <ctype.h>
+
+String::String(const char* cstr) {
+  buffer = NULL;
+  capacity = 0;
+  len = 0;
+  if (cstr) copy(cstr, strlen(cstr));
+}
+
+String::String(const String& value) {
+  buffer = NULL;
+  capacity = 0;
+  len = 0;
+  *this = value;
+}
+
+String::String(String&& value) {
+  buffer = NULL;
+  capacity = 0;
+  len = 0;
+  move(value);
+}
+
+String::String(char c) {
+  buffer = NULL;
+  capacity = 0;
+  len = 0;
+  char text[2] = { c, '\0' };
+  *this = text;
+}
+
+// Number constructors format into a stack buffer first, as the core does
+static void formatNumber(char* text, size_t size, unsigned long value, unsigned char base, bool negative) {
+  char digits[34];
+  int count = 0;
+  do {
+    int digit = value % base;
+    digits[count++] = digit < 10 ? '0' + digit : 'a' + digit - 10;
+    value /= base;
+  } while (value > 0 && count < 33);
+
+  size_t out = 0;
+  if (negative && out + 1 < size) text[out++] = '-';
+  while (count > 0 && out + 1 < size) text[out++] = digits[--count];
+  text[out] = '\0';
+}
+
+String::String(unsigned char value, unsigned char base) : String((unsigned long)value, base) {}
+String::String(unsigned int value, unsigned char base) : String((unsigned long)value, base) {}
+String::String(int value, unsigned char base) : String((long)value, base) {}
+
+String::String(long value, unsigned char base) {
+  buffer = NULL;
+  capacity = 0;
+  len = 0;
+  char text[34];
+  bool negative = base == 10 && value < 0;
+  formatNumber(text, sizeof(text), negative ? -(unsigned long)value : (unsigned long)value, base, negative);
+  *this = text;
+}
+
+String::String(unsigned long value, unsigned char base) {
+  buffer = NULL;
+  capacity = 0;
+  len = 0;
+  char text[34];
+  formatNumber(text, sizeof(text), value, base, false);
+  *this = text;
+}
+
+String::String(double value, unsigned char decimals) {
+  buffer = NULL;
+  capacity = 0;
+  len = 0;
+  char text[40];
+  snprintf(text, sizeof(text), "%.*f", decimals, value);
+  *this = text;
+}
+
+String::~String() {
+  hostFree(buffer);
+}
+
+void String::invalidate() {
+  hostFree(buffer);
+  buffer = NULL;
+  capacity = 0;
+  len = 0;
+}
+
+bool String::reserve(unsigned int size) {
+  if (buffer && capacity >= size) return true;
+  if (changeBuffer(size)) {
+    if (len == 0) buffer[0] = '\0';
+    return true;
+  }
+  return false;
+}
+
+bool String::changeBuffer(unsigned int maxLength) {
+  char* grown = (char*)hostRealloc(buffer, maxLength + 1);
+  if (grown == NULL) return false;
+  buffer = grown;
+  capacity = maxLength;
+  return true;
+}
+
+String& String::copy(const char* cstr, unsigned int length) {
+  if (!reserve(length)) {
+    invalidate();
+    return *this;
+  }
+  len = length;
+  memcpy(buffer, cstr, length);
+  buffer[length] = '\0';
+  return *this;
+}
+
+void String::move(String& rhs) {
+  if (this != &rhs) {
+    hostFree(buffer);
+    buffer = rhs.buffer;
+    capacity = rhs.capacity;
+    len = rhs.len;
+    rhs.buffer = NULL;
+    rhs.capacity = 0;
+    rhs.len = 0;
+  }
+}
+
+String& String::operator=(const String& rhs) {
+  if (this == &rhs) return *this;
+  if (rhs.buffer) copy(rhs.buffer, rhs.len);
+  else invalidate();
+  return *this;
+}
+
+String& String::operator=(String&& rhs) {
+  move(rhs);
+  return *this;
+}
+
+String& String::operator=(const char* cstr) {
+  if (cstr) copy(cstr, strlen(cstr));
+  else invalidate();
+  return *this;
+}
+
+bool String::concat(const char* cstr, unsigned int length) {
+  unsigned int newLength = len + length;
+  if (!cstr) return false;
+  if (length == 0) return true;
+  if (!reserve(newLength)) return false;
+  memmove(buffer + len, cstr, length);
+  len = newLength;
+  buffer[len] = '\0';
+  return true;
+}
+
+bool String::concat(const String& s) {
+  return concat(s.c_str(), s.len);
+}
+
+bool String::concat(const char* cstr) {
+  return cstr ? concat(cstr, strlen(cstr)) : false;
+}
+
+bool String::concat(char c) {
+  return concat(&c, 1);
+}
+
+bool String::concat(int value) {
+  char text[12];
+  snprintf(text, sizeof(text), "%d", value);
+  return concat(text);
+}
+
+bool String::concat(unsigned int value) {
+  char text[12];
+  snprintf(text, sizeof(text), "%u", value);
+  return concat(text);
+}
+
+bool String::concat(long value) {
+  char text[24];
+  snprintf(text, sizeof(text), "%ld", value);
+  return concat(text);
+}
+
+bool String::concat(unsigned long value) {
+  char text[24];
+  snprintf(text, sizeof(text), "%lu", value);
+  return concat(text);
+}
+
+// The core's StringSumHelper copies the left side once, then appends
+String operator+(const String& lhs, const String& rhs) { String sum(lhs); sum.concat(rhs); return sum; }
+String operator+(const String& lhs, const char* cstr) { String sum(lhs); sum.concat(cstr); return sum; }
+String operator+(const char* cstr, const String& rhs) { String sum(cstr); sum.concat(rhs); return sum; }
+String operator+(const String& lhs, char c) { String sum(lhs); sum.concat(c); return sum; }
+String operator+(String&& lhs, const String& rhs) { lhs.concat(rhs); return String(static_cast<String&&>(lhs)); }
+String operator+(String&& lhs, const char* cstr) { lhs.concat(cstr); return String(static_cast<String&&>(lhs)); }
+String operator+(String&& lhs, char c) { lhs.concat(c); return String(static_cast<String&&>(lhs)); }
+
+bool String::equals(const char* cstr) const {
+  return strcmp(c_str(), cstr ? cstr : "") == 0;
+}
+
+bool String::startsWith(const String& prefix) const {
+  if (len < prefix.len) return false;
+  return strncmp(c_str(), prefix.c_str(), prefix.len) == 0;
+}
+
+bool String::endsWith(const String& suffix) const {
+  if (len < suffix.len) return false;
+  return strcmp(c_str() + len - suffix.len, suffix.c_str()) == 0;
+}
+
+char String::charAt(unsigned int index) const {
+  return index < len ? buffer[index] : '\0';
+}
+
+char& String::operator[](unsigned int index) {
+  static char dummy;
+  if (index >= len || !buffer) {
+    dummy = '\0';
+    return dummy;
+  }
+  return buffer[index];
+}
+
+int String::indexOf(char c, unsigned int from) const {
+  if (from >= len) return -1;
+  const char* found = strchr(buffer + from, c);
+  return found ? found - buffer : -1;
+}
+
+int String::indexOf(const String& s, unsigned int from) const {
+  if (from >= len) return -1;
+  const char* found = strstr(buffer + from, s.c_str());
+  return found ? found - buffer : -1;
+}
+
+String String::substring(unsigned int left, unsigned int right) const {
+  if (left > right) {
+    unsigned int swap = left;
+    left = right;
+    right = swap;
+  }
+  String out;
+  if (left >= len) return out;
+  if (right > len) right = len;
+  out.copy(buffer + left, right - left);
+  return out;
+}
+
+void String::toLowerCase() {
+  for (unsigned int i = 0; i < len; i++) buffer[i] = tolower((unsigned char)buffer[i]);
+}
+
+void String::toUpperCase() {
+  for (unsigned int i = 0; i < len; i++) buffer[i] = toupper((unsigned char)buffer[i]);
+}
+
+void String::trim() {
+  if (!buffer || len == 0) return;
+  char* begin = buffer;
+  while (isspace((unsigned char)*begin)) begin++;
+  char* end = buffer + len - 1;
+  while (end >= begin && isspace((unsigned char)*end)) end--;
+  len = end + 1 - begin;
+  if (begin > buffer) memmove(buffer, begin, len);
+  buffer[len] = '\0';
+}
+
+long String::toInt() const {
+  return buffer ? atol(buffer) : 0;
+}
@@ -0,0 +1,92 @@
+#ifndef HOST_WSTRING_H
+#define HOST_WSTRING_H
+#include <stddef.h>
+
+/**
+ * @class String
+ * @brief Host copy of the Arduino String, down to how it uses the heap
+ *
+ * Like the AVR core's WString, every buffer is sized exactly to its
+ * contents and grown with realloc() one append at a time, so the
+ * allocation counts HostBoard keeps match what the board would do.
+ */
+class String {
+public:
+    String(const char* cstr = "");
+    String(const String& value);
+    String(String&& value);
+    explicit String(char c);
+    explicit String(unsigned char value, unsigned char base = 10);
+    explicit String(int value, unsigned char base = 10);
+    explicit String(unsigned int value, unsigned char base = 10);
+    explicit String(long value, unsigned char base = 10);
+    explicit String(unsigned long value, unsigned char base = 10);
+    explicit String(double value, unsigned char decimals = 2);
+    ~String();
+
+    String& operator=(const String& rhs);
+    String& operator=(String&& rhs);
+    String& operator=(const char* cstr);
+
+    bool reserve(unsigned int size);
+    unsigned int length() const { return len; }
+    const char* c_str() const { return buffer ? buffer : ""; }
+
+    bool concat(const String& s);
+    bool concat(const char* cstr);
+    bool concat(const char* cstr, unsigned int length);
+    bool concat(char c);
+    bool concat(int value);
+    bool concat(unsigned int value);
+    bool concat(long value);
+    bool concat(unsigned long value);
+
+    String& operator+=(const String& rhs) { concat(rhs); return *this; }
+    String& operator+=(const char* cstr) { concat(cstr); return *this; }
+    String& operator+=(char c) { concat(c); return *this; }
+    String& operator+=(int value) { concat(value); return *this; }
+    String& operator+=(unsigned int value) { concat(value); return *this; }
+    String& operator+=(long value) { concat(value); return *this; }
+    String& operator+=(unsigned long value) { concat(value); return *this; }
+
+    friend String operator+(const String& lhs, const String& rhs);
+    friend String operator+(const String& lhs, const char* cstr);
+    friend String operator+(const char* cstr, const String& rhs);
+    friend String operator+(const String& lhs, char c);
+    friend String operator+(String&& lhs, const String& rhs);
+    friend String operator+(String&& lhs, const char* cstr);
+    friend String operator+(String&& lhs, char c);
+
+    bool equals(const char* cstr) const;
+    bool operator==(const String& rhs) const { return equals(rhs.c_str()); }
+    bool operator==(const char* cstr) const { return equals(cstr); }
+    bool operator!=(const String& rhs) const { return !equals(rhs.c_str()); }
+    bool operator!=(const char* cstr) const { return !equals(cstr); }
+    bool startsWith(const String& prefix) const;
+    bool endsWith(const String& suffix) const;
+
+    char charAt(unsigned int index) const;
+    char operator[](unsigned int index) const { return charAt(index); }
+    char& operator[](unsigned int index);
+    int indexOf(char c, unsigned int from = 0) const;
+    int indexOf(const String& s, unsigned int from = 0) const;
+
+    String substring(unsigned int left) const { return substring(left, len); }
+    String substring(unsigned int left, unsigned int right) const;
+    void toLowerCase();
+    void toUpperCase();
+    void trim();
+    long toInt() const;
+
+private:
+    char* buffer;
+    unsigned int capacity;
+    unsigned int len;
+
+    void invalidate();
+    bool changeBuffer(unsigned int maxLength);
+    String& copy(const char* cstr, unsigned int length);
+    void move(String& rhs);
+};
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef HOST_WIRE_H
+#define HOST_WIRE_H
+#include "Arduino.h"
+
+/**
+ * @class TwoWire
+ * @brief Host I2C: every byte goes to the current HostBoard's LCD decoder
+ */
+class TwoWire {
+public:
+  void begin() {}
+  void setClock(unsigned long) {}
+  void beginTransmission(uint8_t) { HostBoard::current().advance(HostBoard::current().i2cByteUs); }
+  size_t write(uint8_t value) { HostBoard::current().onI2CWrite(value); return 1; }
+  uint8_t endTransmission() { return 0; }
+};
+extern TwoWire Wire;
+
+#endif
@@ -0,0 +1,273 @@
+/**
+ * @file karaoke.cpp
+ * @brief Score a WAV recording as if it were sung into the microphone
+ *
+ * @details Runs main.ino built with a microphone (see KaraokeScorer.h)
+ * against a virtual clock, plays a song and feeds the recording to the
+ * scorer one ADC reading at a time, at the rate the free-running ADC
+ * takes them, starting as the first note sounds. Each line's score is
+ * printed as the sketch puts it on the LCD, then the sketch's total.
+ *
+ * Any 8- or 16-bit PCM WAV will do, at any rate; one channel is used.
+ * A melody rendered by render.cpp (left channel) should score close to
+ * 100%, and the same song rendered a semitone off (render -k 1) close
+ * to 0, which makes a quick check of the scorer:
+ *   ./render -o wav && ./karaoke 0 wav/00-twinkle-little-star.wav
+ *
+ * Build from the repository root (see host/Makefile):
+ *   make -C host karaoke
+ *
+ * Usage: karaoke [-c channel] [-d delay_ms] [-k semitones] [-t tempo%] [-l loop_us] [-m min%] <song> <file.wav>
+ *
+ * -d starts the recording that long after the first note (negative:
+ * before it), for a singer who comes in late. -k and -t are typed as
+ * the key and tempo commands before the song. -m exits with 1 if the
+ * score comes out below min%.
+ */
+
+#include "sketch.h"
+
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static const unsigned long MAX_RUN_MS = 600000;   // Give up after 10 minutes
+static const unsigned long END_WAIT_MS = 1000;    // After the song, for the total to print
+
+/**
+ * @brief One channel of a WAV file
+ */
+struct Recording {
+  std::vector<int16_t> samples;
+  unsigned long rate;
+};
+
+static uint32_t readLE(const uint8_t* bytes, int count) {
+  uint32_t value = 0;
+  for (int i = count - 1; i >= 0; i--) value = (value << 8) | bytes[i];
+  return value;
+}
+
+/**
+ * @brief Read one channel of a PCM WAV file
+ */
+static bool readWav(const char* path, unsigned channel, Recording& out, std::string& error) {
+  FILE* file = fopen(path, "rb");
+  if (file == NULL) {
+    error = "cannot read file";
+    return false;
+  }
+  std::vector<uint8_t> data;
+  uint8_t buffer[4096];
+  size_t got;
+  while ((got = fread(buffer, 1, sizeof(buffer), file)) > 0) data.insert(data.end(), buffer, buffer + got);
+  fclose(file);
+
+  if (data.size() < 12 || memcmp(&data[0], "RIFF", 4) != 0 || memcmp(&data[8], "WAVE", 4) != 0) {
+    error = "not a WAV file";
+    return false;
+  }
+
+  unsigned format = 0, channels = 0, bits = 0;
+  size_t pos = 12;
+  while (pos + 8 <= data.size()) {
+    uint32_t size = readLE(&data[pos + 4], 4);
+    size_t body = pos + 8;
+    size_t end = std::min(data.size(), body + size);
+
+    if (memcmp(&data[pos], "fmt ", 4) == 0 && size >= 16) {
+      format = readLE(&data[body], 2);
+      channels = readLE(&data[body + 2], 2);
+      out.rate = readLE(&data[body + 4], 4);
+      bits = readLE(&data[body + 14], 2);
+    } else if (memcmp(&data[pos], "data", 4) == 0) {
+      if (format != 1 || (bits != 8 && bits != 16) || channels == 0 || out.rate == 0) {
+        error = "only 8- or 16-bit PCM is read";
+        return false;
+      }
+      if (channel >= channels) {
+        error = "no such channel";
+        return false;
+      }
+      size_t frame = channels * bits / 8;
+      for (size_t at = body + channel * bits / 8; at + bits / 8 <= end; at += frame) {
+        out.samples.push_back(bits == 16 ? (int16_t)readLE(&data[at], 2) : (int16_t)((data[at] - 128) << 8));
+      }
+      return true;
+    }
+    pos = body + size + (size & 1);
+  }
+  error = "no audio data";
+  return false;
+}
+
+/**
+ * @brief The recording at a time, as the ADC would read the module
+ * @param seconds From the start of the recording; outside it is silence
+ *
+ * Full scale is +-512 counts about the module's mid-supply bias, less a
+ * little headroom, with linear interpolation between samples.
+ */
+static uint16_t readingAt(const Recording& recording, double seconds) {
+  double position = seconds * recording.rate;
+  if (position < 0 || position + 1 >= recording.samples.size()) return 512;
+
+  size_t index = (size_t)position;
+  double fraction = position - index;
+  double value = recording.samples[index] * (1 - fraction) + recording.samples[index + 1] * fraction;
+  long reading = 512 + (long)(value / 80);
+  return (uint16_t)constrain(reading, 0L, 1023L);
+}
+
+/**
+ * @class KaraokeBoard
+ * @brief HostBoard that takes typed lines and keeps the sketch's serial output
+ */
+class KaraokeBoard : public HostBoard {
+public:
+  std::string input;
+  std::vector<std::string> output;  // Whole lines, oldest first
+  bool echo;
+
+  KaraokeBoard() : echo(false) {}
+
+  void type(const std::string& text) {
+    input += text;
+    input += '\n';
+  }
+
+  void onSerialWrite(uint8_t c) override {
+    if (c == '\n') {
+      if (echo) printf("  | %s\n", outputLine.c_str());
+      output.push_back(outputLine);
+      outputLine.clear();
+    } else if (c != '\r') {
+      outputLine += (char)c;
+    }
+  }
+
+  int onSerialAvailable() override { return input.size(); }
+  int onSerialPeek() override { return input.empty() ? -1 : (unsigned char)input[0]; }
+  int onSerialRead() override {
+    if (input.empty()) return -1;
+    int c = (unsigned char)input[0];
+    input.erase(0, 1);
+    return c;
+  }
+
+private:
+  std::string outputLine;
+};
+
+static void usage() {
+  fprintf(stderr, "usage: karaoke [-c channel] [-d delay_ms] [-k semitones] [-t tempo%%] [-l loop_us] [-m min%%] "
+                  "<song> <file.wav>\n");
+}
+
+int main(int argc, char** argv) {
+  unsigned channel = 0;
+  long delayMs = 0;
+  int transpose = 0;
+  int tempo = 100;
+  unsigned long loopUs = 1000;
+  int minPercent = -1;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "c:d:k:t:l:m:h")) != -1) {
+    switch (opt) {
+      case 'c': channel = atoi(optarg); break;
+      case 'd': delayMs = atol(optarg); break;
+      case 'k': transpose = atoi(optarg); break;
+      case 't': tempo = atoi(optarg); break;
+      case 'l': loopUs = strtoul(optarg, NULL, 10); break;
+      case 'm': minPercent = atoi(optarg); break;
+      default: usage(); return 2;
+    }
+  }
+  if (argc - optind != 2 || loopUs == 0) {
+    usage();
+    return 2;
+  }
+  int songIndex = atoi(argv[optind]);
+  const char* path = argv[optind + 1];
+
+  Recording recording;
+  std::string error;
+  if (!readWav(path, channel, recording, error)) {
+    fprintf(stderr, "%s: %s\n", path, error.c_str());
+    return 2;
+  }
+  printf("%s: %.1f s at %lu Hz, channel %u\n", path, (double)recording.samples.size() / recording.rate,
+         recording.rate, channel);
+
+  KaraokeBoard board;
+  board.i2cByteUs = 90;     // 100kHz I2C, as on the board
+  board.makeCurrent();
+  setup();
+
+  if (!scorer.isFitted()) {
+    fprintf(stderr, "the sketch has no microphone: build with -DMIC_PIN=A0\n");
+    return 2;
+  }
+  if (transpose != 0) board.type("key " + std::to_string(transpose));
+  if (tempo != 100) board.type("tempo " + std::to_string(tempo));
+  board.type("play " + std::to_string(songIndex));
+  board.echo = true;
+
+  // Readings are numbered from the first note
+  unsigned long startUs = 0;
+  bool started = false;
+  unsigned long endedMs = 0;
+  bool ended = false;
+  unsigned long reading = 0;
+  unsigned int linesShown = 0;
+  int total = -1;
+
+  while (board.nowUs / 1000 < MAX_RUN_MS) {
+    if (!started && buzzer.isPlaying()) {
+      started = true;
+      startUs = board.nowUs - buzzer.getSongPosition() * 1000;
+    }
+    if (started) {
+      while (startUs + (unsigned long)(reading * 1000000.0 / MIC_READING_HZ) <= board.nowUs) {
+        double seconds = (double)reading / MIC_READING_HZ - delayMs / 1000.0;
+        scorer.feed(readingAt(recording, seconds));
+        reading++;
+      }
+    }
+
+    loop();
+
+    if (scorer.getLines() > linesShown) {
+      linesShown = scorer.getLines();
+      printf("%8.3f  line %u: %d%%\n", (board.nowUs - startUs) / 1000000.0, linesShown,
+             scorer.getLastLinePercent());
+    } else if (scorer.getLines() < linesShown) {
+      linesShown = scorer.getLines();   // Song over; the score was cleared
+    }
+
+    if (started && !ended && !buzzer.isPlaying()) {
+      ended = true;
+      endedMs = board.nowUs / 1000;
+    }
+    if (ended && board.nowUs / 1000 - endedMs >= END_WAIT_MS) break;
+
+    board.advance(loopUs);
+  }
+
+  for (size_t i = 0; i < board.output.size(); i++) {
+    sscanf(board.output[i].c_str(), "Karaoke score: %d%%", &total);
+  }
+  if (!ended) {
+    printf("the song did not finish\n");
+    return 1;
+  }
+  if (total < 0) {
+    printf("nothing was scored\n");
+    return minPercent >= 0 ? 1 : 0;
+  }
+  printf("score %d%%, %lu blocks lost\n", total, scorer.getOverruns());
+  return total < minPercent ? 1 : 0;
+}
@@ -0,0 +1,171 @@
+/**
+ * @file packsongs.cpp
+ * @brief Build an SD card song library (see SongCard.h)
+ *
+ * @details Packs songs into the card layout the sketch reads: SONGS.IDX
+ * and one S<nnn>.SNG file per song, written to a directory. Copy the
+ * directory's files to the root of a FAT-formatted card, or point the
+ * host tools at it (trace -c). With no files given it packs every entry
+ * of songs[]; otherwise it packs the text files (see host/songtext.h),
+ * in order.
+ *
+ * Pitches are stored as MIDI note numbers. A frequency that isn't an
+ * equal-tempered note (as in pitches.h) is moved to the nearest one,
+ * with a warning. Accents don't fit the packed note and are dropped, also
+ * with a warning.
+ *
+ * Build from the repository root (see host/Makefile):
+ *   make -C host packsongs
+ *
+ * Usage: packsongs [-o dir] [song.txt ...]
+ */
+
+#include "songtext.h"
+#include "SongCard.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+static_assert(sizeof(CardIndexHeader) == 8, "index header layout");
+static_assert(sizeof(CardIndexEntry) == 32, "index entry layout");
+static_assert(sizeof(CardSongHeader) == 32, "song header layout");
+static_assert(sizeof(CardLyric) == 16, "lyric layout");
+
+static void putPacked(FILE* out, PackedNote packed) {
+  uint8_t bytes[2] = { (uint8_t)(packed & 0xFF), (uint8_t)(packed >> 8) };
+  fwrite(bytes, 1, 2, out);
+}
+
+/**
+ * @brief Pack a part, splitting notes too long for one packed note
+ * @return Packed notes written
+ */
+static int packPart(FILE* out, const HostSong& song, int voice) {
+  int count = 0;
+  for (size_t i = 0; i < song.parts[voice].size(); i++) {
+    const Note& note = song.parts[voice][i];
+    uint8_t midi = midiNote(note.frequency);
+    if (note.frequency > 0 && midiFrequency(midi) != note.frequency) {
+      fprintf(stderr, "%s: %d Hz played as %d Hz\n", song.title.c_str(), note.frequency, midiFrequency(midi));
+    }
+    if (song.accents[voice][i] != 0) {
+      fprintf(stderr, "%s: accent on note %u dropped\n", song.title.c_str(), (unsigned)i);
+    }
+    if (note.duration % PACKED_TICK_MS != 0) {
+      fprintf(stderr, "%s: %d ms rounded to %u ms steps\n", song.title.c_str(), note.duration, PACKED_TICK_MS);
+    }
+
+    unsigned long ticks = (note.duration + PACKED_TICK_MS / 2) / PACKED_TICK_MS;
+    do {
+      unsigned long part = std::min(ticks, (unsigned long)PACKED_MAX_TICKS);
+      putPacked(out, (PackedNote)((midi << 9) | part));
+      ticks -= part;
+      count++;
+    } while (ticks > 0);
+  }
+  return count;
+}
+
+/**
+ * @brief Write one song file
+ * @return False if it can't be written
+ */
+static bool packSong(const char* dir, int index, const HostSong& song) {
+  char path[512];
+  snprintf(path, sizeof(path), "%s/S%03d.SNG", dir, index);
+  FILE* out = fopen(path, "wb");
+  if (out == NULL) return false;
+
+  // Notes first, then go back for the header once the counts are known
+  CardSongHeader header;
+  memset(&header, 0, sizeof(header));
+  fwrite(&header, sizeof(header), 1, out);
+
+  memcpy(header.magic, "SNG1", 4);
+  for (int v = 0; v < 2; v++) {
+    header.noteCounts[v] = packPart(out, song, v);
+  }
+  header.lyricCount = song.words.size();
+  header.durationMs = song.info.durationMs;
+  header.lowestPitch = song.info.lowestPitch;
+  header.highestPitch = song.info.highestPitch;
+
+  // Lyrics start on a 16-byte boundary (see SongCard::open())
+  while (ftell(out) % 16 != 0) fputc(0, out);
+  for (size_t i = 0; i < song.words.size(); i++) {
+    CardLyric lyric;
+    memset(&lyric, 0, sizeof(lyric));
+    lyric.timeMs = song.words[i].first;
+    strncpy(lyric.word, song.words[i].second.c_str(), sizeof(lyric.word) - 1);
+    fwrite(&lyric, sizeof(lyric), 1, out);
+  }
+
+  fseek(out, 0, SEEK_SET);
+  fwrite(&header, sizeof(header), 1, out);
+  return fclose(out) == 0;
+}
+
+int main(int argc, char** argv) {
+  const char* dir = "card";
+
+  int opt;
+  while ((opt = getopt(argc, argv, "o:h")) != -1) {
+    switch (opt) {
+      case 'o': dir = optarg; break;
+      default:
+        fprintf(stderr, "usage: packsongs [-o dir] [song.txt ...]\n");
+        return 2;
+    }
+  }
+
+  std::vector<HostSong> library;
+  if (optind == argc) {
+    for (int i = 0; i < SONG_COUNT; i++) {
+      library.push_back(HostSong());
+      loadLibrarySong(i, library.back());
+    }
+  } else {
+    for (int i = optind; i < argc; i++) {
+      library.push_back(HostSong());
+      HostSong& song = library.back();
+      if (!loadSongFile(argv[i], song)) {
+        fprintf(stderr, "cannot read %s\n", argv[i]);
+        return 2;
+      }
+      if (song.title.empty()) song.title = argv[i];
+    }
+  }
+
+  mkdir(dir, 0755);
+  std::string indexPath = std::string(dir) + "/SONGS.IDX";
+  FILE* index = fopen(indexPath.c_str(), "wb");
+  if (index == NULL) {
+    fprintf(stderr, "cannot write %s\n", indexPath.c_str());
+    return 2;
+  }
+
+  CardIndexHeader indexHeader;
+  memcpy(indexHeader.magic, "SIDX", 4);
+  indexHeader.count = library.size();
+  indexHeader.reserved = 0;
+  fwrite(&indexHeader, sizeof(indexHeader), 1, index);
+
+  for (size_t i = 0; i < library.size(); i++) {
+    const HostSong& song = library[i];
+    CardIndexEntry entry;
+    memset(&entry, 0, sizeof(entry));
+    strncpy(entry.title, song.title.c_str(), sizeof(entry.title) - 1);
+    entry.durationMs = song.info.durationMs;
+    fwrite(&entry, sizeof(entry), 1, index);
+
+    if (!packSong(dir, i, song)) {
+      fprintf(stderr, "cannot write song %d\n", (int)i);
+      return 2;
+    }
+    printf("S%03d.SNG  %-27s %3d + %3d notes, %3d words, %.1f s\n", (int)i, entry.title,
+           (int)song.parts[0].size(), (int)song.parts[1].size(), (int)song.words.size(),
+           song.info.durationMs / 1000.0);
+  }
+  fclose(index);
+  return 0;
+}
@@ -0,0 +1,396 @@
+/**
+ * @file render.cpp
+ * @brief Render every song in songs[] to WAV files, off the board
+ *
+ * @details Runs the real DualBuzzer sequencing code against a virtual
+ * clock, records every tone()/noTone() call, and turns them into square
+ * waves: melody on the left channel, harmony on the right, 16-bit PCM.
+ * Songs render in parallel, one per thread.
+ *
+ * For each song it also reports how long it ran and how far each voice's
+ * notes started from where the tables put them ("drift"), plus how far
+ * apart the two voices were at the points where both should change
+ * together ("align"). Both should be 0 at any loop period that divides
+ * the note lengths; anything else is a timing regression.
+ *
+ * Build from the repository root (see host/Makefile):
+ *   make -C host render
+ *
+ * Usage: render [-o dir] [-t tempo%] [-k semitones] [-l loop_us] [-r rate]
+ *               [-j threads] [-d max_drift_ms] [-H harmony]
+ * Exits with 1 if any note drifts more than max_drift_ms (when given).
+ * -H takes the same rules as the harmony command (song, third, sixth,
+ * drone, bass), to hear a generated harmony against the written one.
+ */
+
+#include "Arduino.h"
+#include "DualBuzzer.h"
+#include "songs.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <string>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+static const uint8_t MELODY_PIN = 9;
+static const uint8_t HARMONY_PIN = 10;
+static const int16_t AMPLITUDE = 12000;      // Per channel, well clear of clipping
+static const unsigned long MAX_SONG_US = 600000000UL; // Give up after 10 minutes
+
+// Names for -H, in HarmonyRule order
+static const char* const HARMONY_NAMES[HARMONY_RULE_COUNT] = {"song", "third", "sixth", "drone", "bass"};
+
+/**
+ * @brief Command line settings
+ */
+struct RenderOptions {
+  std::string outDir;
+  int tempo;
+  int transpose;
+  HarmonyRule harmony;
+  unsigned long loopUs;     // Time between buzzer.update() calls
+  unsigned long sampleRate;
+  unsigned threads;
+  double maxDriftMs;        // < 0 = report only
+};
+
+/**
+ * @brief One tone() or noTone() call
+ */
+struct ToneEvent {
+  unsigned long timeUs;
+  unsigned int frequency;   // 0 = silent
+};
+
+/**
+ * @brief Timing results for one song
+ */
+struct SongReport {
+  std::string name;
+  std::string file;
+  unsigned long expectedMs;
+  unsigned long endUs[2];       // When each voice went quiet
+  double maxDriftUs[2];
+  double meanDriftUs[2];
+  double maxAlignUs;
+  bool eventsMatch;             // One event per note plus the final stop
+  bool written;
+};
+
+/**
+ * @class RenderBoard
+ * @brief HostBoard that keeps each buzzer pin's tone changes
+ */
+class RenderBoard : public HostBoard {
+public:
+  std::vector<ToneEvent> voices[2];
+
+  void onTone(uint8_t pin, unsigned int frequency) override { record(pin, frequency); }
+  void onNoTone(uint8_t pin) override { record(pin, 0); }
+  void onSerialWrite(uint8_t) override {}
+
+private:
+  /**
+   * Several calls in the same instant (a stop, then the first note)
+   * leave only the last one, which is what the buzzer ends up playing.
+   */
+  void record(uint8_t pin, unsigned int frequency) {
+    int voice = pin == MELODY_PIN ? 0 : pin == HARMONY_PIN ? 1 : -1;
+    if (voice < 0) return;
+
+    std::vector<ToneEvent>& events = voices[voice];
+    if (!events.empty() && events.back().timeUs == nowUs) {
+      events.back().frequency = frequency;
+    } else {
+      ToneEvent event = { nowUs, frequency };
+      events.push_back(event);
+    }
+  }
+};
+
+/**
+ * @brief Start times the tables give for each note, plus the end, in microseconds
+ */
+static std::vector<double> idealTimes(const Note* notes, int length, int tempo) {
+  std::vector<double> times;
+  unsigned long written = 0;
+  times.push_back(0);
+  for (int i = 0; i < length; i++) {
+    Note note;
+    memcpy_P(&note, &notes[i], sizeof(Note));
+    written += note.duration;
+    times.push_back(written * 100000.0 / tempo);
+  }
+  return times;
+}
+
+/**
+ * @brief Compare a voice's recorded events with its ideal times
+ */
+static void measureDrift(const std::vector<ToneEvent>& events, const std::vector<double>& ideal,
+                         double& maxDrift, double& meanDrift) {
+  maxDrift = 0;
+  meanDrift = 0;
+  size_t count = std::min(events.size(), ideal.size());
+  for (size_t i = 0; i < count; i++) {
+    double drift = fabs(events[i].timeUs - ideal[i]);
+    maxDrift = std::max(maxDrift, drift);
+    meanDrift += drift;
+  }
+  if (count > 0) meanDrift /= count;
+}
+
+/**
+ * @brief Largest gap between the voices where both should change at once
+ */
+static double measureAlignment(const std::vector<ToneEvent> events[2], const std::vector<double> ideal[2]) {
+  double worst = 0;
+  size_t a = 0;
+  size_t b = 0;
+  while (a < ideal[0].size() && b < ideal[1].size() && a < events[0].size() && b < events[1].size()) {
+    if (ideal[0][a] < ideal[1][b]) {
+      a++;
+    } else if (ideal[1][b] < ideal[0][a]) {
+      b++;
+    } else {
+      double gap = fabs((double)events[0][a].timeUs - (double)events[1][b].timeUs);
+      worst = std::max(worst, gap);
+      a++;
+      b++;
+    }
+  }
+  return worst;
+}
+
+static void putLE(FILE* file, uint32_t value, int bytes) {
+  for (int i = 0; i < bytes; i++) {
+    fputc((value >> (8 * i)) & 0xFF, file);
+  }
+}
+
+/**
+ * @brief Turn one voice's events into a square wave
+ * @param channel Interleaved stereo buffer; this voice fills every other sample
+ */
+static void synthesize(const std::vector<ToneEvent>& events, unsigned long sampleRate,
+                       std::vector<int16_t>& samples, int channel) {
+  size_t frames = samples.size() / 2;
+  size_t next = 0;
+  unsigned int frequency = 0;
+  double phase = 0;
+
+  for (size_t n = 0; n < frames; n++) {
+    double timeUs = n * 1000000.0 / sampleRate;
+    while (next < events.size() && events[next].timeUs <= timeUs) {
+      frequency = events[next].frequency;
+      next++;
+    }
+
+    int16_t value = 0;
+    if (frequency > 0) {
+      value = phase < 0.5 ? AMPLITUDE : -AMPLITUDE;
+      phase += (double)frequency / sampleRate;
+      phase -= floor(phase);
+    }
+    samples[n * 2 + channel] = value;
+  }
+}
+
+/**
+ * @brief Write a 16-bit stereo PCM WAV file
+ */
+static bool writeWav(const std::string& path, const std::vector<int16_t>& samples, unsigned long sampleRate) {
+  FILE* file = fopen(path.c_str(), "wb");
+  if (file == NULL) return false;
+
+  uint32_t dataBytes = samples.size() * sizeof(int16_t);
+  fwrite("RIFF", 1, 4, file);
+  putLE(file, 36 + dataBytes, 4);
+  fwrite("WAVEfmt ", 1, 8, file);
+  putLE(file, 16, 4);                   // fmt chunk size
+  putLE(file, 1, 2);                    // PCM
+  putLE(file, 2, 2);                    // Channels
+  putLE(file, sampleRate, 4);
+  putLE(file, sampleRate * 4, 4);       // Bytes per second
+  putLE(file, 4, 2);                    // Bytes per frame
+  putLE(file, 16, 2);                   // Bits per sample
+  fwrite("data", 1, 4, file);
+  putLE(file, dataBytes, 4);
+  for (size_t i = 0; i < samples.size(); i++) {
+    putLE(file, (uint16_t)samples[i], 2);
+  }
+
+  bool ok = !ferror(file);
+  return fclose(file) == 0 && ok;
+}
+
+/**
+ * @brief File name for a song: its number and a lower-case slug of its title
+ */
+static std::string fileName(int index, const char* name) {
+  char prefix[8];
+  snprintf(prefix, sizeof(prefix), "%02d-", index);
+  std::string slug = prefix;
+  bool dash = false;
+  for (const char* c = name; *c; c++) {
+    if (isalnum((unsigned char)*c)) {
+      slug += (char)tolower((unsigned char)*c);
+      dash = false;
+    } else if (!dash) {
+      slug += '-';
+      dash = true;
+    }
+  }
+  while (slug.size() > 0 && slug[slug.size() - 1] == '-') slug.erase(slug.size() - 1);
+  return slug + ".wav";
+}
+
+/**
+ * @brief Play one song on its own virtual board and write its WAV
+ */
+static void renderSong(int index, const RenderOptions& options, SongReport& report) {
+  RenderBoard board;
+  board.makeCurrent();
+
+  Song song;
+  memcpy_P(&song, &songs[index], sizeof(Song));
+  report.name = song.name;
+  report.file = options.outDir + "/" + fileName(index, song.name);
+  report.expectedMs = (unsigned long)(song.info.durationMs * 100.0 / options.tempo + 0.5);
+
+  DualBuzzer buzzer(MELODY_PIN, HARMONY_PIN);
+  buzzer.setTempo(options.tempo);
+  buzzer.setTranspose(options.transpose);
+  buzzer.setSong((Note*)song.melody, song.melodyLength, (Note*)song.harmony, song.harmonyLength, song.info);
+  buzzer.setAccents(MELODY_VOICE, song.melodyAccents);
+  buzzer.setAccents(HARMONY_VOICE, song.harmonyAccents);
+  buzzer.setHarmonyStyle(song.harmonyStyle);
+  buzzer.setHarmonyRule(options.harmony);
+  bool generated = buzzer.isHarmonyGenerated();
+  buzzer.play();
+
+  while (buzzer.isPlaying() && board.nowUs < MAX_SONG_US) {
+    board.advance(options.loopUs);
+    buzzer.update();
+  }
+
+  std::vector<double> ideal[2] = {
+    idealTimes(song.melody, song.melodyLength, options.tempo),
+    // A generated harmony changes note with the melody
+    generated ? idealTimes(song.melody, song.melodyLength, options.tempo)
+              : idealTimes(song.harmony, song.harmonyLength, options.tempo)
+  };
+
+  unsigned long lastUs = 0;
+  report.eventsMatch = true;
+  for (int v = 0; v < 2; v++) {
+    const std::vector<ToneEvent>& events = board.voices[v];
+    report.endUs[v] = events.empty() ? 0 : events.back().timeUs;
+    lastUs = std::max(lastUs, report.endUs[v]);
+    measureDrift(events, ideal[v], report.maxDriftUs[v], report.meanDriftUs[v]);
+    if (events.size() != ideal[v].size()) report.eventsMatch = false;
+  }
+  report.maxAlignUs = measureAlignment(board.voices, ideal);
+
+  // Half a second of silence at the end, so players do not clip the last note
+  size_t frames = (lastUs + 500000UL) * (double)options.sampleRate / 1000000.0;
+  std::vector<int16_t> samples(frames * 2, 0);
+  for (int v = 0; v < 2; v++) {
+    synthesize(board.voices[v], options.sampleRate, samples, v);
+  }
+  report.written = writeWav(report.file, samples, options.sampleRate);
+}
+
+static void usage() {
+  fprintf(stderr, "usage: render [-o dir] [-t tempo%%] [-k semitones] [-l loop_us] [-r rate] [-j threads] [-d max_drift_ms] [-H harmony]\n");
+}
+
+int main(int argc, char** argv) {
+  RenderOptions options;
+  options.outDir = "wav";
+  options.tempo = 100;
+  options.transpose = 0;
+  options.harmony = HARMONY_WRITTEN;
+  options.loopUs = 1000;
+  options.sampleRate = 44100;
+  options.threads = std::max(1u, std::thread::hardware_concurrency());
+  options.maxDriftMs = -1;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "o:t:k:l:r:j:d:H:h")) != -1) {
+    switch (opt) {
+      case 'o': options.outDir = optarg; break;
+      case 't': options.tempo = atoi(optarg); break;
+      case 'k': options.transpose = atoi(optarg); break;
+      case 'l': options.loopUs = strtoul(optarg, NULL, 10); break;
+      case 'r': options.sampleRate = strtoul(optarg, NULL, 10); break;
+      case 'j': options.threads = strtoul(optarg, NULL, 10); break;
+      case 'd': options.maxDriftMs = atof(optarg); break;
+      case 'H': {
+        int rule = 0;
+        while (rule < HARMONY_RULE_COUNT && strcmp(optarg, HARMONY_NAMES[rule]) != 0) rule++;
+        if (rule == HARMONY_RULE_COUNT) {
+          usage();
+          return 2;
+        }
+        options.harmony = (HarmonyRule)rule;
+        break;
+      }
+      default: usage(); return 2;
+    }
+  }
+
+  if (options.tempo < TEMPO_MIN_PERCENT || options.tempo > TEMPO_MAX_PERCENT ||
+      options.transpose < -TRANSPOSE_MAX_SEMITONES || options.transpose > TRANSPOSE_MAX_SEMITONES ||
+      options.loopUs == 0 || options.sampleRate < 8000 || options.threads == 0) {
+    usage();
+    return 2;
+  }
+  mkdir(options.outDir.c_str(), 0755);
+
+  // Each worker takes the next song until none are left
+  std::vector<SongReport> reports(SONG_COUNT);
+  std::atomic<int> nextSong(0);
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t < std::min(options.threads, (unsigned)SONG_COUNT); t++) {
+    workers.push_back(std::thread([&]() {
+      int index;
+      while ((index = nextSong++) < SONG_COUNT) {
+        renderSong(index, options, reports[index]);
+      }
+    }));
+  }
+  for (size_t t = 0; t < workers.size(); t++) {
+    workers[t].join();
+  }
+
+  printf("tempo %d%%, key %+d, harmony %s, loop %luus, %lu Hz\n\n", options.tempo, options.transpose,
+         HARMONY_NAMES[options.harmony], options.loopUs, options.sampleRate);
+  printf("%-2s %-24s %9s %9s %14s %14s %9s\n", "#", "song", "expected", "actual",
+         "melody drift", "harmony drift", "align");
+  printf("%-2s %-24s %9s %9s %14s %14s %9s\n", "", "", "ms", "ms", "max/mean ms", "max/mean ms", "max ms");
+
+  bool failed = false;
+  for (int i = 0; i < SONG_COUNT; i++) {
+    const SongReport& r = reports[i];
+    unsigned long actualMs = std::max(r.endUs[0], r.endUs[1]) / 1000;
+    printf("%-2d %-24.24s %9lu %9lu %7.2f/%-6.2f %7.2f/%-6.2f %9.2f%s%s\n", i, r.name.c_str(),
+           r.expectedMs, actualMs,
+           r.maxDriftUs[0] / 1000, r.meanDriftUs[0] / 1000,
+           r.maxDriftUs[1] / 1000, r.meanDriftUs[1] / 1000,
+           r.maxAlignUs / 1000,
+           r.eventsMatch ? "" : "  (note count mismatch)",
+           r.written ? "" : "  (WAV not written)");
+
+    double worstMs = std::max(std::max(r.maxDriftUs[0], r.maxDriftUs[1]), r.maxAlignUs) / 1000;
+    if (!r.eventsMatch || !r.written || (options.maxDriftMs >= 0 && worstMs > options.maxDriftMs)) {
+      failed = true;
+    }
+  }
+
+  printf("\nWAV files in %s/\n", options.outDir.c_str());
+  return failed ? 1 : 0;
+}
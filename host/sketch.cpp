@@ -0,0 +1,3 @@
+// main.ino, compiled as C++ for the host (see sketch.h)
+#include "sketch.h"
+#include "../main.ino"
@@ -0,0 +1,65 @@
+#ifndef HOST_SKETCH_H
+#define HOST_SKETCH_H
+#include "Arduino.h"
+#include "DualBuzzer.h"
+#include "SettingsStore.h"
+#include "NoteStream.h"
+#include "SongCard.h"
+#include "ClockSync.h"
+#include "KaraokeScorer.h"
+
+/*
+ * main.ino as seen from host tools. The Arduino IDE writes these
+ * prototypes itself before compiling a sketch; on the host, sketch.cpp
+ * includes this first. Add new sketch functions here as well.
+ */
+
+struct PreparedSong;
+
+void setup();
+void loop();
+void handleSerialCommands();
+void dispatchLine(const String& line);
+void applyStreamAction(StreamAction action);
+void processCommand(String command);
+void moveToNextSong();
+void loadSong(int songIndex);
+void getSongName(int songIndex, char* name, size_t size);
+void prepareSong(int songIndex, PreparedSong& prepared);
+int peekNextSong(bool& fromQueue);
+void prefetchNextSong();
+void cancelNextSong();
+void cuedSongStarted();
+void popQueue();
+void showQueue();
+void shuffleQueue();
+void runBench();
+void showTasks();
+void showPower();
+void showSync();
+void showTrace();
+String describeFlightEvent(const FlightEvent& event);
+void showMic();
+void reportScore();
+unsigned long sharedClock();
+void applySyncAction(SyncAction action);
+void startSyncedSong(int songIndex, unsigned long at);
+bool canSleep();
+unsigned long sleepTime();
+String patternName(int pattern);
+void showStatus();
+void captureSettings(SavedState& state);
+void applySettings(const SavedState& state);
+void restoreDefaults();
+void saveResumePoint(bool playing);
+void resumeSong(int songIndex, unsigned long positionMs);
+void playStartupSequence();
+
+// Sketch state host tools look at
+extern DualBuzzer buzzer;
+extern AsyncLCD lcd;
+extern int currentSong;
+extern ClockSync clockSync;
+extern KaraokeScorer scorer;
+
+#endif
@@ -0,0 +1,146 @@
+#ifndef HOST_SONG_TEXT_H
+#define HOST_SONG_TEXT_H
+/*
+ * Songs for the host tools: the entries of songs[], or text files. Both
+ * come out as a HostSong, with the notes as written.
+ */
+#include "Arduino.h"
+#include "DualBuzzer.h"
+#include "songs.h"
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdio.h>
+
+/**
+ * @brief A song in host memory
+ */
+struct HostSong {
+  std::string title;
+  std::vector<Note> parts[2];             // Melody, harmony
+  std::vector<int8_t> accents[2];         // One per note of each part
+  std::vector<std::pair<unsigned long, std::string> > words;
+  SongInfo info;
+};
+
+/**
+ * @brief Copy an entry of songs[] out of PROGMEM
+ *
+ * A melody-only song gets the harmony the sketch would generate for it.
+ */
+static inline void loadLibrarySong(int index, HostSong& song) {
+  Song header;
+  memcpy_P(&header, &songs[index], sizeof(Song));
+
+  const Note* tables[2] = { header.melody, header.harmony };
+  const int8_t* accents[2] = { header.melodyAccents, header.harmonyAccents };
+  int lengths[2] = { header.melodyLength, header.harmonyLength };
+  for (int v = 0; v < 2; v++) {
+    for (int i = 0; i < lengths[v]; i++) {
+      Note note;
+      memcpy_P(&note, &tables[v][i], sizeof(Note));
+      song.parts[v].push_back(note);
+      song.accents[v].push_back(accents[v] != NULL ? (int8_t)pgm_read_byte(&accents[v][i]) : 0);
+    }
+  }
+  if (header.harmony == NULL && header.harmonyStyle.rule != HARMONY_WRITTEN) {
+    Harmonizer harmonizer;
+    harmonizer.setStyle(header.harmonyStyle);
+    for (size_t i = 0; i < song.parts[0].size(); i++) {
+      Note note;
+      harmonizer.harmonize(i, song.parts[0][i], note);
+      song.parts[1].push_back(note);
+    }
+    song.accents[1] = song.accents[0];
+  }
+  song.info = header.info;
+  for (size_t i = 0; i < song.parts[1].size(); i++) {
+    song.info.lowestPitch = lowerPitch(song.info.lowestPitch, song.parts[1][i].frequency);
+    song.info.highestPitch = higherPitch(song.info.highestPitch, song.parts[1][i].frequency);
+  }
+  for (int i = 0; i < header.lyricsCount; i++) {
+    LyricTiming lyric;
+    memcpy_P(&lyric, &header.lyrics[i], sizeof(LyricTiming));
+    song.words.push_back(std::make_pair(lyric.timeMs, std::string(lyric.word)));
+  }
+
+  char name[64];
+  strncpy_P(name, header.name, sizeof(name) - 1);
+  name[sizeof(name) - 1] = '\0';
+  song.title = name;
+}
+
+/**
+ * @brief Read a song from a text file
+ * @return False if the file can't be read
+ *
+ * One event per line:
+ *   t <title>
+ *   m <Hz> <ms> [accent]   melody note (0 Hz = rest; accent in volume steps)
+ *   h <Hz> <ms> [accent]   harmony note
+ *   w <ms> <word>     lyric at a song time (/word starts a line)
+ * Anything else (such as # comments) is skipped.
+ */
+static inline bool loadSongFile(const char* path, HostSong& song) {
+  FILE* file = fopen(path, "r");
+  if (file == NULL) return false;
+
+  char line[128];
+  while (fgets(line, sizeof(line), file) != NULL) {
+    int frequency, duration;
+    int accent = 0;
+    unsigned long timeMs;
+    char word[64];
+    if (strncmp(line, "t ", 2) == 0) {
+      song.title = std::string(line + 2, strcspn(line + 2, "\r\n"));
+    } else if (sscanf(line, "m %d %d %d", &frequency, &duration, &accent) >= 2) {
+      Note note = { frequency, duration };
+      song.parts[MELODY_VOICE].push_back(note);
+      song.accents[MELODY_VOICE].push_back(accent);
+    } else if (sscanf(line, "h %d %d %d", &frequency, &duration, &accent) >= 2) {
+      Note note = { frequency, duration };
+      song.parts[HARMONY_VOICE].push_back(note);
+      song.accents[HARMONY_VOICE].push_back(accent);
+    } else if (sscanf(line, "w %lu %63s", &timeMs, word) == 2) {
+      song.words.push_back(std::make_pair(timeMs, std::string(word)));
+    }
+  }
+  fclose(file);
+
+  // Work out what describeSong() would have
+  song.info.durationMs = 0;
+  song.info.lowestPitch = 0;
+  song.info.highestPitch = 0;
+  for (int v = 0; v < 2; v++) {
+    unsigned long length = 0;
+    for (size_t i = 0; i < song.parts[v].size(); i++) {
+      const Note& note = song.parts[v][i];
+      length += note.duration;
+      song.info.lowestPitch = lowerPitch(song.info.lowestPitch, note.frequency);
+      song.info.highestPitch = higherPitch(song.info.highestPitch, note.frequency);
+    }
+    song.info.durationMs = std::max(song.info.durationMs, length);
+  }
+  return true;
+}
+
+/**
+ * @brief Play the song several times over as one long song
+ */
+static inline void repeatSong(HostSong& song, int times) {
+  HostSong once = song;
+  for (int n = 1; n < times; n++) {
+    unsigned long offset = n * once.info.durationMs;
+    for (int v = 0; v < 2; v++) {
+      song.parts[v].insert(song.parts[v].end(), once.parts[v].begin(), once.parts[v].end());
+      song.accents[v].insert(song.accents[v].end(), once.accents[v].begin(), once.accents[v].end());
+    }
+    for (size_t i = 0; i < once.words.size(); i++) {
+      song.words.push_back(std::make_pair(once.words[i].first + offset, once.words[i].second));
+    }
+  }
+  song.info.durationMs = once.info.durationMs * times;
+}
+
+#endif
@@ -0,0 +1,378 @@
+/**
+ * @file streamsong.cpp
+ * @brief Stream a song to the sketch over serial (see NoteStream.h)
+ *
+ * @details Sends a song's notes and lyrics a few at a time as "~" lines,
+ * keeping within the credit the board hands out, and starts playback
+ * once the rings are primed. The song is an entry of songs[] or a text
+ * file (see host/songtext.h). -n repeats it, which makes a song longer
+ * than flash could hold.
+ *
+ * Data lines are sent one at a time, each waiting for its answer, and
+ * the next line always goes to whichever part runs out soonest in song
+ * time. At the end it reports the underruns, how long playback held and
+ * how full the rings stayed.
+ *
+ * By default it runs the whole sketch (host/sketch.cpp) on a virtual
+ * clock, with bytes arriving at the baud rate into a 64-byte receive
+ * buffer as in the stress test. With -D it streams to a real board.
+ *
+ * Build from the repository root (see host/Makefile):
+ *   make -C host streamsong
+ *
+ * Usage: streamsong [-s song | -f file] [-n repeat] [-b baud] [-l loop_us]
+ *                   [-D /dev/ttyACM0]
+ */
+
+#include "sketch.h"
+#include "songtext.h"
+
+#include <deque>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdarg.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <termios.h>
+#include <time.h>
+
+static const int NOTES_PER_LINE = 4;
+static const unsigned long ANSWER_TIMEOUT_US = 1000000;  // Resend a line with no answer
+
+/**
+ * @class Sender
+ * @brief Host side of the stream protocol, independent of the link
+ *
+ * Streams are the voices (0, 1) and the lyrics (index STREAM_VOICES).
+ */
+class Sender {
+public:
+  // Results
+  unsigned long linesSent;
+  unsigned long resends;
+  unsigned long underruns;
+  unsigned long telemetryCount;
+  int lowestFill[STREAM_VOICES];   // While still sending; -1 if sent in full before playback
+  double fillTotal[STREAM_VOICES];
+  bool finished;                  // Board closed the session
+
+  Sender(const HostSong& song) : song(song) {
+    linesSent = 0;
+    resends = 0;
+    underruns = 0;
+    telemetryCount = 0;
+    finished = false;
+    opened = false;
+    playSent = false;
+    waitingSince = 0;
+    awaiting = -1;
+    for (int s = 0; s <= STREAM_VOICES; s++) {
+      acked[s] = 0;
+      limits[s] = 0;
+      endSent[s] = false;
+    }
+    for (int v = 0; v < STREAM_VOICES; v++) {
+      lowestFill[v] = -1;
+      fillTotal[v] = 0;
+    }
+  }
+
+  /**
+   * @brief Next line to send, or "" to wait for the board
+   * @param nowUs Host clock, for the answer timeout
+   */
+  std::string nextLine(unsigned long long nowUs) {
+    if (finished) return "";
+    if (!opened) {
+      opened = true;
+      return line("~s %lu %d %d", song.info.durationMs, song.info.lowestPitch, song.info.highestPitch);
+    }
+    if (awaiting >= 0) {
+      if (nowUs - waitingSince < ANSWER_TIMEOUT_US) return "";
+      awaiting = -1;  // Lost; the line is safe to send again
+      resends++;
+    }
+
+    // Feed whichever part runs out soonest in song time
+    int stream = -1;
+    unsigned long soonest = 0;
+    for (int s = 0; s <= STREAM_VOICES; s++) {
+      if (acked[s] >= total(s) || acked[s] >= limits[s]) continue;
+      unsigned long coveredTo = coverage(s);
+      if (stream < 0 || coveredTo < soonest) {
+        stream = s;
+        soonest = coveredTo;
+      }
+    }
+
+    if (stream < 0) {
+      // Nothing can go yet: mark finished parts, then start once primed
+      for (int s = 0; s < STREAM_VOICES; s++) {
+        if (!endSent[s] && acked[s] >= total(s)) {
+          endSent[s] = true;
+          return line("~e %d %d", s, total(s));
+        }
+      }
+      if (!playSent && limits[MELODY_VOICE] > 0) {
+        playSent = true;
+        return "~p\n";
+      }
+      return "";
+    }
+
+    awaiting = stream;
+    waitingSince = nowUs;
+    if (stream == STREAM_VOICES) {
+      const std::pair<unsigned long, std::string>& word = song.words[acked[stream]];
+      return line("~w %d %lu %s", acked[stream], word.first, word.second.substr(0, STREAM_WORD_SIZE - 1).c_str());
+    }
+
+    std::string text = line("~n %d %d", stream, acked[stream]);
+    text.erase(text.size() - 1);
+    int end = std::min(std::min(acked[stream] + NOTES_PER_LINE, total(stream)), limits[stream]);
+    for (int i = acked[stream]; i < end; i++) {
+      const Note& note = song.parts[stream][i];
+      int accent = song.accents[stream][i];
+      std::string item = accent != 0 ? line(" %d:%d:%d", note.frequency, note.duration, accent)
+                                     : line(" %d:%d", note.frequency, note.duration);
+      item.erase(item.size() - 1);
+      if (i > acked[stream] && text.size() + item.size() > STREAM_LINE_MAX) break;   // Accents make lines longer
+      text += item;
+    }
+    return text + "\n";
+  }
+
+  /**
+   * @brief Act on one line from the board (anything but "~" lines is ignored)
+   */
+  void receive(const std::string& text) {
+    char stream;
+    int received, limit;
+    int fills[STREAM_VOICES + 1];
+    unsigned long count;
+
+    if (sscanf(text.c_str(), "~a %c %d %d", &stream, &received, &limit) == 3) {
+      int s = stream == 'l' ? STREAM_VOICES : stream - '0';
+      if (s < 0 || s > STREAM_VOICES) return;
+      if (received < acked[s]) resends++;
+      acked[s] = received;
+      limits[s] = limit;
+      if (awaiting == s) awaiting = -1;
+    } else if (sscanf(text.c_str(), "~f %d %d %d %lu", &fills[0], &fills[1], &fills[2], &count) == 4) {
+      if (!playSent) return;
+      telemetryCount++;
+      for (int v = 0; v < STREAM_VOICES; v++) {
+        // A part that has been sent in full is allowed to run down
+        if (acked[v] < total(v) && (lowestFill[v] < 0 || fills[v] < lowestFill[v])) lowestFill[v] = fills[v];
+        fillTotal[v] += fills[v];
+      }
+      underruns = count;
+    } else if (text.compare(0, 2, "~u") == 0) {
+      printf("underrun: %s\n", text.c_str());
+    } else if (text.compare(0, 2, "~x") == 0) {
+      finished = true;
+    }
+  }
+
+private:
+  const HostSong& song;
+  bool opened;
+  bool playSent;
+  int awaiting;                       // Stream whose answer is due, -1 if none
+  unsigned long long waitingSince;
+  int acked[STREAM_VOICES + 1];       // Received, as last answered
+  int limits[STREAM_VOICES + 1];
+  bool endSent[STREAM_VOICES + 1];
+
+  int total(int stream) {
+    return stream == STREAM_VOICES ? (int)song.words.size() : (int)song.parts[stream].size();
+  }
+
+  // Song time up to which a stream has been received
+  unsigned long coverage(int stream) {
+    if (stream == STREAM_VOICES) return song.words[acked[stream]].first;
+    unsigned long time = 0;
+    for (int i = 0; i < acked[stream]; i++) time += song.parts[stream][i].duration;
+    return time;
+  }
+
+  static std::string line(const char* format, ...) {
+    char buffer[STREAM_LINE_MAX + 8];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    return std::string(buffer) + "\n";
+  }
+};
+
+/**
+ * @class StreamBoard
+ * @brief HostBoard that hands the sketch's serial output back as lines
+ */
+class StreamBoard : public HostBoard {
+public:
+  std::deque<std::string> fromBoard;  // Lines the host has received
+  unsigned long holdUs;               // Time playback spent holding
+
+  StreamBoard(unsigned long baud) {
+    setBaud(baud);
+    holdUs = 0;
+  }
+
+  void onSerialWrite(uint8_t c) override {
+    if (c == '\n') {
+      fromBoard.push_back(outputLine);
+      outputLine.clear();
+    } else if (c != '\r') {
+      outputLine += (char)c;
+    }
+  }
+
+private:
+  std::string outputLine;
+};
+
+static void report(const Sender& sender, double seconds, double heldMs, unsigned long rxDropped) {
+  printf("lines sent:  %lu (%lu resent)\n", sender.linesSent, sender.resends);
+  printf("underruns:   %lu, held %.0f ms in all\n", sender.underruns, heldMs);
+  for (int v = 0; v < STREAM_VOICES; v++) {
+    double mean = sender.telemetryCount ? sender.fillTotal[v] / sender.telemetryCount : 0;
+    if (sender.lowestFill[v] < 0) {
+      printf("voice %d ring: sent in full, mean %.1f of %d notes\n", v, mean, STREAM_NOTE_SLOTS);
+    } else {
+      printf("voice %d ring: lowest %d, mean %.1f of %d notes\n", v, sender.lowestFill[v], mean, STREAM_NOTE_SLOTS);
+    }
+  }
+  if (rxDropped > 0) printf("bytes lost to a full receive buffer: %lu\n", rxDropped);
+  printf("played:      %.1f s%s\n", seconds, sender.finished ? "" : " (did not finish)");
+}
+
+/**
+ * @brief Stream to the sketch running on the host
+ */
+static int runSimulation(const HostSong& song, unsigned long baud, unsigned long loopUs) {
+  StreamBoard board(baud);
+  board.i2cByteUs = 90;
+  board.makeCurrent();
+
+  setup();
+  board.fromBoard.clear();
+
+  Sender sender(song);
+  unsigned long startUs = board.nowUs;
+  unsigned long limitUs = startUs + (song.info.durationMs + 60000UL) * 1000UL;
+
+  while (!sender.finished && board.nowUs < limitUs) {
+    while (!board.fromBoard.empty()) {
+      sender.receive(board.fromBoard.front());
+      board.fromBoard.pop_front();
+    }
+    if (!board.serialWireBusy()) {
+      std::string text = sender.nextLine(board.nowUs);
+      if (!text.empty()) {
+        board.sendSerial(text, board.nowUs);
+        sender.linesSent++;
+      }
+    }
+
+    unsigned long passStart = board.nowUs;
+    board.deliverSerial();
+    loop();
+    board.advance(loopUs);
+    if (buzzer.isHolding()) board.holdUs += board.nowUs - passStart;
+  }
+
+  report(sender, (board.nowUs - startUs) / 1000000.0, board.holdUs / 1000.0, board.serialRxDropped);
+  return sender.finished && sender.underruns == 0 ? 0 : 1;
+}
+
+static unsigned long long wallUs() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (unsigned long long)now.tv_sec * 1000000ULL + now.tv_nsec / 1000;
+}
+
+/**
+ * @brief Stream to a real board
+ */
+static int runDevice(const HostSong& song, const char* device, unsigned long baud) {
+  int port = openBoardPort(device, baud);
+  if (port < 0) return 2;
+
+  Sender sender(song);
+  std::string line;
+  unsigned long long startUs = wallUs();
+  unsigned long long limitUs = startUs + (song.info.durationMs + 60000ULL) * 1000ULL;
+
+  while (!sender.finished && wallUs() < limitUs) {
+    std::string text = sender.nextLine(wallUs());
+    if (!text.empty()) {
+      if (write(port, text.data(), text.size()) < 0) break;
+      tcdrain(port);
+      sender.linesSent++;
+    }
+
+    char buffer[256];
+    ssize_t count = read(port, buffer, sizeof(buffer));
+    for (ssize_t i = 0; i < count; i++) {
+      if (buffer[i] == '\n') {
+        sender.receive(line);
+        line.clear();
+      } else if (buffer[i] != '\r') {
+        line += buffer[i];
+      }
+    }
+    usleep(500);
+  }
+  close(port);
+
+  // Hold time isn't visible from here; each underrun is at least one hold
+  report(sender, (wallUs() - startUs) / 1000000.0, 0, 0);
+  return sender.finished && sender.underruns == 0 ? 0 : 1;
+}
+
+static void usage() {
+  fprintf(stderr, "usage: streamsong [-s song | -f file] [-n repeat] [-b baud] [-l loop_us] [-D device]\n");
+}
+
+int main(int argc, char** argv) {
+  int songIndex = 0;
+  const char* path = NULL;
+  int repeat = 1;
+  unsigned long baud = 9600;
+  unsigned long loopUs = 200;
+  const char* device = NULL;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "s:f:n:b:l:D:h")) != -1) {
+    switch (opt) {
+      case 's': songIndex = atoi(optarg); break;
+      case 'f': path = optarg; break;
+      case 'n': repeat = std::max(1, atoi(optarg)); break;
+      case 'b': baud = strtoul(optarg, NULL, 10); break;
+      case 'l': loopUs = strtoul(optarg, NULL, 10); break;
+      case 'D': device = optarg; break;
+      default: usage(); return 2;
+    }
+  }
+
+  HostSong song;
+  if (path != NULL) {
+    if (!loadSongFile(path, song)) {
+      fprintf(stderr, "cannot read %s\n", path);
+      return 2;
+    }
+  } else if (songIndex >= 0 && songIndex < SONG_COUNT) {
+    loadLibrarySong(songIndex, song);
+  } else {
+    usage();
+    return 2;
+  }
+  repeatSong(song, repeat);
+
+  printf("streaming %d + %d notes, %d words, %.1f s\n", (int)song.parts[0].size(), (int)song.parts[1].size(),
+         (int)song.words.size(), song.info.durationMs / 1000.0);
+  return device != NULL ? runDevice(song, device, baud) : runSimulation(song, baud, loopUs);
+}
@@ -0,0 +1,550 @@
+/**
+ * @file stress.cpp
+ * @brief Flood the serial command handler while a song plays, and measure the damage
+ *
+ * @details Sends a stream of serial lines at a set rate while a song plays.
+ * Lines are a configurable mix of valid commands, malformed ones and
+ * unterminated fragments. It reports, as JSON:
+ *   - how late each note started compared with the song table, and how
+ *     many notes were skipped after a pass ran longer than a note
+ *     (simulation only)
+ *   - how far ahead of its note each word reached the lyric cursor
+ *     (simulation only)
+ *   - how many commands never came back as "Command: ..."
+ *   - bytes lost to a full receive buffer
+ *   - the loop rate and the longest loop pass
+ *
+ * By default it runs the whole sketch (host/sketch.cpp) on a virtual
+ * clock. Serial is modelled as on an Uno:
+ *   - input arrives a byte at a time at the baud rate into a 64-byte
+ *     receive buffer, and bytes that find it full are lost;
+ *   - Serial.print() blocks while the 64-byte transmit buffer is full;
+ *   - a line with no newline waits in the sketch's line buffer and runs
+ *     into whatever arrives next.
+ * Runs are repeatable for a given seed.
+ *
+ * With -D it drives a real board over USB instead, sending the same
+ * traffic in real time. Only what can be seen from the host side is
+ * reported then: commands echoed and dropped, and how long each echo
+ * took.
+ *
+ * Build from the repository root (see host/Makefile):
+ *   make -C host stress
+ *
+ * Usage: stress [-r lines_per_s] [-m valid,malformed,unterminated] [-s song]
+ *               [-t seconds] [-l loop_us] [-b baud] [-x seed] [-o report.json]
+ *               [-D /dev/ttyACM0]
+ */
+
+#include "sketch.h"
+#include "songs.h"
+
+#include <deque>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdio.h>
+#include <unistd.h>
+#include <termios.h>
+#include <time.h>
+
+static const uint8_t MELODY_PIN = 9;
+static const uint8_t HARMONY_PIN = 10;
+
+// Commands that answer without changing how the song plays
+static const char* VALID_COMMANDS[] = {
+  "status", "status", "status", "list", "queue", "tempo", "key", "viz",
+  "fastboot", "led on", "pattern 3", "auto off", "gap 0", "help"
+};
+static const char* MALFORMED_COMMANDS[] = {
+  "tempo abc", "pattern 9", "play 99", "key +40", "gap -5", "xyzzy", "queue clear please", ""
+};
+
+enum LineKind { LINE_VALID, LINE_MALFORMED, LINE_UNTERMINATED, LINE_KINDS };
+
+/**
+ * @brief Command line settings
+ */
+struct StressOptions {
+  double linesPerSecond;
+  int mix[LINE_KINDS];          // Relative weights
+  int song;
+  double seconds;               // 0 = until the song ends
+  unsigned long loopUs;         // Loop pass cost besides the sketch's own waits
+  unsigned long baud;
+  unsigned long seed;
+  const char* reportPath;
+  const char* device;
+};
+
+/**
+ * @class Traffic
+ * @brief Repeatable stream of serial lines with random spacing
+ */
+class Traffic {
+public:
+  unsigned long sent[LINE_KINDS];
+  unsigned long terminated;     // Lines that ended in a newline
+
+  Traffic(const StressOptions& options) : options(options), state(options.seed ? options.seed : 1) {
+    memset(sent, 0, sizeof(sent));
+    terminated = 0;
+  }
+
+  /**
+   * @brief Next line to send
+   * @param kind Set to what the line is
+   */
+  std::string nextLine(LineKind& kind) {
+    int total = options.mix[0] + options.mix[1] + options.mix[2];
+    int pick = total > 0 ? random() % total : 0;
+    kind = pick < options.mix[0] ? LINE_VALID : pick < options.mix[0] + options.mix[1] ? LINE_MALFORMED : LINE_UNTERMINATED;
+    sent[kind]++;
+
+    std::string text;
+    if (kind == LINE_VALID) {
+      text = VALID_COMMANDS[random() % (sizeof(VALID_COMMANDS) / sizeof(VALID_COMMANDS[0]))];
+    } else if (kind == LINE_MALFORMED) {
+      // Canned mistakes, or printable junk up to 100 characters
+      if (random() % 2 == 0) {
+        text = MALFORMED_COMMANDS[random() % (sizeof(MALFORMED_COMMANDS) / sizeof(MALFORMED_COMMANDS[0]))];
+      } else {
+        int length = 1 + random() % 100;
+        for (int i = 0; i < length; i++) text += (char)(' ' + random() % 95);
+      }
+    } else {
+      // Start of a command with no newline; it runs into the next line
+      std::string command = VALID_COMMANDS[random() % (sizeof(VALID_COMMANDS) / sizeof(VALID_COMMANDS[0]))];
+      return command.substr(0, 1 + random() % command.size());
+    }
+    terminated++;
+    return text + "\n";
+  }
+
+  /**
+   * @brief Microseconds until the next line, exponentially distributed around the rate
+   */
+  unsigned long nextGapUs() {
+    double uniform = (random() % 1000000 + 1) / 1000001.0;
+    return (unsigned long)(-log(uniform) * 1000000.0 / options.linesPerSecond);
+  }
+
+private:
+  const StressOptions& options;
+  uint32_t state;
+
+  uint32_t random() {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+  }
+};
+
+/**
+ * @brief max, mean and 99th percentile of a set of values
+ */
+struct Spread {
+  double max;
+  double mean;
+  double p99;
+};
+
+static Spread spreadOf(std::vector<double> values) {
+  Spread spread = { 0, 0, 0 };
+  if (values.empty()) return spread;
+  std::sort(values.begin(), values.end());
+  for (size_t i = 0; i < values.size(); i++) spread.mean += values[i];
+  spread.mean /= values.size();
+  spread.max = values.back();
+  spread.p99 = values[std::min(values.size() - 1, (size_t)(values.size() * 0.99))];
+  return spread;
+}
+
+static void printSpread(FILE* out, const char* name, const Spread& spread, bool last) {
+  fprintf(out, "    \"%s\": {\"max\": %.3f, \"mean\": %.3f, \"p99\": %.3f}%s\n",
+          name, spread.max, spread.mean, spread.p99, last ? "" : ",");
+}
+
+static void printOptions(FILE* out, const StressOptions& options) {
+  fprintf(out, "  \"config\": {\"target\": \"%s\", \"lines_per_second\": %.2f, "
+          "\"mix\": {\"valid\": %d, \"malformed\": %d, \"unterminated\": %d}, "
+          "\"song\": %d, \"seconds\": %.1f, \"loop_us\": %lu, \"baud\": %lu, \"seed\": %lu},\n",
+          options.device ? options.device : "sim", options.linesPerSecond,
+          options.mix[0], options.mix[1], options.mix[2], options.song, options.seconds,
+          options.loopUs, options.baud, options.seed);
+}
+
+static void printSent(FILE* out, const Traffic& traffic) {
+  fprintf(out, "  \"sent\": {\"valid\": %lu, \"malformed\": %lu, \"unterminated\": %lu, \"lines\": %lu},\n",
+          traffic.sent[LINE_VALID], traffic.sent[LINE_MALFORMED], traffic.sent[LINE_UNTERMINATED],
+          traffic.terminated);
+}
+
+/**
+ * @class StressBoard
+ * @brief HostBoard with Uno-like serial buffers and a record of note starts
+ */
+class StressBoard : public HostBoard {
+public:
+  std::vector<unsigned long> noteStarts[2];
+  std::vector<long> wordTimes;      // When the lyric cursor reached each word, -1 until it does
+  unsigned long songStartUs;        // wordTimes are from here
+  unsigned long echoed;             // "Command: " lines printed
+  unsigned long txStallUs;          // Time Serial.print() spent waiting for room
+
+  StressBoard(unsigned long baud) {
+    setBaud(baud);
+    songStartUs = 0;
+    echoed = 0;
+    txStallUs = 0;
+  }
+
+  void onSerialWrite(uint8_t c) override {
+    unsigned long before = nowUs;
+    transmitSerial();
+    txStallUs += nowUs - before;
+
+    if (c == '\n') {
+      if (outputLine.compare(0, 9, "Command: ") == 0) echoed++;
+      outputLine.clear();
+    } else if (c != '\r') {
+      outputLine += (char)c;
+    }
+  }
+
+  void onTone(uint8_t pin, unsigned int) override { noteStart(pin); }
+  void onNoTone(uint8_t pin) override { noteStart(pin); }
+
+  // A new word is drawn as soon as the cursor reaches it, which can be
+  // long before a pass with a slow command in it ends
+  void onLCDWrite(bool glyph, uint8_t address, uint8_t value) override {
+    HostBoard::onLCDWrite(glyph, address, value);
+    noteWord();
+  }
+
+  /**
+   * @brief Note when the lyric cursor first reaches each word
+   */
+  void noteWord() {
+    int word = buzzer.getCurrentLyricIndex();
+    if (word < 0 || word >= (int)wordTimes.size() || wordTimes[word] >= 0 || nowUs < songStartUs) return;
+    wordTimes[word] = nowUs - songStartUs;
+  }
+
+private:
+  std::string outputLine;
+
+  // Several calls in one instant count once, as in the renderer
+  void noteStart(uint8_t pin) {
+    int voice = pin == MELODY_PIN ? 0 : pin == HARMONY_PIN ? 1 : -1;
+    if (voice < 0) return;
+    std::vector<unsigned long>& starts = noteStarts[voice];
+    if (starts.empty() || starts.back() != nowUs) starts.push_back(nowUs);
+  }
+};
+
+/**
+ * @struct PartTiming
+ * @brief When each note of a part was written to start, and did start
+ */
+struct PartTiming {
+  std::vector<unsigned long> writtenMs;   // Each note, then the end of the part
+  std::vector<long> startUs;              // Song time of each, -1 if it never started
+};
+
+/**
+ * @brief Match a part's note starts to the song table
+ *
+ * Each start is matched to the note whose written time it falls in, so
+ * a note the player skipped after a long pass (see PolyBuzzer::update())
+ * shows as never started rather than making every later note look late.
+ * The song clock counts whole milliseconds from somewhere in the first
+ * note's millisecond, so starts get a millisecond's grace.
+ */
+static PartTiming partTiming(const std::vector<unsigned long>& starts, const Note* notes, int length,
+                             unsigned long songStartUs) {
+  PartTiming part;
+  part.writtenMs.push_back(0);
+  for (int i = 0; i < length; i++) {
+    Note note;
+    memcpy_P(&note, &notes[i], sizeof(Note));
+    part.writtenMs.push_back(part.writtenMs.back() + note.duration);
+  }
+
+  part.startUs.assign(part.writtenMs.size(), -1);
+  for (size_t event = 0; event < starts.size(); event++) {
+    if (starts[event] < songStartUs) continue;
+    unsigned long us = starts[event] - songStartUs;
+    size_t i = std::upper_bound(part.writtenMs.begin(), part.writtenMs.end(), us / 1000 + 1) - part.writtenMs.begin() - 1;
+    if (part.startUs[i] < 0) part.startUs[i] = us;
+  }
+  return part;
+}
+
+/**
+ * @brief Lateness of each note start against the song table, in ms
+ * @param skipped Set to the notes that never started
+ */
+static std::vector<double> lateness(const PartTiming& part, unsigned long& skipped) {
+  std::vector<double> late;
+  skipped = 0;
+  for (size_t i = 0; i < part.startUs.size(); i++) {
+    if (part.startUs[i] >= 0) {
+      late.push_back(part.startUs[i] / 1000.0 - part.writtenMs[i]);
+    } else if (i + 1 < part.startUs.size()) {
+      skipped++;
+    }
+  }
+  return late;
+}
+
+/**
+ * @brief How far ahead of its note each word was put under the lyric cursor, in ms
+ * @param words Song time (us) the cursor reached each word, -1 if it never did
+ *
+ * The sketch means to lead by about the LCD's latency (see
+ * DualBuzzer::getLyricPosition()). A word is timed against the melody
+ * note it falls in, as that note actually started.
+ */
+static std::vector<double> lyricLead(const PartTiming& melody, const Song& song, const std::vector<long>& words) {
+  std::vector<double> lead;
+  for (int w = 0; w < song.lyricsCount && w < (int)words.size(); w++) {
+    LyricTiming lyric;
+    memcpy_P(&lyric, &song.lyrics[w], sizeof(LyricTiming));
+    size_t i = std::upper_bound(melody.writtenMs.begin(), melody.writtenMs.end(), lyric.timeMs) - melody.writtenMs.begin() - 1;
+    if (words[w] < 0 || melody.startUs[i] < 0) continue;
+    long soundedUs = melody.startUs[i] + (long)(lyric.timeMs - melody.writtenMs[i]) * 1000;
+    lead.push_back((soundedUs - words[w]) / 1000.0);
+  }
+  return lead;
+}
+
+/**
+ * @brief Run the sketch on the host with the flood going
+ */
+static int runSimulation(const StressOptions& options, FILE* out) {
+  StressBoard board(options.baud);
+  board.i2cByteUs = 90;
+  board.makeCurrent();
+  Traffic traffic(options);
+
+  setup();
+  // The play command waits 2s before starting; the song starts with its first note
+  unsigned long commandUs = board.nowUs;
+  String play = "play " + String(options.song);
+  processCommand(play);
+  unsigned long songStartUs = board.nowUs;
+  for (size_t i = 0; i < board.noteStarts[0].size(); i++) {
+    if (board.noteStarts[0][i] >= commandUs + 2000000UL) {
+      songStartUs = board.noteStarts[0][i];
+      break;
+    }
+  }
+  unsigned long echoedBefore = board.echoed;
+
+  Song song;
+  memcpy_P(&song, &songs[options.song], sizeof(Song));
+
+  // Flood until the song ends (or the time is up), then let the input drain
+  unsigned long stopUs = options.seconds > 0 ? songStartUs + (unsigned long)(options.seconds * 1000000) : 0;
+  unsigned long nextLineUs = songStartUs + traffic.nextGapUs();
+  unsigned long passes = 0;
+  unsigned long longestPassUs = 0;
+  unsigned long floodEndUs = 0;
+  board.songStartUs = songStartUs;
+  board.wordTimes.assign(song.lyricsCount, -1);
+
+  while (true) {
+    bool flooding = floodEndUs == 0;
+    if (flooding) {
+      bool songOver = options.seconds == 0 && !buzzer.isPlaying();
+      bool timeUp = stopUs != 0 && board.nowUs >= stopUs;
+      if (songOver || timeUp) floodEndUs = board.nowUs;
+    }
+    if (floodEndUs != 0) {
+      if (board.serialIdle() || board.nowUs - floodEndUs > 30000000UL) break;
+    }
+
+    while (floodEndUs == 0 && nextLineUs <= board.nowUs) {
+      LineKind kind;
+      board.sendSerial(traffic.nextLine(kind), nextLineUs);
+      nextLineUs += traffic.nextGapUs();
+    }
+
+    unsigned long passStart = board.nowUs;
+    board.deliverSerial();
+    loop();
+    board.noteWord();
+    board.advance(options.loopUs);
+    passes++;
+    if (floodEndUs == 0) longestPassUs = std::max(longestPassUs, board.nowUs - passStart);
+  }
+
+  double floodSeconds = (floodEndUs - songStartUs) / 1000000.0;
+  unsigned long echoed = board.echoed - echoedBefore;
+  // An unterminated fragment joins the next line, which still echoes once
+  long dropped = (long)traffic.terminated - (long)echoed;
+
+  // A generated harmony has the melody's timing
+  PartTiming parts[2] = {
+    partTiming(board.noteStarts[0], song.melody, song.melodyLength, songStartUs),
+    song.harmony != NULL ? partTiming(board.noteStarts[1], song.harmony, song.harmonyLength, songStartUs)
+                         : partTiming(board.noteStarts[1], song.melody, song.melodyLength, songStartUs)
+  };
+  unsigned long skipped[2];
+  Spread late[2] = { spreadOf(lateness(parts[0], skipped[0])), spreadOf(lateness(parts[1], skipped[1])) };
+  Spread lead = spreadOf(lyricLead(parts[0], song, board.wordTimes));
+
+  fprintf(out, "{\n");
+  printOptions(out, options);
+  printSent(out, traffic);
+  fprintf(out, "  \"commands\": {\"echoed\": %lu, \"dropped\": %ld, \"rx_overflow_bytes\": %lu},\n",
+          echoed, dropped < 0 ? 0 : dropped, board.serialRxDropped);
+  fprintf(out, "  \"loop\": {\"passes\": %lu, \"rate_hz\": %.1f, \"longest_pass_ms\": %.3f, \"tx_stall_ms\": %.1f},\n",
+          passes, passes / ((board.nowUs - songStartUs) / 1000000.0), longestPassUs / 1000.0, board.txStallUs / 1000.0);
+  fprintf(out, "  \"flood_seconds\": %.3f,\n", floodSeconds);
+  fprintf(out, "  \"note_lateness_ms\": {\n");
+  printSpread(out, "melody", late[0], false);
+  printSpread(out, "harmony", late[1], true);
+  fprintf(out, "  },\n");
+  fprintf(out, "  \"notes_skipped\": {\"melody\": %lu, \"harmony\": %lu},\n", skipped[0], skipped[1]);
+  fprintf(out, "  \"lyric_lead_ms\": {\"max\": %.3f, \"mean\": %.3f, \"p99\": %.3f}\n}\n", lead.max, lead.mean, lead.p99);
+  return 0;
+}
+
+/**
+ * @brief Wall-clock microseconds
+ */
+static unsigned long long wallUs() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (unsigned long long)now.tv_sec * 1000000ULL + now.tv_nsec / 1000;
+}
+
+/**
+ * @brief Send the same traffic to a real board and time its echoes
+ */
+static int runDevice(const StressOptions& options, FILE* out) {
+  int port = openBoardPort(options.device, options.baud);
+  if (port < 0) return 2;
+
+  char play[16];
+  snprintf(play, sizeof(play), "play %d\n", options.song);
+  if (write(port, play, strlen(play)) < 0) return 2;
+
+  Traffic traffic(options);
+  std::deque<unsigned long long> waiting;     // When each terminated line finished sending
+  std::vector<double> echoDelays;
+  unsigned long echoed = 0;
+  std::string line;
+
+  double seconds = options.seconds > 0 ? options.seconds : 30;
+  unsigned long long startUs = wallUs();
+  unsigned long long endUs = startUs + (unsigned long long)(seconds * 1000000);
+  unsigned long long nextLineUs = startUs + 2000000 + traffic.nextGapUs(); // After the play delay
+  unsigned long long drainUntil = endUs + 3000000;
+
+  while (wallUs() < drainUntil) {
+    unsigned long long now = wallUs();
+    if (now < endUs && now >= nextLineUs) {
+      LineKind kind;
+      std::string text = traffic.nextLine(kind);
+      if (write(port, text.data(), text.size()) < 0) break;
+      tcdrain(port);
+      if (kind != LINE_UNTERMINATED) waiting.push_back(wallUs());
+      nextLineUs += traffic.nextGapUs();
+    }
+
+    char buffer[256];
+    ssize_t count = read(port, buffer, sizeof(buffer));
+    for (ssize_t i = 0; i < count; i++) {
+      if (buffer[i] == '\n') {
+        if (line.compare(0, 9, "Command: ") == 0 && line.compare(0, 14, "Command: play ") != 0) {
+          echoed++;
+          if (!waiting.empty()) {
+            echoDelays.push_back((wallUs() - waiting.front()) / 1000.0);
+            waiting.pop_front();
+          }
+        }
+        line.clear();
+      } else if (buffer[i] != '\r') {
+        line += buffer[i];
+      }
+    }
+    usleep(500);
+  }
+  close(port);
+
+  long dropped = (long)traffic.terminated - (long)echoed;
+  fprintf(out, "{\n");
+  printOptions(out, options);
+  printSent(out, traffic);
+  fprintf(out, "  \"commands\": {\"echoed\": %lu, \"dropped\": %ld},\n", echoed, dropped < 0 ? 0 : dropped);
+  fprintf(out, "  \"echo_delay_ms\": {\n");
+  printSpread(out, "all", spreadOf(echoDelays), true);
+  fprintf(out, "  }\n}\n");
+  return 0;
+}
+
+static void usage() {
+  fprintf(stderr, "usage: stress [-r lines_per_s] [-m valid,malformed,unterminated] [-s song] [-t seconds]\n"
+                  "              [-l loop_us] [-b baud] [-x seed] [-o report.json] [-D device]\n");
+}
+
+int main(int argc, char** argv) {
+  StressOptions options;
+  options.linesPerSecond = 5;
+  options.mix[LINE_VALID] = 70;
+  options.mix[LINE_MALFORMED] = 20;
+  options.mix[LINE_UNTERMINATED] = 10;
+  options.song = 0;
+  options.seconds = 0;
+  options.loopUs = 200;
+  options.baud = 9600;
+  options.seed = 1;
+  options.reportPath = NULL;
+  options.device = NULL;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "r:m:s:t:l:b:x:o:D:h")) != -1) {
+    switch (opt) {
+      case 'r': options.linesPerSecond = atof(optarg); break;
+      case 'm':
+        if (sscanf(optarg, "%d,%d,%d", &options.mix[0], &options.mix[1], &options.mix[2]) != 3) {
+          usage();
+          return 2;
+        }
+        break;
+      case 's': options.song = atoi(optarg); break;
+      case 't': options.seconds = atof(optarg); break;
+      case 'l': options.loopUs = strtoul(optarg, NULL, 10); break;
+      case 'b': options.baud = strtoul(optarg, NULL, 10); break;
+      case 'x': options.seed = strtoul(optarg, NULL, 10); break;
+      case 'o': options.reportPath = optarg; break;
+      case 'D': options.device = optarg; break;
+      default: usage(); return 2;
+    }
+  }
+
+  if (options.linesPerSecond <= 0 || options.song < 0 || options.song >= SONG_COUNT ||
+      options.loopUs == 0 || options.baud == 0 ||
+      options.mix[0] < 0 || options.mix[1] < 0 || options.mix[2] < 0 ||
+      options.mix[0] + options.mix[1] + options.mix[2] == 0) {
+    usage();
+    return 2;
+  }
+
+  FILE* out = stdout;
+  if (options.reportPath != NULL) {
+    out = fopen(options.reportPath, "w");
+    if (out == NULL) {
+      fprintf(stderr, "cannot write %s\n", options.reportPath);
+      return 2;
+    }
+  }
+
+  int result = options.device ? runDevice(options, out) : runSimulation(options, out);
+  if (out != stdout) fclose(out);
+  return result;
+}
@@ -0,0 +1,483 @@
+/**
+ * @file syncsim.cpp
+ * @brief Several units sharing a clock over serial (see ClockSync.h)
+ *
+ * @details Runs a copy of the whole sketch per unit, each in its own
+ * process, connected by pipes to this one, which plays the wires between
+ * them. Every unit has its own clock: it boots at a different time and
+ * runs fast or slow by a set number of parts per million, as ceramic
+ * resonators do. Units run in lockstep on true time, half a millisecond
+ * at a time.
+ *
+ * Unit 0 is the master and the rest follow, as if each had been set up
+ * with "sync master" or "sync follow" and "save". By default they are
+ * daisy-chained, each unit's TX wired to the next one's RX; with -b the
+ * master's TX goes to every follower instead. Bytes take their time on
+ * the wire at the baud rate, and a unit's 64-byte buffers fill and block
+ * as on an Uno.
+ *
+ * A session of "<ms> <text>" lines is typed into the master, as in
+ * trace.cpp. The default one waits for the chain to lock and then starts
+ * a song everywhere with "sync play". Every note each follower plays is
+ * then matched with the master's, and the run fails if any starts more
+ * than the tolerance away in true time.
+ *
+ * Build from the repository root (see host/Makefile):
+ *   make -C host syncsim
+ *
+ * Usage: syncsim [-n units] [-b] [-s session] [-x drift_scale%] [-t tolerance_ms] [-l loop_us] [-v]
+ *
+ * -x scales every unit's clock error (100 = the table below, 0 = perfect
+ * clocks). -l is what each loop pass costs besides the sketch's own
+ * waits; the default of 2ms is about what an Uno's pass takes with the
+ * LCD and LEDs busy. -v prints each unit's serial output.
+ */
+
+#include "sketch.h"
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+static const int MAX_UNITS = 8;
+static const unsigned long STEP_US = 500;               // True time per lockstep
+static const unsigned long BAUD = 9600;
+static const unsigned long BYTE_US = 10000000UL / BAUD;
+static const uint8_t MELODY_PIN = 9;
+static const uint8_t HARMONY_PIN = 10;
+
+// Each unit's clock error and when it was switched on
+static const long UNIT_PPM[MAX_UNITS] = { 0, 3000, -2500, 4500, -4000, 1200, -800, 500 };
+static const unsigned long UNIT_BOOT_MS[MAX_UNITS] = { 0, 173, 41, 388, 260, 97, 311, 150 };
+
+static const char* DEFAULT_SESSION[] = {
+  "500 sync",
+  "20000 sync play 0",
+  "50000 sync",
+  "51000 .end",
+};
+
+/**
+ * @struct SimEvent
+ * @brief A byte on a wire or a buzzer change, at a true time
+ */
+struct SimEvent {
+  uint64_t atUs;          // True time: when a byte has fully arrived, or the tone changed
+  uint8_t kind;
+  uint8_t pin;
+  uint16_t value;         // Byte, or Hz (0 = off)
+};
+
+enum { EVENT_BYTE, EVENT_TONE };
+
+/**
+ * @struct StepHeader
+ * @brief Parent to unit: run until untilUs, after taking count bytes for the wire
+ */
+struct StepHeader {
+  uint64_t untilUs;       // 0 = finish and report
+  uint32_t count;
+};
+
+/**
+ * @struct UnitReport
+ * @brief Unit to parent at the end of the run
+ */
+struct UnitReport {
+  int64_t offsetMs;
+  int64_t driftPpm;
+  int64_t lastErrorMs;
+  uint32_t beacons;
+  uint8_t role;
+  uint8_t locked;
+};
+
+static bool readAll(int fd, void* data, size_t size) {
+  uint8_t* bytes = (uint8_t*)data;
+  while (size > 0) {
+    ssize_t got = read(fd, bytes, size);
+    if (got <= 0) return false;
+    bytes += got;
+    size -= got;
+  }
+  return true;
+}
+
+static bool writeAll(int fd, const void* data, size_t size) {
+  const uint8_t* bytes = (const uint8_t*)data;
+  while (size > 0) {
+    ssize_t put = write(fd, bytes, size);
+    if (put <= 0) return false;
+    bytes += put;
+    size -= put;
+  }
+  return true;
+}
+
+/**
+ * @class UnitBoard
+ * @brief HostBoard for one unit: its own clock rate, and serial at the baud rate
+ */
+class UnitBoard : public HostBoard {
+public:
+  std::vector<SimEvent> events;     // Since the last step
+
+  UnitBoard(long ppm, unsigned long bootUs) : ppm(ppm), bootUs(bootUs) {
+    setBaud(BAUD);
+  }
+
+  // Local microseconds at a true time, and back
+  uint64_t toLocal(uint64_t trueUs) {
+    if (trueUs <= bootUs) return 0;
+    return (uint64_t)((trueUs - bootUs) * (1.0 + ppm / 1e6));
+  }
+  uint64_t toTrue(uint64_t localUs) {
+    return bootUs + (uint64_t)(localUs / (1.0 + ppm / 1e6));
+  }
+
+  void receive(const SimEvent& event) {
+    receiveSerial((uint8_t)event.value, toLocal(event.atUs));
+  }
+
+  void onSerialWrite(uint8_t c) override {
+    SimEvent event = { toTrue(transmitSerial()), EVENT_BYTE, 0, c };
+    events.push_back(event);
+  }
+
+  void onTone(uint8_t pin, unsigned int frequency) override { tone(pin, frequency); }
+  void onNoTone(uint8_t pin) override { tone(pin, 0); }
+
+private:
+  long ppm;
+  uint64_t bootUs;
+
+  void tone(uint8_t pin, unsigned int frequency) {
+    SimEvent event = { toTrue(nowUs), EVENT_TONE, pin, (uint16_t)frequency };
+    events.push_back(event);
+  }
+};
+
+/**
+ * @brief Store the settings a unit would have been given over USB
+ */
+static void presetUnit(uint8_t role) {
+  SavedState state;
+  state.autoPlay = false;
+  state.ledsEnabled = true;
+  state.ledPattern = LED_PATTERN_DEFAULT;
+  state.visualizer = false;
+  state.fastBoot = true;
+  state.transpose = 0;
+  state.harmony = HARMONY_WRITTEN;
+  state.tempo = 100;
+  state.songGap = 0;
+  state.syncRole = role;
+  state.melodyVolume = PITCH_VOLUME_MAX;
+  state.harmonyVolume = PITCH_VOLUME_MAX;
+  state.song = -1;
+  state.resume = false;
+  state.positionMs = 0;
+
+  SettingsStore store;
+  store.save(state);
+  store.flush();
+}
+
+/**
+ * @brief A unit's process: run the sketch a step at a time for the parent
+ */
+static int runUnit(int index, long ppm, unsigned long loopUs, int fromParent, int toParent) {
+  UnitBoard board(ppm, UNIT_BOOT_MS[index] * 1000UL);
+  board.i2cByteUs = 90;
+  board.randomState = index + 1;
+  board.makeCurrent();
+
+  presetUnit(index == 0 ? SYNC_MASTER : SYNC_FOLLOWER);
+  setup();
+
+  StepHeader step;
+  while (readAll(fromParent, &step, sizeof(step))) {
+    for (uint32_t i = 0; i < step.count; i++) {
+      SimEvent event;
+      if (!readAll(fromParent, &event, sizeof(event))) return 1;
+      board.receive(event);
+    }
+
+    if (step.untilUs == 0) {
+      UnitReport report = { clockSync.getOffset(), clockSync.getDrift(), clockSync.getLastError(),
+                            (uint32_t)clockSync.getBeacons(), clockSync.getRole(), clockSync.isLocked() };
+      writeAll(toParent, &report, sizeof(report));
+      return 0;
+    }
+
+    uint64_t target = board.toLocal(step.untilUs);
+    while (board.nowUs < target) {
+      board.deliverSerial();
+      loop();
+      board.advance(loopUs);
+    }
+
+    uint32_t count = board.events.size();
+    if (!writeAll(toParent, &count, sizeof(count)) ||
+        !writeAll(toParent, board.events.data(), count * sizeof(SimEvent))) return 1;
+    board.events.clear();
+  }
+  return 1;
+}
+
+/**
+ * @struct Unit
+ * @brief The parent's side of one unit
+ */
+struct Unit {
+  pid_t pid;
+  int toUnit;
+  int fromUnit;
+  long ppm;
+  std::vector<SimEvent> inbox;          // Bytes to hand over at the next step
+  std::vector<SimEvent> tones;
+  std::string line;                     // Serial output so far
+};
+
+/**
+ * @brief Read "<ms> <text>" lines
+ */
+static bool readSession(const char* path, std::vector<std::pair<unsigned long, std::string> >& session) {
+  std::vector<std::string> lines;
+  if (path == NULL) {
+    lines.assign(DEFAULT_SESSION, DEFAULT_SESSION + sizeof(DEFAULT_SESSION) / sizeof(DEFAULT_SESSION[0]));
+  } else {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) return false;
+    char text[512];
+    while (fgets(text, sizeof(text), file)) {
+      size_t length = strlen(text);
+      while (length > 0 && (text[length - 1] == '\n' || text[length - 1] == '\r')) text[--length] = '\0';
+      lines.push_back(text);
+    }
+    fclose(file);
+  }
+
+  for (size_t i = 0; i < lines.size(); i++) {
+    if (lines[i].empty() || lines[i][0] == '#') continue;
+    char* rest = NULL;
+    unsigned long atMs = strtoul(lines[i].c_str(), &rest, 10);
+    if (rest == lines[i].c_str()) {
+      fprintf(stderr, "session line %u: expected \"<ms> <text>\"\n", (unsigned)i + 1);
+      return false;
+    }
+    if (*rest == ' ') rest++;
+    session.push_back(std::make_pair(atMs, std::string(rest)));
+  }
+  return true;
+}
+
+/**
+ * @brief A pin's tone changes from a true time on, less the silencing
+ *        that comes before the song's first note
+ */
+static void songTones(const Unit& unit, uint8_t pin, uint64_t fromUs, std::vector<SimEvent>& out) {
+  for (size_t i = 0; i < unit.tones.size(); i++) {
+    const SimEvent& event = unit.tones[i];
+    if (event.pin != pin || event.atUs < fromUs) continue;
+    if (out.empty() && event.value == 0) continue;
+    out.push_back(event);
+  }
+}
+
+/**
+ * @brief Match a follower's notes with the master's, pin by pin, from a true time on
+ * @return Notes compared, or -1 if the two played different notes
+ */
+static long compareNotes(const Unit& master, const Unit& follower, uint64_t fromUs, double& worstMs, double& totalMs) {
+  long compared = 0;
+  const uint8_t pins[] = { MELODY_PIN, HARMONY_PIN };
+  for (int p = 0; p < 2; p++) {
+    std::vector<SimEvent> a, b;
+    songTones(master, pins[p], fromUs, a);
+    songTones(follower, pins[p], fromUs, b);
+    if (a.size() != b.size()) return -1;
+
+    for (size_t i = 0; i < a.size(); i++) {
+      if (a[i].value != b[i].value) return -1;
+      double skewMs = ((double)b[i].atUs - (double)a[i].atUs) / 1000.0;
+      worstMs = std::max(worstMs, fabs(skewMs));
+      totalMs += fabs(skewMs);
+      compared++;
+    }
+  }
+  return compared;
+}
+
+static void usage() {
+  fprintf(stderr, "usage: syncsim [-n units] [-b] [-s session] [-x drift_scale%%] [-t tolerance_ms] [-l loop_us] [-v]\n");
+}
+
+int main(int argc, char** argv) {
+  int unitCount = 3;
+  bool bus = false;
+  const char* sessionPath = NULL;
+  long driftScale = 100;
+  double toleranceMs = 10;
+  unsigned long loopUs = 2000;
+  bool verbose = false;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "n:bs:x:t:l:vh")) != -1) {
+    switch (opt) {
+      case 'n': unitCount = atoi(optarg); break;
+      case 'b': bus = true; break;
+      case 's': sessionPath = optarg; break;
+      case 'x': driftScale = atol(optarg); break;
+      case 't': toleranceMs = atof(optarg); break;
+      case 'l': loopUs = strtoul(optarg, NULL, 10); break;
+      case 'v': verbose = true; break;
+      default: usage(); return 2;
+    }
+  }
+  if (unitCount < 2 || unitCount > MAX_UNITS || loopUs == 0) {
+    usage();
+    return 2;
+  }
+
+  std::vector<std::pair<unsigned long, std::string> > session;
+  if (!readSession(sessionPath, session)) {
+    fprintf(stderr, "cannot read %s\n", sessionPath);
+    return 2;
+  }
+  fflush(stdout);
+
+  // One process per unit
+  std::vector<Unit> units(unitCount);
+  for (int u = 0; u < unitCount; u++) {
+    int down[2], up[2];
+    if (pipe(down) != 0 || pipe(up) != 0) {
+      perror("pipe");
+      return 2;
+    }
+    units[u].ppm = UNIT_PPM[u] * driftScale / 100;
+    units[u].pid = fork();
+    if (units[u].pid == 0) {
+      close(down[1]);
+      close(up[0]);
+      _exit(runUnit(u, units[u].ppm, loopUs, down[0], up[1]));
+    }
+    close(down[0]);
+    close(up[1]);
+    units[u].toUnit = down[1];
+    units[u].fromUnit = up[0];
+  }
+
+  // The session is typed into the master at the baud rate
+  uint64_t endUs = (session.empty() ? 2000 : session.back().first + 2000) * 1000ULL;
+  uint64_t typedFreeUs = 0;
+  uint64_t syncPlayUs = 0;
+  size_t next = 0;
+
+  for (uint64_t nowUs = 0; nowUs < endUs; nowUs += STEP_US) {
+    while (next < session.size() && session[next].first * 1000ULL <= nowUs) {
+      const std::string& text = session[next].second;
+      if (text == ".end") {
+        endUs = nowUs;
+      } else {
+        if (text.compare(0, 10, "sync play ") == 0 && syncPlayUs == 0) syncPlayUs = nowUs;
+        std::string typed = text + "\n";
+        for (size_t i = 0; i < typed.size(); i++) {
+          typedFreeUs = std::max(typedFreeUs, nowUs) + BYTE_US;
+          SimEvent event = { typedFreeUs, EVENT_BYTE, 0, (uint8_t)typed[i] };
+          units[0].inbox.push_back(event);
+        }
+      }
+      next++;
+    }
+    if (nowUs >= endUs) break;
+
+    for (int u = 0; u < unitCount; u++) {
+      StepHeader step = { nowUs + STEP_US, (uint32_t)units[u].inbox.size() };
+      writeAll(units[u].toUnit, &step, sizeof(step));
+      writeAll(units[u].toUnit, units[u].inbox.data(), units[u].inbox.size() * sizeof(SimEvent));
+      units[u].inbox.clear();
+    }
+
+    for (int u = 0; u < unitCount; u++) {
+      uint32_t count;
+      if (!readAll(units[u].fromUnit, &count, sizeof(count))) {
+        fprintf(stderr, "unit %d stopped\n", u);
+        return 2;
+      }
+      std::vector<SimEvent> events(count);
+      readAll(units[u].fromUnit, events.data(), count * sizeof(SimEvent));
+
+      for (size_t i = 0; i < events.size(); i++) {
+        const SimEvent& event = events[i];
+        if (event.kind == EVENT_TONE) {
+          units[u].tones.push_back(event);
+          continue;
+        }
+
+        // Daisy chain: on to the next unit. Bus: the master's TX reaches every follower.
+        if (bus && u == 0) {
+          for (int f = 1; f < unitCount; f++) units[f].inbox.push_back(event);
+        } else if (!bus && u + 1 < unitCount) {
+          units[u + 1].inbox.push_back(event);
+        }
+
+        if (event.value == '\n') {
+          if (verbose) printf("%10.3f  %d  %s\n", event.atUs / 1000.0, u, units[u].line.c_str());
+          units[u].line.clear();
+        } else if (event.value != '\r') {
+          units[u].line += (char)event.value;
+        }
+      }
+    }
+  }
+
+  // Reports
+  std::vector<UnitReport> reports(unitCount);
+  for (int u = 0; u < unitCount; u++) {
+    StepHeader step = { 0, 0 };
+    writeAll(units[u].toUnit, &step, sizeof(step));
+    if (!readAll(units[u].fromUnit, &reports[u], sizeof(UnitReport))) {
+      fprintf(stderr, "unit %d did not report\n", u);
+      return 2;
+    }
+    close(units[u].toUnit);
+    close(units[u].fromUnit);
+    waitpid(units[u].pid, NULL, 0);
+  }
+
+  printf("%d units, %s, %.1f s\n", unitCount, bus ? "bus" : "daisy chain", endUs / 1000000.0);
+  printf("%-5s %-9s %7s %8s %7s %9s %9s %8s %6s %9s %9s\n", "unit", "role", "ppm", "boot ms", "locked",
+         "drift", "estimate", "beacons", "notes", "worst ms", "mean ms");
+
+  bool ok = syncPlayUs > 0;
+  for (int u = 0; u < unitCount; u++) {
+    const UnitReport& r = reports[u];
+    const char* role = r.role == SYNC_MASTER ? "master" : r.role == SYNC_FOLLOWER ? "follower" : "off";
+    printf("%-5d %-9s %+7ld %8lu %7s", u, role, units[u].ppm, UNIT_BOOT_MS[u], r.locked ? "yes" : "no");
+
+    if (u == 0) {
+      printf(" %9s %9s %8s %6s\n", "-", "-", "-", "-");
+      continue;
+    }
+
+    // How much faster the master's clock runs than this one's, and what the unit made of it
+    double drift = ((1 + units[0].ppm / 1e6) / (1 + units[u].ppm / 1e6) - 1) * 1e6;
+    double worstMs = 0, totalMs = 0;
+    long compared = compareNotes(units[0], units[u], syncPlayUs, worstMs, totalMs);
+    printf(" %+9.0f %+9lld %8u", drift, (long long)r.driftPpm, r.beacons);
+    if (compared < 0) {
+      printf("  notes differ from the master's\n");
+      ok = false;
+    } else {
+      printf(" %6ld %9.2f %9.2f\n", compared, worstMs, compared ? totalMs / compared : 0);
+      if (compared == 0 || worstMs > toleranceMs || !r.locked) ok = false;
+    }
+  }
+  printf("%s (tolerance %.1f ms)\n", ok ? "in step" : "NOT in step", toleranceMs);
+  return ok ? 0 : 1;
+}
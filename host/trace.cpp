@@ -0,0 +1,361 @@
+/**
+ * @file trace.cpp
+ * @brief Record or check an event trace of the whole sketch on the host
+ *
+ * @details Runs main.ino's setup() and loop() against a virtual clock and
+ * types a scripted serial session into it. Every tone()/noTone(), pin
+ * write, character or glyph row written to the LCD, and line printed to
+ * Serial goes into the trace with its virtual time, so two builds can be
+ * compared line by line.
+ *
+ * The trace ends with budget lines: I2C bytes for each song played, pin
+ * writes per second and heap allocations. When checking against a golden
+ * trace, the run fails if the events differ or if any budget grows by
+ * more than the tolerance, so a change that keeps the output right but
+ * sends more to the LCD or churns the heap still shows up.
+ *
+ * Build from the repository root (see host/Makefile):
+ *   make -C host trace
+ *
+ * Usage: trace [-s session] [-w trace_out] [-g golden] [-l loop_us] [-p tolerance%] [-c card_dir]
+ *   Record a golden on a known-good build:  ./trace -w golden.trace
+ *   Check a later build against it:         ./trace -g golden.trace
+ *
+ * host/golden holds a session and its trace; "make -C host check" runs
+ * it. A change that is meant to alter the trace records it again with
+ * "make -C host golden", in the same commit.
+ *
+ * -c inserts an SD card holding the files in card_dir (see packsongs.cpp),
+ * each 512-byte sector costing 2ms to read. The sketch only looks for
+ * the card when built with -DSD_CARD_CS=<pin>.
+ *
+ * A session file has one "<ms> <text>" per line: that many milliseconds
+ * after setup() returns, the text is typed, followed by a newline. "<ms> .end" stops the run. Blank
+ * lines and lines starting with # are skipped. Without -s a built-in
+ * session plays a song with most settings changed along the way.
+ */
+
+#include "sketch.h"
+
+#include <map>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdarg.h>
+#include <unistd.h>
+
+static const char* DEFAULT_SESSION[] = {
+  "500 status",
+  "1000 play 2",
+  "2500 tempo 120",
+  "4000 viz on",
+  "6000 key 3",
+  "7500 pattern 1",
+  "9000 status",
+  "10000 led off",
+  "12000 viz off",
+  "13000 play 1",
+  "17000 stop",
+  "17500 list",
+  "18500 .end",
+};
+
+/**
+ * @brief One line of typed input, due at a virtual time
+ */
+struct SessionLine {
+  unsigned long atMs;
+  std::string text;
+};
+
+/**
+ * @class TraceBoard
+ * @brief HostBoard that writes everything the sketch does to a trace
+ */
+class TraceBoard : public HostBoard {
+public:
+  std::vector<std::string> lines;
+  unsigned long pinWrites;
+  std::string input;                // Typed but not yet read
+
+  TraceBoard() : pinWrites(0) {}
+
+  void log(const char* format, ...) {
+    char text[256];
+    int used = snprintf(text, sizeof(text), "%10.3f ", nowUs / 1000.0);
+    va_list args;
+    va_start(args, format);
+    vsnprintf(text + used, sizeof(text) - used, format, args);
+    va_end(args);
+    lines.push_back(text);
+  }
+
+  void type(const std::string& text) {
+    log("rx   %s", text.c_str());
+    input += text;
+    input += '\n';
+  }
+
+  void onTone(uint8_t pin, unsigned int frequency) override {
+    pinWrites++;
+    log("tone %u %u", pin, frequency);
+  }
+
+  void onNoTone(uint8_t pin) override {
+    pinWrites++;
+    log("tone %u off", pin);
+  }
+
+  void onPinWrite(uint8_t pin, int value) override {
+    pinWrites++;
+    log("pin  %u %d", pin, value);
+  }
+
+  void onLCDWrite(bool glyph, uint8_t address, uint8_t value) override {
+    if (glyph) {
+      log("cg   %02u.%u %02x", address >> 3, address & 7, value);
+    } else {
+      int row = address >= 0x40 ? 1 : 0;
+      int col = address - (row ? 0x40 : 0);
+      if (value >= 0x20 && value < 0x7F && value != '\'') log("lcd  %d,%02d '%c'", row, col, value);
+      else log("lcd  %d,%02d 0x%02x", row, col, value);
+    }
+  }
+
+  // Serial output, a line at a time
+  void onSerialWrite(uint8_t c) override {
+    if (c == '\n') {
+      log("tx   %s", outputLine.c_str());
+      outputLine.clear();
+    } else if (c != '\r') {
+      outputLine += (char)c;
+    }
+  }
+
+  int onSerialAvailable() override { return input.size(); }
+  int onSerialPeek() override { return input.empty() ? -1 : (unsigned char)input[0]; }
+  int onSerialRead() override {
+    if (input.empty()) return -1;
+    int c = (unsigned char)input[0];
+    input.erase(0, 1);
+    return c;
+  }
+
+private:
+  std::string outputLine;
+};
+
+/**
+ * @brief Read "<ms> <text>" lines
+ */
+static bool parseSession(const std::vector<std::string>& raw, std::vector<SessionLine>& session) {
+  for (size_t i = 0; i < raw.size(); i++) {
+    const std::string& line = raw[i];
+    if (line.empty() || line[0] == '#') continue;
+
+    char* rest = NULL;
+    unsigned long atMs = strtoul(line.c_str(), &rest, 10);
+    if (rest == line.c_str() || (*rest != ' ' && *rest != '\0')) {
+      fprintf(stderr, "session line %u: expected \"<ms> <text>\"\n", (unsigned)i + 1);
+      return false;
+    }
+    if (*rest == ' ') rest++;
+
+    SessionLine entry = { atMs, rest };
+    session.push_back(entry);
+  }
+  return true;
+}
+
+static bool readLines(const char* path, std::vector<std::string>& lines) {
+  FILE* file = fopen(path, "r");
+  if (file == NULL) return false;
+
+  char text[512];
+  while (fgets(text, sizeof(text), file)) {
+    size_t length = strlen(text);
+    while (length > 0 && (text[length - 1] == '\n' || text[length - 1] == '\r')) text[--length] = '\0';
+    lines.push_back(text);
+  }
+  fclose(file);
+  return true;
+}
+
+/**
+ * @brief Pull "# budget <name> <value>" lines out of a trace
+ */
+static std::map<std::string, double> readBudgets(const std::vector<std::string>& lines) {
+  std::map<std::string, double> budgets;
+  for (size_t i = 0; i < lines.size(); i++) {
+    if (lines[i].compare(0, 9, "# budget ") != 0) continue;
+    size_t space = lines[i].rfind(' ');
+    budgets[lines[i].substr(9, space - 9)] = atof(lines[i].c_str() + space + 1);
+  }
+  return budgets;
+}
+
+/**
+ * @brief Compare events exactly and budgets within the tolerance
+ * @return True if the run matches the golden trace
+ */
+static bool checkGolden(const std::vector<std::string>& golden, const std::vector<std::string>& run,
+                        double tolerancePercent) {
+  bool ok = true;
+
+  // Events: everything but the # lines
+  std::vector<std::string> expected;
+  std::vector<std::string> actual;
+  for (size_t i = 0; i < golden.size(); i++) if (golden[i].compare(0, 1, "#") != 0) expected.push_back(golden[i]);
+  for (size_t i = 0; i < run.size(); i++) if (run[i].compare(0, 1, "#") != 0) actual.push_back(run[i]);
+
+  size_t common = std::min(expected.size(), actual.size());
+  size_t first = common;
+  for (size_t i = 0; i < common; i++) {
+    if (expected[i] != actual[i]) {
+      first = i;
+      break;
+    }
+  }
+  if (first < common || expected.size() != actual.size()) {
+    ok = false;
+    printf("events differ from event %u:\n", (unsigned)first + 1);
+    for (size_t i = first; i < first + 5 && i < std::max(expected.size(), actual.size()); i++) {
+      printf("  golden: %s\n", i < expected.size() ? expected[i].c_str() : "(end)");
+      printf("  run:    %s\n", i < actual.size() ? actual[i].c_str() : "(end)");
+    }
+  } else {
+    printf("events match (%u)\n", (unsigned)actual.size());
+  }
+
+  std::map<std::string, double> limits = readBudgets(golden);
+  std::map<std::string, double> measured = readBudgets(run);
+  printf("\n%-32s %10s %10s %10s\n", "budget", "golden", "run", "limit");
+  for (std::map<std::string, double>::iterator it = limits.begin(); it != limits.end(); ++it) {
+    double limit = it->second * (1 + tolerancePercent / 100);
+    bool present = measured.count(it->first) > 0;
+    double value = present ? measured[it->first] : 0;
+    bool over = present && value > limit;
+    printf("%-32s %10.1f %10.1f %10.1f%s\n", it->first.c_str(), it->second, value, limit,
+           !present ? "  missing" : over ? "  OVER" : "");
+    if (over) ok = false;
+  }
+  return ok;
+}
+
+static void usage() {
+  fprintf(stderr, "usage: trace [-s session] [-w trace_out] [-g golden] [-l loop_us] [-p tolerance%%] [-c card_dir]\n");
+}
+
+int main(int argc, char** argv) {
+  const char* sessionPath = NULL;
+  const char* outPath = NULL;
+  const char* goldenPath = NULL;
+  unsigned long loopUs = 1000;
+  double tolerancePercent = 10;
+  const char* cardDir = NULL;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "s:w:g:l:p:c:h")) != -1) {
+    switch (opt) {
+      case 's': sessionPath = optarg; break;
+      case 'w': outPath = optarg; break;
+      case 'g': goldenPath = optarg; break;
+      case 'l': loopUs = strtoul(optarg, NULL, 10); break;
+      case 'p': tolerancePercent = atof(optarg); break;
+      case 'c': cardDir = optarg; break;
+      default: usage(); return 2;
+    }
+  }
+  if (loopUs == 0) {
+    usage();
+    return 2;
+  }
+
+  std::vector<std::string> rawSession;
+  if (sessionPath != NULL) {
+    if (!readLines(sessionPath, rawSession)) {
+      fprintf(stderr, "cannot read %s\n", sessionPath);
+      return 2;
+    }
+  } else {
+    rawSession.assign(DEFAULT_SESSION, DEFAULT_SESSION + sizeof(DEFAULT_SESSION) / sizeof(DEFAULT_SESSION[0]));
+  }
+  std::vector<SessionLine> session;
+  if (!parseSession(rawSession, session)) return 2;
+
+  TraceBoard board;
+  board.i2cByteUs = 90;     // 100kHz I2C, as on the board
+  board.sdRoot = cardDir;
+  board.sdSectorUs = 2000;
+  board.makeCurrent();
+
+  setup();
+  board.log("---- setup done");
+
+  // Session times count from here. Run until the session ends (or 2s
+  // after its last line).
+  unsigned long startMs = board.nowUs / 1000;
+  unsigned long endMs = startMs + (session.empty() ? 2000 : session.back().atMs + 2000);
+  std::map<int, unsigned long> songI2C;
+  size_t next = 0;
+  unsigned long passes = 0;
+
+  while (board.nowUs / 1000 < endMs) {
+    while (next < session.size() && (startMs + session[next].atMs) * 1000 <= board.nowUs) {
+      if (session[next].text == ".end") {
+        endMs = startMs + session[next].atMs;
+      } else {
+        board.type(session[next].text);
+      }
+      next++;
+    }
+    if (board.nowUs / 1000 >= endMs) break;
+
+    unsigned long i2cBefore = board.i2cBytes;
+    loop();
+    passes++;
+    if (buzzer.isPlaying()) songI2C[currentSong] += board.i2cBytes - i2cBefore;
+
+    board.advance(loopUs);
+  }
+
+  // Budgets
+  double seconds = board.nowUs / 1000000.0;  // Setup included
+  char text[96];
+  snprintf(text, sizeof(text), "# run %.3f s, %lu loop passes", seconds, passes);
+  board.lines.push_back(text);
+  for (std::map<int, unsigned long>::iterator it = songI2C.begin(); it != songI2C.end(); ++it) {
+    snprintf(text, sizeof(text), "# budget i2c-bytes song %d %lu", it->first, it->second);
+    board.lines.push_back(text);
+  }
+  snprintf(text, sizeof(text), "# budget pin-writes-per-second %.1f", board.pinWrites / seconds);
+  board.lines.push_back(text);
+  snprintf(text, sizeof(text), "# budget heap-allocations %lu", board.heapAllocations);
+  board.lines.push_back(text);
+  snprintf(text, sizeof(text), "# heap peak %ld bytes, %ld still allocated", board.heapPeakBytes, board.heapBytes);
+  board.lines.push_back(text);
+
+  if (outPath != NULL) {
+    FILE* file = fopen(outPath, "w");
+    if (file == NULL) {
+      fprintf(stderr, "cannot write %s\n", outPath);
+      return 2;
+    }
+    for (size_t i = 0; i < board.lines.size(); i++) fprintf(file, "%s\n", board.lines[i].c_str());
+    fclose(file);
+  }
+
+  if (goldenPath != NULL) {
+    std::vector<std::string> golden;
+    if (!readLines(goldenPath, golden)) {
+      fprintf(stderr, "cannot read %s\n", goldenPath);
+      return 2;
+    }
+    return checkGolden(golden, board.lines, tolerancePercent) ? 0 : 1;
+  }
+
+  if (outPath == NULL) {
+    for (size_t i = 0; i < board.lines.size(); i++) printf("%s\n", board.lines[i].c_str());
+  }
+  return 0;
+}
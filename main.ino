@@ -11,8 +11,18 @@
  */
 
 #include "DualBuzzer.h"
+#include "SettingsStore.h"
+#include "NoteStream.h"
+#include "SongCard.h"
+#include "PitchTimer.h"
+#include "LoopScheduler.h"
+#include "PowerSaver.h"
+#include "ClockSync.h"
+#include "FlightRecorder.h"
+#include "KaraokeScorer.h"
 #include <LiquidCrystal_I2C.h>
 #include "pitches.h"
+#include "songs.h"
 
 // Pin definitions
 const int MELODY_BUZZER_PIN = 9;
@@ -30,8 +40,9 @@ const int LCD_ADDRESS = 0x27;
 const int LCD_COLS = 16;
 const int LCD_ROWS = 2;
 
-// Initialize I2C LCD
-LiquidCrystal_I2C lcd(LCD_ADDRESS, LCD_COLS, LCD_ROWS);
+// Initialize I2C LCD; drawing goes through the non-blocking AsyncLCD front end
+LiquidCrystal_I2C lcdDriver(LCD_ADDRESS, LCD_COLS, LCD_ROWS);
+AsyncLCD lcd(lcdDriver, LCD_ADDRESS, LCD_COLS, LCD_ROWS);
 bool lcdAvailable = false;
 
 
@@ -46,345 +57,371 @@ const Note startupChime[] PROGMEM = {
   {NOTE_G4, 150}, {NOTE_C5, 300}
 };
 
-// Song 1: Twinkle Twinkle Little Star - PROGMEM
-const Note twinkleMelody[] PROGMEM = {
-  // Verse 1: "Twinkle, twinkle, little star"
-  {NOTE_C4, 400}, {NOTE_C4, 400}, {NOTE_G4, 400}, {NOTE_G4, 400},
-  {NOTE_A4, 400}, {NOTE_A4, 400}, {NOTE_G4, 800},
-  
-  // "How I wonder what you are"
-  {NOTE_F4, 400}, {NOTE_F4, 400}, {NOTE_E4, 400}, {NOTE_E4, 400},
-  {NOTE_D4, 400}, {NOTE_D4, 400}, {NOTE_C4, 800},
-  
-  // Verse 2: "Up above the world so high"
-  {NOTE_G4, 400}, {NOTE_G4, 400}, {NOTE_F4, 400}, {NOTE_F4, 400},
-  {NOTE_E4, 400}, {NOTE_E4, 400}, {NOTE_D4, 800},
-  
-  // "Like a diamond in the sky"
-  {NOTE_G4, 400}, {NOTE_G4, 400}, {NOTE_F4, 400}, {NOTE_F4, 400},
-  {NOTE_E4, 400}, {NOTE_E4, 400}, {NOTE_D4, 800},
-  
-  // Verse 3: "When the blazing sun is gone"
-  {NOTE_C4, 400}, {NOTE_C4, 400}, {NOTE_G4, 400}, {NOTE_G4, 400},
-  {NOTE_A4, 400}, {NOTE_A4, 400}, {NOTE_G4, 800},
-  
-  // "When he nothing shines upon"
-  {NOTE_F4, 400}, {NOTE_F4, 400}, {NOTE_E4, 400}, {NOTE_E4, 400},
-  {NOTE_D4, 400}, {NOTE_D4, 400}, {NOTE_C4, 800},
-  
-  // Verse 4: "Then you show your little light"
-  {NOTE_G4, 400}, {NOTE_G4, 400}, {NOTE_F4, 400}, {NOTE_F4, 400},
-  {NOTE_E4, 400}, {NOTE_E4, 400}, {NOTE_D4, 800},
-  
-  // "Twinkle, twinkle, all the night"
-  {NOTE_G4, 400}, {NOTE_G4, 400}, {NOTE_F4, 400}, {NOTE_F4, 400},
-  {NOTE_E4, 400}, {NOTE_E4, 400}, {NOTE_D4, 800},
-  
-  // Final verse: "Twinkle, twinkle, little star"
-  {NOTE_C4, 400}, {NOTE_C4, 400}, {NOTE_G4, 400}, {NOTE_G4, 400},
-  {NOTE_A4, 400}, {NOTE_A4, 400}, {NOTE_G4, 800},
-  
-  // "How I wonder what you are"
-  {NOTE_F4, 400}, {NOTE_F4, 400}, {NOTE_E4, 400}, {NOTE_E4, 400},
-  {NOTE_D4, 400}, {NOTE_D4, 400}, {NOTE_C4, 800}
-};
+// Song management variables
+int currentSong = 0;
+bool autoPlay = false;
+bool ledsEnabled = true;
+int currentLEDPattern = LED_PATTERN_DEFAULT; // Index in LED_PATTERNS (see LEDPatterns.h)
 
+bool userStopped = false; // Track if user manually stopped/paused
+bool waitingForPlayAgain = false; // Track if we're waiting for play again response
+bool wasPlaying = false;
+unsigned long playAgainStart = 0; // When the play again question was asked
+const unsigned long PLAY_AGAIN_WAIT_TIME = 10000; // 10 seconds to respond
 
-const Note twinkleHarmony[] PROGMEM = {
-  // Verse 1 harmony
-  {NOTE_E4, 400}, {NOTE_E4, 400}, {NOTE_B4, 400}, {NOTE_B4, 400},
-  {NOTE_C5, 400}, {NOTE_C5, 400}, {NOTE_B4, 800},
-  {NOTE_A4, 400}, {NOTE_A4, 400}, {NOTE_G4, 400}, {NOTE_G4, 400},
-  {NOTE_F4, 400}, {NOTE_F4, 400}, {NOTE_E4, 800},
-  
-  // Verse 2 harmony
-  {NOTE_E4, 400}, {NOTE_E4, 400}, {NOTE_D4, 400}, {NOTE_D4, 400},
-  {NOTE_C4, 400}, {NOTE_C4, 400}, {NOTE_B3, 800},
-  {NOTE_E4, 400}, {NOTE_E4, 400}, {NOTE_D4, 400}, {NOTE_D4, 400},
-  {NOTE_C4, 400}, {NOTE_C4, 400}, {NOTE_B3, 800},
-  
-  // Verse 3 harmony
-  {NOTE_E4, 400}, {NOTE_E4, 400}, {NOTE_B4, 400}, {NOTE_B4, 400},
-  {NOTE_C5, 400}, {NOTE_C5, 400}, {NOTE_B4, 800},
-  {NOTE_A4, 400}, {NOTE_A4, 400}, {NOTE_G4, 400}, {NOTE_G4, 400},
-  {NOTE_F4, 400}, {NOTE_F4, 400}, {NOTE_E4, 800},
-  
-  // Verse 4 harmony
-  {NOTE_E4, 400}, {NOTE_E4, 400}, {NOTE_D4, 400}, {NOTE_D4, 400},
-  {NOTE_C4, 400}, {NOTE_C4, 400}, {NOTE_B3, 800},
-  {NOTE_E4, 400}, {NOTE_E4, 400}, {NOTE_D4, 400}, {NOTE_D4, 400},
-  {NOTE_C4, 400}, {NOTE_C4, 400}, {NOTE_B3, 800},
-  
-  // Final verse harmony
-  {NOTE_E4, 400}, {NOTE_E4, 400}, {NOTE_B4, 400}, {NOTE_B4, 400},
-  {NOTE_C5, 400}, {NOTE_C5, 400}, {NOTE_B4, 800},
-  {NOTE_A4, 400}, {NOTE_A4, 400}, {NOTE_G4, 400}, {NOTE_G4, 400},
-  {NOTE_F4, 400}, {NOTE_F4, 400}, {NOTE_E4, 800}
-};
+// Playlist queue (ring buffer of song numbers)
+const int QUEUE_CAPACITY = 8;
+int playQueue[QUEUE_CAPACITY];
+int queueHead = 0;
+int queueCount = 0;
+unsigned long songGap = 0; // Silence between songs when advancing on its own (ms)
+const unsigned long MAX_SONG_GAP = 10000;
 
-// Word-based lyrics for Twinkle Twinkle Little Star - PROGMEM
+// Next song, prefetched and cued while the current one plays
+struct PreparedSong {
+  int index;                 // Song number, or -1 if nothing is prepared
+  bool fromQueue;            // Pop the queue when it starts
+  Song header;               // RAM copy of the songs[] entry
+  char title[LCD_COLS + 1];  // Title card, already cut to the display width
+};
+PreparedSong nextSong = { -1, false, {}, "" };
 
-const LyricTiming twinkleLyricTimings[] PROGMEM = {
-    // First verse
-    {"Twinkle", 0}, {"twinkle", 2}, {"little", 4}, {"star", 6},
-    {"How", 7}, {"I", 8}, {"wonder", 9}, {"what", 11}, {"you", 12}, {"are", 13},
+// Settings and resume point kept in EEPROM
+SettingsStore settingsStore;
+SavedState savedState;       // Copy of the record last loaded or written
+bool fastBoot = false;       // Skip the startup show and long help on power-up
+unsigned long lastResumeSave = 0;
+const unsigned long RESUME_SAVE_INTERVAL = 300000; // Checkpoint a long song's position while playing
 
-    // Second verse
-    {"Up", 14}, {"above", 15}, {"the", 17}, {"world", 18}, {"so", 19}, {"high", 20},
-    {"Like", 21}, {"a", 22}, {"diamond", 23}, {"in", 25}, {"the", 26}, {"sky", 27},
+// Songs sent over serial while they play (see NoteStream.h)
+NoteStream noteStream;
 
-    // Third verse
-    {"When", 28}, {"the", 29}, {"blazing", 30}, {"sun", 32}, {"is", 33}, {"gone", 34},
-    {"When", 35}, {"he", 36}, {"nothing", 37}, {"shines", 39}, {"upon", 40},
+// Song library on an SD card (see SongCard.h), used in place of songs[]
+// when a card with an index is found. Build with -DSD_CARD_CS=<pin> to
+// look for one; the reader takes SPI pins 11-13, so move the blue and
+// white LEDs off them first.
+SongCard songCard;
+int librarySize = SONG_COUNT;
 
-    // Fourth verse
-    {"Then", 42}, {"you", 43}, {"show", 44}, {"your", 45}, {"little", 46}, {"light", 48},
-    {"Twinkle", 49}, {"twinkle", 51}, {"all", 53}, {"the", 54}, {"night", 55},
+// Serial command handling
+const unsigned long SERIAL_BAUD = 9600;
+String serialBuffer = "";
+const unsigned long SERIAL_CHECK_INTERVAL = 100; // Check serial every 100ms
 
-    // Final verse
-    {"Twinkle", 56}, {"twinkle", 58}, {"little", 60}, {"star", 62},
-    {"How", 63}, {"I", 64}, {"wonder", 65}, {"what", 67}, {"you", 68}, {"are", 69}
-};
+// What loop() runs, and how often (see LoopScheduler.h). Audio comes
+// first so a busy LCD or serial line costs the notes as little as
+// possible. Budgets are for an Uno; runs over them show in "tasks".
+void audioTask();
+void ledTask();
+void micTask();
+void idleTask();
+void lcdTask();
+void serialTask();
+void playerTask();
 
+enum TaskId { TASK_AUDIO, TASK_LEDS, TASK_MIC, TASK_IDLE, TASK_LCD, TASK_SERIAL, TASK_PLAYER, TASK_COUNT };
 
-// Song 2: Jingle Bells - PROGMEM
-const Note jingleMelody[] PROGMEM = {
-  // "Jingle bells, jingle bells"
-  {NOTE_E4, 300}, {NOTE_E4, 300}, {NOTE_E4, 600},
-  {NOTE_E4, 300}, {NOTE_E4, 300}, {NOTE_E4, 600},
-  {NOTE_E4, 300}, {NOTE_G4, 300}, {NOTE_C4, 450}, {NOTE_D4, 150},
-  {NOTE_E4, 1200},
-  
-  // "Jingle all the way"
-  {NOTE_F4, 300}, {NOTE_F4, 300}, {NOTE_F4, 450}, {NOTE_F4, 150},
-  {NOTE_F4, 300}, {NOTE_E4, 300}, {NOTE_E4, 300}, {NOTE_E4, 300},
-  {NOTE_E4, 300}, {NOTE_D4, 300}, {NOTE_D4, 300}, {NOTE_E4, 300},
-  {NOTE_D4, 600}, {NOTE_G4, 600},
-  
-  // "Oh what fun it is to ride"
-  {NOTE_E4, 300}, {NOTE_E4, 300}, {NOTE_E4, 600},
-  {NOTE_E4, 300}, {NOTE_E4, 300}, {NOTE_E4, 600},
-  {NOTE_E4, 300}, {NOTE_G4, 300}, {NOTE_C4, 450}, {NOTE_D4, 150},
-  {NOTE_E4, 1200},
-  
-  // "In a one-horse open sleigh"
-  {NOTE_F4, 300}, {NOTE_F4, 300}, {NOTE_F4, 450}, {NOTE_F4, 150},
-  {NOTE_F4, 300}, {NOTE_E4, 300}, {NOTE_E4, 300}, {NOTE_E4, 300},
-  {NOTE_G4, 300}, {NOTE_G4, 300}, {NOTE_F4, 300}, {NOTE_D4, 300},
-  {NOTE_C4, 1200}
+LoopTask tasks[TASK_COUNT] = {
+  // name      run          period (ms)             priority  budget (us)
+  { "audio",  audioTask,   0,                      7,        500 },
+  { "leds",   ledTask,     LED_FRAME_INTERVAL,     6,        500 },  // Envelope step; set again in setup()
+  { "mic",    micTask,     0,                      5,        1000 }, // At most SCORE_DRAIN_MAX samples
+  { "idle",   idleTask,    IDLE_FRAME_INTERVAL,    4,        2000 },
+  { "lcd",    lcdTask,     0,                      3,        1500 },  // AsyncLCD stops itself at 1000us
+  { "serial", serialTask,  SERIAL_CHECK_INTERVAL,  2,        2000 },
+  { "player", playerTask,  0,                      1,        1000 }
 };
+LoopScheduler scheduler;
 
-const Note jingleHarmony[] PROGMEM = {
-  // Harmony for "Jingle bells, jingle bells"
-  {NOTE_C4, 300}, {NOTE_C4, 300}, {NOTE_C4, 600},
-  {NOTE_C4, 300}, {NOTE_C4, 300}, {NOTE_C4, 600},
-  {NOTE_C4, 300}, {NOTE_E4, 300}, {NOTE_G3, 450}, {NOTE_B3, 150},
-  {NOTE_C4, 1200},
-  
-  // Harmony for "Jingle all the way"
-  {NOTE_D4, 300}, {NOTE_D4, 300}, {NOTE_D4, 450}, {NOTE_D4, 150},
-  {NOTE_D4, 300}, {NOTE_C4, 300}, {NOTE_C4, 300}, {NOTE_C4, 300},
-  {NOTE_G3, 300}, {NOTE_B3, 300}, {NOTE_B3, 300}, {NOTE_C4, 300},
-  {NOTE_B3, 600}, {NOTE_D4, 600},
-  
-  // Repeat harmony pattern
-  {NOTE_C4, 300}, {NOTE_C4, 300}, {NOTE_C4, 600},
-  {NOTE_C4, 300}, {NOTE_C4, 300}, {NOTE_C4, 600},
-  {NOTE_C4, 300}, {NOTE_E4, 300}, {NOTE_G3, 450}, {NOTE_B3, 150},
-  {NOTE_C4, 1200},
-  
-  {NOTE_D4, 300}, {NOTE_D4, 300}, {NOTE_D4, 450}, {NOTE_D4, 150},
-  {NOTE_D4, 300}, {NOTE_C4, 300}, {NOTE_C4, 300}, {NOTE_C4, 300},
-  {NOTE_E4, 300}, {NOTE_E4, 300}, {NOTE_D4, 300}, {NOTE_B3, 300},
-  {NOTE_G3, 1200}
-};
+// Sleeps between tasks while nothing is playing (see PowerSaver.h)
+PowerSaver powerSaver;
 
-const LyricTiming jingleLyricTimings[] PROGMEM = {
-    // First verse: "Jingle bells, jingle bells, jingle all the way"
-    {"Jingle", 0}, {"bells", 1}, {"jingle", 3}, {"bells", 4}, {"jingle", 6},
-    {"all", 7}, {"the", 8}, {"way", 9},
+// The last few notes, commands and slow passes, kept across a watchdog
+// reset for the "trace" command (see FlightRecorder.h)
+FlightRecorder flightRecorder;
 
-    // Second part: "Oh what fun it is to ride in a one-horse open sleigh"
-    {"Oh", 11}, {"what", 12}, {"fun", 13}, {"it", 14}, {"is", 15}, {"to", 16}, {"ride", 17},
-    {"in", 18}, {"a", 19}, {"one", 20}, {"horse", 21}, {"open", 22}, {"sleigh", 23},
+// Scores singing into a microphone module against the melody (see
+// KaraokeScorer.h). Build with -DMIC_PIN=A0, or another analog pin, to
+// use one. Each line's score shows on the LCD as the next line begins.
+KaraokeScorer scorer;
+bool micEnabled = true;
+int scoredLine = 0;     // buzzer.getLyricLine() for the line being scored
 
-    // Repeat: "Jingle bells, jingle bells, jingle all the way"
-    {"Jingle", 25}, {"bells", 26}, {"jingle", 28}, {"bells", 29}, {"jingle", 31},
-    {"all", 32}, {"the", 33}, {"way", 34},
+// Song clock shared with other units on the serial line (see ClockSync.h)
+ClockSync clockSync;
+const char* const syncRoleNames[] = {"off", "master", "follower"};
 
-    // Final: "Oh what fun it is to ride in a one-horse open sleigh"
-    {"Oh", 36}, {"what", 37}, {"fun", 38}, {"it", 39}, {"is", 40}, {"to", 41}, {"ride", 42},
-    {"in", 43}, {"a", 44}, {"one", 45}, {"horse", 46}, {"open", 47}, {"sleigh", 48}
-};
+// Names for the "harmony" command, in HarmonyRule order
+const char* const harmonyNames[HARMONY_RULE_COUNT] = {"song", "third", "sixth", "drone", "bass"};
 
-// Song 3: Mary Had a Little Lamb
-const Note maryMelody[] PROGMEM = {
-  // Verse 1
-  {NOTE_E4, 400}, {NOTE_D4, 400}, {NOTE_C4, 400}, {NOTE_D4, 400},
-  {NOTE_E4, 400}, {NOTE_E4, 400}, {NOTE_E4, 800},
+void setup() {
+  // Initialize Serial for commands
+  Serial.begin(SERIAL_BAUD);
+  noteStream.begin(Serial);
+  clockSync.begin(Serial, SERIAL_BAUD);
   
-  {NOTE_D4, 400}, {NOTE_D4, 400}, {NOTE_D4, 800},
+#ifdef SD_CARD_CS
+  if (songCard.begin(SD_CARD_CS)) {
+    librarySize = songCard.getSongCount();
+  }
+#endif
+#ifdef MIC_PIN
+  scorer.begin(MIC_PIN);
+#endif
   
-  {NOTE_E4, 400}, {NOTE_G4, 400}, {NOTE_G4, 800},
+  // Restore saved settings before anything is shown
+  bool restored = settingsStore.load(savedState);
+  if (restored) {
+    applySettings(savedState);
+  } else {
+    captureSettings(savedState);
+    savedState.song = -1;
+    savedState.resume = false;
+    savedState.positionMs = 0;
+  }
   
-  {NOTE_E4, 400}, {NOTE_D4, 400}, {NOTE_C4, 400}, {NOTE_D4, 400},
-  {NOTE_E4, 400}, {NOTE_E4, 400}, {NOTE_E4, 400}, {NOTE_E4, 400},
+  if (fastBoot) {
+    // The full help is ~1.5KB, which blocks for over a second at 9600 baud
+    Serial.println();
+    Serial.println("=== Music Player === (fast boot)");
+  } else {
+    Serial.println();
+    Serial.println("=== Music Player ===");
+    Serial.println("Commands:");
+    Serial.println("  play <song_number> - Play specific song (0-" + String(librarySize-1) + ")");
+    Serial.println("  stop - Stop current playback");
+    Serial.println("  list - List all available songs");
+    Serial.println("  auto on/off - Enable/disable auto-play");
+    Serial.println("  led on/off - Enable/disable LEDs");
+    Serial.println("  viz on/off - Pitch bars on the bottom LCD row");
+    Serial.println("  pattern <0-" + String(LED_PATTERN_COUNT-1) + "> - Change LED pattern");
+    Serial.println("  queue <song_number> - Add a song to the playlist");
+    Serial.println("  queue / queue clear - Show or empty the playlist");
+    Serial.println("  next - Skip to the next song");
+    Serial.println("  shuffle - Shuffle the playlist");
+    Serial.println("  gap <ms> - Silence between songs (0 = gapless)");
+    Serial.println("  tempo <25-400> - Playback speed in percent");
+    Serial.println("  key <-12..+12> - Transpose by semitones");
+    Serial.println("  harmony <song|third|sixth|drone|bass> - Written or generated harmony");
+    Serial.println("  vol melody/harmony <0-" + String(PITCH_VOLUME_MAX) + "> - Volume of each part");
+    Serial.println("  mic / mic on/off - Singing score from the microphone (MIC_PIN builds)");
+    Serial.println("  status - Show current status");
+    Serial.println("  bench - Time a note change (tone() vs pitch table)");
+    Serial.println("  tasks / tasks reset - Scheduler timings / clear them");
+    Serial.println("  power - Time asleep and estimated charge used");
+    Serial.println("  trace / trace clear - Recent events, kept across a watchdog reset / empty it");
+    Serial.println("  sync master/follow/off - Share a song clock with other units");
+    Serial.println("  sync play <song_number> [lead_ms] / sync stop - Start or stop every unit together");
+    Serial.println("  save / reset - Store settings in EEPROM / restore defaults");
+    Serial.println("  fastboot on/off - Skip the startup show on power-up");
+    Serial.println("  ~ lines - Song streamed from a host (see README)");
+    Serial.println("  yes/y - Play song again (when prompted)");
+    Serial.println("  no/n - Skip to next song (when prompted)");
+    Serial.println("  help - Show this help menu");
+    Serial.println();
+  }
+
+  // Initialize I2C LCD
+  lcd.begin();
+  lcdAvailable = true;
   
-  {NOTE_D4, 400}, {NOTE_D4, 400}, {NOTE_E4, 400}, {NOTE_D4, 400},
-  {NOTE_C4, 800}
-};
+  // Set up the buzzer with LCD display
+  buzzer.setLCD(&lcd, LCD_ROWS, LCD_COLS);
+  buzzer.setClock(sharedClock);
+  buzzer.setRecorder(&flightRecorder);
+  
+  // Setup LEDs
+  buzzer.setupLEDs(LED_RED_PIN, LED_BLUE_PIN, LED_GREEN_PIN, LED_YELLOW_PIN, LED_WHITE_PIN);
+  buzzer.enableLEDs(ledsEnabled);
+  buzzer.setLEDPattern(currentLEDPattern);
 
-const Note maryHarmony[] PROGMEM = {
-  // Verse 1 harmony
-  {NOTE_C4, 400}, {NOTE_B3, 400}, {NOTE_A3, 400}, {NOTE_B3, 400},
-  {NOTE_C4, 400}, {NOTE_C4, 400}, {NOTE_C4, 800},
+  if (!fastBoot) {
+    // Play startup sequence with chime and animation
+    playStartupSequence();
+    
+    // Allow time to read the startup message
+    delay(1500);
+  }
   
-  {NOTE_B3, 400}, {NOTE_B3, 400}, {NOTE_B3, 800},
+  buzzer.startIdleMode();
   
-  {NOTE_C4, 400}, {NOTE_E4, 400}, {NOTE_E4, 800},
+  // Carry on from where the last session left off
+  if (restored && savedState.resume && savedState.song >= 0 && savedState.song < librarySize) {
+    resumeSong(savedState.song, savedState.positionMs);
+  }
   
-  {NOTE_C4, 400}, {NOTE_B3, 400}, {NOTE_A3, 400}, {NOTE_B3, 400},
-  {NOTE_C4, 400}, {NOTE_C4, 400}, {NOTE_C4, 400}, {NOTE_C4, 400},
+  if (songCard.isPresent()) {
+    Serial.println("SD card: " + String(librarySize) + " songs");
+  }
+  if (scorer.isFitted()) {
+    Serial.println("Microphone: singing is scored. Type 'mic' to check the level.");
+  }
   
-  {NOTE_B3, 400}, {NOTE_B3, 400}, {NOTE_C4, 400}, {NOTE_B3, 400},
-  {NOTE_A3, 800}
-};
-
-// Lyrics timings: word and index of melody note start
-const LyricTiming maryLyricTimings[] PROGMEM = {
-  {"Mary", 0}, {"had", 2}, {"a", 3}, {"little", 4}, {"lamb,", 6},
-  {"little", 7}, {"lamb,", 9},
-  {"Its", 10}, {"fleece", 11}, {"was", 12},
-  {"white", 13}, {"as", 14}, {"snow.", 15},
-  {"Everywhere", 16}, {"that", 17}, {"Mary", 18}, {"went,", 20}, {"the", 22}, {"lamb", 23}
-};
-
+  // Last, so the startup show doesn't count as a stall
+  flightRecorder.begin();
+  if (flightRecorder.wasWatchdogReset()) {
+    Serial.println("Restarted by the watchdog after a stall. Type 'trace' to see what led up to it.");
+  }
+  Serial.println("System ready! Type 'help' for commands.");
+  
+  tasks[TASK_LEDS].periodMs = buzzer.getLEDInterval();
+  scheduler.begin(tasks, TASK_COUNT);
+  powerSaver.begin(Serial);
+}
 
+void loop() {
+  scheduler.run();
+  flightRecorder.endPass(scheduler.getLastPass(), scheduler.getLastSlowest());
+  
+  // Idle or stopped: sleep until the next LED or idle frame, or a command.
+  // A command is handled as soon as it wakes us rather than at the next
+  // serial check, so "play" starts no later than it would awake.
+  if (canSleep()) {
+    if (powerSaver.sleep(sleepTime())) {
+      scheduler.wake(TASK_SERIAL);
+    }
+  }
+}
 
-// Song management variables
-struct Song {
-  const Note* melody;
-  int melodyLength;
-  const Note* harmony;
-  int harmonyLength;
-  const LyricTiming* lyrics;
-  int lyricsCount;
-  const char* name;
-};
+/**
+ * @brief Check whether the every-pass tasks have nothing to do
+ * 
+ * True when no song is playing, cued, due to start or streaming, and no EEPROM write,
+ * LCD change or serial input is waiting.
+ */
+bool canSleep() {
+  return !buzzer.isPlaying() && !buzzer.isSongCued() && !buzzer.isStartPending() && !noteStream.isActive() &&
+         !settingsStore.isBusy() && lcd.isIdle() && Serial.available() == 0;
+}
 
-const Song songs[] PROGMEM = {
-  {
-    twinkleMelody, sizeof(twinkleMelody) / sizeof(twinkleMelody[0]),
-    twinkleHarmony, sizeof(twinkleHarmony) / sizeof(twinkleHarmony[0]),
-    twinkleLyricTimings, sizeof(twinkleLyricTimings) / sizeof(twinkleLyricTimings[0]),
-    "Twinkle Little Star"
-  },
-  {
-    jingleMelody, sizeof(jingleMelody) / sizeof(jingleMelody[0]),
-    jingleHarmony, sizeof(jingleHarmony) / sizeof(jingleHarmony[0]),
-    jingleLyricTimings, sizeof(jingleLyricTimings) / sizeof(jingleLyricTimings[0]),
-    "Jingle Bells"
-  },
-  {
-    maryMelody, sizeof(maryMelody) / sizeof(maryMelody[0]),
-    maryHarmony, sizeof(maryHarmony) / sizeof(maryHarmony[0]),
-    maryLyricTimings, sizeof(maryLyricTimings) / sizeof(maryLyricTimings[0]),
-    "Mary Had a Little Lamb"
+/**
+ * @brief How long loop() may sleep for
+ * @return Milliseconds until a periodic task or the play again timeout is due
+ */
+unsigned long sleepTime() {
+  unsigned long slack = scheduler.getSlack();
+  if (waitingForPlayAgain) {
+    unsigned long waited = millis() - playAgainStart;
+    unsigned long left = waited < PLAY_AGAIN_WAIT_TIME ? PLAY_AGAIN_WAIT_TIME - waited : 0;
+    slack = min(slack, left);
   }
-};
-
+  return slack;
+}
 
-const int SONG_COUNT = sizeof(songs) / sizeof(songs[0]);
-int currentSong = 0;
-bool autoPlay = false;
-bool ledsEnabled = true;
-int currentLEDPattern = 3;
-const int LED_PATTERN_COUNT = 4;
+// Notes and cued songs
+void audioTask() {
+  buzzer.updateAudio();
+}
 
-bool userStopped = false; // Track if user manually stopped/paused
-bool waitingForPlayAgain = false; // Track if we're waiting for play again response
-bool wasPlaying = false;
-unsigned long playAgainTimeout = 0; 
-const unsigned long PLAY_AGAIN_WAIT_TIME = 10000; // 10 seconds to respond
+void ledTask() {
+  buzzer.updateLEDs();
+}
 
-// Serial command handling
-String serialBuffer = "";
-unsigned long lastSerialCheck = 0;
-const unsigned long SERIAL_CHECK_INTERVAL = 100; // Check serial every 100ms
+// Microphone against the melody, and each line's score as the next begins
+void micTask() {
+  bool singing = scorer.isFitted() && micEnabled && buzzer.isPlaying() && !buzzer.isHolding();
+  scorer.listen(singing);
+  if (!singing) return;
+  
+  scorer.update(buzzer.getPitch(MELODY_VOICE));
+  
+  int line = buzzer.getLyricLine();
+  if (line != scoredLine) {
+    scoredLine = line;
+    int percent = scorer.endLine();
+    if (percent >= 0) buzzer.showLineScore(percent);
+  }
+}
 
-// Pattern
-String patternNames[] = {"Rainbow Chase", "Sequential Notes", "Note Mapping", "Random Notes"};
+void idleTask() {
+  buzzer.updateIdleScreen();
+}
 
-void setup() {
-  // Initialize Serial for commands
-  Serial.begin(9600);
-  Serial.println();
-  Serial.println("=== Music Player ===");
-  Serial.println("Commands:");
-  Serial.println("  play <song_number> - Play specific song (0-" + String(SONG_COUNT-1) + ")");
-  Serial.println("  stop - Stop current playback");
-  Serial.println("  list - List all available songs");
-  Serial.println("  auto on/off - Enable/disable auto-play");
-  Serial.println("  led on/off - Enable/disable LEDs");
-  Serial.println("  pattern <0-3> - Change LED pattern");
-  Serial.println("  status - Show current status");
-  Serial.println("  yes/y - Play song again (when prompted)");
-  Serial.println("  no/n - Skip to next song (when prompted)");
-  Serial.println("  help - Show this help menu");
-  Serial.println();
+// Lyrics, visualizer and the I2C drain
+void lcdTask() {
+  buzzer.updateDisplay();
+}
 
-  // Initialize I2C LCD
-  lcd.init();
-  lcd.backlight();
-  lcdAvailable = true;
+// Commands, plus stream credit, telemetry, the stall timeout and sync beacons
+void serialTask() {
+  handleSerialCommands();
+  clockSync.update();
   
-  // Set up the buzzer with LCD display
-  buzzer.setLCD(&lcd, LCD_ROWS, LCD_COLS);
+  if (noteStream.isActive()) {
+    if (noteStream.isStarted() && (buzzer.getNoteSource() != &noteStream || !buzzer.isPlaying())) {
+      // Stopped, finished, or another song has taken over
+      noteStream.close();
+    } else if (noteStream.update() == STREAM_STOP) {
+      Serial.println("ERROR: Stream stalled - stopping.");
+      applyStreamAction(STREAM_STOP);
+    }
+  }
   
-  // Setup LEDs
-  buzzer.setupLEDs(LED_RED_PIN, LED_BLUE_PIN, LED_GREEN_PIN, LED_YELLOW_PIN, LED_WHITE_PIN);
-  buzzer.enableLEDs(ledsEnabled);
-  buzzer.setLEDPattern(PATTERN_RANDOM_NOTES);
+  // Every pass while a song streams in, so credit goes back promptly, and
+  // while following, so a beacon is timed when it arrives
+  bool everyPass = noteStream.isActive() || clockSync.isFollowing();
+  scheduler.setPeriod(TASK_SERIAL, everyPass ? 0 : SERIAL_CHECK_INTERVAL);
+}
 
-  // Play startup sequence with chime and animation
-  playStartupSequence();
-  
-  // Allow time to read the startup message
-  delay(1500);
+// Settings, resume point, the next song and what happens when a song ends
+void playerTask() {
+  unsigned long currentTime = millis();
   
-  // Load and start first song
-  // loadSong(currentSong);
-  // showStatus();
-  buzzer.startIdleMode();
+  // Write any pending EEPROM record a byte at a time
+  settingsStore.update();
   
-  Serial.println("System ready! Type 'help' for commands.");
-}
+  // Keep the resume point current: when playback starts or stops, when the
+  // song changes, and every RESUME_SAVE_INTERVAL while playing. The silent
+  // gap before a cued song does not count as stopping. Streamed songs
+  // can't be resumed, so they count as stopped.
+  bool playing = buzzer.isPlaying() && buzzer.getNoteSource() != &noteStream;
+  if (playing) {
+    if (!savedState.resume || currentSong != savedState.song ||
+        currentTime - lastResumeSave >= RESUME_SAVE_INTERVAL) {
+      saveResumePoint(true);
+    }
+  } else if (savedState.resume && !buzzer.isSongCued()) {
+    saveResumePoint(false);
+  }
 
-void loop() {
-  // Update the buzzer state (handles music and LEDs)
-  buzzer.update();
   
-  // Check for serial commands periodically
-  unsigned long currentTime = millis();
-  if (currentTime - lastSerialCheck >= SERIAL_CHECK_INTERVAL) {
-    handleSerialCommands();
-    lastSerialCheck = currentTime;
+  // Keep the next song prefetched and cued while this one plays
+  // (songs played from a NoteSource can't be cued)
+  if (buzzer.isPlaying() && nextSong.index < 0 && buzzer.getNoteSource() == NULL) {
+    prefetchNextSong();
+  }
+  
+  // The buzzer has switched to the cued song on its own
+  if (nextSong.index >= 0 && !buzzer.isSongCued() && buzzer.isPlaying()) {
+    cuedSongStarted();
   }
-
   
   // Serial.println(!buzzer.isPlaying());
   if (!buzzer.isPlaying() && !userStopped && !waitingForPlayAgain) {
     
-    if (wasPlaying) {
+    if (wasPlaying && buzzer.isSongCued()) {
+      // In the gap before the cued song: show its title card
+      reportScore();
+      lcd.clear();
+      lcd.print("Up next:");
+      lcd.setCursor(0, 1);
+      lcd.print(nextSong.title);
+    } else if (wasPlaying && buzzer.getNoteSource() == &noteStream) {
+      Serial.println("\n=== Streamed Song Finished ===");
+      reportScore();
+      noteStream.close();
+      buzzer.stop();
+    } else if (wasPlaying) {
       Serial.println("\n=== Song Finished ===");
+      reportScore();
       char songName[50];
-      strcpy_P(songName, (const char*)pgm_read_ptr(&songs[currentSong].name));
+      getSongName(currentSong, songName, sizeof(songName));
       Serial.println("Play '" + String(songName) + "' again? (yes/no)");
       Serial.println("You have 10 seconds to respond...");
       buzzer.stop();
       
       waitingForPlayAgain = true;
-      playAgainTimeout = currentTime + PLAY_AGAIN_WAIT_TIME;
+      playAgainStart = currentTime;
     }
     wasPlaying = false;
   } else if (buzzer.isPlaying()) {
@@ -393,12 +430,12 @@ void loop() {
   
   
   // Handle play again timeout or auto-play when not waiting for user input
-  if (waitingForPlayAgain && currentTime >= playAgainTimeout) {
+  if (waitingForPlayAgain && currentTime - playAgainStart >= PLAY_AGAIN_WAIT_TIME) {
     // Timeout reached, proceed with auto-play logic
     Serial.println("No response - proceeding with auto-play setting...");
     waitingForPlayAgain = false;
     
-    if (autoPlay) {
+    if (autoPlay || queueCount > 0) {
       moveToNextSong();
     } else {
       Serial.println("Auto-play disabled. Type 'play <song>' to start another song.");
@@ -412,17 +449,113 @@ void loop() {
 }
 
 void handleSerialCommands() {
-  if (Serial.available() > 0) {
-    serialBuffer = Serial.readStringUntil('\n');
-    processCommand(serialBuffer);
+  // Take whatever bytes have arrived and act on whole lines only, so a
+  // line still on the wire (or never finished) never stalls playback
+  while (Serial.available() > 0) {
+    char c = Serial.read();
+    if (c == '\n') {
+      dispatchLine(serialBuffer);
+      serialBuffer = "";
+    } else if (serialBuffer.length() < STREAM_LINE_MAX) {
+      serialBuffer += c;
+    }
   }
 }
 
+/**
+ * @brief Send a line to clock sync, the song stream or, failing that, the
+ *        command parser
+ */
+void dispatchLine(const String& line) {
+  SyncAction sync = clockSync.handleLine(line);
+  if (sync != SYNC_NOT_MINE) {
+    applySyncAction(sync);
+    return;
+  }
+  
+  // A follower hears everything the unit before it prints; of that, only
+  // its own sync command is meant for it
+  if (clockSync.isFollowing() && !line.startsWith("sync")) return;
+  
+  StreamAction action = noteStream.handleLine(line);
+  if (action == STREAM_NOT_MINE) {
+    processCommand(line);
+  } else {
+    applyStreamAction(action);
+  }
+}
+
+/**
+ * @brief Start or stop the streamed song at the host's request
+ */
+void applyStreamAction(StreamAction action) {
+  if (action == STREAM_START) {
+    cancelNextSong();
+    buzzer.stopIdleMode();
+    buzzer.setStreamedSong(&noteStream, &noteStream, noteStream.getSongInfo());
+    scorer.startSong();
+    buzzer.play();
+    userStopped = false;
+    waitingForPlayAgain = false;
+    Serial.println("Playing streamed song");
+  } else if (action == STREAM_STOP) {
+    if (buzzer.getNoteSource() == &noteStream && buzzer.isPlaying()) {
+      userStopped = true;
+      buzzer.stop();
+    }
+    noteStream.close();
+  }
+}
+
+/**
+ * @brief Start or stop a song at the master's request
+ */
+void applySyncAction(SyncAction action) {
+  if (action == SYNC_START) {
+    buzzer.setTempo(clockSync.getStartTempo());
+    startSyncedSong(clockSync.getStartSong(), clockSync.getStartTime());
+  } else if (action == SYNC_STOP) {
+    buzzer.stop();
+    cancelNextSong();
+    userStopped = true;
+    waitingForPlayAgain = false;
+    Serial.println("Playback stopped.");
+  }
+}
+
+/**
+ * @brief Load a song and start it at a time on the shared clock
+ * 
+ * The title card shows until then, in place of "play"'s two second pause.
+ */
+void startSyncedSong(int songIndex, unsigned long at) {
+  if (songIndex < 0 || songIndex >= librarySize) {
+    Serial.println("ERROR: Invalid song number. Use 0-" + String(librarySize-1));
+    return;
+  }
+  
+  buzzer.stop();
+  buzzer.stopIdleMode();
+  currentSong = songIndex;
+  loadSong(currentSong);
+  buzzer.playAt(at);
+  
+  userStopped = false;
+  waitingForPlayAgain = false;
+  wasPlaying = false;
+  
+  char songName[50];
+  getSongName(currentSong, songName, sizeof(songName));
+  Serial.println("Playing: " + String(songName) + " at " + String(at) +
+                 (clockSync.isLocked() ? "" : " (clock not locked)"));
+}
+
 void processCommand(String command) {
   command.trim();
   command.toLowerCase();
   
   Serial.println("Command: " + command);
+  flightRecorder.recordCommand(command.c_str());
   
   // Handle play again responses
   if (waitingForPlayAgain) {
@@ -436,7 +569,7 @@ void processCommand(String command) {
       waitingForPlayAgain = false;
       userStopped = true;
       buzzer.stop();
-      if (autoPlay) {
+      if (autoPlay || queueCount > 0) {
         moveToNextSong();
       } else {
         Serial.println("Auto-play disabled. Type 'play <song>' to start another song.");
@@ -451,9 +584,9 @@ void processCommand(String command) {
     String songNumberStr = command.substring(5);
     int songNumber = songNumberStr.toInt();
     
-    // Validate song number
-    if (songNumber < 0 || songNumber >= SONG_COUNT) {
-      Serial.println("ERROR: Invalid song number. Use 0-" + String(SONG_COUNT-1));
+    // Validate song number (toInt() reads anything that isn't one as 0)
+    if (songNumber < 0 || songNumber >= librarySize || (songNumber == 0 && songNumberStr != "0")) {
+      Serial.println("ERROR: Invalid song number. Use 0-" + String(librarySize-1));
       Serial.println("Type 'list' to see available songs.");
       return;
     }
@@ -471,7 +604,7 @@ void processCommand(String command) {
     waitingForPlayAgain = false;
     
     char songName[50];
-    strcpy_P(songName, (const char*)pgm_read_ptr(&songs[currentSong].name));
+    getSongName(currentSong, songName, sizeof(songName));
     Serial.println("Playing: " + String(songName));
   } 
 
@@ -479,14 +612,15 @@ void processCommand(String command) {
     // Handle "play" without parameters
     Serial.println("What song would you like to play?");
     Serial.println("Available songs:");
-    for (int i = 0; i < SONG_COUNT; i++) {
+    for (int i = 0; i < librarySize; i++) {
       char songName[50];
-      strcpy_P(songName, (const char*)pgm_read_ptr(&songs[i].name));
+      getSongName(i, songName, sizeof(songName));
       Serial.println("  " + String(i) + ": " + String(songName));
     }
     Serial.println("Usage: play <song_number>");
   } else if (command == "stop") {
     buzzer.stop();
+    cancelNextSong();
     userStopped = true;  // Mark as user-initiated stop
     waitingForPlayAgain = false;  // Cancel any play again prompt
     lcd.clear();
@@ -495,18 +629,20 @@ void processCommand(String command) {
     
   } else if (command == "list") {
     Serial.println("Available songs:");
-    for (int i = 0; i < SONG_COUNT; i++) {
+    for (int i = 0; i < librarySize; i++) {
       char songName[50];
-      strcpy_P(songName, (const char*)pgm_read_ptr(&songs[i].name));
+      getSongName(i, songName, sizeof(songName));
       Serial.println("  " + String(i) + ": " + String(songName));
     }
     
   } else if (command == "auto on") {
     autoPlay = true;
+    cancelNextSong(); // Re-cue with the new setting
     Serial.println("Auto-play enabled.");
     
   } else if (command == "auto off") {
     autoPlay = false;
+    cancelNextSong();
     Serial.println("Auto-play disabled.");
     
   } else if (command == "auto") {
@@ -526,43 +662,282 @@ void processCommand(String command) {
     // Handle "led" without parameters  
     Serial.println("LEDs are currently: " + String(ledsEnabled ? "Enabled" : "Disabled"));
     Serial.println("Usage: led <on/off>");
+  } else if (command == "viz on") {
+    buzzer.enableVisualizer(true);
+    Serial.println("Visualizer enabled.");
+  } else if (command == "viz off") {
+    buzzer.enableVisualizer(false);
+    Serial.println("Visualizer disabled.");
+  } else if (command == "viz") {
+    // Handle "viz" without parameters
+    Serial.println("Visualizer is currently: " + String(buzzer.isVisualizerEnabled() ? "Enabled" : "Disabled"));
+    Serial.println("Usage: viz <on/off>");
   } else if (command.startsWith("pattern ")) {
     String patternStr = command.substring(8);
     int pattern = patternStr.toInt();
     
     if (pattern < 0 || pattern >= LED_PATTERN_COUNT) {
       Serial.println("ERROR: Invalid pattern number. Use 0-" + String(LED_PATTERN_COUNT-1));
-      Serial.println("Patterns: 0=Rainbow Chase, 1=Sequential, 2= Note Mapping, 3=Random Notes");
+      Serial.println("Type 'pattern' to see available patterns.");
       return;
     }
     
     currentLEDPattern = pattern;
-    buzzer.setLEDPattern((LEDPattern)pattern);
+    buzzer.setLEDPattern(pattern);
     
-    Serial.println("LED pattern set to: " + patternNames[pattern]);
+    Serial.println("LED pattern set to: " + patternName(pattern));
     
   } else if (command == "pattern") {
     // Handle "pattern" without parameters
     Serial.println("Which LED pattern would you like?");
     Serial.println("Available patterns:");
-    Serial.println("  0: Rainbow Chase");
-    Serial.println("  1: Sequential Notes");
-    Serial.println("  2: Note Mapping");
-    Serial.println("  3: Random Notes");
-    Serial.println("Current pattern: " + String(patternNames[currentLEDPattern]));
+    for (int i = 0; i < LED_PATTERN_COUNT; i++) {
+      Serial.println("  " + String(i) + ": " + patternName(i));
+    }
+    Serial.println("Current pattern: " + patternName(currentLEDPattern));
     Serial.println("Usage: pattern <pattern_number>");
 
+  } else if (command == "queue clear") {
+    queueHead = 0;
+    queueCount = 0;
+    cancelNextSong();
+    Serial.println("Playlist cleared.");
+    
+  } else if (command.startsWith("queue ")) {
+    String songNumberStr = command.substring(6);
+    int songNumber = songNumberStr.toInt();
+    
+    if (songNumber < 0 || songNumber >= librarySize || (songNumber == 0 && songNumberStr != "0")) {
+      Serial.println("ERROR: Invalid song number. Use 0-" + String(librarySize-1));
+      return;
+    }
+    if (queueCount >= QUEUE_CAPACITY) {
+      Serial.println("ERROR: Playlist is full (" + String(QUEUE_CAPACITY) + " songs).");
+      return;
+    }
+    
+    playQueue[(queueHead + queueCount) % QUEUE_CAPACITY] = songNumber;
+    queueCount++;
+    cancelNextSong(); // Re-cue in case this is now the next song
+    showQueue();
+    
+  } else if (command == "queue") {
+    showQueue();
+    
+  } else if (command == "next") {
+    buzzer.stopIdleMode();
+    userStopped = false;
+    waitingForPlayAgain = false;
+    moveToNextSong();
+    
+  } else if (command == "shuffle") {
+    shuffleQueue();
+    showQueue();
+    
+  } else if (command.startsWith("gap ")) {
+    String gapStr = command.substring(4);
+    long gap = gapStr.toInt();
+    
+    if (gap < 0 || gap > (long)MAX_SONG_GAP || (gap == 0 && gapStr != "0")) {
+      Serial.println("ERROR: Invalid gap. Use 0-" + String(MAX_SONG_GAP) + " ms");
+      return;
+    }
+    
+    songGap = gap;
+    cancelNextSong();
+    Serial.println("Gap between songs set to: " + String(songGap) + " ms");
+    
+  } else if (command == "gap") {
+    Serial.println("Gap between songs is currently: " + String(songGap) + " ms");
+    Serial.println("Usage: gap <ms> (0 = gapless)");
+    
+  } else if (command.startsWith("tempo ")) {
+    int percent = command.substring(6).toInt();
+    
+    if (percent < TEMPO_MIN_PERCENT || percent > TEMPO_MAX_PERCENT) {
+      Serial.println("ERROR: Invalid tempo. Use " + String(TEMPO_MIN_PERCENT) + "-" + String(TEMPO_MAX_PERCENT) + " percent");
+      return;
+    }
+    
+    buzzer.setTempo(percent);
+    Serial.println("Tempo set to: " + String(percent) + "%");
+    
+  } else if (command == "tempo") {
+    // Handle "tempo" without parameters
+    Serial.println("Tempo is currently: " + String(buzzer.getTempo()) + "%");
+    Serial.println("Usage: tempo <percent> (100 = as written)");
+    
+  } else if (command.startsWith("key ")) {
+    String keyStr = command.substring(4);
+    keyStr.trim();
+    int semitones = keyStr.toInt();
+    
+    if ((semitones == 0 && keyStr != "0" && keyStr != "+0" && keyStr != "-0") ||
+        semitones < -TRANSPOSE_MAX_SEMITONES || semitones > TRANSPOSE_MAX_SEMITONES) {
+      Serial.println("ERROR: Invalid key. Use -" + String(TRANSPOSE_MAX_SEMITONES) + " to +" + String(TRANSPOSE_MAX_SEMITONES) + " semitones");
+      return;
+    }
+    
+    buzzer.setTranspose(semitones);
+    Serial.println("Key set to: " + String(semitones > 0 ? "+" : "") + String(semitones) + " semitones");
+    
+  } else if (command == "key") {
+    // Handle "key" without parameters
+    int semitones = buzzer.getTranspose();
+    Serial.println("Key is currently: " + String(semitones > 0 ? "+" : "") + String(semitones) + " semitones");
+    Serial.println("Usage: key <+/-semitones> (0 = as written)");
+    
+  } else if (command.startsWith("harmony ")) {
+    String ruleStr = command.substring(8);
+    ruleStr.trim();
+    
+    int rule = 0;
+    while (rule < HARMONY_RULE_COUNT && ruleStr != harmonyNames[rule]) rule++;
+    if (rule == HARMONY_RULE_COUNT) {
+      Serial.println("ERROR: Invalid harmony. Use song, third, sixth, drone or bass");
+      return;
+    }
+    
+    buzzer.setHarmonyRule((HarmonyRule)rule);
+    Serial.println("Harmony set to: " + String(harmonyNames[rule]));
+    
+  } else if (command == "harmony") {
+    // Handle "harmony" without parameters
+    Serial.println("Harmony is currently: " + String(harmonyNames[buzzer.getHarmonyRule()]));
+    Serial.println("Usage: harmony <song|third|sixth|drone|bass> (song = as written)");
+    
+  } else if (command.startsWith("vol ")) {
+    // "vol melody <n>" or "vol harmony <n>"
+    String args = command.substring(4);
+    int space = args.indexOf(' ');
+    String part = space > 0 ? args.substring(0, space) : args;
+    String levelStr = space > 0 ? args.substring(space + 1) : String("");
+    levelStr.trim();
+    int level = levelStr.toInt();
+    int voice = (part == "melody") ? MELODY_VOICE : (part == "harmony") ? HARMONY_VOICE : -1;
+    
+    if (voice < 0 || level < 0 || level > PITCH_VOLUME_MAX || (level == 0 && levelStr != "0")) {
+      Serial.println("ERROR: Invalid volume. Use vol melody <0-" + String(PITCH_VOLUME_MAX) +
+                     "> or vol harmony <0-" + String(PITCH_VOLUME_MAX) + ">");
+      return;
+    }
+    
+    buzzer.setVolume(voice, level);
+    Serial.println(String(voice == MELODY_VOICE ? "Melody" : "Harmony") + " volume set to: " + String(level) +
+                   (level == 0 ? " (muted)" : ""));
+    
+  } else if (command == "vol") {
+    // Handle "vol" without parameters
+    Serial.println("Volume is currently: melody " + String(buzzer.getVolume(MELODY_VOICE)) +
+                   ", harmony " + String(buzzer.getVolume(HARMONY_VOICE)));
+    Serial.println("Usage: vol <melody|harmony> <0-" + String(PITCH_VOLUME_MAX) + "> (" +
+                   String(PITCH_VOLUME_MAX) + " = full, 0 = muted)");
+    
+  } else if (command == "save") {
+    captureSettings(savedState);
+    saveResumePoint(buzzer.isPlaying());
+    Serial.println("Settings saved.");
+    
+  } else if (command == "reset") {
+    settingsStore.erase();
+    restoreDefaults();
+    Serial.println("Stored settings erased; defaults restored.");
+    
+  } else if (command == "fastboot on") {
+    fastBoot = true;
+    Serial.println("Fast boot enabled. Type 'save' to keep it.");
+    
+  } else if (command == "fastboot off") {
+    fastBoot = false;
+    Serial.println("Fast boot disabled. Type 'save' to keep it.");
+    
+  } else if (command == "fastboot") {
+    // Handle "fastboot" without parameters
+    Serial.println("Fast boot is currently: " + String(fastBoot ? "Enabled" : "Disabled"));
+    Serial.println("Usage: fastboot <on/off>");
+    
+  } else if (command == "mic on" || command == "mic off") {
+    if (!scorer.isFitted()) {
+      Serial.println("ERROR: No microphone. Build with -DMIC_PIN=<analog pin> to use one.");
+      return;
+    }
+    micEnabled = command == "mic on";
+    Serial.println("Singing score " + String(micEnabled ? "enabled." : "disabled."));
+    
+  } else if (command == "mic") {
+    showMic();
+    
   } else if (command == "status") {
     showStatus();
+  } else if (command == "bench") {
+    runBench();
+  } else if (command == "tasks") {
+    showTasks();
+  } else if (command == "tasks reset") {
+    scheduler.resetStats();
+    Serial.println("Task timings cleared.");
+  } else if (command == "power") {
+    showPower();
+  } else if (command == "trace") {
+    showTrace();
+  } else if (command == "trace clear") {
+    flightRecorder.clear();
+    flightRecorder.release();
+    Serial.println("Flight recorder cleared.");
+  } else if (command == "sync") {
+    showSync();
+  } else if (command == "sync master" || command == "sync follow" || command == "sync off") {
+    clockSync.setRole(command == "sync master" ? SYNC_MASTER : command == "sync follow" ? SYNC_FOLLOWER : SYNC_OFF);
+    Serial.println("Clock sync: " + String(syncRoleNames[clockSync.getRole()]) + ". Type 'save' to keep it.");
+  } else if (command.startsWith("sync play ")) {
+    if (clockSync.getRole() != SYNC_MASTER) {
+      Serial.println("ERROR: Only the master starts songs. Use 'sync master' first.");
+      return;
+    }
+    // "sync play <song> [lead_ms]"
+    String args = command.substring(10);
+    int space = args.indexOf(' ');
+    int songNumber = args.toInt();
+    unsigned long lead = space > 0 ? args.substring(space + 1).toInt() : SYNC_DEFAULT_LEAD;
+    if (songNumber < 0 || songNumber >= librarySize) {
+      Serial.println("ERROR: Invalid song number. Use 0-" + String(librarySize-1));
+      return;
+    }
+    unsigned long at = clockSync.now() + lead;
+    clockSync.sendStart(songNumber, at, buzzer.getTempo());
+    startSyncedSong(songNumber, at);
+  } else if (command == "sync stop") {
+    clockSync.sendStop();
+    applySyncAction(SYNC_STOP);
   } else if (command == "help") {
     Serial.println("=== Commands ===");
-    Serial.println("play <song_number> - Play specific song (0-" + String(SONG_COUNT-1) + ")");
+    Serial.println("play <song_number> - Play specific song (0-" + String(librarySize-1) + ")");
     Serial.println("stop - Stop current playback");
     Serial.println("list - List all available songs");
     Serial.println("auto on/off - Enable/disable auto-play");
     Serial.println("led on/off - Enable/disable LEDs");
-    Serial.println("pattern <0-3> - Change LED pattern");
+    Serial.println("viz on/off - Pitch bars on the bottom LCD row");
+    Serial.println("pattern <0-" + String(LED_PATTERN_COUNT-1) + "> - Change LED pattern");
+    Serial.println("queue <song_number> - Add a song to the playlist");
+    Serial.println("queue / queue clear - Show or empty the playlist");
+    Serial.println("next - Skip to the next song");
+    Serial.println("shuffle - Shuffle the playlist");
+    Serial.println("gap <ms> - Silence between songs (0 = gapless)");
+    Serial.println("tempo <25-400> - Playback speed in percent");
+
+    Serial.println("key <-12..+12> - Transpose by semitones");
+    Serial.println("harmony <song|third|sixth|drone|bass> - Written or generated harmony");
+    Serial.println("vol melody/harmony <0-" + String(PITCH_VOLUME_MAX) + "> - Volume of each part");
+    Serial.println("mic / mic on/off - Singing score from the microphone (MIC_PIN builds)");
     Serial.println("status - Show current status");
+    Serial.println("bench - Time a note change (tone() vs pitch table)");
+    Serial.println("tasks / tasks reset - Scheduler timings / clear them");
+    Serial.println("power - Time asleep and estimated charge used");
+    Serial.println("trace / trace clear - Recent events, kept across a watchdog reset / empty it");
+    Serial.println("sync master/follow/off - Share a song clock with other units");
+    Serial.println("sync play <song_number> [lead_ms] / sync stop - Start or stop every unit together");
+    Serial.println("save / reset - Store settings in EEPROM / restore defaults");
+    Serial.println("fastboot on/off - Skip the startup show on power-up");
     Serial.println("yes/y - Play song again (when prompted)");
     Serial.println("no/n - Skip to next song (when prompted)");
     Serial.println("help - Show this help menu");
@@ -578,79 +953,564 @@ void processCommand(String command) {
 }
 
 void moveToNextSong() {
-  // Display song change message
-  lcd.clear();
-  lcd.setCursor(0, 0);
-  lcd.print("Auto: Next song");
-  Serial.println("Auto-play: Switching to next song...");
-  delay(1000);
+  Serial.println("Switching to next song...");
   
-  // Switch to next song
-  currentSong = (currentSong + 1) % SONG_COUNT;
+  // Next in the playlist, otherwise the following song number
+  bool fromQueue;
+  int songIndex = peekNextSong(fromQueue);
+  if (songIndex < 0) {
+    songIndex = (currentSong + 1) % librarySize;
+  } else if (fromQueue) {
+    popQueue();
+  }
+  
+  // Switch to next song (no pause: the title card shows while it starts)
+  currentSong = songIndex;
   loadSong(currentSong);
   buzzer.play();
   
   char songName[50];
-  strcpy_P(songName, (const char*)pgm_read_ptr(&songs[currentSong].name));
+  getSongName(currentSong, songName, sizeof(songName));
   Serial.println("Now playing: " + String(songName));
 }
 
 void loadSong(int songIndex) {
-  if (songIndex < 0 || songIndex >= SONG_COUNT) {
+  if (songIndex < 0 || songIndex >= librarySize) {
     Serial.println("ERROR: Invalid song index");
     return;
   }
 
+  // Use the prefetched copy if this is the song we prepared
+  PreparedSong prepared;
+  if (songCard.isPresent()) {
+    // Played straight off the card; only its header is read now
+    if (!songCard.open(songIndex)) {
+      Serial.println("ERROR: Cannot read song " + String(songIndex) + " from the SD card");
+      return;
+    }
+    getSongName(songIndex, prepared.title, sizeof(prepared.title));
+  } else if (nextSong.index == songIndex) {
+    prepared = nextSong;
+  } else {
+    prepareSong(songIndex, prepared);
+  }
+
   buzzer.stop();
+  cancelNextSong();
+  scorer.startSong();
   
- // Read song data directly from PROGMEM without dynamic allocation
-  buzzer.setSong((Note*)pgm_read_ptr(&songs[songIndex].melody), 
-                pgm_read_word(&songs[songIndex].melodyLength),
-                (Note*)pgm_read_ptr(&songs[songIndex].harmony), 
-                pgm_read_word(&songs[songIndex].harmonyLength));
-  
-  // Read lyrics from PROGMEM
- buzzer.setLyrics((LyricTiming*)pgm_read_ptr(&songs[songIndex].lyrics),
-                   pgm_read_word(&songs[songIndex].lyricsCount));
+  if (songCard.isPresent()) {
+    buzzer.setStreamedSong(&songCard, &songCard, songCard.getSongInfo());
+  } else {
+    buzzer.setSong((Note*)prepared.header.melody, prepared.header.melodyLength,
+                   (Note*)prepared.header.harmony, prepared.header.harmonyLength,
+                   prepared.header.info);
+    buzzer.setAccents(MELODY_VOICE, prepared.header.melodyAccents);
+    buzzer.setAccents(HARMONY_VOICE, prepared.header.harmonyAccents);
+    buzzer.setHarmonyStyle(prepared.header.harmonyStyle);
+    buzzer.setLyrics((LyricTiming*)prepared.header.lyrics, prepared.header.lyricsCount);
+  }
   
   // Display song info on LCD
   lcd.clear();
   lcd.print("Song: ");
   lcd.print(String(songIndex));
   lcd.setCursor(0, 1);
+  lcd.print(prepared.title);
+}
+
+/**
+ * @brief Copy a song's name, from the SD card index or songs[]
+ * @param name Filled in, cut to size - 1 characters
+ */
+void getSongName(int songIndex, char* name, size_t size) {
+  if (songCard.isPresent()) {
+    CardIndexEntry entry;
+    if (!songCard.readEntry(songIndex, entry)) entry.title[0] = '\0';
+    strncpy(name, entry.title, size - 1);
+  } else {
+    strncpy_P(name, (const char*)pgm_read_ptr(&songs[songIndex].name), size - 1);
+  }
+  name[size - 1] = '\0';
+}
+
+/**
+ * @brief Copy a songs[] entry into RAM and build its title card
+ */
+void prepareSong(int songIndex, PreparedSong& prepared) {
+  memcpy_P(&prepared.header, &songs[songIndex], sizeof(Song));
+  prepared.index = songIndex;
+  prepared.fromQueue = false;
+  strncpy_P(prepared.title, prepared.header.name, LCD_COLS);
+  prepared.title[LCD_COLS] = '\0';
+}
+
+/**
+ * @brief Work out which song plays after the current one
+ * @param fromQueue Set when the song comes from the playlist
+ * @return Song number, or -1 if playback should stop
+ */
+int peekNextSong(bool& fromQueue) {
+  if (queueCount > 0) {
+    fromQueue = true;
+    return playQueue[queueHead];
+  }
+  fromQueue = false;
+  return autoPlay ? (currentSong + 1) % librarySize : -1;
+}
+
+/**
+ * @brief Prepare the next song and cue it on the buzzer
+ * 
+ * Runs while the current song plays, so the header copy, title card and
+ * song length are ready before the switch.
+ */
+void prefetchNextSong() {
+  bool fromQueue;
+  int songIndex = peekNextSong(fromQueue);
+  if (songIndex < 0) return;
+  
+  prepareSong(songIndex, nextSong);
+  nextSong.fromQueue = fromQueue;
+  buzzer.cueSong((Note*)nextSong.header.melody, nextSong.header.melodyLength,
+                 (Note*)nextSong.header.harmony, nextSong.header.harmonyLength,
+                 nextSong.header.info,
+                 (LyricTiming*)nextSong.header.lyrics, nextSong.header.lyricsCount,
+                 songGap);
+  buzzer.cueAccents(MELODY_VOICE, nextSong.header.melodyAccents);
+  buzzer.cueAccents(HARMONY_VOICE, nextSong.header.harmonyAccents);
+  buzzer.cueHarmonyStyle(nextSong.header.harmonyStyle);
+}
+
+/**
+ * @brief Forget the prefetched song so it is prepared again
+ * 
+ * Called whenever the playlist, auto-play or gap changes, and whenever
+ * playback is stopped or restarted by hand.
+ */
+void cancelNextSong() {
+  buzzer.cancelCue();
+  nextSong.index = -1;
+}
+
+/**
+ * @brief Bookkeeping once the buzzer has started the cued song
+ */
+void cuedSongStarted() {
+  reportScore();
+  if (nextSong.fromQueue) {
+    popQueue();
+  }
+  currentSong = nextSong.index;
+  nextSong.index = -1;
+  wasPlaying = true;
+  
   char songName[50];
-  strcpy_P(songName, (const char*)pgm_read_ptr(&songs[songIndex].name));
+  getSongName(currentSong, songName, sizeof(songName));
+  Serial.println("Now playing: " + String(songName));
+}
+
+void popQueue() {
+  if (queueCount == 0) return;
+  queueHead = (queueHead + 1) % QUEUE_CAPACITY;
+  queueCount--;
+}
+
+void showQueue() {
+  if (queueCount == 0) {
+    Serial.println("Playlist is empty.");
+  } else {
+    Serial.println("Playlist:");
+    for (int i = 0; i < queueCount; i++) {
+      int songIndex = playQueue[(queueHead + i) % QUEUE_CAPACITY];
+      char songName[50];
+      getSongName(songIndex, songName, sizeof(songName));
+      Serial.println("  " + String(i + 1) + ". " + String(songIndex) + ": " + String(songName));
+    }
+  }
+  Serial.println("Gap between songs: " + String(songGap) + " ms");
+}
 
-  String name = String(songName);
-  if (name.length() > LCD_COLS) {
-    name = name.substring(0, LCD_COLS);
+/**
+ * @brief Shuffle the playlist in place
+ * 
+ * An empty playlist is first filled with every other song.
+ */
+void shuffleQueue() {
+  randomSeed(micros());
+  
+  if (queueCount == 0) {
+    for (int i = 0; i < librarySize && queueCount < QUEUE_CAPACITY; i++) {
+      if (i == currentSong && librarySize > 1) continue;
+      playQueue[(queueHead + queueCount) % QUEUE_CAPACITY] = i;
+      queueCount++;
+    }
   }
-  lcd.print(name);
   
+  // Fisher-Yates over the live part of the ring
+  for (int i = queueCount - 1; i > 0; i--) {
+    int j = random(0, i + 1);
+    int a = (queueHead + i) % QUEUE_CAPACITY;
+    int b = (queueHead + j) % QUEUE_CAPACITY;
+    int swap = playQueue[a];
+    playQueue[a] = playQueue[b];
+    playQueue[b] = swap;
+  }
+  
+  cancelNextSong();
+}
+
+/**
+ * @brief Time note changes through tone() and through the pitch table
+ * 
+ * Runs the same notes both ways on the melody buzzer (a short chirp)
+ * and prints the average cost of one change, as PolyBuzzer makes it.
+ */
+void runBench() {
+  if (buzzer.isPlaying()) {
+    Serial.println("ERROR: Stop playback before running bench");
+    return;
+  }
+  
+  // Two octaves from middle C, with the Hz looked up beforehand
+  const int BENCH_CHANGES = 96;
+  const uint8_t BENCH_NOTES = 24;
+  unsigned int frequencies[BENCH_NOTES];
+  for (uint8_t i = 0; i < BENCH_NOTES; i++) {
+    frequencies[i] = midiFrequency(60 + i);
+  }
+  
+  unsigned long start = micros();
+  for (int i = 0; i < BENCH_CHANGES; i++) {
+    tone(MELODY_BUZZER_PIN, frequencies[i % BENCH_NOTES]);
+  }
+  unsigned long toneUs = micros() - start;
+  noTone(MELODY_BUZZER_PIN);
+  
+  start = micros();
+  for (int i = 0; i < BENCH_CHANGES; i++) {
+    pitchTone(MELODY_BUZZER_PIN, 60 + i % BENCH_NOTES);
+  }
+  unsigned long pitchUs = micros() - start;
+  pitchNoTone(MELODY_BUZZER_PIN);
+  
+  Serial.println("Note change: tone() " + String(toneUs / (double)BENCH_CHANGES, 1) + " us, pitch table " +
+                 String(pitchUs / (double)BENCH_CHANGES, 1) + " us" +
+                 (isPitchTimerPin(MELODY_BUZZER_PIN) ? " (Timer1)" : " (tone() on this board)"));
+}
+
+/**
+ * @brief Print how each scheduler task has been doing
+ * 
+ * Times are from micros(), so they are only as fine as its 4us steps.
+ */
+void showTasks() {
+  Serial.println("=== Tasks ===");
+  for (uint8_t i = 0; i < scheduler.getTaskCount(); i++) {
+    const LoopTask& task = scheduler.getTask(i);
+    const LoopTaskStats& stats = scheduler.getStats(i);
+    unsigned long average = stats.runs > 0 ? stats.totalUs / stats.runs : 0;
+    String period = task.periodMs > 0 ? String(task.periodMs) + "ms" : String("every pass");
+    Serial.println(String(task.name) + " (" + period + "): " + String(stats.runs) + " runs, avg " +
+                   String(average) + "us, worst " + String(stats.worstUs) + "us, budget " +
+                   String(task.budgetUs) + "us");
+    if (stats.overruns > 0 || stats.missed > 0) {
+      Serial.println("  " + String(stats.overruns) + " over budget, " + String(stats.missed) + " periods missed");
+    }
+  }
+  Serial.println("Passes: " + String(scheduler.getPasses()) + ", longest " + String(scheduler.getWorstPass()) + "us");
+}
+
+/**
+ * @brief Print how much of the time the MCU has slept, and what it saved
+ * 
+ * Charge is for the ATmega328P alone, from datasheet currents.
+ */
+void showPower() {
+  unsigned long asleep = powerSaver.getAsleepMs();
+  unsigned long awake = powerSaver.getAwakeMs();
+  unsigned long total = asleep + awake;
+  
+  Serial.println("=== Power ===");
+  Serial.println("Awake: " + String(awake / 1000.0, 1) + " s, asleep: " + String(asleep / 1000.0, 1) + " s (" +
+                 String(total > 0 ? asleep * 100.0 / total : 0.0, 1) + "%)");
+  Serial.println("Sleeps: " + String(powerSaver.getSleeps()) + ", woken by serial: " + String(powerSaver.getSerialWakes()));
+  Serial.println("MCU charge: " + String(powerSaver.getChargeMah(), 3) + " mAh (" +
+                 String(powerSaver.getSavedMah(), 3) + " mAh saved by sleeping)");
+}
+
+/**
+ * @brief Print the clock sync role and how well the clock is tracking
+ */
+void showSync() {
+  Serial.println("=== Clock Sync ===");
+  Serial.println("Role: " + String(syncRoleNames[clockSync.getRole()]) +
+                 (clockSync.isFollowing() ? String(clockSync.isLocked() ? ", locked" : ", not locked") : String("")));
+  Serial.println("Shared clock: " + String(clockSync.now()) + " ms");
+  if (clockSync.isFollowing()) {
+    Serial.println("Offset: " + String(clockSync.getOffset()) + " ms, drift " + String(clockSync.getDrift()) +
+                   " ppm, last correction " + String(clockSync.getLastError()) + " ms");
+    Serial.println("Beacons: " + String(clockSync.getBeacons()));
+  }
+}
+
+/**
+ * @brief Print the flight recorder's events, oldest first
+ * 
+ * After a watchdog reset these are the events that led up to it, and
+ * recording only starts again once they have been printed.
+ */
+void showTrace() {
+  Serial.println("=== Flight Recorder ===");
+  if (flightRecorder.wasWatchdogReset()) {
+    Serial.println("The last run ended in a watchdog reset.");
+  }
+  for (uint8_t i = 0; i < flightRecorder.getCount(); i++) {
+    const FlightEvent& event = flightRecorder.getEvent(i);
+    Serial.println(String(event.time) + " ms  " + describeFlightEvent(event));
+  }
+  if (flightRecorder.isHeld()) {
+    flightRecorder.release();
+    Serial.println("Recording again.");
+  }
+}
+
+/**
+ * @brief One flight recorder event as text
+ */
+String describeFlightEvent(const FlightEvent& event) {
+  String task = event.arg < TASK_COUNT ? String(" in ") + tasks[event.arg].name : String("");
+  String passMs = String(event.value / 10.0, 1) + " ms";
+  
+  switch (event.type) {
+    case FLIGHT_BOOT:
+      return event.arg ? "boot, after a watchdog reset" : "boot";
+    case FLIGHT_NOTE: {
+      String voice = event.arg == MELODY_VOICE ? String("melody") :
+                     event.arg == HARMONY_VOICE ? String("harmony") : "voice " + String(event.arg);
+      return voice + " note " + String(event.value);
+    }
+    case FLIGHT_COMMAND: {
+      char text[4] = { (char)event.arg, (char)(event.value & 0xFF), (char)(event.value >> 8), '\0' };
+      return "command '" + String(text) + "'";
+    }
+    case FLIGHT_LCD:
+      return "lcd frame sent, " + String(event.value) + " dropped so far";
+    case FLIGHT_SLOW_PASS:
+      return "slow pass " + passMs + task;
+    case FLIGHT_STALL:
+      return event.arg == 0xFF ? String("stall, board reset") : "stall " + passMs + task;
+  }
+  return "event " + String(event.type);
+}
+
+/**
+ * @brief Print the microphone level and the score so far
+ * 
+ * The level is measured while a song plays; sing a line and check it
+ * sits well above the quiet level when setting the module's gain.
+ */
+void showMic() {
+  if (!scorer.isFitted()) {
+    Serial.println("No microphone. Build with -DMIC_PIN=<analog pin> to use one.");
+    return;
+  }
+  Serial.println("=== Microphone ===");
+  Serial.println("Scoring: " + String(micEnabled ? "Enabled" : "Disabled") +
+                 (scorer.isListening() ? ", listening" : ""));
+  Serial.println("Level: " + String(scorer.getLevel()) + " (quiet below " + String(SCORE_QUIET_LEVEL) + ")");
+  if (scorer.getLastLinePercent() >= 0) {
+    Serial.println("Last line: " + String(scorer.getLastLinePercent()) + "% in tune");
+  }
+  if (scorer.getSongBlocks() > 0) {
+    Serial.println("This song: " + String(scorer.getSongPercent()) + "% in tune so far");
+  }
+  Serial.println("Blocks lost to a full buffer: " + String(scorer.getOverruns()));
+}
+
+/**
+ * @brief Print the song's score, if any of it was sung, and start afresh
+ */
+void reportScore() {
+  scorer.endLine();
+  if (scorer.getSongBlocks() > 0) {
+    Serial.println("Karaoke score: " + String(scorer.getSongPercent()) + "% in tune (" +
+                   String(scorer.getSongHits()) + " of " + String(scorer.getSongBlocks()) + " checks, " +
+                   String(scorer.getLines()) + " lines)");
+  }
+  scorer.startSong();
+}
+
+/**
+ * @brief Song clock for the buzzer: the shared clock when synced
+ */
+unsigned long sharedClock() {
+  return clockSync.now();
+}
+
+/**
+ * @brief Get an LED pattern's name from the registry
+ */
+String patternName(int pattern) {
+  char name[LED_PATTERN_NAME_SIZE];
+  getLEDPatternName(pattern, name, sizeof(name));
+  return String(name);
 }
 
 void showStatus() {
   Serial.println("=== Current Status ===");
   char songName[50];
-  strcpy_P(songName, (const char*)pgm_read_ptr(&songs[currentSong].name));
+  getSongName(currentSong, songName, sizeof(songName));
   Serial.println("Current song: " + String(currentSong) + " (" + String(songName) + ")");
   Serial.println("Playing: " + String(buzzer.isPlaying() ? "Yes" : "No"));
   Serial.println("Auto-play: " + String(autoPlay ? "Enabled" : "Disabled"));
+  Serial.println("Playlist: " + String(queueCount) + " song(s), gap " + String(songGap) + " ms");
   Serial.println("LEDs: " + String(ledsEnabled ? "Enabled" : "Disabled"));
+  Serial.println("Visualizer: " + String(buzzer.isVisualizerEnabled() ? "Enabled" : "Disabled"));
+  Serial.println("Fast boot: " + String(fastBoot ? "Enabled" : "Disabled"));
+
+  Serial.println("Tempo: " + String(buzzer.getTempo()) + "%");
+  Serial.println("Key: " + String(buzzer.getTranspose() > 0 ? "+" : "") + String(buzzer.getTranspose()) + " semitones");
+  Serial.println("Harmony: " + String(harmonyNames[buzzer.getHarmonyRule()]) +
+                 (buzzer.isHarmonyGenerated() ? " (generated)" : ""));
+  Serial.println("Volume: melody " + String(buzzer.getVolume(MELODY_VOICE)) +
+                 ", harmony " + String(buzzer.getVolume(HARMONY_VOICE)));
+  if (scorer.isFitted()) {
+    Serial.println("Microphone: " + String(micEnabled ? "Enabled" : "Disabled"));
+  }
+
   Serial.println("User stopped: " + String(userStopped ? "Yes" : "No"));
   Serial.println("Waiting for play again: " + String(waitingForPlayAgain ? "Yes" : "No"));
   
-  Serial.println("LED pattern: " + String(currentLEDPattern) + " (" + patternNames[currentLEDPattern] + ")");
-  Serial.println("Total songs: " + String(SONG_COUNT));
+  Serial.println("LED pattern: " + String(currentLEDPattern) + " (" + patternName(currentLEDPattern) + ")");
+  Serial.println("Total songs: " + String(librarySize));
+  if (songCard.isPresent()) {
+    Serial.println("Library: SD card, " + String(songCard.getBlockReads()) + " block reads (" +
+                   String(songCard.getLateReads()) + " as a note started)");
+  } else {
+    Serial.println("Library: built in");
+  }
+  Serial.println("LCD frames dropped: " + String(lcd.getDroppedFrames()));
+  Serial.println("Drawn ahead of the notes: lyrics " + String((buzzer.getLyricLatency() + 500) / 1000) +
+                 " ms, LEDs up to " + String((buzzer.getLEDLead() + 500) / 1000) + " ms");
+  if (noteStream.isActive()) {
+    Serial.println("Stream: buffered " + String(noteStream.getFill(MELODY_VOICE)) + "/" +
+                   String(noteStream.getFill(HARMONY_VOICE)) + " notes, " +
+                   String(noteStream.getLyricFill()) + " words");
+  }
+  Serial.println("Stream underruns: " + String(noteStream.getUnderruns()));
   Serial.println("=====================");
 }
 
+/**
+ * @brief Copy the current settings into a SavedState (resume point untouched)
+ */
+void captureSettings(SavedState& state) {
+  state.autoPlay = autoPlay;
+  state.ledsEnabled = ledsEnabled;
+  state.ledPattern = currentLEDPattern;
+  state.visualizer = buzzer.isVisualizerEnabled();
+  state.fastBoot = fastBoot;
+  state.transpose = buzzer.getTranspose();
+  state.tempo = buzzer.getTempo();
+  state.songGap = songGap;
+  state.harmony = buzzer.getHarmonyRule();
+  state.syncRole = clockSync.getRole();
+  state.melodyVolume = buzzer.getVolume(MELODY_VOICE);
+  state.harmonyVolume = buzzer.getVolume(HARMONY_VOICE);
+}
+
+/**
+ * @brief Apply stored settings to the sketch and the buzzer
+ * 
+ * Values are range-checked again, in case the record came from a build
+ * with different limits.
+ */
+void applySettings(const SavedState& state) {
+  autoPlay = state.autoPlay;
+  ledsEnabled = state.ledsEnabled;
+  currentLEDPattern = constrain(state.ledPattern, 0, LED_PATTERN_COUNT - 1);
+  fastBoot = state.fastBoot;
+  songGap = min((unsigned long)state.songGap, MAX_SONG_GAP);
+  if (state.song >= 0 && state.song < librarySize) {
+    currentSong = state.song;
+  }
+  
+  buzzer.enableLEDs(ledsEnabled);
+  buzzer.setLEDPattern(currentLEDPattern);
+  buzzer.enableVisualizer(state.visualizer);
+  buzzer.setTempo(state.tempo);
+  buzzer.setTranspose(state.transpose);
+  buzzer.setHarmonyRule((HarmonyRule)constrain(state.harmony, 0, HARMONY_RULE_COUNT - 1));
+  buzzer.setVolume(MELODY_VOICE, min(state.melodyVolume, PITCH_VOLUME_MAX));
+  buzzer.setVolume(HARMONY_VOICE, min(state.harmonyVolume, PITCH_VOLUME_MAX));
+  if (state.syncRole != clockSync.getRole()) {
+    clockSync.setRole(constrain(state.syncRole, (uint8_t)SYNC_OFF, (uint8_t)SYNC_FOLLOWER));
+  }
+}
+
+/**
+ * @brief Put every setting back to its power-on default
+ */
+void restoreDefaults() {
+  SavedState defaults;
+  defaults.autoPlay = false;
+  defaults.ledsEnabled = true;
+  defaults.ledPattern = LED_PATTERN_DEFAULT;
+  defaults.visualizer = false;
+  defaults.fastBoot = false;
+  defaults.transpose = 0;
+  defaults.tempo = 100;
+  defaults.songGap = 0;
+  defaults.harmony = HARMONY_WRITTEN;
+  defaults.syncRole = SYNC_OFF;
+  defaults.melodyVolume = PITCH_VOLUME_MAX;
+  defaults.harmonyVolume = PITCH_VOLUME_MAX;
+  defaults.song = -1;
+  applySettings(defaults);
+  cancelNextSong(); // Re-cue with the new settings
+  
+  // Match what is playing now, so the next checkpoint is not forced early
+  captureSettings(savedState);
+  savedState.song = currentSong;
+  savedState.resume = buzzer.isPlaying();
+  savedState.positionMs = 0;
+}
+
+/**
+ * @brief Record the current song and position in EEPROM
+ * @param playing Whether to resume this song on the next power-up
+ */
+void saveResumePoint(bool playing) {
+  savedState.song = currentSong;
+  savedState.resume = playing;
+  savedState.positionMs = playing ? buzzer.getSongPosition() : 0;
+  settingsStore.save(savedState);
+  lastResumeSave = millis();
+}
+
+/**
+ * @brief Start a song part-way through, as saved before power was lost
+ */
+void resumeSong(int songIndex, unsigned long positionMs) {
+  currentSong = songIndex;
+  loadSong(currentSong);
+  buzzer.play();
+  buzzer.seek(positionMs);
+  wasPlaying = true;
+  
+  char songName[50];
+  getSongName(currentSong, songName, sizeof(songName));
+  Serial.println("Resuming: " + String(songName) + " at " + String(positionMs / 1000) + "s");
+}
+
 void playStartupSequence() {
   // Clear display
   if (lcdAvailable) {
     lcd.clear();
     lcd.setCursor(0, 0);
     lcd.print("Starting up...");
+    lcd.flush(); // The chime blocks, so send the message now
   }
   
   // Play startup chime with synchronized LEDs
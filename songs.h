@@ -0,0 +1,281 @@
+/**
+ * @file songs.h
+ * @brief Song library: note tables, lyric timings and the songs[] index
+ *
+ * @details Kept apart from main.ino so host tools (see host/) can load the
+ * exact tables the sketch plays. Include from one translation unit only;
+ * the tables are defined here, in PROGMEM.
+ */
+
+#ifndef SONGS_H
+#define SONGS_H
+#include "DualBuzzer.h"
+#include "pitches.h"
+
+// Song 1: Twinkle Twinkle Little Star - PROGMEM
+constexpr Note twinkleMelody[] PROGMEM = {
+  // Verse 1: "Twinkle, twinkle, little star"
+  {NOTE_C4, 400}, {NOTE_C4, 400}, {NOTE_G4, 400}, {NOTE_G4, 400},
+  {NOTE_A4, 400}, {NOTE_A4, 400}, {NOTE_G4, 800},
+  
+  // "How I wonder what you are"
+  {NOTE_F4, 400}, {NOTE_F4, 400}, {NOTE_E4, 400}, {NOTE_E4, 400},
+  {NOTE_D4, 400}, {NOTE_D4, 400}, {NOTE_C4, 800},
+  
+  // Verse 2: "Up above the world so high"
+  {NOTE_G4, 400}, {NOTE_G4, 400}, {NOTE_F4, 400}, {NOTE_F4, 400},
+  {NOTE_E4, 400}, {NOTE_E4, 400}, {NOTE_D4, 800},
+  
+  // "Like a diamond in the sky"
+  {NOTE_G4, 400}, {NOTE_G4, 400}, {NOTE_F4, 400}, {NOTE_F4, 400},
+  {NOTE_E4, 400}, {NOTE_E4, 400}, {NOTE_D4, 800},
+  
+  // Verse 3: "When the blazing sun is gone"
+  {NOTE_C4, 400}, {NOTE_C4, 400}, {NOTE_G4, 400}, {NOTE_G4, 400},
+  {NOTE_A4, 400}, {NOTE_A4, 400}, {NOTE_G4, 800},
+  
+  // "When he nothing shines upon"
+  {NOTE_F4, 400}, {NOTE_F4, 400}, {NOTE_E4, 400}, {NOTE_E4, 400},
+  {NOTE_D4, 400}, {NOTE_D4, 400}, {NOTE_C4, 800},
+  
+  // Verse 4: "Then you show your little light"
+  {NOTE_G4, 400}, {NOTE_G4, 400}, {NOTE_F4, 400}, {NOTE_F4, 400},
+  {NOTE_E4, 400}, {NOTE_E4, 400}, {NOTE_D4, 800},
+  
+  // "Twinkle, twinkle, all the night"
+  {NOTE_G4, 400}, {NOTE_G4, 400}, {NOTE_F4, 400}, {NOTE_F4, 400},
+  {NOTE_E4, 400}, {NOTE_E4, 400}, {NOTE_D4, 800},
+  
+  // Final verse: "Twinkle, twinkle, little star"
+  {NOTE_C4, 400}, {NOTE_C4, 400}, {NOTE_G4, 400}, {NOTE_G4, 400},
+  {NOTE_A4, 400}, {NOTE_A4, 400}, {NOTE_G4, 800},
+  
+  // "How I wonder what you are"
+  {NOTE_F4, 400}, {NOTE_F4, 400}, {NOTE_E4, 400}, {NOTE_E4, 400},
+  {NOTE_D4, 400}, {NOTE_D4, 400}, {NOTE_C4, 800}
+};
+
+
+constexpr Note twinkleHarmony[] PROGMEM = {
+  // Verse 1 harmony
+  {NOTE_E4, 400}, {NOTE_E4, 400}, {NOTE_B4, 400}, {NOTE_B4, 400},
+  {NOTE_C5, 400}, {NOTE_C5, 400}, {NOTE_B4, 800},
+  {NOTE_A4, 400}, {NOTE_A4, 400}, {NOTE_G4, 400}, {NOTE_G4, 400},
+  {NOTE_F4, 400}, {NOTE_F4, 400}, {NOTE_E4, 800},
+  
+  // Verse 2 harmony
+  {NOTE_E4, 400}, {NOTE_E4, 400}, {NOTE_D4, 400}, {NOTE_D4, 400},
+  {NOTE_C4, 400}, {NOTE_C4, 400}, {NOTE_B3, 800},
+  {NOTE_E4, 400}, {NOTE_E4, 400}, {NOTE_D4, 400}, {NOTE_D4, 400},
+  {NOTE_C4, 400}, {NOTE_C4, 400}, {NOTE_B3, 800},
+  
+  // Verse 3 harmony
+  {NOTE_E4, 400}, {NOTE_E4, 400}, {NOTE_B4, 400}, {NOTE_B4, 400},
+  {NOTE_C5, 400}, {NOTE_C5, 400}, {NOTE_B4, 800},
+  {NOTE_A4, 400}, {NOTE_A4, 400}, {NOTE_G4, 400}, {NOTE_G4, 400},
+  {NOTE_F4, 400}, {NOTE_F4, 400}, {NOTE_E4, 800},
+  
+  // Verse 4 harmony
+  {NOTE_E4, 400}, {NOTE_E4, 400}, {NOTE_D4, 400}, {NOTE_D4, 400},
+  {NOTE_C4, 400}, {NOTE_C4, 400}, {NOTE_B3, 800},
+  {NOTE_E4, 400}, {NOTE_E4, 400}, {NOTE_D4, 400}, {NOTE_D4, 400},
+  {NOTE_C4, 400}, {NOTE_C4, 400}, {NOTE_B3, 800},
+  
+  // Final verse harmony
+  {NOTE_E4, 400}, {NOTE_E4, 400}, {NOTE_B4, 400}, {NOTE_B4, 400},
+  {NOTE_C5, 400}, {NOTE_C5, 400}, {NOTE_B4, 800},
+  {NOTE_A4, 400}, {NOTE_A4, 400}, {NOTE_G4, 400}, {NOTE_G4, 400},
+  {NOTE_F4, 400}, {NOTE_F4, 400}, {NOTE_E4, 800}
+};
+
+// Word-based lyrics for Twinkle Twinkle Little Star - PROGMEM
+
+constexpr LyricTiming twinkleLyricTimings[] PROGMEM = {
+    // First verse
+    {"/Twinkle", 0}, {"twinkle", 800}, {"little", 1600}, {"star", 2400},
+    {"/How", 3200}, {"I", 3600}, {"wonder", 4000}, {"what", 4800}, {"you", 5200}, {"are", 5600},
+
+    // Second verse
+    {"/Up", 6400}, {"above", 6800}, {"the", 7600}, {"world", 8000}, {"so", 8400}, {"high", 8800},
+    {"/Like", 9600}, {"a", 10000}, {"diamond", 10400}, {"in", 11200}, {"the", 11600}, {"sky", 12000},
+
+    // Third verse
+    {"/When", 12800}, {"the", 13200}, {"blazing", 13600}, {"sun", 14400}, {"is", 14800}, {"gone", 15200},
+    {"/When", 16000}, {"he", 16400}, {"nothing", 16800}, {"shines", 17600}, {"upon", 18000},
+
+    // Fourth verse
+    {"/Then", 19200}, {"you", 19600}, {"show", 20000}, {"your", 20400}, {"little", 20800}, {"light", 21600},
+    {"/Twinkle", 22400}, {"twinkle", 23200}, {"all", 24000}, {"the", 24400}, {"night", 24800},
+
+    // Final verse
+    {"/Twinkle", 25600}, {"twinkle", 26400}, {"little", 27200}, {"star", 28000},
+    {"/How", 28800}, {"I", 29200}, {"wonder", 29600}, {"what", 30400}, {"you", 30800}, {"are", 31200}
+};
+
+
+// Song 2: Jingle Bells - PROGMEM
+constexpr Note jingleMelody[] PROGMEM = {
+  // "Jingle bells, jingle bells"
+  {NOTE_E4, 300}, {NOTE_E4, 300}, {NOTE_E4, 600},
+  {NOTE_E4, 300}, {NOTE_E4, 300}, {NOTE_E4, 600},
+  {NOTE_E4, 300}, {NOTE_G4, 300}, {NOTE_C4, 450}, {NOTE_D4, 150},
+  {NOTE_E4, 1200},
+  
+  // "Jingle all the way"
+  {NOTE_F4, 300}, {NOTE_F4, 300}, {NOTE_F4, 450}, {NOTE_F4, 150},
+  {NOTE_F4, 300}, {NOTE_E4, 300}, {NOTE_E4, 300}, {NOTE_E4, 300},
+  {NOTE_E4, 300}, {NOTE_D4, 300}, {NOTE_D4, 300}, {NOTE_E4, 300},
+  {NOTE_D4, 600}, {NOTE_G4, 600},
+  
+  // "Oh what fun it is to ride"
+  {NOTE_E4, 300}, {NOTE_E4, 300}, {NOTE_E4, 600},
+  {NOTE_E4, 300}, {NOTE_E4, 300}, {NOTE_E4, 600},
+  {NOTE_E4, 300}, {NOTE_G4, 300}, {NOTE_C4, 450}, {NOTE_D4, 150},
+  {NOTE_E4, 1200},
+  
+  // "In a one-horse open sleigh"
+  {NOTE_F4, 300}, {NOTE_F4, 300}, {NOTE_F4, 450}, {NOTE_F4, 150},
+  {NOTE_F4, 300}, {NOTE_E4, 300}, {NOTE_E4, 300}, {NOTE_E4, 300},
+  {NOTE_G4, 300}, {NOTE_G4, 300}, {NOTE_F4, 300}, {NOTE_D4, 300},
+  {NOTE_C4, 1200}
+};
+
+constexpr Note jingleHarmony[] PROGMEM = {
+  // Harmony for "Jingle bells, jingle bells"
+  {NOTE_C4, 300}, {NOTE_C4, 300}, {NOTE_C4, 600},
+  {NOTE_C4, 300}, {NOTE_C4, 300}, {NOTE_C4, 600},
+  {NOTE_C4, 300}, {NOTE_E4, 300}, {NOTE_G3, 450}, {NOTE_B3, 150},
+  {NOTE_C4, 1200},
+  
+  // Harmony for "Jingle all the way"
+  {NOTE_D4, 300}, {NOTE_D4, 300}, {NOTE_D4, 450}, {NOTE_D4, 150},
+  {NOTE_D4, 300}, {NOTE_C4, 300}, {NOTE_C4, 300}, {NOTE_C4, 300},
+  {NOTE_G3, 300}, {NOTE_B3, 300}, {NOTE_B3, 300}, {NOTE_C4, 300},
+  {NOTE_B3, 600}, {NOTE_D4, 600},
+  
+  // Repeat harmony pattern
+  {NOTE_C4, 300}, {NOTE_C4, 300}, {NOTE_C4, 600},
+  {NOTE_C4, 300}, {NOTE_C4, 300}, {NOTE_C4, 600},
+  {NOTE_C4, 300}, {NOTE_E4, 300}, {NOTE_G3, 450}, {NOTE_B3, 150},
+  {NOTE_C4, 1200},
+  
+  {NOTE_D4, 300}, {NOTE_D4, 300}, {NOTE_D4, 450}, {NOTE_D4, 150},
+  {NOTE_D4, 300}, {NOTE_C4, 300}, {NOTE_C4, 300}, {NOTE_C4, 300},
+  {NOTE_E4, 300}, {NOTE_E4, 300}, {NOTE_D4, 300}, {NOTE_B3, 300},
+  {NOTE_G3, 1200}
+};
+
+constexpr LyricTiming jingleLyricTimings[] PROGMEM = {
+    // First verse: "Jingle bells, jingle bells, jingle all the way"
+    {"/Jingle", 0}, {"bells", 300}, {"jingle", 1200}, {"bells", 1500}, {"jingle", 2400},
+    {"all", 2700}, {"the", 3000}, {"way", 3450},
+
+    // Second part: "Oh what fun it is to ride in a one-horse open sleigh"
+    {"/Oh", 4800}, {"what", 5100}, {"fun", 5400}, {"it", 5850}, {"is", 6000}, {"to", 6300}, {"ride", 6600},
+    {"in", 6900}, {"a", 7200}, {"one", 7500}, {"horse", 7800}, {"open", 8100}, {"sleigh", 8400},
+
+    // Repeat: "Jingle bells, jingle bells, jingle all the way"
+    {"/Jingle", 9600}, {"bells", 9900}, {"jingle", 10800}, {"bells", 11100}, {"jingle", 12000},
+    {"all", 12300}, {"the", 12600}, {"way", 13050},
+
+    // Final: "Oh what fun it is to ride in a one-horse open sleigh"
+    {"/Oh", 14400}, {"what", 14700}, {"fun", 15000}, {"it", 15450}, {"is", 15600}, {"to", 15900}, {"ride", 16200},
+    {"in", 16500}, {"a", 16800}, {"one", 17100}, {"horse", 17400}, {"open", 17700}, {"sleigh", 18000}
+};
+
+// Song 3: Mary Had a Little Lamb
+constexpr Note maryMelody[] PROGMEM = {
+  // Verse 1
+  {NOTE_E4, 400}, {NOTE_D4, 400}, {NOTE_C4, 400}, {NOTE_D4, 400},
+  {NOTE_E4, 400}, {NOTE_E4, 400}, {NOTE_E4, 800},
+  
+  {NOTE_D4, 400}, {NOTE_D4, 400}, {NOTE_D4, 800},
+  
+  {NOTE_E4, 400}, {NOTE_G4, 400}, {NOTE_G4, 800},
+  
+  {NOTE_E4, 400}, {NOTE_D4, 400}, {NOTE_C4, 400}, {NOTE_D4, 400},
+  {NOTE_E4, 400}, {NOTE_E4, 400}, {NOTE_E4, 400}, {NOTE_E4, 400},
+  
+  {NOTE_D4, 400}, {NOTE_D4, 400}, {NOTE_E4, 400}, {NOTE_D4, 400},
+  {NOTE_C4, 800}
+};
+
+// Lyrics timings: word and song time (ms) it starts
+constexpr LyricTiming maryLyricTimings[] PROGMEM = {
+  {"/Mary", 0}, {"had", 800}, {"a", 1200}, {"little", 1600}, {"lamb,", 2400},
+  {"little", 3200}, {"lamb,", 4000},
+  {"/Its", 4800}, {"fleece", 5200}, {"was", 5600},
+  {"white", 6400}, {"as", 6800}, {"snow.", 7200},
+  {"/Everywhere", 7600}, {"that", 8000}, {"Mary", 8400}, {"went,", 9200}, {"the", 10000}, {"lamb", 10400}
+};
+
+
+
+// Song measurements, worked out by the compiler. A table whose parts end
+// at different times, or whose lyrics are out of order or run past the
+// end of the song, stops the build here.
+constexpr SongInfo twinkleInfo = describeSong(twinkleMelody, twinkleHarmony);
+static_assert(partsMatch(twinkleMelody, twinkleHarmony), "Twinkle: melody and harmony lengths differ");
+static_assert(lyricsSorted(twinkleLyricTimings), "Twinkle: lyrics are out of order");
+static_assert(lyricsWithin(twinkleLyricTimings, twinkleInfo.durationMs), "Twinkle: lyrics run past the end");
+
+constexpr SongInfo jingleInfo = describeSong(jingleMelody, jingleHarmony);
+static_assert(partsMatch(jingleMelody, jingleHarmony), "Jingle Bells: melody and harmony lengths differ");
+static_assert(lyricsSorted(jingleLyricTimings), "Jingle Bells: lyrics are out of order");
+static_assert(lyricsWithin(jingleLyricTimings, jingleInfo.durationMs), "Jingle Bells: lyrics run past the end");
+
+// Mary's harmony is generated, a third below the melody in C major
+constexpr SongInfo maryInfo = describeMelody(maryMelody);
+static_assert(lyricsSorted(maryLyricTimings), "Mary: lyrics are out of order");
+static_assert(lyricsWithin(maryLyricTimings, maryInfo.durationMs), "Mary: lyrics run past the end");
+
+// Song table entry; every pointer is to PROGMEM. A melody-only song has
+// a NULL harmony and generates one by its style's rule; the style's key
+// and beat are also used when the "harmony" command picks a rule.
+struct Song {
+  const Note* melody;
+  int melodyLength;
+  const Note* harmony;
+  int harmonyLength;
+  const int8_t* melodyAccents;      // One per note, or NULL for none
+  const int8_t* harmonyAccents;
+  const LyricTiming* lyrics;
+  int lyricsCount;
+  SongInfo info;
+  HarmonyStyle harmonyStyle;
+  const char* name;
+};
+
+const Song songs[] PROGMEM = {
+  {
+    twinkleMelody, sizeof(twinkleMelody) / sizeof(twinkleMelody[0]),
+    twinkleHarmony, sizeof(twinkleHarmony) / sizeof(twinkleHarmony[0]),
+    NULL, NULL,                             // No accents
+    twinkleLyricTimings, sizeof(twinkleLyricTimings) / sizeof(twinkleLyricTimings[0]),
+    twinkleInfo,
+    { HARMONY_WRITTEN, 0, false, 400 },     // C major
+    "Twinkle Little Star"
+  },
+  {
+    jingleMelody, sizeof(jingleMelody) / sizeof(jingleMelody[0]),
+    jingleHarmony, sizeof(jingleHarmony) / sizeof(jingleHarmony[0]),
+    NULL, NULL,                             // No accents
+    jingleLyricTimings, sizeof(jingleLyricTimings) / sizeof(jingleLyricTimings[0]),
+    jingleInfo,
+    { HARMONY_WRITTEN, 0, false, 300 },     // C major
+    "Jingle Bells"
+  },
+  {
+    maryMelody, sizeof(maryMelody) / sizeof(maryMelody[0]),
+    NULL, 0,
+    NULL, NULL,                             // No accents
+    maryLyricTimings, sizeof(maryLyricTimings) / sizeof(maryLyricTimings[0]),
+    maryInfo,
+    { HARMONY_THIRD, 0, false, 400 },       // Thirds in C major
+    "Mary Had a Little Lamb"
+  }
+};
+
+const int SONG_COUNT = sizeof(songs) / sizeof(songs[0]);
+
+#endif